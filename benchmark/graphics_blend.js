@@ -0,0 +1,16 @@
+// Time antialiased drawing on a 16 bit Graphics, where every edge pixel is blended
+var g = Graphics.createArrayBuffer(176,176,16,{msb:true});
+var t = getTime();
+for (var i=0;i<200;i++) {
+  var a = i*Math.PI/100;
+  g.setColor(i*0x0841).drawLineAA(88,88,88+Math.sin(a)*85,88+Math.cos(a)*85);
+}
+var lineTime = getTime()-t;
+var poly = [];
+for (var i=0;i<32;i++) poly.push(88+Math.sin(i*Math.PI/16)*(i&1?40:80), 88+Math.cos(i*Math.PI/16)*(i&1?40:80));
+t = getTime();
+for (var i=0;i<50;i++)
+  g.setColor(i*0x1234).fillPolyAA(poly);
+var polyTime = getTime()-t;
+print("200 drawLineAA: "+(lineTime*1000).toFixed(1)+"ms");
+print("50 fillPolyAA: "+(polyTime*1000).toFixed(1)+"ms");
@@ -0,0 +1,23 @@
+// Time compositing a 176x176 screen from 3 layers with drawImages: a full screen
+// 4bpp background, a tiled 8bpp pattern with transparency, and a 1bpp overlay
+var W = 176, H = 176;
+var g = Graphics.createArrayBuffer(W,H,16,{msb:true});
+var bg = Graphics.createArrayBuffer(W,H,4,{msb:true});
+for (var i=0;i<W;i+=8) bg.setColor(i>>3).fillRect(i,0,i+7,H-1);
+var tile = Graphics.createArrayBuffer(16,16,8,{msb:true});
+tile.setColor(1).fillCircle(8,8,6).setColor(2).fillCircle(8,8,3);
+var fg = Graphics.createArrayBuffer(W,H,1,{msb:true});
+fg.setColor(1).setFont("Vector",40).setFontAlign(0,0).drawString("12:34",W/2,H/2);
+var pal8 = new Uint16Array(256);
+pal8[1] = 0xF800; pal8[2] = 0xFFE0;
+var layers = [
+  {x:0,y:0,image:{width:W,height:H,bpp:4,buffer:bg.buffer}},
+  {x:0,y:0,repeat:true,image:{width:16,height:16,bpp:8,buffer:tile.buffer,palette:pal8,transparent:0}},
+  {x:0,y:0,image:{width:W,height:H,bpp:1,buffer:fg.buffer,transparent:0}}
+];
+var frames = 20;
+var t = getTime();
+for (var i=0;i<frames;i++)
+  g.drawImages(layers,{x:0,y:0,width:W,height:H});
+t = getTime()-t;
+print("drawImages, 3 layers "+W+"x"+H+": "+(t*1000/frames).toFixed(2)+"ms/frame");
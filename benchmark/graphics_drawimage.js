@@ -0,0 +1,19 @@
+// Time full-screen drawImage calls on a 176x176 16 bit Graphics (ArrayBuffers are limited to 64kB)
+var g = Graphics.createArrayBuffer(176,176,16,{msb:true});
+function mkImage(bpp, transparent) {
+  var img = { width:176, height:176, bpp:bpp, buffer:new ArrayBuffer(176*176*bpp/8) };
+  var b = new Uint8Array(img.buffer);
+  for (var i=0;i<b.length;i++) b[i] = (i*31)>>3;
+  if (transparent!==undefined) img.transparent = transparent;
+  return img;
+}
+[["16bpp", mkImage(16)],
+ ["16bpp transparent", mkImage(16, 0)],
+ ["8bpp", mkImage(8)],
+ ["4bpp", mkImage(4)],
+ ["1bpp", mkImage(1)]].forEach(function(t) {
+  var n = 20, time = getTime();
+  for (var i=0;i<n;i++) g.drawImage(t[1], 0, 0);
+  time = getTime()-time;
+  print(t[0]+": "+(time*1000/n).toFixed(2)+"ms per draw");
+});
@@ -0,0 +1,23 @@
+// Time clear, fillRect and horizontal lines on ArrayBuffer Graphics of different bit depths and layouts
+// (shows how long each call takes, including the overhead of calling it from JS)
+function bench(bpp, opts) {
+  var g = Graphics.createArrayBuffer(128,128,bpp,opts);
+  var n = 200, t, r = [];
+  t = getTime();
+  for (var i=0;i<n;i++) g.setBgColor(i&1).clear();
+  r.push((getTime()-t)*1000000/n);
+  t = getTime();
+  for (var i=0;i<n;i++) g.setColor(i&3).fillRect(3+(i&3),5,120-(i&7),117);
+  r.push((getTime()-t)*1000000/n);
+  t = getTime();
+  for (var i=0;i<n;i++) g.drawLine(1+(i&3),i&127,126-(i&3),i&127);
+  r.push((getTime()-t)*1000000/n);
+  print((bpp+"bpp "+JSON.stringify(opts||{})+"                  ").substr(0,30)+
+        "clear "+r[0].toFixed(1)+"us, fillRect "+r[1].toFixed(1)+"us, hline "+r[2].toFixed(1)+"us");
+}
+[1,2,4,8,16,24].forEach(bpp => bench(bpp));
+bench(1,{msb:true});
+bench(4,{msb:true});
+bench(1,{vertical_byte:true});
+bench(4,{interleavex:true});
+bench(8,{interleavex:true});
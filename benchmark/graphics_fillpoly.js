@@ -0,0 +1,16 @@
+// Time polygon filling - big vector font text, a many-pointed star and antialiased polygons
+var g = Graphics.createArrayBuffer(240,200,8);
+var star = [];
+for (var i=0;i<60;i++) {
+  var r = (i&1) ? 40 : 95, a = i*Math.PI/30;
+  star.push(120+r*Math.sin(a), 100-r*Math.cos(a));
+}
+function time(name, n, fn) {
+  var t = getTime();
+  for (var i=0;i<n;i++) fn(i);
+  print(name+": "+((getTime()-t)*1000/n).toFixed(3)+"ms");
+}
+time("vector font 60px", 20, () => g.setFont("Vector",60).drawString("Hello 123",0,0));
+time("vector font 16px", 50, () => g.setFont("Vector",16).drawString("The quick brown fox",0,100));
+time("fillPoly star", 50, () => g.fillPoly(star));
+time("fillPolyAA star", 20, () => g.fillPolyAA(star));
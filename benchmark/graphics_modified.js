@@ -0,0 +1,59 @@
+// Estimate bytes sent to the display per frame for a typical watch face redraw,
+// comparing flipping the whole modified bounding box with flipping just the
+// modified rectangles from getModified().rects
+var W = 176, H = 176;
+var g = Graphics.createArrayBuffer(W,H,4);
+// Memory LCD (Bangle.js 2): whole rows of 3 bits per pixel + 2 byte header each
+function memlcdBytes(rects) {
+  var rows = new Uint8Array(H), runs = 0, bytes = 0;
+  rects.forEach(r => rows.fill(1, r.y1, r.y2+1));
+  for (var y=0;y<H;y++) if (rows[y]) {
+    bytes += 2+Math.ceil(W*3/8);
+    if (!y || !rows[y-1]) runs++;
+  }
+  return bytes + runs*2;
+}
+// 16 bit SPI LCD: 11 bytes to set up a window, then full rows if the area is over half the width
+function spilcdBytes(rects) {
+  var bytes = 0;
+  rects.forEach(r => {
+    var x1 = r.x1&~1, x2 = Math.min(r.x2|1, W-1);
+    if ((x2+1-x1)*2 > W) { x1 = 0; x2 = W-1; }
+    bytes += 11 + (x2+1-x1)*(r.y2+1-r.y1)*2;
+  });
+  return bytes;
+}
+function drawFace(t) {
+  var d = new Date(t);
+  // big time in the middle
+  g.reset().setFont("Vector",48).setFontAlign(0,0);
+  g.clearRect(0,60,W-1,110).drawString(("0"+d.getHours()).substr(-2)+":"+("0"+d.getMinutes()).substr(-2), W/2, 86);
+  // seconds in the bottom right
+  g.setFont("4x6",3).setFontAlign(1,1);
+  g.clearRect(W-30,H-20,W-1,H-1).drawString(("0"+d.getSeconds()).substr(-2), W-2, H-2);
+  // battery icon in the top left
+  g.clearRect(0,0,23,11).drawRect(0,0,20,11).fillRect(21,3,23,8).fillRect(2,2,2+(d.getSeconds()%17),9);
+}
+var frames = 60, bboxSpi = 0, rectSpi = 0, bboxMem = 0, rectMem = 0, nRects = 0;
+var t0 = new Date(2021,0,1,10,9,0).getTime();
+drawFace(t0);
+g.getModified(true);
+var t = getTime();
+for (var i=1;i<=frames;i++) {
+  // update seconds and battery every frame, the time once a minute
+  var d = new Date(t0+i*1000);
+  if (d.getSeconds()) {
+    g.setFont("4x6",3).setFontAlign(1,1);
+    g.clearRect(W-30,H-20,W-1,H-1).drawString(("0"+d.getSeconds()).substr(-2), W-2, H-2);
+    g.clearRect(0,0,23,11).drawRect(0,0,20,11).fillRect(21,3,23,8).fillRect(2,2,2+(d.getSeconds()%17),9);
+  } else drawFace(d.getTime());
+  var m = g.getModified(true);
+  var bbox = [{x1:m.x1,y1:m.y1,x2:m.x2,y2:m.y2}];
+  bboxSpi += spilcdBytes(bbox); rectSpi += spilcdBytes(m.rects);
+  bboxMem += memlcdBytes(bbox); rectMem += memlcdBytes(m.rects);
+  nRects += m.rects.length;
+}
+t = getTime()-t;
+print("Draw time: "+(t*1000/frames).toFixed(2)+"ms/frame, "+(nRects/frames).toFixed(1)+" rects/frame");
+print("SPI LCD 16 bit: bounding box "+Math.round(bboxSpi/frames)+" bytes/frame, rects "+Math.round(rectSpi/frames)+" bytes/frame");
+print("Memory LCD:     bounding box "+Math.round(bboxMem/frames)+" bytes/frame, rects "+Math.round(rectMem/frames)+" bytes/frame");
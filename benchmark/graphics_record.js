@@ -0,0 +1,44 @@
+// Time redrawing a watch face each second with normal draw calls, with
+// Graphics.replay redrawing everything, and with Graphics.replay only
+// redrawing what has changed
+var W = 176, H = 176;
+var g = Graphics.createArrayBuffer(W,H,4);
+var face = {time:"10:09", secs:"00", batt:0};
+function drawFace(g, f) {
+  g.reset().clearRect(0,24,W-1,H-1);
+  g.setColor(3).fillRect({x:4,y:28,x2:W-5,y2:56,r:8}).setColor(15);
+  g.setFont("Vector",48).setFontAlign(0,0).drawString(f.time, W/2, 100);
+  g.setFont("4x6",3).setFontAlign(1,1).drawString(f.secs, W-2, H-2);
+  g.setFontAlign(-1,-1).drawString("Mon 1 Jan", 10, 34);
+  g.drawRect(0,H-12,20,H-1).fillRect(21,H-9,23,H-4).fillRect(2,H-10,2+f.batt,H-3);
+  for (var i=0;i<12;i++) {
+    var a = i*Math.PI/6;
+    g.drawLine(W/2+Math.sin(a)*60, 100-Math.cos(a)*60, W/2+Math.sin(a)*66, 100-Math.cos(a)*66);
+  }
+}
+// indices of the commands we'll override
+var TIME = 7, SECS = 10, BATT = 15;
+var list = g.record(g => drawFace(g, face));
+var frames = 120;
+function run(name, fn) {
+  g.replay(list, undefined, true);
+  g.getModified(true);
+  var t = getTime(), area = 0;
+  for (var i=1;i<=frames;i++) {
+    var f = {time:"10:"+(10+(i/60|0)), secs:("0"+(i%60)).substr(-2), batt:i%17};
+    fn(f);
+    var m = g.getModified(true);
+    if (m) area += (m.x2+1-m.x1)*(m.y2+1-m.y1);
+  }
+  t = getTime()-t;
+  print(name+": "+(t*1000/frames).toFixed(2)+"ms/frame, "+Math.round(area/frames)+" pixels modified/frame");
+}
+run("Draw calls", f => drawFace(g, f));
+run("replay all", f => {
+  var o = {}; o[TIME] = f.time; o[SECS] = f.secs; o[BATT] = [2,H-10,2+f.batt,H-3];
+  g.replay(list, o, true);
+});
+run("replay", f => {
+  var o = {}; o[TIME] = f.time; o[SECS] = f.secs; o[BATT] = [2,H-10,2+f.batt,H-3];
+  g.replay(list, o);
+});
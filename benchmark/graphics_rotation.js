@@ -0,0 +1,22 @@
+// Compare drawing speed with each setRotation - rotated drawing should be about as fast as unrotated
+function fill(a,f) { for (var i=0;i<a.length;i++) a[i]=f(i); return a; }
+var g = Graphics.createArrayBuffer(176,176,16);
+var img8 = {width:64,height:64,bpp:8,buffer:fill(new Uint8Array(64*64),i=>i*7).buffer};
+var img16 = {width:64,height:64,bpp:16,buffer:fill(new Uint16Array(64*64),i=>i*77).buffer};
+var img1 = {width:64,height:64,bpp:1,buffer:fill(new Uint8Array(64*64/8),i=>i*7).buffer};
+var imgT = {width:64,height:64,bpp:8,transparent:0,buffer:fill(new Uint8Array(64*64),i=>(i%5)?i:0).buffer};
+function time(n, fn) {
+  var t = getTime();
+  for (var i=0;i<n;i++) fn(i);
+  return ((getTime()-t)*1000/n).toFixed(3)+"ms";
+}
+[0,1,2,3].forEach(function(r) {
+  g.setRotation(r);
+  print("setRotation("+r+"):"+
+    " fillRect "+time(200,()=>g.fillRect(10,20,160,150))+
+    ", drawImage 8bpp "+time(100,()=>g.drawImage(img8,30,40))+
+    ", 16bpp "+time(100,()=>g.drawImage(img16,30,40))+
+    ", 1bpp "+time(100,()=>g.drawImage(img1,30,40))+
+    ", transparent "+time(100,()=>g.drawImage(imgT,30,40))+
+    ", scale 1.5 "+time(20,()=>g.drawImage(img8,30,40,{scale:1.5})));
+});
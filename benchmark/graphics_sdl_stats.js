@@ -0,0 +1,21 @@
+// Redraw a simple watch-face style UI on a headless SDL Graphics and report
+// g.getStats() for each frame (frame time, pixels drawn, bytes flushed)
+// Needs a build with USE_LCD_SDL=1 or USE_LCD_SDL=headless
+var W = 176, H = 176;
+var g = Graphics.createSDL(W,H,16,{headless:true});
+var totals = {frameTime:0, pixels:0, flushBytes:0};
+var FRAMES = 60;
+for (var i=0;i<=FRAMES;i++) {
+  g.reset();
+  if (i==0) g.clear(); // first frame draws everything
+  g.clearRect(20,60,W-20,110);
+  g.setFont("Vector",40).setFontAlign(0,0).drawString("10:"+("0"+(i%60)).substr(-2), W/2, 85);
+  g.setColor(0x07E0).fillRect(0,H-8,(i*W/FRAMES)|0,H-1);
+  g.flip();
+  var s = g.getStats();
+  if (i>0) for (var k in totals) totals[k] += s[k];
+}
+print("Average over "+FRAMES+" frames:");
+print(" frame time "+(totals.frameTime/FRAMES).toFixed(2)+"ms");
+print(" pixels drawn "+(totals.pixels/FRAMES|0));
+print(" bytes flushed "+(totals.flushBytes/FRAMES|0));
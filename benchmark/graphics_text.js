@@ -0,0 +1,21 @@
+// Time redrawing the same text labels - as UIs that update every second do
+var g = Graphics.createArrayBuffer(240,160,8);
+var text = "The quick brown fox jumps over the lazy dog 0123456789";
+function time(name, n, fn) {
+  var t = getTime();
+  for (var i=0;i<n;i++) fn(i);
+  print(name+": "+((getTime()-t)*1000/n).toFixed(3)+"ms");
+}
+time("vector 20px drawString", 50, () => g.setFont("Vector",20).drawString(text,0,0));
+time("vector 40px drawString", 50, () => g.setFont("Vector",40).drawString("12:34",0,40));
+time("vector stringWidth", 200, () => g.setFont("Vector",20).stringWidth(text));
+time("vector wrapString", 100, () => g.setFont("Vector",20).wrapString(text+" "+text, 200));
+// a made-up 16px high proportional custom font
+var widths = "", bits = 0;
+for (var c=32;c<128;c++) { var w = 4+(c%6); widths += String.fromCharCode(w); bits += w*16; }
+var bitmap = new Uint8Array(bits/8);
+for (var i=0;i<bitmap.length;i++) bitmap[i] = (i*73)^(i>>3);
+bitmap = E.toString(bitmap);
+time("custom drawString", 50, () => g.setFontCustom(bitmap,32,widths,16).drawString(text,0,100));
+time("custom x2 drawString", 50, () => g.setFontCustom(bitmap,32,widths,16|512).drawString("12:34:56",0,120));
+time("custom stringWidth", 200, () => g.setFontCustom(bitmap,32,widths,16).stringWidth(text));
@@ -0,0 +1,116 @@
+#!/usr/bin/python3
+
+# This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+#
+# Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+#
+# ----------------------------------------------------------------------------------------
+# Measure how many HTTP requests per second the Linux build's 'http' server
+# can handle over loopback: with a new connection for every request, with
+# one keep-alive connection, and with requests pipelined on a keep-alive
+# connection.
+#
+# ./benchmark/linux_http_requests.py [path/to/espruino] [count]
+# ----------------------------------------------------------------------------------------
+
+import os
+import socket
+import subprocess
+import sys
+import time
+
+ESPRUINO = sys.argv[1] if len(sys.argv)>1 else os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "espruino")
+COUNT = int(sys.argv[2]) if len(sys.argv)>2 else 1000
+PORT = 28773
+PIPELINE_DEPTH = 16
+
+code = """
+require("http").createServer(function(req, res) {
+  var body = "Hello " + req.url;
+  res.writeHead(200, {"Content-Type":"text/plain", "Content-Length":body.length});
+  res.end(body);
+}).listen(%d);
+console.log("READY");
+""" % PORT
+
+REQUEST = b"GET /test HTTP/1.1\r\nHost: localhost\r\nUser-Agent: benchmark\r\nAccept: */*\r\n\r\n"
+CLOSE_REQUEST = b"GET /test HTTP/1.1\r\nHost: localhost\r\nUser-Agent: benchmark\r\nAccept: */*\r\nConnection: close\r\n\r\n"
+
+class ResponseReader:
+  """ Reads responses (which must have a Content-Length) from a socket """
+  def __init__(self, sock):
+    self.sock = sock
+    self.data = b""
+  def read(self):
+    while b"\r\n\r\n" not in self.data:
+      self.recv()
+    headers, self.data = self.data.split(b"\r\n\r\n", 1)
+    length = 0
+    for line in headers.split(b"\r\n")[1:]:
+      k, v = line.split(b":", 1)
+      if k.strip().lower() == b"content-length": length = int(v)
+    while len(self.data) < length:
+      self.recv()
+    body, self.data = self.data[:length], self.data[length:]
+    if body != b"Hello /test": sys.exit("Bad response %r" % body)
+  def recv(self):
+    d = self.sock.recv(65536)
+    if not d: sys.exit("Connection closed")
+    self.data += d
+
+def connect():
+  sock = socket.create_connection(("127.0.0.1", PORT))
+  sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+  return sock
+
+def new_connections():
+  for i in range(COUNT):
+    sock = connect()
+    sock.sendall(CLOSE_REQUEST)
+    ResponseReader(sock).read()
+    sock.close()
+
+def keep_alive():
+  sock = connect()
+  reader = ResponseReader(sock)
+  for i in range(COUNT):
+    sock.sendall(REQUEST)
+    reader.read()
+  sock.close()
+
+def pipelined():
+  sock = connect()
+  reader = ResponseReader(sock)
+  for i in range(0, COUNT, PIPELINE_DEPTH):
+    n = min(PIPELINE_DEPTH, COUNT-i)
+    sock.sendall(REQUEST*n)
+    for j in range(n): reader.read()
+  sock.close()
+
+proc = subprocess.Popen([ESPRUINO, "-e", code],
+                        stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+try:
+  out = b""
+  while b"READY" not in out:
+    c = proc.stdout.read(1)
+    if not c:
+      print(out.decode(errors="replace"))
+      sys.exit("Espruino exited before it was ready")
+    out += c
+
+  tests = [
+    ("new connection each", new_connections),
+    ("keep-alive", keep_alive),
+    ("pipelined (%d deep)" % PIPELINE_DEPTH, pipelined),
+  ]
+  for name, test in tests:
+    start = time.perf_counter()
+    test()
+    seconds = time.perf_counter() - start
+    print("%-24s %6d requests in %.3fs = %8.1f requests/sec" % (name, COUNT, seconds, COUNT/seconds))
+finally:
+  proc.kill()
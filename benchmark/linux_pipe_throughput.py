@@ -0,0 +1,94 @@
+#!/usr/bin/python3
+
+# This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+#
+# Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+#
+# ----------------------------------------------------------------------------------------
+# Measure how fast the Linux build can move data with E.pipe between native
+# streams: a File piped to Serial1 (attached to a pseudo-terminal) and a
+# StorageFile piped to a socket.
+#
+# ./benchmark/linux_pipe_throughput.py [path/to/espruino] [kilobytes]
+# ----------------------------------------------------------------------------------------
+
+import os
+import pty
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+import tty
+
+ESPRUINO = sys.argv[1] if len(sys.argv)>1 else os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "espruino")
+KILOBYTES = int(sys.argv[2]) if len(sys.argv)>2 else 64
+NET_PORT = 28773
+total = KILOBYTES*1024
+
+master, slave = pty.openpty()
+tty.setraw(slave)
+tty.setraw(master)
+slavePath = os.ttyname(slave)
+fileData = bytes((i%64)+32 for i in range(total))
+tmp = tempfile.NamedTemporaryFile(delete=False)
+tmp.write(fileData)
+tmp.close()
+
+code = """
+var storage = require("Storage");
+var line = "";
+for (var i=0;i<256;i++) line += String.fromCharCode(32+(i&63));
+storage.open("pipe.txt","r").erase();
+var f = storage.open("pipe.txt","w");
+for (var i=0;i<%d*4;i++) f.write(line);
+Serial1.setup(115200, {path:%s});
+require("net").createServer(function(c) {
+  E.pipe(storage.open("pipe.txt","r"), c);
+}).listen(%d);
+function fileToSerial() {
+  E.pipe(E.openFile(%s,"r"), Serial1, {end:false});
+}
+console.log("READY");
+""" % (KILOBYTES, '"'+slavePath+'"', NET_PORT, '"'+tmp.name+'"')
+
+proc = subprocess.Popen([ESPRUINO], stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+try:
+  proc.stdin.write(b"echo(0);\n" + code.replace("\n", " ").encode() + b"\n")
+  proc.stdin.flush()
+  out = b""
+  while b"READY" not in out:
+    c = proc.stdout.read(1)
+    if not c:
+      print(out.decode(errors="replace"))
+      sys.exit("Espruino exited before it was ready")
+    out += c
+
+  # File -> Serial1
+  start = time.perf_counter()
+  proc.stdin.write(b"fileToSerial()\n")
+  proc.stdin.flush()
+  received = 0
+  while received < total:
+    received += len(os.read(master, 65536))
+  seconds = time.perf_counter() - start
+  print("%-24s %8d bytes in %.3fs = %8.1f kB/sec" % ("File -> Serial", received, seconds, received/1024/seconds))
+
+  # StorageFile -> socket
+  start = time.perf_counter()
+  sock = socket.create_connection(("127.0.0.1", NET_PORT))
+  received = 0
+  while True:
+    d = sock.recv(65536)
+    if not d: break
+    received += len(d)
+  sock.close()
+  seconds = time.perf_counter() - start
+  print("%-24s %8d bytes in %.3fs = %8.1f kB/sec" % ("StorageFile -> socket", received, seconds, received/1024/seconds))
+finally:
+  proc.kill()
+  os.unlink(tmp.name)
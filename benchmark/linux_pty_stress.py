@@ -0,0 +1,83 @@
+#!/usr/bin/python3
+
+# This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+#
+# Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+#
+# ----------------------------------------------------------------------------------------
+# Stress test the Linux build's serial receive path: attach Serial1 to a
+# pseudo-terminal, pump data in at full speed and report the sustained
+# bytes/sec that got through to Serial.on('data') - and whether the
+# input FIFO overflowed.
+#
+# ./benchmark/linux_pty_stress.py [path/to/espruino] [megabytes]
+# ----------------------------------------------------------------------------------------
+
+import os
+import pty
+import subprocess
+import sys
+import time
+import tty
+
+ESPRUINO = sys.argv[1] if len(sys.argv)>1 else os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "espruino")
+MEGABYTES = float(sys.argv[2]) if len(sys.argv)>2 else 4
+
+master, slave = pty.openpty()
+tty.setraw(slave)
+slavePath = os.ttyname(slave)
+total = int(MEGABYTES*1024*1024)
+
+code = """
+var n=0, t;
+Serial1.setup(115200, {path:%s});
+Serial1.on('data', function(d) {
+  if (!n) t=getTime();
+  n+=d.length;
+  if (n>=%d) {
+    var e = E.getErrorFlags();
+    console.log("RESULT", n, getTime()-t, JSON.stringify(e));
+    quit();
+  }
+});
+setInterval(function(){}, 1000); // keep running until we're done
+console.log("READY");
+""" % ('"'+slavePath+'"', total)
+
+proc = subprocess.Popen([ESPRUINO, "-e", code],
+                        stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+# wait for Espruino to open the pty
+out = b""
+while b"READY" not in out:
+  c = proc.stdout.read(1)
+  if not c:
+    print(out.decode(errors="replace"))
+    sys.exit("Espruino exited before it was ready")
+  out += c
+
+block = bytes((i%64)+32 for i in range(4096))
+sent = 0
+start = time.time()
+while sent < total:
+  sent += os.write(master, block[:min(len(block), total-sent)])
+
+out = b""
+for line in proc.stdout:
+  out += line
+  if b"RESULT" in line: break
+proc.kill()
+
+line = [l for l in out.decode(errors="replace").splitlines() if "RESULT" in l]
+if not line:
+  print(out.decode(errors="replace"))
+  sys.exit("No result")
+_, received, seconds, errors = line[0].split(" ", 3)
+received = int(received)
+seconds = float(seconds)
+print("Received %d bytes in %.3fs = %d bytes/sec" % (received, seconds, received/seconds if seconds else 0))
+print("Error flags: %s" % errors)
+sys.exit(0 if "FIFO_FULL" not in errors else 1)
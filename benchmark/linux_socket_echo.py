@@ -0,0 +1,80 @@
+#!/usr/bin/python3
+
+# This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+#
+# Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+#
+# ----------------------------------------------------------------------------------------
+# Measure how quickly the Linux build notices network traffic: run a TCP
+# echo server in Espruino, bounce small messages off it one at a time and
+# report the round-trip latency - and how much CPU Espruino uses while
+# it is sitting idle waiting for data.
+#
+# ./benchmark/linux_socket_echo.py [path/to/espruino] [count]
+# ----------------------------------------------------------------------------------------
+
+import os
+import socket
+import subprocess
+import sys
+import time
+
+ESPRUINO = sys.argv[1] if len(sys.argv)>1 else os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "espruino")
+COUNT = int(sys.argv[2]) if len(sys.argv)>2 else 1000
+PORT = 28765
+
+code = """
+require("net").createServer(function(c) {
+  c.on('data', function(d) { c.write(d); });
+}).listen(%d);
+console.log("READY");
+""" % PORT
+
+def cpu_seconds(pid):
+  with open("/proc/%d/stat" % pid) as f:
+    fields = f.read().rsplit(")", 1)[1].split()
+  return (int(fields[11]) + int(fields[12])) / os.sysconf("SC_CLK_TCK") # utime+stime
+
+proc = subprocess.Popen([ESPRUINO, "-e", code],
+                        stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+try:
+  out = b""
+  while b"READY" not in out:
+    c = proc.stdout.read(1)
+    if not c:
+      print(out.decode(errors="replace"))
+      sys.exit("Espruino exited before it was ready")
+    out += c
+
+  sock = socket.create_connection(("127.0.0.1", PORT))
+  sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+  times = []
+  for i in range(COUNT):
+    msg = ("%08d" % i).encode()
+    start = time.perf_counter()
+    sock.sendall(msg)
+    got = b""
+    while len(got) < len(msg):
+      d = sock.recv(64)
+      if not d: sys.exit("Connection closed")
+      got += d
+    times.append(time.perf_counter() - start)
+    if got != msg: sys.exit("Bad echo %r != %r" % (got, msg))
+
+  # how busy is Espruino when there's nothing to do?
+  idleStart = cpu_seconds(proc.pid)
+  time.sleep(2)
+  idleCPU = (cpu_seconds(proc.pid) - idleStart) / 2
+  sock.close()
+finally:
+  proc.kill()
+
+times.sort()
+ms = lambda t: t*1000
+print("%d round trips: mean %.3fms, median %.3fms, 99th percentile %.3fms, max %.3fms" % (
+      COUNT, ms(sum(times)/len(times)), ms(times[len(times)//2]), ms(times[len(times)*99//100]), ms(times[-1])))
+print("CPU use while idle: %.1f%%" % (idleCPU*100))
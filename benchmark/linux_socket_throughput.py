@@ -0,0 +1,93 @@
+#!/usr/bin/python3
+
+# This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+#
+# Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+#
+# ----------------------------------------------------------------------------------------
+# Measure how fast the Linux build can send data over loopback: Espruino
+# serves a large response from a 'net' server and from an 'http' server
+# (as one big string, as lots of small writes, and from a Storage file with
+# res.sendFile), and we time how long it takes to download.
+#
+# ./benchmark/linux_socket_throughput.py [path/to/espruino] [kilobytes]
+# ----------------------------------------------------------------------------------------
+
+import os
+import socket
+import subprocess
+import sys
+import time
+
+ESPRUINO = sys.argv[1] if len(sys.argv)>1 else os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "espruino")
+KILOBYTES = int(sys.argv[2]) if len(sys.argv)>2 else 256
+NET_PORT = 28771
+HTTP_PORT = 28772
+
+code = """
+var big = "";
+for (var i=0;i<1024;i++) big += String.fromCharCode(32+(i&63));
+var kb = %d;
+big = new Array(kb+1).join(big); // one big string
+var small = big.substr(0,256);
+var storage = require("Storage");
+storage.erase("big.txt");
+for (var i=0;i<kb;i++) storage.write("big.txt", big.substr(0,1024), i*1024, kb*1024);
+require("net").createServer(function(c) {
+  c.on('data', function(d) {
+    if (d[0]=="B") c.write(big);
+    else for (var i=0;i<kb*4;i++) c.write(small);
+    c.end();
+  });
+}).listen(%d);
+require("http").createServer(function(req, res) {
+  if (req.url!="/file") res.writeHead(200, {"Content-Type":"text/plain"});
+  if (req.url=="/big") res.end(big);
+  else if (req.url=="/file") res.sendFile("big.txt");
+  else {
+    for (var i=0;i<kb*4;i++) res.write(small);
+    res.end();
+  }
+}).listen(%d);
+console.log("READY");
+""" % (KILOBYTES, NET_PORT, HTTP_PORT)
+
+def download(port, request):
+  start = time.perf_counter()
+  sock = socket.create_connection(("127.0.0.1", port))
+  sock.sendall(request)
+  total = 0
+  while True:
+    d = sock.recv(65536)
+    if not d: break
+    total += len(d)
+  sock.close()
+  return total, time.perf_counter() - start
+
+proc = subprocess.Popen([ESPRUINO, "-e", code],
+                        stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+try:
+  out = b""
+  while b"READY" not in out:
+    c = proc.stdout.read(1)
+    if not c:
+      print(out.decode(errors="replace"))
+      sys.exit("Espruino exited before it was ready")
+    out += c
+
+  tests = [
+    ("net, one write", NET_PORT, b"B"),
+    ("net, 256 byte writes", NET_PORT, b"S"),
+    ("http, one write", HTTP_PORT, b"GET /big HTTP/1.0\r\n\r\n"),
+    ("http, 256 byte writes", HTTP_PORT, b"GET /small HTTP/1.0\r\n\r\n"),
+    ("http, sendFile", HTTP_PORT, b"GET /file HTTP/1.0\r\n\r\n"),
+  ]
+  for name, port, request in tests:
+    size, seconds = download(port, request)
+    print("%-24s %8d bytes in %.3fs = %8.1f kB/sec" % (name, size, seconds, size/1024/seconds))
+finally:
+  proc.kill()
@@ -0,0 +1,23 @@
+// Time de-duplicating 2000 IDs (1000 unique) with a Set, a Map and a plain object
+var IDS = 2000;
+var ids = [];
+for (var i=0;i<IDS;i++) ids.push("id"+((i*7919)%(IDS/2)));
+
+var t = getTime();
+var s = new Set();
+ids.forEach(function(id) { s.add(id); });
+var setTime = getTime()-t;
+
+t = getTime();
+var m = new Map();
+ids.forEach(function(id) { m.set(id, (m.get(id)|0)+1); });
+var mapTime = getTime()-t;
+
+t = getTime();
+var o = {};
+ids.forEach(function(id) { o[id] = (o[id]|0)+1; });
+var objTime = getTime()-t;
+
+print("Set: "+s.size+" unique in "+setTime.toFixed(3)+"s");
+print("Map: "+m.size+" counts in "+mapTime.toFixed(3)+"s");
+print("Object: "+Object.keys(o).length+" counts in "+objTime.toFixed(3)+"s");
@@ -0,0 +1,28 @@
+// Time reading a 10k line CSV log back from a StorageFile with readLine and read
+// (needs ~170kB of free Storage - reduce LINES on smaller devices)
+var LINES = 10000;
+var s = require("Storage");
+var f = s.open("bench.csv","w");
+f.erase();
+f = s.open("bench.csv","w");
+var block = "";
+for (var i=0;i<LINES;i++) {
+  block += i+","+(i*7%1000)+","+(i&1?"on":"off")+"\n";
+  if ((i&63)==63 || i==LINES-1) { f.write(block); block=""; }
+}
+
+var t = getTime();
+f = s.open("bench.csv","r");
+var l, lines = 0, bytes = 0;
+while ((l=f.readLine())!==undefined) { lines++; bytes+=l.length; }
+var readLineTime = getTime()-t;
+
+t = getTime();
+f = s.open("bench.csv","r");
+var chunks = 0;
+while ((l=f.read(256))!==undefined) chunks++;
+var readTime = getTime()-t;
+
+print("readLine: "+lines+" lines, "+bytes+" bytes in "+readLineTime.toFixed(3)+"s");
+print("read(256): "+chunks+" reads in "+readTime.toFixed(3)+"s");
+f.erase();
@@ -1880,6 +1880,8 @@ void jswrap_banglejs_setLCDMode(JsVar *mode) {
     jsvUnLock(arrData);
   }
   graphicsStructResetState(&graphicsInternal); // reset colour, cliprect, etc
+  // flip only sends what was modified, so make sure all of the new buffer gets sent
+  graphicsSetModified(&graphicsInternal, 0, 0, graphicsInternal.data.width-1, graphicsInternal.data.height-1);
   jsvUnLock(graphics);
   lcdST7789_setMode( lcdMode );
   graphicsSetCallbacks(&graphicsInternal); // set the callbacks up after the mode change
@@ -151,6 +151,59 @@ uint32_t heatshrink_decode_cb(int (*in_callback)(uint32_t *cbdata), uint32_t *in
 
 
 
+/** Streaming decode - gets data from callback, throws away the first 'skip' bytes of output and then
+ * writes at most 'len' bytes to the callback. It stops reading input as soon as it has output 'len' bytes,
+ * so a slice can be read without decompressing everything after it. Returns the number of bytes written */
+uint32_t heatshrink_decode_range_cb(int (*in_callback)(uint32_t *cbdata), uint32_t *in_cbdata, uint32_t skip, uint32_t len, void (*out_callback)(unsigned char ch, uint32_t *cbdata), uint32_t *out_cbdata) {
+  heatshrink_decoder hsd;
+  uint8_t inBuf[BUFFERSIZE];
+  uint8_t outBuf[BUFFERSIZE];
+  heatshrink_decoder_reset(&hsd);
+
+  size_t i;
+  size_t count = 0;
+  uint32_t written = 0;
+  int lastByte = 0;
+  size_t inBufCount = 0;
+  size_t inBufOffset = 0;
+  while (written<len && (lastByte >= 0 || inBufCount>0)) {
+    // Read data from input
+    if (inBufCount==0) {
+      inBufOffset = 0;
+      while (inBufCount<BUFFERSIZE && lastByte>=0) {
+        lastByte = in_callback(in_cbdata);
+        if (lastByte >= 0)
+          inBuf[inBufCount++] = (uint8_t)lastByte;
+      }
+    }
+    // decode
+    bool ok = heatshrink_decoder_sink(&hsd, &inBuf[inBufOffset], inBufCount, &count) >= 0;
+    assert(ok);NOT_USED(ok);
+    inBufCount -= count;
+    inBufOffset += count;
+    if ((inBufCount==0) && (lastByte < 0)) {
+      heatshrink_decoder_finish(&hsd);
+    }
+
+    HSD_poll_res pres;
+    do {
+      pres = heatshrink_decoder_poll(&hsd, outBuf, sizeof(outBuf), &count);
+      assert(pres >= 0);
+      i = 0;
+      if (skip) { // skip data before the range we want
+        i = (count < skip) ? count : skip;
+        skip -= (uint32_t)i;
+      }
+      for (;i<count && written<len;i++) {
+        out_callback(outBuf[i], out_cbdata);
+        written++;
+      }
+    } while (pres == HSDR_POLL_MORE && written<len);
+  }
+  return written;
+}
+
+
 /** gets data from array, writes to callback if nonzero. Returns total length. */
 uint32_t heatshrink_encode(unsigned char *in_data, size_t in_len, void (*out_callback)(unsigned char ch, uint32_t *cbdata), uint32_t *out_cbdata) {
   HeatShrinkPtrInputCallbackInfo cbi;
@@ -28,6 +28,10 @@ uint32_t heatshrink_encode_cb(int (*in_callback)(uint32_t *cbdata), uint32_t *in
 /** gets data from callback, writes it into callback if nonzero. Returns total length */
 uint32_t heatshrink_decode_cb(int (*in_callback)(uint32_t *cbdata), uint32_t *in_cbdata, void (*out_callback)(unsigned char ch, uint32_t *cbdata), uint32_t *out_cbdata);
 
+/** Streaming decode - gets data from callback, skips the first 'skip' bytes of output and writes at most 'len'
+ * bytes to callback, stopping as soon as it has them. Returns the number of bytes written */
+uint32_t heatshrink_decode_range_cb(int (*in_callback)(uint32_t *cbdata), uint32_t *in_cbdata, uint32_t skip, uint32_t len, void (*out_callback)(unsigned char ch, uint32_t *cbdata), uint32_t *out_cbdata);
+
 /** gets data from array, writes to callback if nonzero. Returns total length. */
 uint32_t heatshrink_encode(unsigned char *in_data, size_t in_len, void (*out_callback)(unsigned char ch, uint32_t *cbdata), uint32_t *out_cbdata);
 
@@ -0,0 +1,120 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2021 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * Cache of rasterised font glyphs and character widths
+ *
+ * The cache is a single flat string in hiddenRoot, containing a GlyphCacheHeader
+ * followed by GlyphCacheEntry+data, one after the other. When it's full, the
+ * least recently used entries are removed and everything after them is moved
+ * down. It's only ever a cache, so it's removed when we're low on memory or
+ * before saving.
+ * ----------------------------------------------------------------------------
+ */
+#include "glyph_cache.h"
+#include "jsparse.h"
+
+#ifdef USE_GLYPH_CACHE
+
+typedef struct {
+  uint32_t used;       ///< Bytes of entries after this header
+  uint32_t useCounter; ///< Incremented each time an entry is used
+  uint32_t changes;    ///< Incremented each time entries are added (and others may have moved)
+} GlyphCacheHeader;
+
+static uint16_t glyphCacheLastFontId = GLYPH_CACHE_FONT_VECTOR;
+
+static size_t glyphCacheEntrySize(size_t length) {
+  return (sizeof(GlyphCacheEntry) + length + 3) & ~(size_t)3;
+}
+
+void glyphCacheKeyInit(GlyphCacheKey *key, uint16_t font, JsVarRef owner, char ch) {
+  memset(key, 0, sizeof(GlyphCacheKey)); // so padding is zero for memcmp
+  key->font = font;
+  key->owner = owner;
+  key->ch = (uint8_t)ch;
+}
+
+JsVar *glyphCacheGet(bool create) {
+  JsVar *cache = jsvObjectGetChild(execInfo.hiddenRoot, GLYPH_CACHE_NAME, 0);
+  if (cache || !create) return cache;
+  cache = jsvNewFlatStringOfLength(GLYPH_CACHE_SIZE);
+  if (!cache) return 0; // not enough memory - just don't cache
+  GlyphCacheHeader *header = (GlyphCacheHeader*)jsvGetFlatStringPointer(cache);
+  header->used = 0;
+  header->useCounter = 0;
+  header->changes = 0;
+  jsvObjectSetChild(execInfo.hiddenRoot, GLYPH_CACHE_NAME, cache);
+  return cache;
+}
+
+GlyphCacheEntry *glyphCacheFind(JsVar *cache, const GlyphCacheKey *key) {
+  GlyphCacheHeader *header = (GlyphCacheHeader*)jsvGetFlatStringPointer(cache);
+  unsigned char *ptr = (unsigned char*)(header+1);
+  unsigned char *end = ptr + header->used;
+  while (ptr < end) {
+    GlyphCacheEntry *entry = (GlyphCacheEntry*)ptr;
+    if (!memcmp(&entry->key, key, sizeof(GlyphCacheKey))) {
+      entry->lastUsed = ++header->useCounter;
+      return entry;
+    }
+    ptr += glyphCacheEntrySize(entry->length);
+  }
+  return 0;
+}
+
+GlyphCacheEntry *glyphCacheAdd(JsVar *cache, const GlyphCacheKey *key, size_t length) {
+  GlyphCacheHeader *header = (GlyphCacheHeader*)jsvGetFlatStringPointer(cache);
+  unsigned char *base = (unsigned char*)(header+1);
+  size_t capacity = jsvGetStringLength(cache) - sizeof(GlyphCacheHeader);
+  size_t size = glyphCacheEntrySize(length);
+  // Don't let one glyph push out everything else
+  if (length>0xFFFF || size > capacity/4) return 0;
+  // Remove least recently used entries until it fits
+  while (header->used + size > capacity) {
+    unsigned char *ptr = base, *end = base + header->used, *oldest = base;
+    while (ptr < end) {
+      GlyphCacheEntry *entry = (GlyphCacheEntry*)ptr;
+      if ((int32_t)(entry->lastUsed - ((GlyphCacheEntry*)oldest)->lastUsed) < 0)
+        oldest = ptr;
+      ptr += glyphCacheEntrySize(entry->length);
+    }
+    size_t oldestSize = glyphCacheEntrySize(((GlyphCacheEntry*)oldest)->length);
+    memmove(oldest, oldest+oldestSize, (size_t)(end - (oldest+oldestSize)));
+    header->used -= (uint32_t)oldestSize;
+  }
+  GlyphCacheEntry *entry = (GlyphCacheEntry*)(base + header->used);
+  header->used += (uint32_t)size;
+  header->changes++;
+  memset(entry, 0, sizeof(GlyphCacheEntry));
+  memcpy(&entry->key, key, sizeof(GlyphCacheKey)); // including padding, for memcmp
+  entry->lastUsed = ++header->useCounter;
+  entry->length = (uint16_t)length;
+  return entry;
+}
+
+uint32_t glyphCacheGetChanges(JsVar *cache) {
+  return ((GlyphCacheHeader*)jsvGetFlatStringPointer(cache))->changes;
+}
+
+uint16_t glyphCacheNewFontId() {
+  if (++glyphCacheLastFontId == GLYPH_CACHE_FONT_VECTOR)
+    ++glyphCacheLastFontId;
+  return glyphCacheLastFontId;
+}
+
+bool glyphCacheFree() {
+  JsVar *cache = jsvObjectGetChild(execInfo.hiddenRoot, GLYPH_CACHE_NAME, 0);
+  if (!cache) return false;
+  jsvObjectRemoveChild(execInfo.hiddenRoot, GLYPH_CACHE_NAME);
+  jsvUnLock(cache);
+  return true;
+}
+
+#endif // USE_GLYPH_CACHE
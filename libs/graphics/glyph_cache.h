@@ -0,0 +1,72 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2021 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * Cache of rasterised font glyphs and character widths
+ * ----------------------------------------------------------------------------
+ */
+#ifndef GLYPH_CACHE_H
+#define GLYPH_CACHE_H
+
+#include "jsutils.h"
+#include "jsvar.h"
+
+#ifndef SAVE_ON_FLASH
+#define USE_GLYPH_CACHE
+#endif
+
+#ifdef USE_GLYPH_CACHE
+
+#ifndef GLYPH_CACHE_SIZE
+#define GLYPH_CACHE_SIZE 2048 ///< Bytes of RAM (allocated as a flat string when first needed) for the glyph cache
+#endif
+
+#define GLYPH_CACHE_NAME JS_HIDDEN_CHAR_STR"GlC" ///< name of the glyph cache in hiddenRoot
+#define GLYPH_CACHE_FONT_VECTOR 0 ///< font ID for the built-in vector font
+#define GLYPH_CACHE_WIDTHS 0x80 ///< In GlyphCacheKey.flags - the entry contains the width of every character rather than a glyph
+
+/// What a glyph cache entry is for - all unused fields must be 0
+typedef struct {
+  uint16_t font;       ///< GLYPH_CACHE_FONT_VECTOR, or an ID from glyphCacheNewFontId
+  uint16_t sizex, sizey; ///< Font size (if the glyph depends on it)
+  uint8_t ch;          ///< Character code
+  uint8_t flags;       ///< JSGRAPHICSFLAGS_MAPPEDXY bits the glyph was rendered with, or GLYPH_CACHE_WIDTHS
+  JsVarRef owner;      ///< For custom fonts, the Graphics instance the font belongs to
+} GlyphCacheKey;
+
+/// A glyph cache entry. 'length' bytes of data follow this header
+typedef struct {
+  GlyphCacheKey key;
+  uint32_t lastUsed;   ///< For finding the least recently used entry
+  int16_t x, y;        ///< Offset of the bitmap from the glyph's origin
+  uint16_t width, height; ///< Size of the bitmap
+  uint16_t advance;    ///< How far to move after drawing this character
+  uint16_t length;     ///< Bytes of data after this header
+} GlyphCacheEntry;
+
+/// Get a pointer to the data after a glyph cache entry
+#define GLYPH_CACHE_DATA(ENTRY) ((unsigned char*)((ENTRY)+1))
+
+/// Initialise a glyph cache key
+void glyphCacheKeyInit(GlyphCacheKey *key, uint16_t font, JsVarRef owner, char ch);
+/// Get the glyph cache (locked), creating it if create=true and there's enough memory. Returns 0 if not available
+JsVar *glyphCacheGet(bool create);
+/// Find an entry in the glyph cache (and mark it as recently used). Pointer is valid until glyphCacheAdd is called or the cache is unlocked
+GlyphCacheEntry *glyphCacheFind(JsVar *cache, const GlyphCacheKey *key);
+/// Add a new entry (with uninitialised data of the given length) to the cache, removing the least recently used entries to make room. Returns 0 if it was too big to add
+GlyphCacheEntry *glyphCacheAdd(JsVar *cache, const GlyphCacheKey *key, size_t length);
+/// Returns a number that changes whenever entries are added (so pointers to entries may no longer be valid)
+uint32_t glyphCacheGetChanges(JsVar *cache);
+/// Get a new unique font ID (for custom fonts)
+uint16_t glyphCacheNewFontId();
+/// Remove the glyph cache, freeing its memory. Returns true if it existed
+bool glyphCacheFree();
+
+#endif // USE_GLYPH_CACHE
+#endif // GLYPH_CACHE_H
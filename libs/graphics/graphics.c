@@ -110,6 +110,30 @@ void graphicsFallbackScroll(JsGraphics *gfx, int xdir, int ydir, int x1, int y1,
   }
 }
 
+void graphicsFallbackBlitSpan(JsGraphics *gfx, int x, int y, int w, const unsigned char *data) {
+  if (gfx->data.bpp==16) {
+    for (int i=0;i<w;i++) {
+      gfx->setPixel(gfx, x+i, y, (unsigned int)((data[0]<<8) | data[1]));
+      data += 2;
+    }
+  } else {
+    for (int i=0;i<w;i++)
+      gfx->setPixel(gfx, x+i, y, data[i]);
+  }
+}
+
+void graphicsFallbackBlitColumn(JsGraphics *gfx, int x, int y, int h, const unsigned char *data) {
+  if (gfx->data.bpp==16) {
+    for (int i=0;i<h;i++) {
+      gfx->setPixel(gfx, x, y+i, (unsigned int)((data[0]<<8) | data[1]));
+      data += 2;
+    }
+  } else {
+    for (int i=0;i<h;i++)
+      gfx->setPixel(gfx, x, y+i, data[i]);
+  }
+}
+
 // ----------------------------------------------------------------------------------------------
 
 void graphicsStructResetState(JsGraphics *gfx) {
@@ -142,6 +166,15 @@ void graphicsStructResetState(JsGraphics *gfx) {
   gfx->data.cursorY = 0;
 }
 
+#ifdef GRAPHICS_BLEND_CACHE_SIZE
+/// Empty the cache of blended fg/bg colors, and set it up for the current colors
+static void graphicsBlendCacheReset(JsGraphics *gfx) {
+  gfx->blendFgColor = gfx->data.fgColor;
+  gfx->blendBgColor = gfx->data.bgColor;
+  memset(gfx->blendCacheAmt, 0xFF, sizeof(gfx->blendCacheAmt));
+}
+#endif
+
 void graphicsStructInit(JsGraphics *gfx, int width, int height, int bpp) {
   // type/width/height/bpp should be set elsewhere...
   gfx->data.flags = JSGRAPHICSFLAGS_NONE;
@@ -150,10 +183,10 @@ void graphicsStructInit(JsGraphics *gfx, int width, int height, int bpp) {
   gfx->data.bpp = (unsigned char)bpp;
   graphicsStructResetState(gfx);
 #ifndef NO_MODIFIED_AREA
-  gfx->data.modMaxX = -32768;
-  gfx->data.modMaxY = -32768;
-  gfx->data.modMinX = 32767;
-  gfx->data.modMinY = 32767;
+  graphicsResetModified(gfx);
+#endif
+#ifdef GRAPHICS_BLEND_CACHE_SIZE
+  graphicsBlendCacheReset(gfx);
 #endif
 }
 
@@ -164,6 +197,11 @@ bool graphicsSetCallbacks(JsGraphics *gfx) {
   gfx->fillRect = graphicsFallbackFillRect;
   gfx->blit = graphicsFallbackBlit;
   gfx->scroll = graphicsFallbackScroll;
+  gfx->blitSpan = graphicsFallbackBlitSpan;
+  gfx->blitColumn = graphicsFallbackBlitColumn;
+#ifdef GRAPHICS_BLEND_CACHE_SIZE
+  graphicsBlendCacheReset(gfx);
+#endif
 #ifdef USE_LCD_SDL
   if (gfx->data.type == JSGRAPHICSTYPE_SDL) {
     lcdSetCallbacks_SDL(gfx);
@@ -282,6 +320,26 @@ void deviceToGraphicsCoordinates(const JsGraphics *gfx, int *x, int *y) {
   }
 }
 
+void graphicsGetDeviceMapping(const JsGraphics *gfx, GfxDeviceMapping *m) {
+  bool swap = (gfx->data.flags & JSGRAPHICSFLAGS_SWAP_XY)!=0;
+  m->x = 0;
+  m->y = 0;
+  m->xx = swap ? 0 : 1;
+  m->xy = swap ? 1 : 0;
+  m->yx = swap ? 1 : 0;
+  m->yy = swap ? 0 : 1;
+  if (gfx->data.flags & JSGRAPHICSFLAGS_INVERT_X) {
+    m->x = gfx->data.width-1;
+    m->xx = (signed char)-m->xx;
+    m->xy = (signed char)-m->xy;
+  }
+  if (gfx->data.flags & JSGRAPHICSFLAGS_INVERT_Y) {
+    m->y = gfx->data.height-1;
+    m->yx = (signed char)-m->yx;
+    m->yy = (signed char)-m->yy;
+  }
+}
+
 // If graphics is flipped or rotated then the coordinates need modifying
 void graphicsToDeviceCoordinates16x(const JsGraphics *gfx, int *x, int *y) {
   if (gfx->data.flags & JSGRAPHICSFLAGS_SWAP_XY) {
@@ -300,6 +358,117 @@ unsigned short graphicsGetHeight(const JsGraphics *gfx) {
   return (gfx->data.flags & JSGRAPHICSFLAGS_SWAP_XY) ? gfx->data.width : gfx->data.height;
 }
 
+#ifndef NO_MODIFIED_AREA
+void graphicsResetModified(JsGraphics *gfx) {
+  gfx->data.modMaxX = -32768;
+  gfx->data.modMaxY = -32768;
+  gfx->data.modMinX = 32767;
+  gfx->data.modMinY = 32767;
+#if JSGRAPHICS_MODIFIED_RECTS>1
+  gfx->data.modRectCount = 0;
+#endif
+}
+
+#if JSGRAPHICS_MODIFIED_RECTS>1
+static int graphicsRectArea(int x1, int y1, int x2, int y2) {
+  return (x2+1-x1)*(y2+1-y1);
+}
+
+/* Add an area to the list of modified rectangles. If it overlaps any existing rectangle (or
+can be joined to one without covering any unmodified pixels) they're merged. If we run out
+of rectangles we merge with whichever one makes the area grow the least */
+static void graphicsAddModifiedRect(JsGraphicsData *d, int x1, int y1, int x2, int y2) {
+  JsGraphicsClipRect *r = d->modRects;
+  int count = d->modRectCount;
+  // Fast path - already inside a rectangle (very common when drawing pixel by pixel)
+  for (int i=0;i<count;i++)
+    if (x1>=r[i].x1 && y1>=r[i].y1 && x2<=r[i].x2 && y2<=r[i].y2) return;
+  while (true) {
+    int i = 0;
+    while (i<count) {
+      int ux1 = (r[i].x1<x1) ? r[i].x1 : x1;
+      int uy1 = (r[i].y1<y1) ? r[i].y1 : y1;
+      int ux2 = (r[i].x2>x2) ? r[i].x2 : x2;
+      int uy2 = (r[i].y2>y2) ? r[i].y2 : y2;
+      bool overlaps = x1<=r[i].x2 && x2>=r[i].x1 && y1<=r[i].y2 && y2>=r[i].y1;
+      if (overlaps || graphicsRectArea(ux1,uy1,ux2,uy2) <= graphicsRectArea(x1,y1,x2,y2)+graphicsRectArea(r[i].x1,r[i].y1,r[i].x2,r[i].y2)) {
+        // merge, remove this rect, and start again as the bigger rect may now overlap others
+        x1 = ux1; y1 = uy1; x2 = ux2; y2 = uy2;
+        r[i] = r[--count];
+        i = 0;
+      } else i++;
+    }
+    if (count < JSGRAPHICS_MODIFIED_RECTS) break;
+    // No space - merge with whichever rect it grows the area the least
+    int best = 0, bestGrowth = 0x7FFFFFFF;
+    for (i=0;i<count;i++) {
+      int growth = graphicsRectArea((r[i].x1<x1) ? r[i].x1 : x1, (r[i].y1<y1) ? r[i].y1 : y1,
+                                    (r[i].x2>x2) ? r[i].x2 : x2, (r[i].y2>y2) ? r[i].y2 : y2) -
+                   graphicsRectArea(r[i].x1,r[i].y1,r[i].x2,r[i].y2);
+      if (growth < bestGrowth) {
+        bestGrowth = growth;
+        best = i;
+      }
+    }
+    if (r[best].x1<x1) x1 = r[best].x1;
+    if (r[best].y1<y1) y1 = r[best].y1;
+    if (r[best].x2>x2) x2 = r[best].x2;
+    if (r[best].y2>y2) y2 = r[best].y2;
+    r[best] = r[--count];
+  }
+  r[count].x1 = (unsigned short)x1;
+  r[count].y1 = (unsigned short)y1;
+  r[count].x2 = (unsigned short)x2;
+  r[count].y2 = (unsigned short)y2;
+  d->modRectCount = (unsigned char)(count+1);
+}
+#endif
+
+/// Add a (non-empty, on-screen) area to the modified area. Returns true if the overall modified area grew
+static bool graphicsAddModified(JsGraphics *gfx, int x1, int y1, int x2, int y2) {
+  JsGraphicsData *d = &gfx->data;
+  bool grew = false;
+#if JSGRAPHICS_MODIFIED_RECTS>1
+  if (d->modMinX > d->modMaxX || d->modRectCount > JSGRAPHICS_MODIFIED_RECTS)
+    d->modRectCount = 0; // modified area was reset without graphicsResetModified
+  graphicsAddModifiedRect(d, x1, y1, x2, y2);
+#endif
+  if (x1 < d->modMinX) { d->modMinX=(short)x1; grew = true; }
+  if (x2 > d->modMaxX) { d->modMaxX=(short)x2; grew = true; }
+  if (y1 < d->modMinY) { d->modMinY=(short)y1; grew = true; }
+  if (y2 > d->modMaxY) { d->modMaxY=(short)y2; grew = true; }
+  return grew;
+}
+
+int graphicsGetModifiedRects(const JsGraphics *gfx, JsGraphicsClipRect *rects) {
+  const JsGraphicsData *d = &gfx->data;
+  if (d->modMinX > d->modMaxX || d->modMinY > d->modMaxY) return 0;
+#if JSGRAPHICS_MODIFIED_RECTS>1
+  /* If something else has changed modMin/Max directly (eg. to force a
+  full-screen flip) the rectangles won't cover it, so just use the bounding box */
+  int count = d->modRectCount;
+  if (count>0 && count<=JSGRAPHICS_MODIFIED_RECTS) {
+    int x1=0x7FFF, y1=0x7FFF, x2=-1, y2=-1;
+    for (int i=0;i<count;i++) {
+      if (d->modRects[i].x1<x1) x1=d->modRects[i].x1;
+      if (d->modRects[i].y1<y1) y1=d->modRects[i].y1;
+      if (d->modRects[i].x2>x2) x2=d->modRects[i].x2;
+      if (d->modRects[i].y2>y2) y2=d->modRects[i].y2;
+    }
+    if (x1==d->modMinX && y1==d->modMinY && x2==d->modMaxX && y2==d->modMaxY) {
+      memcpy(rects, d->modRects, (size_t)count*sizeof(JsGraphicsClipRect));
+      return count;
+    }
+  }
+#endif
+  rects[0].x1 = (unsigned short)((d->modMinX<0) ? 0 : d->modMinX);
+  rects[0].y1 = (unsigned short)((d->modMinY<0) ? 0 : d->modMinY);
+  rects[0].x2 = (unsigned short)d->modMaxX;
+  rects[0].y2 = (unsigned short)d->modMaxY;
+  return 1;
+}
+#endif
+
 // Set the area modified by a draw command and also clip to the screen/clipping bounds
 bool graphicsSetModifiedAndClip(JsGraphics *gfx, int *x1, int *y1, int *x2, int *y2) {
   bool modified = false;
@@ -308,10 +477,8 @@ bool graphicsSetModifiedAndClip(JsGraphics *gfx, int *x1, int *y1, int *x2, int
   if (*y1<gfx->data.clipRect.y1) { *y1 = gfx->data.clipRect.y1; modified = true; }
   if (*x2>gfx->data.clipRect.x2) { *x2 = gfx->data.clipRect.x2; modified = true; }
   if (*y2>gfx->data.clipRect.y2) { *y2 = gfx->data.clipRect.y2; modified = true; }
-  if (*x1 < gfx->data.modMinX) { gfx->data.modMinX=(short)*x1; modified = true; }
-  if (*x2 > gfx->data.modMaxX) { gfx->data.modMaxX=(short)*x2; modified = true; }
-  if (*y1 < gfx->data.modMinY) { gfx->data.modMinY=(short)*y1; modified = true; }
-  if (*y2 > gfx->data.modMaxY) { gfx->data.modMaxY=(short)*y2; modified = true; }
+  if (*x1<=*x2 && *y1<=*y2 && graphicsAddModified(gfx, *x1, *y1, *x2, *y2))
+    modified = true;
 #else
   if (*x1<0) { *x1 = 0; modified = true; }
   if (*y1<0) { *y1 = 0; modified = true; }
@@ -321,13 +488,39 @@ bool graphicsSetModifiedAndClip(JsGraphics *gfx, int *x1, int *y1, int *x2, int
   return modified;
 }
 
+bool graphicsSetModifiedAndClipUser(JsGraphics *gfx, int *x1, int *y1, int *x2, int *y2) {
+  if (!(gfx->data.flags & JSGRAPHICSFLAGS_MAPPEDXY))
+    return graphicsSetModifiedAndClip(gfx, x1, y1, x2, y2);
+  // Transform to device coordinates, clip, and transform back
+  int dx1 = *x1, dy1 = *y1, dx2 = *x2, dy2 = *y2, t;
+  graphicsToDeviceCoordinates(gfx, &dx1, &dy1);
+  graphicsToDeviceCoordinates(gfx, &dx2, &dy2);
+  if (dx1>dx2) { t=dx1; dx1=dx2; dx2=t; }
+  if (dy1>dy2) { t=dy1; dy1=dy2; dy2=t; }
+  bool clipped = graphicsSetModifiedAndClip(gfx, &dx1, &dy1, &dx2, &dy2);
+  if (dx1>dx2 || dy1>dy2) { // nothing left
+    *x2 = *x1-1;
+    *y2 = *y1-1;
+    return true;
+  }
+  deviceToGraphicsCoordinates(gfx, &dx1, &dy1);
+  deviceToGraphicsCoordinates(gfx, &dx2, &dy2);
+  *x1 = (dx1<dx2) ? dx1 : dx2;
+  *x2 = (dx1<dx2) ? dx2 : dx1;
+  *y1 = (dy1<dy2) ? dy1 : dy2;
+  *y2 = (dy1<dy2) ? dy2 : dy1;
+  return clipped;
+}
+
 // Set the area modified by a draw command
 void graphicsSetModified(JsGraphics *gfx, int x1, int y1, int x2, int y2) {
 #ifndef NO_MODIFIED_AREA
-  if (x1 < gfx->data.modMinX) { gfx->data.modMinX=(short)x1; }
-  if (x2 > gfx->data.modMaxX) { gfx->data.modMaxX=(short)x2; }
-  if (y1 < gfx->data.modMinY) { gfx->data.modMinY=(short)y1; }
-  if (y2 > gfx->data.modMaxY) { gfx->data.modMaxY=(short)y2; }
+  if (x1<0) x1 = 0;
+  if (y1<0) y1 = 0;
+  if (x2>=gfx->data.width) x2 = gfx->data.width-1;
+  if (y2>=gfx->data.height) y2 = gfx->data.height-1;
+  if (x1<=x2 && y1<=y2)
+    graphicsAddModified(gfx, x1, y1, x2, y2);
 #endif
 }
 
@@ -356,18 +549,13 @@ uint32_t graphicsBlendColor(JsGraphics *gfx, unsigned int fg, unsigned int bg, i
     // TODO: if our graphics instance is paletted this isn't correct!
     return (bg*(256-amt) + fg*amt) >> 8;
   } else if (gfx->data.bpp==16) { // Blend from bg to fg
-    unsigned int b = bg;
-    unsigned int br = (b>>11)&0x1F;
-    unsigned int bg = (b>>5)&0x3F;
-    unsigned int bb = b&0x1F;
-    unsigned int f = fg;
-    unsigned int fr = (f>>11)&0x1F;
-    unsigned int fg = (f>>5)&0x3F;
-    unsigned int fb = f&0x1F;
-    unsigned int ri = (br*(256-amt) + fr*amt) >> 8;
-    unsigned int gi = (bg*(256-amt) + fg*amt) >> 8;
-    unsigned int bi = (bb*(256-amt) + fb*amt) >> 8;
-    return (bi | gi<<5 | ri<<11);
+    /* Spread RGB565 out to 00000GGGGGG00000RRRRR000000BBBBB so each channel has 5 bits
+    spare above it, then blend all three at once with a 5 bit (0..32) amount */
+    uint32_t a = (amt+4)>>3;
+    uint32_t f = ((fg&0xFFFF) | (fg&0xFFFF)<<16) & 0x07E0F81F;
+    uint32_t b = ((bg&0xFFFF) | (bg&0xFFFF)<<16) & 0x07E0F81F;
+    uint32_t c = ((((f - b) * a) >> 5) + b) & 0x07E0F81F;
+    return (c | c>>16) & 0xFFFF;
 #ifdef ESPR_GRAPHICS_12BIT
   } else if (gfx->data.bpp==12) { // Blend from bg to fg
     unsigned int b = bg;
@@ -403,6 +591,22 @@ uint32_t graphicsBlendColor(JsGraphics *gfx, unsigned int fg, unsigned int bg, i
 
 /// Merge one color into another based on current bit depth (amt is 0..256)
 uint32_t graphicsBlendGfxColor(JsGraphics *gfx, int iamt) {
+#ifdef GRAPHICS_BLEND_CACHE_SIZE
+  /* Fonts and images only use a few different amounts, so remember the results for the
+  current fg/bg colors rather than blending each pixel */
+  if (gfx->data.bpp>=8 && gfx->data.bpp<=16) {
+    unsigned int amt = (iamt>0) ? (unsigned)iamt : 0;
+    if (amt>256) amt=256;
+    if (gfx->blendFgColor!=gfx->data.fgColor || gfx->blendBgColor!=gfx->data.bgColor)
+      graphicsBlendCacheReset(gfx);
+    unsigned int i = amt>>4;
+    if (gfx->blendCacheAmt[i]!=amt) {
+      gfx->blendCacheAmt[i] = (unsigned short)amt;
+      gfx->blendCache[i] = (unsigned short)graphicsBlendColor(gfx, gfx->data.fgColor, gfx->data.bgColor, (int)amt);
+    }
+    return gfx->blendCache[i];
+  }
+#endif
   return graphicsBlendColor(gfx, gfx->data.fgColor, gfx->data.bgColor, iamt);
 }
 
@@ -414,10 +618,7 @@ static void graphicsSetPixelDevice(JsGraphics *gfx, int x, int y, unsigned int c
       y<gfx->data.clipRect.y1 ||
       x>gfx->data.clipRect.x2 ||
       y>gfx->data.clipRect.y2) return;
-  if (x < gfx->data.modMinX) gfx->data.modMinX=(short)x;
-  if (x > gfx->data.modMaxX) gfx->data.modMaxX=(short)x;
-  if (y < gfx->data.modMinY) gfx->data.modMinY=(short)y;
-  if (y > gfx->data.modMaxY) gfx->data.modMaxY=(short)y;
+  graphicsAddModified(gfx, x, y, x, y);
 #else
   if (x<0 || y<0 || x>=gfx->data.width || y>=gfx->data.height) return;
 #endif
@@ -460,10 +661,7 @@ void graphicsFillRectDevice(JsGraphics *gfx, int x1, int y1, int x2, int y2, uns
 #endif
   if (x2<x1 || y2<y1) return; // nope
 #ifndef NO_MODIFIED_AREA
-  if (x1 < gfx->data.modMinX) gfx->data.modMinX=(short)x1;
-  if (x2 > gfx->data.modMaxX) gfx->data.modMaxX=(short)x2;
-  if (y1 < gfx->data.modMinY) gfx->data.modMinY=(short)y1;
-  if (y2 > gfx->data.modMaxY) gfx->data.modMaxY=(short)y2;
+  graphicsAddModified(gfx, x1, y1, x2, y2);
 #endif
   if (x1==x2 && y1==y2) {
     gfx->setPixel(gfx,(int)x1,(int)y1,col);
@@ -769,28 +967,153 @@ void graphicsDrawCircleAA(JsGraphics *gfx, int x0, int y0, int r){
 
 #endif
 
-// Fill poly - each member of vertices is 1/16th pixel
-void graphicsFillPoly(JsGraphics *gfx, int points, short *vertices) {
-  typedef struct {
-    short x,y;
-  } VertXY;
-  VertXY *v = (VertXY*)vertices;
-
-  int i,j,y;
-  int miny = (int)(gfx->data.height-1);
-  int maxy = 0;
-  for (i=0;i<points;i++) {
-    // convert into device coordinates...
-    int vx = v[i].x;
-    int vy = v[i].y;
+/// One edge of a polygon in graphicsFillPolyScan's edge table
+typedef struct {
+  short yTop;          ///< First scanline that crosses this edge
+  short yBottom;       ///< This edge is crossed by scanlines less than this
+  short x;             ///< X coordinate of the vertex that intersections are measured from
+  short len;           ///< Y length of the edge (always positive)
+  signed char xDir;    ///< +1/-1 - the direction X moves in as we get further from that vertex
+  signed char yDir;    ///< +1 if that vertex is at the top (so we get further from it each scanline), -1 if not
+  bool slope;          ///< winding direction
+  unsigned char index; ///< original index of edge (so crossings at the same X are always sorted the same way)
+  unsigned int q, r;   ///< Quotient and remainder of (|y-vertex.y| * |dx|) / len - so crossing X = x + xDir*q
+  unsigned int stepQ, stepR; ///< How much q,r change by each scanline
+} GfxPolyEdge;
+
+#define GFX_POLY_MAX_EDGES 64
+
+/** Scan-convert a polygon using a sorted edge table and active edge list. Vertices are in 1/16th pixels
+ * and device coordinates. Scanlines are at yStart, yStart+yStep, ... up to and including yEnd, and
+ * spanFn is called for each span inside the polygon (using the non-zero winding rule) */
+void graphicsFillPolyScan(JsGraphics *gfx, int points, const short *vertices, int yStart, int yEnd, int yStep, GfxPolySpanFn spanFn, void *spanData) {
+  GfxPolyEdge edges[GFX_POLY_MAX_EDGES];
+  int edgeCount = 0;
+  // Build the edge table
+  int j = points-1;
+  for (int i=0;i<points && edgeCount<GFX_POLY_MAX_EDGES;i++) {
+    int xi = vertices[i*2], yi = vertices[i*2+1];
+    int xj = vertices[j*2], yj = vertices[j*2+1];
+    j = i;
+    int l = yj - yi;
+    if (!l) continue; // don't do horiz lines - rely on the ends of the lines that join onto them
+    int ymin = (l>0) ? yi : yj;
+    int ymax = (l>0) ? yj : yi;
+    // find the first scanline that crosses this edge
+    int y = yStart;
+    if (ymin > y) y += ((ymin - y + yStep - 1) / yStep) * yStep;
+    if (y >= ymax || y > yEnd) continue;
+    GfxPolyEdge *e = &edges[edgeCount];
+    int dx = xj - xi;
+    unsigned int adx = (unsigned int)((dx<0) ? -dx : dx);
+    e->yTop = (short)y;
+    e->yBottom = (short)ymax;
+    e->x = (short)xi;
+    e->len = (short)((l<0) ? -l : l);
+    e->xDir = (signed char)((dx<0) ? -1 : 1);
+    e->yDir = (signed char)((l>0) ? 1 : -1);
+    e->slope = l>1;
+    e->index = (unsigned char)i;
+    unsigned int t = (unsigned int)((y>yi) ? y-yi : yi-y) * adx;
+    e->q = t / (unsigned int)e->len;
+    e->r = t % (unsigned int)e->len;
+    t = (unsigned int)yStep * adx;
+    e->stepQ = t / (unsigned int)e->len;
+    e->stepR = t % (unsigned int)e->len;
+    // insertion sort by first scanline
+    int k = edgeCount++;
+    while (k>0 && edges[k-1].yTop > e->yTop) k--;
+    if (k!=edgeCount-1) {
+      GfxPolyEdge tmp = *e;
+      memmove(&edges[k+1], &edges[k], sizeof(GfxPolyEdge)*(size_t)(edgeCount-1-k));
+      edges[k] = tmp;
+    }
+  }
+
+  unsigned char active[GFX_POLY_MAX_EDGES];
+  short cross[GFX_POLY_MAX_EDGES];
+  int activeCount = 0, nextEdge = 0;
+  for (int y=yStart;y<=yEnd;y+=yStep) {
+    // add edges that start on this scanline
+    while (nextEdge<edgeCount && edges[nextEdge].yTop<=y)
+      active[activeCount++] = (unsigned char)nextEdge++;
+    if (!activeCount) {
+      if (nextEdge>=edgeCount) break; // nothing left to do
+      continue;
+    }
+    // remove finished edges, and insertion sort the rest by X (they're almost always in order already)
+    int n = 0;
+    for (int i=0;i<activeCount;i++) {
+      GfxPolyEdge *e = &edges[active[i]];
+      if (e->yBottom <= y) continue;
+      short x = (short)(e->x + e->xDir*(int)e->q);
+      int k = n++;
+      while (k>0 && (cross[k-1]>x || (cross[k-1]==x && edges[active[k-1]].index>e->index))) {
+        cross[k] = cross[k-1];
+        active[k] = active[k-1];
+        k--;
+      }
+      cross[k] = x;
+      active[k] = (unsigned char)(e - edges);
+    }
+    activeCount = n;
+    //  Fill the pixels between node pairs.
+    int x = 0, s = 0;
+    for (int i=0;i<activeCount;i++) {
+      GfxPolyEdge *e = &edges[active[i]];
+      if (s==0) x = cross[i];
+      if (e->slope) s++; else s--;
+      if (!s || i==activeCount-1)
+        spanFn(gfx, y, x, cross[i], spanData);
+      // step on to the next scanline
+      if (e->yDir>0) {
+        e->q += e->stepQ;
+        e->r += e->stepR;
+        if (e->r >= (unsigned int)e->len) {
+          e->r -= (unsigned int)e->len;
+          e->q++;
+        }
+      } else {
+        e->q -= e->stepQ;
+        if (e->r < e->stepR) {
+          e->r += (unsigned int)e->len - e->stepR;
+          e->q--;
+        } else
+          e->r -= e->stepR;
+      }
+    }
+    if (jspIsInterrupted()) break;
+  }
+}
+
+static void graphicsFillPolySpan(JsGraphics *gfx, int y, int x1, int x2, void *data) {
+  NOT_USED(data);
+  x1 = (x1+15)>>4;
+  x2 = (x2+15)>>4;
+  if (x2>x1) graphicsFillRectDevice(gfx,x1,y>>4,x2-1,y>>4,gfx->data.fgColor);
+}
+
+/// Convert polygon vertices to device coordinates, and get the min and max Y
+static void graphicsPolyToDevice(JsGraphics *gfx, int points, short *vertices, int *miny, int *maxy) {
+  *miny = 0x7FFF;
+  *maxy = -0x8000;
+  for (int i=0;i<points;i++) {
+    int vx = vertices[i*2];
+    int vy = vertices[i*2+1];
     graphicsToDeviceCoordinates16x(gfx, &vx, &vy);
-    v[i].x = (short)vx;
-    v[i].y = (short)vy;
-    // work out min and max
-    short y = v[i].y>>4;
-    if (y<miny) miny=y;
-    if (y>maxy) maxy=y;
+    vertices[i*2] = (short)vx;
+    vertices[i*2+1] = (short)vy;
+    if (vy<*miny) *miny=vy;
+    if (vy>*maxy) *maxy=vy;
   }
+}
+
+// Fill poly - each member of vertices is 1/16th pixel
+void graphicsFillPoly(JsGraphics *gfx, int points, short *vertices) {
+  int miny, maxy;
+  graphicsPolyToDevice(gfx, points, vertices, &miny, &maxy);
+  miny >>= 4;
+  maxy >>= 4;
 #ifndef SAVE_ON_FLASH
   if (miny < gfx->data.clipRect.y1) miny=gfx->data.clipRect.y1;
   if (maxy > gfx->data.clipRect.y2) maxy=gfx->data.clipRect.y2;
@@ -798,58 +1121,269 @@ void graphicsFillPoly(JsGraphics *gfx, int points, short *vertices) {
   if (miny<0) miny=0;
   if (maxy>=gfx->data.height) maxy=(int)(gfx->data.height-1);
 #endif
+  graphicsFillPolyScan(gfx, points, vertices, miny<<4, maxy<<4, 16, graphicsFillPolySpan, 0);
+}
+
+#ifdef GRAPHICS_ANTIALIAS
+/// One edge of a polygon for graphicsFillPolyAA, with y1 > y0
+typedef struct {
+  short x0, y0, x1, y1;
+  signed char dir;     ///< +1 if the edge went down, -1 if up (for the non-zero winding rule)
+  short x;             ///< X where the edge leaves the row we're on (so where it enters the next one)
+  unsigned int q, r;   ///< Quotient and remainder of |x-x0| at the bottom of the row we're on
+  unsigned int stepQ, stepR; ///< How much q,r change each row
+} GfxPolyAAEdge;
+
+/** Coverage of the current row of pixels for graphicsFillPolyAA. Each edge adds to the cells of
+ * the pixels it passes through: 'cover' is the (signed) height of edge in the pixel, which also
+ * applies to every pixel to the right, and 'area' is twice the area of the pixel to the right of
+ * the edge. Both are in 1/16th pixels, so a fully covered pixel has cover 16 and area 512 */
+typedef struct {
+  int area;
+  short cover;
+  bool touched;        ///< Has this cell been added to GfxPolyAACoverage.cells yet?
+} GfxPolyAACell;
+
+typedef struct {
+  int row;             ///< The row of pixels we're accumulating coverage for
+  int x1, x2;          ///< The range of X values (inclusive) we're accumulating for
+  GfxPolyAACell *cell; ///< One for each pixel from x1 to x2
+  short *cells;        ///< X values of the cells that have been touched (cells[0..cellCount-1])
+  int cellCount;
+} GfxPolyAACoverage;
+
+/// Get the X coordinate of an edge from q (see GfxPolyAAEdge)
+static int graphicsFillPolyAAEdgeX(GfxPolyAAEdge *e, unsigned int q) {
+  return (e->x1 < e->x0) ? e->x0 - (int)q : e->x0 + (int)q;
+}
+
+/// Start using an edge on the row starting at rowTop, working out where it crosses each row with division only once
+static void graphicsFillPolyAAEdgeStart(GfxPolyAAEdge *e, int rowTop) {
+  int dx = e->x1 - e->x0;
+  // unsigned, as the products can be more than 31 bits
+  unsigned int adx = (unsigned int)((dx<0) ? -dx : dx), len = (unsigned int)(e->y1 - e->y0);
+  e->x = (short)((e->y0 >= rowTop) ? e->x0 : graphicsFillPolyAAEdgeX(e, (unsigned int)(rowTop - e->y0) * adx / len));
+  unsigned int t = (unsigned int)(rowTop + 16 - e->y0) * adx;
+  e->q = t / len;
+  e->r = t % len;
+  t = 16 * adx;
+  e->stepQ = t / len;
+  e->stepR = t % len;
+}
+
+/// Add part of an edge that's within one pixel (u0/u1 are X in 1/16th pixels from the left of it)
+static void graphicsFillPolyAACell(GfxPolyAACoverage *c, int x, int h, int u0, int u1) {
+  if (x < c->x1) { // left of what we can draw - but it still covers everything to the right
+    x = c->x1;
+    u0 = u1 = 0;
+  } else if (x > c->x2) return;
+  GfxPolyAACell *cell = &c->cell[x - c->x1];
+  if (!cell->touched) {
+    cell->touched = true;
+    c->cells[c->cellCount++] = (short)x;
+  }
+  cell->cover = (short)(cell->cover + h);
+  cell->area += h*(32-u0-u1);
+}
+
+/// Add the part of an edge from (xa,ya) to (xb,yb) (1/16th pixels, ya<=yb, within the current row)
+static void graphicsFillPolyAASegment(GfxPolyAACoverage *c, int xa, int ya, int xb, int yb, int dir) {
+  if (xa > xb) { // always go left to right
+    int t = xa; xa = xb; xb = t;
+    t = ya; ya = yb; yb = t;
+  }
+  int dx = xb - xa, dy = yb - ya; // dy may be negative now
+  int px = xa>>4, pxEnd = (xb-1)>>4;
+  if (dx==0 || px>=pxEnd) { // all within one pixel
+    graphicsFillPolyAACell(c, px, dir*(dy<0?-dy:dy), xa-px*16, xb-px*16);
+    return;
+  }
+  int x = xa, y = ya;
+  while (px <= pxEnd) {
+    int nx = (px+1)*16;
+    if (nx > xb) nx = xb;
+    int ny = (nx==xb) ? yb : ya + (nx-xa)*dy/dx;
+    int h = ny - y;
+    graphicsFillPolyAACell(c, px, dir*(h<0?-h:h), x-px*16, nx-px*16);
+    x = nx;
+    y = ny;
+    px++;
+  }
+}
 
-  const int MAX_CROSSES = 64;
-
-  // for each scanline
-  for (y=miny<<4;y<=maxy<<4;y+=16) {
-    int yl = y>>4;
-    short cross[MAX_CROSSES];
-    bool slopes[MAX_CROSSES];
-    int crosscnt = 0;
-    // work out all the times lines cross the scanline
-    j = points-1;
-    for (i=0;i<points;i++) {
-      if ((v[i].y<=y && v[j].y>y) || (v[j].y<=y && v[i].y>y)) {
-        if (crosscnt < MAX_CROSSES) {
-          int l = v[j].y - v[i].y;
-          if (l) { // don't do horiz lines - rely on the ends of the lines that join onto them
-            cross[crosscnt] = (short)(v[i].x + ((y - v[i].y) * (v[j].x-v[i].x)) / l);
-            slopes[crosscnt] = (l>1)?1:0;
-            crosscnt++;
-          }
+/// Blend fgColor into a pixel that we know is inside clipRect (so we can skip the checks in graphicsSetPixelDeviceBlended)
+static void graphicsFillPolyAABlend(JsGraphics *gfx, int x, int y, int amt) {
+  unsigned int bg = gfx->getPixel(gfx, x, y);
+  unsigned int col = graphicsBlendColor(gfx, gfx->data.fgColor, bg, amt);
+  gfx->setPixel(gfx, x, y, col & (unsigned int)((1L<<gfx->data.bpp)-1));
+}
+
+/// Draw the accumulated coverage for a row, and clear it
+static void graphicsFillPolyAAFlush(JsGraphics *gfx, GfxPolyAACoverage *c) {
+  // sort the cells by X - they're almost in order already as the edges were added left to right
+  for (int i=1;i<c->cellCount;i++) {
+    short x = c->cells[i];
+    int k = i;
+    while (k>0 && c->cells[k-1]>x) {
+      c->cells[k] = c->cells[k-1];
+      k--;
+    }
+    c->cells[k] = x;
+  }
+#ifndef NO_MODIFIED_AREA
+  // everything we draw is between the first cell and the end of the row, and has already been clipped
+  graphicsAddModified(gfx, c->cells[0], c->row, c->x2, c->row);
+#endif
+  int cover = 0, runStart = -1, lastX = c->x1-1;
+  for (int n=0;n<=c->cellCount;n++) {
+    int x = (n<c->cellCount) ? c->cells[n] : c->x2+1;
+    // pixels between the last cell and this one are all covered by the same amount
+    if (x > lastX+1) {
+      int amt = cover<0 ? -cover : cover;
+      if (amt>=16) {
+        if (runStart<0) runStart = lastX+1;
+      } else {
+        if (runStart>=0) {
+          graphicsFillRectDevice(gfx, runStart, c->row, lastX, c->row, gfx->data.fgColor);
+          runStart = -1;
         }
+        if (amt)
+          for (int px=lastX+1;px<x;px++)
+            graphicsFillPolyAABlend(gfx, px, c->row, amt*16);
       }
-      j = i;
-    }
-
-    // bubble sort
-    for (i=0;i<crosscnt-1;) {
-      if (cross[i]>cross[i+1]) {
-        short t=cross[i];
-        cross[i]=cross[i+1];
-        cross[i+1]=t;
-        bool ts=slopes[i];
-        slopes[i]=slopes[i+1];
-        slopes[i+1]=ts;
-        if (i) i--;
-      } else i++;
     }
+    if (x > c->x2) break;
+    GfxPolyAACell *cell = &c->cell[x - c->x1];
+    int amt = cover*32 + cell->area;
+    if (amt<0) amt = -amt;
+    cover += cell->cover;
+    cell->area = 0;
+    cell->cover = 0;
+    cell->touched = false;
+    if (amt>=512) { // fully covered - draw as a span
+      if (runStart<0) runStart = x;
+    } else {
+      if (runStart>=0) {
+        graphicsFillRectDevice(gfx, runStart, c->row, x-1, c->row, gfx->data.fgColor);
+        runStart = -1;
+      }
+      if (amt)
+        graphicsFillPolyAABlend(gfx, x, c->row, amt>>1);
+    }
+    lastX = x;
+  }
+  if (runStart>=0)
+    graphicsFillRectDevice(gfx, runStart, c->row, c->x2, c->row, gfx->data.fgColor);
+  c->cellCount = 0;
+}
 
-    //  Fill the pixels between node pairs.
-    int x = 0,s = 0;
-    for (i=0;i<crosscnt;i++) {
-      if (s==0) x=cross[i];
-      if (slopes[i]) s++; else s--;
-      if (!s || i==crosscnt-1) {
-        int x1 = (x+15)>>4;
-        int x2 = (cross[i]+15)>>4;
-        if (x2>x1) graphicsFillRectDevice(gfx,x1,yl,x2-1,yl,gfx->data.fgColor);
+/** Fill poly with antialiasing - each member of vertices is 1/16th pixel. This works out exactly how
+ * much of each pixel is covered by the polygon, one row at a time, so fully covered runs of pixels
+ * are filled and only the pixels the edges pass through are blended */
+void graphicsFillPolyAA(JsGraphics *gfx, int points, short *vertices) {
+  int miny, maxy;
+  graphicsPolyToDevice(gfx, points, vertices, &miny, &maxy);
+  GfxPolyAACoverage c;
+  c.x1 = 0x7FFF;
+  c.x2 = -0x8000;
+  for (int i=0;i<points;i++) {
+    if (vertices[i*2]<c.x1) c.x1 = vertices[i*2];
+    if (vertices[i*2]>c.x2) c.x2 = vertices[i*2];
+  }
+  // Pixel x,y covers x*16 .. x*16+16, so pixel-aligned polygons fill the same pixels as graphicsFillPoly
+  c.x1 = c.x1>>4;
+  c.x2 = (c.x2-1)>>4;
+  miny = miny>>4;
+  maxy = (maxy-1)>>4;
+#ifndef SAVE_ON_FLASH
+  if (c.x1 < gfx->data.clipRect.x1) c.x1 = gfx->data.clipRect.x1;
+  if (c.x2 > gfx->data.clipRect.x2) c.x2 = gfx->data.clipRect.x2;
+  if (miny < gfx->data.clipRect.y1) miny = gfx->data.clipRect.y1;
+  if (maxy > gfx->data.clipRect.y2) maxy = gfx->data.clipRect.y2;
+#else
+  if (c.x1<0) c.x1=0;
+  if (c.x2>=gfx->data.width) c.x2=(int)(gfx->data.width-1);
+  if (miny<0) miny=0;
+  if (maxy>=gfx->data.height) maxy=(int)(gfx->data.height-1);
+#endif
+  if (c.x1>c.x2 || miny>maxy) return;
+  // Build the edge table, sorted by the top of each edge
+  GfxPolyAAEdge edges[GFX_POLY_MAX_EDGES];
+  int edgeCount = 0;
+  int j = points-1;
+  for (int i=0;i<points && edgeCount<GFX_POLY_MAX_EDGES;i++) {
+    GfxPolyAAEdge e;
+    e.dir = (vertices[i*2+1] > vertices[j*2+1]) ? 1 : -1;
+    int a = (e.dir>0) ? j : i, b = (e.dir>0) ? i : j;
+    e.x0 = vertices[a*2];
+    e.y0 = vertices[a*2+1];
+    e.x1 = vertices[b*2];
+    e.y1 = vertices[b*2+1];
+    j = i;
+    if (e.y0==e.y1 || e.y1<=miny*16 || e.y0>=maxy*16+16) continue; // horizontal, or not in any row we draw
+    int k = edgeCount++;
+    while (k>0 && edges[k-1].y0 > e.y0) {
+      edges[k] = edges[k-1];
+      k--;
+    }
+    edges[k] = e;
+  }
+  int w = c.x2+1-c.x1;
+  c.cell = (GfxPolyAACell*)alloca(sizeof(GfxPolyAACell)*(size_t)w);
+  c.cells = (short*)alloca(sizeof(short)*(size_t)w);
+  memset(c.cell, 0, sizeof(GfxPolyAACell)*(size_t)w);
+  c.cellCount = 0;
+  unsigned char active[GFX_POLY_MAX_EDGES];
+  int activeCount = 0, nextEdge = 0;
+  for (c.row=miny;c.row<=maxy;c.row++) {
+    int rowTop = c.row*16, rowBottom = rowTop+16;
+    // add edges that start in this row
+    while (nextEdge<edgeCount && edges[nextEdge].y0<rowBottom) {
+      graphicsFillPolyAAEdgeStart(&edges[nextEdge], rowTop);
+      active[activeCount++] = (unsigned char)nextEdge++;
+    }
+    if (!activeCount) {
+      if (nextEdge>=edgeCount) break; // nothing left to do
+      continue;
+    }
+    // remove finished edges, and insertion sort the rest by X so cells are added (mostly) in order
+    int n = 0;
+    for (int i=0;i<activeCount;i++) {
+      GfxPolyAAEdge *e = &edges[active[i]];
+      if (e->y1 <= rowTop) continue;
+      int k = n++;
+      while (k>0 && edges[active[k-1]].x > e->x) {
+        active[k] = active[k-1];
+        k--;
       }
-      if (jspIsInterrupted()) break;
+      active[k] = (unsigned char)(e - edges);
     }
+    activeCount = n;
+    for (int i=0;i<activeCount;i++) {
+      GfxPolyAAEdge *e = &edges[active[i]];
+      // the part of the edge that's in this row
+      int ya = (e->y0 > rowTop) ? e->y0 : rowTop;
+      int yb = rowBottom, xa = e->x;
+      if (e->y1 <= rowBottom) {
+        yb = e->y1;
+        e->x = e->x1;
+      } else {
+        e->x = (short)graphicsFillPolyAAEdgeX(e, e->q);
+        // step on to the next row
+        e->q += e->stepQ;
+        e->r += e->stepR;
+        if (e->r >= (unsigned int)(e->y1 - e->y0)) {
+          e->r -= (unsigned int)(e->y1 - e->y0);
+          e->q++;
+        }
+      }
+      graphicsFillPolyAASegment(&c, xa, ya, e->x, yb, e->dir);
+    }
+    if (c.cellCount) graphicsFillPolyAAFlush(gfx, &c);
+    if (jspIsInterrupted()) break;
   }
 }
+#endif
 
 /// Draw a simple 1bpp image in foreground colour
 void graphicsDrawImage1bpp(JsGraphics *gfx, int x1, int y1, int width, int height, const unsigned char *pixelData) {
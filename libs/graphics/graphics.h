@@ -30,10 +30,24 @@
 #endif
 #endif
 
+#ifndef NO_MODIFIED_AREA
+#ifndef JSGRAPHICS_MODIFIED_RECTS
+#ifdef SAVE_ON_FLASH
+#define JSGRAPHICS_MODIFIED_RECTS 1 // only keep the overall modified area
+#else
+#define JSGRAPHICS_MODIFIED_RECTS 4 ///< How many separate modified rectangles we keep track of
+#endif
+#endif
+#endif
+
 #if defined(LINUX) || defined(BANGLEJS)
 #define GRAPHICS_FAST_PATHS // execute more optimised code when no rotation/etc
 #endif
 
+#ifndef SAVE_ON_FLASH
+#define GRAPHICS_BLEND_CACHE_SIZE 17 ///< How many fg/bg blends graphicsBlendGfxColor remembers (one for each 16 of 0..256)
+#endif
+
 typedef enum {
   JSGRAPHICSTYPE_ARRAYBUFFER, ///< Write everything into an ArrayBuffer
   JSGRAPHICSTYPE_JS,          ///< Call JavaScript when we want to write something
@@ -97,6 +111,7 @@ typedef enum {
 #define JSGRAPHICS_CUSTOMFONT_WIDTH JS_HIDDEN_CHAR_STR"fnW"
 #define JSGRAPHICS_CUSTOMFONT_HEIGHT JS_HIDDEN_CHAR_STR"fnH"
 #define JSGRAPHICS_CUSTOMFONT_FIRSTCHAR JS_HIDDEN_CHAR_STR"fn1"
+#define JSGRAPHICS_CUSTOMFONT_ID JS_HIDDEN_CHAR_STR"fnI" ///< ID for the glyph cache
 
 typedef struct {
   unsigned short x1,y1;
@@ -119,6 +134,10 @@ typedef struct {
 #ifndef NO_MODIFIED_AREA
   JsGraphicsClipRect clipRect;
   short modMinX, modMinY, modMaxX, modMaxY; ///< area that has been modified
+#if JSGRAPHICS_MODIFIED_RECTS>1
+  unsigned char modRectCount; ///< How many entries in modRects are used
+  JsGraphicsClipRect modRects[JSGRAPHICS_MODIFIED_RECTS]; ///< Non-overlapping rectangles inside modMin/Max that have actually been modified
+#endif
 #endif
 } PACKED_FLAGS JsGraphicsData;
 
@@ -132,6 +151,13 @@ typedef struct JsGraphics {
   unsigned int (*getPixel)(struct JsGraphics *gfx, int x, int y); ///< x/y guaranteed to be in range
   void (*blit)(struct JsGraphics *gfx, int x1, int y1, int w, int h, int x2, int y2); ///< blit a WxH area of x1y1 to x2y2 - all guaranteed to be in range
   void (*scroll)(struct JsGraphics *gfx, int xdir, int ydir,  int x1, int y1, int x2, int y2); ///< scroll - leave unscrolled area undefined (all values guaranteed to be in range)
+  void (*blitSpan)(struct JsGraphics *gfx, int x, int y, int w, const unsigned char *data); ///< write 'w' pixels (bpp of 8 or 16, packed MSB-first as in an Image) to x,y - all guaranteed to be in range
+  void (*blitColumn)(struct JsGraphics *gfx, int x, int y, int h, const unsigned char *data); ///< as blitSpan, but write 'h' pixels downwards from x,y (for drawing rotated images)
+#ifdef GRAPHICS_BLEND_CACHE_SIZE
+  unsigned int blendFgColor, blendBgColor; ///< the colors blendCache is for
+  unsigned short blendCacheAmt[GRAPHICS_BLEND_CACHE_SIZE]; ///< the blend amount each blendCache entry is for (0xFFFF = unused)
+  unsigned short blendCache[GRAPHICS_BLEND_CACHE_SIZE]; ///< results of graphicsBlendGfxColor (8 to 16 bit only)
+#endif
 } PACKED_FLAGS JsGraphics;
 typedef void (*JsGraphicsSetPixelFn)(struct JsGraphics *gfx, int x, int y, unsigned int col);
 
@@ -187,13 +213,30 @@ size_t graphicsGetMemoryRequired(const JsGraphics *gfx);
 void graphicsToDeviceCoordinates(const JsGraphics *gfx, int *x, int *y);
 // If graphics is flipped or rotated then the coordinates need modifying. This is to go back - eg for touchscreens
 void deviceToGraphicsCoordinates(const JsGraphics *gfx, int *x, int *y);
+/** How user coordinates map to device coordinates (after setRotation/reflection), so we can transform a whole
+ * row or column at once rather than each pixel: device x = x + xx*userX + xy*userY, device y = y + yx*userX + yy*userY */
+typedef struct {
+  int x, y;
+  signed char xx, xy, yx, yy; ///< each is -1, 0 or 1
+} GfxDeviceMapping;
+void graphicsGetDeviceMapping(const JsGraphics *gfx, GfxDeviceMapping *m);
 
 unsigned short graphicsGetWidth(const JsGraphics *gfx);
 unsigned short graphicsGetHeight(const JsGraphics *gfx);
 // Set the area modified (inclusive of x2,y2) by a draw command and also clip to the screen/clipping bounds. Returns true if clipped
 bool graphicsSetModifiedAndClip(JsGraphics *gfx, int *x1, int *y1, int *x2, int *y2);
+/** As graphicsSetModifiedAndClip, but x1..y2 are in user coordinates (so setRotation is taken into account), and
+ * are clipped in user coordinates. Returns true if clipped */
+bool graphicsSetModifiedAndClipUser(JsGraphics *gfx, int *x1, int *y1, int *x2, int *y2);
 // Set the area modified by a draw command
 void graphicsSetModified(JsGraphics *gfx, int x1, int y1, int x2, int y2);
+#ifndef NO_MODIFIED_AREA
+/// Reset the modified area (and list of modified rectangles) to empty
+void graphicsResetModified(JsGraphics *gfx);
+/** Get the modified area as a list of non-overlapping rectangles (in device coordinates). 'rects' must have
+ * space for JSGRAPHICS_MODIFIED_RECTS. Returns the number of rectangles, or 0 if nothing was modified */
+int graphicsGetModifiedRects(const JsGraphics *gfx, JsGraphicsClipRect *rects);
+#endif
 /// Get a setPixel function (assuming coordinates already clipped with graphicsSetModifiedAndClip) - if all is ok it can choose a faster draw function
 JsGraphicsSetPixelFn graphicsGetSetPixelFn(JsGraphics *gfx);
 /// Get a setPixel function and set modified area (assuming no clipping) (inclusive of x2,y2) - if all is ok it can choose a faster draw function
@@ -211,6 +254,8 @@ void         graphicsFillRect(JsGraphics *gfx, int x1, int y1, int x2, int y2, u
 void graphicsFallbackFillRect(JsGraphics *gfx, int x1, int y1, int x2, int y2, unsigned int col); // Simple fillrect - doesn't call device-specific FR
 void graphicsFillRectDevice(JsGraphics *gfx, int x1, int y1, int x2, int y2, unsigned int col); // fillrect using device coordinates
 void graphicsFallbackScroll(JsGraphics *gfx, int xdir, int ydir, int x1, int y1, int x2, int y2);
+void graphicsFallbackBlitSpan(JsGraphics *gfx, int x, int y, int w, const unsigned char *data); // calls setPixel for each pixel
+void graphicsFallbackBlitColumn(JsGraphics *gfx, int x, int y, int h, const unsigned char *data); // calls setPixel for each pixel
 void graphicsDrawRect(JsGraphics *gfx, int x1, int y1, int x2, int y2);
 void graphicsDrawEllipse(JsGraphics *gfx, int x, int y, int x2, int y2);
 void graphicsFillEllipse(JsGraphics *gfx, int x, int y, int x2, int y2);
@@ -219,6 +264,13 @@ void graphicsDrawLine(JsGraphics *gfx, int x1, int y1, int x2, int y2);
 void graphicsDrawLineAA(JsGraphics *gfx, int ix1, int iy1, int ix2, int iy2); ///< antialiased drawline. each pixel is 1/16th
 void graphicsDrawCircleAA(JsGraphics *gfx, int x, int y, int r);
 void graphicsFillPoly(JsGraphics *gfx, int points, short *vertices); ///< each pixel is 1/16th a pixel may overwrite vertices...
+/// Called for each span inside a polygon with Y and start/end X (exclusive) in 1/16th pixels
+typedef void (*GfxPolySpanFn)(JsGraphics *gfx, int y, int x1, int x2, void *data);
+/// Scan-convert a polygon (vertices in 1/16th pixels, device coordinates), calling spanFn for each span on scanlines yStart..yEnd (inclusive) every yStep
+void graphicsFillPolyScan(JsGraphics *gfx, int points, const short *vertices, int yStart, int yEnd, int yStep, GfxPolySpanFn spanFn, void *spanData);
+#ifdef GRAPHICS_ANTIALIAS
+void graphicsFillPolyAA(JsGraphics *gfx, int points, short *vertices); ///< each pixel is 1/16th a pixel may overwrite vertices...
+#endif
 /// Draw a simple 1bpp image in foreground colour
 void graphicsDrawImage1bpp(JsGraphics *gfx, int x1, int y1, int width, int height, const unsigned char *pixelData);
 /// Scroll the graphics device (in user coords). X>0 = to right, Y >0 = down
@@ -35,6 +35,7 @@
 #include "bitmap_font_4x6.h"
 #include "bitmap_font_6x8.h"
 #include "vector_font.h"
+#include "glyph_cache.h"
 
 #ifdef GRAPHICS_PALETTED_IMAGES
 #if defined(ESPR_GRAPHICS_12BIT)
@@ -276,6 +277,7 @@ typedef struct {
   int sx,sy; //< iterator X increment
   int px,py; //< y iterator position
   int qx,qy; //< x iterator position
+  bool simple; //< unrotated and unscaled, so drawImages can read runs of pixels (set by drawImages)
 } GfxDrawImageLayer;
 
 bool _jswrap_drawImageLayerGetPixel(GfxDrawImageLayer *l, unsigned int *result) {
@@ -354,6 +356,12 @@ NO_INLINE void _jswrap_drawImageLayerSetStart(GfxDrawImageLayer *l, int x, int y
   int dy = y - l->y1;
   l->px += l->sx*dx + l->sy*dy;
   l->py += l->sx*dy - l->sy*dx;
+  if (l->repeat) { // we may have moved more than one image away
+    l->px %= l->mx;
+    if (l->px < 0) l->px += l->mx;
+    l->py %= l->my;
+    if (l->py < 0) l->py += l->my;
+  }
 }
 NO_INLINE void _jswrap_drawImageLayerStartX(GfxDrawImageLayer *l) {
   l->qx = l->px;
@@ -385,10 +393,222 @@ NO_INLINE void _jswrap_drawImageLayerNextY(GfxDrawImageLayer *l) {
   }
 }
 
+#ifdef GRAPHICS_FAST_PATHS
+/// How many pixels _jswrap_drawImageSpans decodes at once (max)
+#define GFX_SPAN_PIXELS 64
+
+/** Get a pointer to the next 'len' bytes from the iterator. If they're contiguous in memory we
+ * return a pointer to them directly, otherwise they're copied into 'buf' */
+static ALWAYS_INLINE const unsigned char *_jswrap_drawImageGetBytes(JsvStringIterator *it, unsigned char *buf, size_t len) {
+  if (it->charIdx + len < it->charsInVar) {
+    const unsigned char *p = (const unsigned char *)&it->ptr[it->charIdx];
+    it->charIdx += len;
+    return p;
+  }
+  // otherwise copy a block at a time
+  size_t n = 0;
+  while (n<len && jsvStringIteratorHasChar(it)) {
+    size_t l = it->charsInVar - it->charIdx;
+    if (l > len-n) l = len-n;
+    memcpy(&buf[n], &it->ptr[it->charIdx], l);
+    n += l;
+    it->charIdx += l-1;
+    jsvStringIteratorNextInline(it);
+  }
+  if (n<len) memset(&buf[n], 0, len-n); // off the end of the image
+  return buf;
+}
+
+/** Write 'w' pixels of an image row at x,y (user coordinates) with blitSpan, or if the Graphics
+ * is rotated so the row is a device column, blitColumn. Reverses the pixels first if needed */
+static void _jswrap_drawImageBlit(JsGraphics *gfx, const GfxDeviceMapping *m, int x, int y, int w, const unsigned char *data, int bytesPerPixel) {
+  if (!(gfx->data.flags & JSGRAPHICSFLAGS_MAPPEDXY)) {
+    gfx->blitSpan(gfx, x, y, w, data);
+    return;
+  }
+  int dx = m->x + m->xx*x + m->xy*y;
+  int dy = m->y + m->yx*x + m->yy*y;
+  unsigned char rev[GFX_SPAN_PIXELS*2];
+  if (m->xx+m->yx < 0) { // the row goes backwards on the device
+    if (bytesPerPixel==2) {
+      for (int i=0;i<w;i++) {
+        rev[i*2] = data[(w-1-i)*2];
+        rev[i*2+1] = data[(w-1-i)*2+1];
+      }
+    } else {
+      for (int i=0;i<w;i++)
+        rev[i] = data[w-1-i];
+    }
+    data = rev;
+    if (m->xx) dx -= w-1;
+    else dy -= w-1;
+  }
+  if (m->xx) gfx->blitSpan(gfx, dx, dy, w, data);
+  else gfx->blitColumn(gfx, dx, dy, w, data);
+}
+
+/** Send the pixels in 'data' (w pixels, 'bytesPerPixel' each) for which the corresponding bit
+ * in 'solid' is set to blitSpan, in runs, clipped to x1..x2 */
+static void _jswrap_drawImageSpanOut(JsGraphics *gfx, const GfxDeviceMapping *m, int x, int y, int w, const unsigned char *data, int bytesPerPixel, uint64_t solid, int x1, int x2) {
+  int i = 0;
+  while (i<w) {
+    // skip transparent pixels, then find the end of the run of solid ones
+    while (i<w && !((solid>>i)&1)) i++;
+    int start = i;
+    while (i<w && ((solid>>i)&1)) i++;
+    // clip and output
+    int sx = x+start, ex = x+i-1;
+    if (sx<x1) sx = x1;
+    if (ex>x2) ex = x2;
+    if (sx<=ex)
+      _jswrap_drawImageBlit(gfx, m, sx, y, 1+ex-sx, &data[(sx-x)*bytesPerPixel], bytesPerPixel);
+  }
+}
+
+/** Draw an unscaled, unrotated image a line at a time using gfx->blitSpan. This only works if
+ * the Graphics is 8 or 16 bits - returns false if not. If the image is already in the Graphics'
+ * format the data goes straight to blitSpan (without even being copied if it's in a flat string),
+ * otherwise pixels are unpacked and the palette is applied a span at a time. Transparent pixels
+ * split spans up, so they're never written. If the Graphics has setRotation applied, each line of
+ * the image is written as a device row or column with blitSpan/blitColumn. */
+static bool _jswrap_drawImageSpans(JsGraphics *gfx, int xPos, int yPos, GfxDrawImageInfo *img, JsvStringIterator *it) {
+  if (gfx->data.bpp!=8 && gfx->data.bpp!=16)
+    return false;
+  int bytesPerPixel = gfx->data.bpp>>3;
+  // Is the image data already in the Graphics' format?
+  bool direct = img->bpp==gfx->data.bpp && !img->palettePtr;
+  // if not, can we unpack it easily?
+  if (!direct && (img->bpp>8 || (8%img->bpp)!=0))
+    return false;
+  int x1 = xPos, y1 = yPos, x2 = xPos+img->width-1, y2 = yPos+img->height-1;
+  graphicsSetModifiedAndClipUser(gfx, &x1, &y1, &x2, &y2);
+  if (x1>x2 || y1>y2) return true; // totally offscreen
+  GfxDeviceMapping m;
+  graphicsGetDeviceMapping(gfx, &m);
+  unsigned char buf[GFX_SPAN_PIXELS*2];
+  unsigned int colData = 0;
+  int bits = 0;
+  for (int y=yPos;y<yPos+img->height;y++) {
+    bool onScreen = y>=y1 && y<=y2;
+    if (direct && !onScreen) { // just skip the line
+      jsvStringIteratorGoto(it, img->buffer, jsvStringIteratorGetIndex(it) + (size_t)img->stride);
+      continue;
+    }
+    for (int x=0;x<img->width;x+=GFX_SPAN_PIXELS) {
+      int w = img->width-x;
+      if (w>GFX_SPAN_PIXELS) w=GFX_SPAN_PIXELS;
+      uint64_t solid = 0xFFFFFFFFFFFFFFFFULL;
+      const unsigned char *data;
+      if (direct) {
+        data = _jswrap_drawImageGetBytes(it, buf, (size_t)(w*bytesPerPixel));
+        if (img->isTransparent) {
+          for (int i=0;i<w;i++) {
+            unsigned int col = (bytesPerPixel==1) ? data[i] : (unsigned int)((data[i*2]<<8)|data[i*2+1]);
+            if (col==img->transparentCol) solid &= ~(1ULL<<i);
+          }
+        }
+      } else {
+        // Unpack a byte at a time and look up the palette
+        unsigned char *p = buf;
+        for (int i=0;i<w;i++) {
+          if (!bits) {
+            colData = (unsigned char)jsvStringIteratorGetCharAndNext(it);
+            bits = 8;
+          }
+          bits -= img->bpp;
+          unsigned int col = (colData>>bits) & img->bitMask;
+          if (col==img->transparentCol) solid &= ~(1ULL<<i);
+          if (img->palettePtr) col = img->palettePtr[col&img->paletteMask];
+          if (bytesPerPixel==2) *(p++) = (unsigned char)(col>>8);
+          *(p++) = (unsigned char)col;
+        }
+        data = buf;
+      }
+      if (onScreen)
+        _jswrap_drawImageSpanOut(gfx, &m, xPos+x, y, w, data, bytesPerPixel, solid, x1, x2);
+    }
+  }
+  return true;
+}
+
+/** Fill in the pixels of a drawImages layer in a span of 'w' pixels for which the bit in 'need' is
+ * set (they're not covered by a layer above), and return 'need' with the bits of solid pixels
+ * cleared. Simple (unrotated, unscaled) layers are unpacked a run at a time straight from the
+ * image, skipping pixels that aren't needed or are outside it. Others are read a pixel at a time. */
+static uint64_t _jswrap_drawImagesLayerSpan(GfxDrawImageLayer *l, int w, unsigned int *cols, uint64_t need) {
+  if (!l->simple) {
+    for (int i=0;i<w;i++) {
+      if (((need>>i)&1) && _jswrap_drawImageLayerGetPixel(l, &cols[i]))
+        need &= ~(1ULL<<i);
+      _jswrap_drawImageLayerNextX(l);
+      _jswrap_drawImageLayerNextXRepeat(l);
+    }
+    return need;
+  }
+  // sx==256 and sy==0, so qx and qy are whole pixels and qy doesn't change along the row
+  int ix = l->qx>>8, iy = l->qy>>8;
+  l->qx += w<<8;
+  if (l->repeat) l->qx %= l->mx;
+  if (!need || iy<0 || iy>=l->img.height) return need;
+  int width = l->img.width, bpp = l->img.bpp;
+  unsigned char buf[(GFX_SPAN_PIXELS*24+7)/8 + 1];
+  int i = 0, end = w;
+  if (!l->repeat) {
+    if (ix<0) i = -ix;
+    if (end > width-ix) end = width-ix;
+  }
+  while (i<end) {
+    // skip pixels that are already covered, and find the end of the run that isn't
+    while (i<end && !((need>>i)&1)) i++;
+    if (i>=end) break;
+    int runEnd = i;
+    while (runEnd<end && ((need>>runEnd)&1)) runEnd++;
+    // the run may wrap around the image if it's repeated
+    int imgx = (ix+i) % width;
+    int n = runEnd-i;
+    if (n > width-imgx) n = width-imgx;
+    // get all the bytes for the run at once, then unpack them
+    size_t bitPos = (size_t)(imgx + iy*width) * (size_t)bpp;
+    jsvStringIteratorGoto(&l->it, l->img.buffer, l->img.bitmapOffset + (bitPos>>3));
+    const unsigned char *p = _jswrap_drawImageGetBytes(&l->it, buf, ((bitPos&7) + (size_t)(n*bpp) + 7)>>3);
+    int bits = 8-(int)(bitPos&7);
+    unsigned int data = *(p++) & (0xFFu>>(bitPos&7));
+    for (int j=i;j<i+n;j++) {
+      while (bits<bpp) {
+        data = (data<<8) | *(p++);
+        bits += 8;
+      }
+      bits -= bpp;
+      unsigned int col = (data>>bits) & l->img.bitMask;
+      if (col!=l->img.transparentCol) {
+        if (l->img.palettePtr) col = l->img.palettePtr[col&l->img.paletteMask];
+        cols[j] = col;
+        need &= ~(1ULL<<j);
+      }
+    }
+    i += n;
+  }
+  return need;
+}
+#endif
+
 NO_INLINE void _jswrap_drawImageSimple(JsGraphics *gfx, int xPos, int yPos, GfxDrawImageInfo *img, JsvStringIterator *it) {
+#ifdef GRAPHICS_FAST_PATHS
+  if (_jswrap_drawImageSpans(gfx, xPos, yPos, img, it))
+    return;
+#endif
   int bits=0, colData=0;
-  JsGraphicsSetPixelFn setPixel = graphicsGetSetPixelUnclippedFn(gfx, xPos, yPos, xPos+img->width-1, yPos+img->height-1);
+  // Clip, then work out where each line starts on the device so we don't have to transform every pixel
+  int x1 = xPos, y1 = yPos, x2 = xPos+img->width-1, y2 = yPos+img->height-1;
+  graphicsSetModifiedAndClipUser(gfx, &x1, &y1, &x2, &y2);
+  if (x1>x2 || y1>y2) return; // totally offscreen
+  GfxDeviceMapping m;
+  graphicsGetDeviceMapping(gfx, &m);
+  unsigned int colMask = (unsigned int)((1L<<gfx->data.bpp)-1);
   for (int y=yPos;y<yPos+img->height;y++) {
+    bool onScreen = y>=y1 && y<=y2;
+    int dx = m.x + m.xx*xPos + m.xy*y;
+    int dy = m.y + m.yx*xPos + m.yy*y;
     for (int x=xPos;x<xPos+img->width;x++) {
       // Get the data we need...
       while (bits < img->bpp) {
@@ -399,10 +619,12 @@ NO_INLINE void _jswrap_drawImageSimple(JsGraphics *gfx, int xPos, int yPos, GfxD
       unsigned int col = (colData>>(bits-img->bpp))&img->bitMask;
       bits -= img->bpp;
       // Try and write pixel!
-      if (img->transparentCol!=col) {
+      if (img->transparentCol!=col && onScreen && x>=x1 && x<=x2) {
         if (img->palettePtr) col = img->palettePtr[col&img->paletteMask];
-        setPixel(gfx, x, y, col);
+        gfx->setPixel(gfx, dx, dy, col & colMask);
       }
+      dx += m.xx;
+      dy += m.yx;
     }
   }
 }
@@ -521,6 +743,29 @@ void jswrap_graphics_init() {
 #endif
 }
 
+/*JSON{
+  "type" : "kill",
+  "generate" : "jswrap_graphics_kill"
+}*/
+void jswrap_graphics_kill() {
+#ifdef USE_GLYPH_CACHE
+  // Don't save the glyph cache - it'll be recreated when needed
+  glyphCacheFree();
+#endif
+}
+
+/*JSON{
+  "type" : "freemem",
+  "generate" : "jswrap_graphics_freemem"
+}*/
+bool jswrap_graphics_freemem() {
+#ifdef USE_GLYPH_CACHE
+  return glyphCacheFree();
+#else
+  return false;
+#endif
+}
+
 /*JSON{
   "type" : "staticmethod",
   "class" : "Graphics",
@@ -695,18 +940,36 @@ JsVar *jswrap_graphics_createCallback(int width, int height, int bpp, JsVar *cal
   "params" : [
     ["width","int32","Pixels wide"],
     ["height","int32","Pixels high"],
-    ["bpp","int32","Bits per pixel (8,16,24 or 32 supported)"]
+    ["bpp","int32","Bits per pixel (8,16,24 or 32 supported)"],
+    ["options","JsVar","[optional] `{headless:true}` to render to memory without opening a window"]
   ],
   "return" : ["JsVar","The new Graphics object"],
   "return_object" : "Graphics"
 }
 Create a Graphics object that renders to SDL window (Linux-based devices only)
+
+Drawing goes to an offscreen buffer, and is copied to the window when `g.flip()`
+is called (if `g.flip()` is never called, the window is updated whenever Espruino
+is idle).
+
+With `{headless:true}` (or if Espruino was built with `USE_LCD_SDL=headless`) no window is
+opened, but drawing, `g.flip()` and `g.getStats()` work as normal - so drawing
+code can be tested and benchmarked without a display.
+
+Only one SDL Graphics instance can be used at once - calling `Graphics.createSDL`
+again makes the new instance take over, and any older one stops drawing.
 */
-JsVar *jswrap_graphics_createSDL(int width, int height, int bpp) {
+JsVar *jswrap_graphics_createSDL(int width, int height, int bpp, JsVar *options) {
   if (width<=0 || height<=0 || width>32767 || height>32767) {
     jsExceptionHere(JSET_ERROR, "Invalid Size");
     return 0;
   }
+  bool headless = false;
+  jsvConfigObject configs[] = {
+      {"headless", JSV_BOOLEAN, &headless}
+  };
+  if (!jsvReadConfigObject(options, configs, sizeof(configs) / sizeof(jsvConfigObject)))
+    return 0;
 
   JsVar *parent = jspNewObject(0, "Graphics");
   if (!parent) return 0; // low memory
@@ -714,10 +977,47 @@ JsVar *jswrap_graphics_createSDL(int width, int height, int bpp) {
   gfx.data.type = JSGRAPHICSTYPE_SDL;
   graphicsStructInit(&gfx,width,height,bpp);
   gfx.graphicsVar = parent;
-  lcdInit_SDL(&gfx);
+  if (!lcdInit_SDL(&gfx, headless)) {
+    jsvUnLock(parent);
+    return 0;
+  }
   graphicsSetVarInitial(&gfx);
+  // Create 'flip' fn
+  JsVar *fn = jsvNewNativeFunction((void (*)(void))lcdFlip_SDL, JSWAT_VOID|JSWAT_THIS_ARG|(JSWAT_BOOL << (JSWAT_BITS*1)));
+  jsvObjectSetChildAndUnLock(parent,"flip",fn);
   return parent;
 }
+
+/*JSON{
+  "type" : "method",
+  "class" : "Graphics",
+  "name" : "getStats",
+  "ifdef" : "USE_LCD_SDL",
+  "generate" : "jswrap_graphics_getStats",
+  "return" : ["JsVar","An object containing stats about the last frame, or undefined"]
+}
+On Graphics instances created with `Graphics.createSDL`, return information about
+the last frame that was sent to the screen with `g.flip()`:
+
+```
+{
+  frames,     // how many times g.flip() has been called
+  frameTime,  // milliseconds between the last two calls to g.flip()
+  flipTime,   // milliseconds the last g.flip() took
+  pixels,     // how many pixels were drawn for the last frame (overdraw is counted)
+  flushBytes, // how many bytes the last g.flip() copied to the window
+  headless    // true if there is no window
+}
+```
+
+This allows the speed of UI changes to be benchmarked on a Linux host.
+Other Graphics instances return `undefined`.
+*/
+JsVar *jswrap_graphics_getStats(JsVar *parent) {
+  JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return 0;
+  if (gfx.data.type!=JSGRAPHICSTYPE_SDL) return 0;
+  return lcdGetStats_SDL(&gfx);
+}
 #endif
 
 
@@ -860,6 +1160,96 @@ int jswrap_graphics_getBPP(JsVar *parent) {
   return gfx.data.bpp;
 }
 
+#ifndef SAVE_ON_FLASH
+#define GRAPHICS_RECORD
+#endif
+
+#ifdef GRAPHICS_RECORD
+/* Graphics.record/replay. Commands are stored one after the other in a flat string as
+a GfxRecCmd followed by 'argc' int32 arguments. Arguments that are variables (strings, images, etc)
+are stored as an index into an array of variables that is kept alongside the commands. */
+typedef enum {
+  GFXREC_RESET,      ///< []
+  GFXREC_COLOR,      ///< [col]
+  GFXREC_BGCOLOR,    ///< [col]
+  GFXREC_FONTSIZE,   ///< [fontSize]
+  GFXREC_FONT,       ///< [name, size, fontSize]
+  GFXREC_FONTCUSTOM, ///< [bitmap, firstChar, width, height]
+  GFXREC_FONTALIGN,  ///< [x, y, rotation]
+  GFXREC_FIRST_DRAW, ///< all commands from here on draw something
+  GFXREC_CLEAR = GFXREC_FIRST_DRAW, ///< [reset]
+  GFXREC_FILLRECT,   ///< [x1, y1, x2, y2, r]
+  GFXREC_CLEARRECT,  ///< [x1, y1, x2, y2, r]
+  GFXREC_DRAWRECT,   ///< [x1, y1, x2, y2]
+  GFXREC_FILLELLIPSE,///< [x1, y1, x2, y2]
+  GFXREC_DRAWELLIPSE,///< [x1, y1, x2, y2]
+  GFXREC_PIXEL,      ///< [x, y, col]
+  GFXREC_LINE,       ///< [x1, y1, x2, y2]
+  GFXREC_POLY,       ///< [closed|antialias<<1, x, y, ...] (x/y scaled by 16 if antialiased)
+  GFXREC_FILLPOLY,   ///< [antialias, x*16, y*16, ...]
+  GFXREC_STRING,     ///< [str, x, y, solidBackground]
+  GFXREC_IMAGE,      ///< [image, x, y, options]
+  GFXREC_COUNT
+} GfxRecCmdType;
+
+/// Which arguments of each command are variables rather than integers
+static const uint8_t GFXREC_VAR_ARGS[GFXREC_COUNT] = {
+  [GFXREC_FONT] = 1,
+  [GFXREC_FONTCUSTOM] = 1|4,
+  [GFXREC_STRING] = 1,
+  [GFXREC_IMAGE] = 1|8,
+};
+
+#define GFXREC_MAX_ARGS 129 ///< 64 points for polygons, plus flags
+#define GFXREC_FLAG_AREA 1 ///< GfxRecCmd.area is the area the command drew last time
+#define GFXREC_FLAG_CHANGED 2 ///< Used while replaying - the command's arguments or state have changed
+
+typedef struct {
+  uint8_t cmd;        ///< GfxRecCmdType
+  uint8_t flags;      ///< GFXREC_FLAG_*
+  uint16_t argc;      ///< How many int32_t arguments follow
+  uint32_t hash;      ///< Hash of the arguments and drawing state the last time this was drawn
+  JsGraphicsClipRect area; ///< Area (in device coordinates) modified the last time this was drawn
+} PACKED_FLAGS GfxRecCmd;
+
+static JsVar *graphicsRecordParent; ///< The Graphics instance we're recording commands for in Graphics.record (or 0)
+static JsVar *graphicsRecordCmds; ///< String of GfxRecCmd being recorded
+static JsVar *graphicsRecordVars; ///< Array of variables referenced by the commands being recorded
+
+/** If Graphics.record is running for 'parent', add the command to the recording and return true.
+ * Arguments that are variables (see GFXREC_VAR_ARGS) are taken from var1/var2 in order */
+static bool _jswrap_graphics_record(JsVar *parent, GfxRecCmdType cmd, int *args, int argc, JsVar *var1, JsVar *var2) {
+  if (graphicsRecordParent!=parent) return false;
+  GfxRecCmd c;
+  memset(&c, 0, sizeof(c));
+  c.cmd = (uint8_t)cmd;
+  c.argc = (uint16_t)argc;
+  for (int i=0;i<argc;i++) {
+    if (GFXREC_VAR_ARGS[cmd] & (1<<i)) {
+      JsVar *v = var1;
+      var1 = var2;
+      args[i] = v ? (int)jsvArrayPush(graphicsRecordVars, v)-1 : -1;
+    }
+  }
+  jsvAppendStringBuf(graphicsRecordCmds, (char*)&c, sizeof(c));
+  int32_t a[GFXREC_MAX_ARGS];
+  for (int i=0;i<argc;i++) a[i] = (int32_t)args[i];
+  jsvAppendStringBuf(graphicsRecordCmds, (char*)a, sizeof(int32_t)*(size_t)argc);
+  return true;
+}
+
+/// Stop Graphics.record from recording commands (while one command calls others). Pass the return value to _jswrap_graphics_recordResume
+static JsVar *_jswrap_graphics_recordPause() {
+  JsVar *p = graphicsRecordParent;
+  graphicsRecordParent = 0;
+  return p;
+}
+
+static void _jswrap_graphics_recordResume(JsVar *p) {
+  graphicsRecordParent = p;
+}
+#endif
+
 /*JSON{
   "type" : "method",
   "class" : "Graphics",
@@ -873,11 +1263,19 @@ that would have been used when Graphics was initialised.
 */
 JsVar *jswrap_graphics_reset(JsVar *parent) {
   JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return 0;
+#ifdef GRAPHICS_RECORD
+  _jswrap_graphics_record(parent, GFXREC_RESET, 0, 0, 0, 0);
+  JsVar *recording = _jswrap_graphics_recordPause(); // the state is reset now as well as when replaying
+#endif
   // properly reset state
   graphicsStructResetState(&gfx);
   graphicsSetVar(&gfx); // gfx data changed because modified area
   // reset font, which will unreference any custom fonts stored inside the instance
-  return jswrap_graphics_setFontSizeX(parent, 1+JSGRAPHICS_FONTSIZE_4X6, false);
+  JsVar *r = jswrap_graphics_setFontSizeX(parent, 1+JSGRAPHICS_FONTSIZE_4X6, false);
+#ifdef GRAPHICS_RECORD
+  _jswrap_graphics_recordResume(recording);
+#endif
+  return r;
 }
 
 /*JSON{
@@ -894,6 +1292,15 @@ JsVar *jswrap_graphics_reset(JsVar *parent) {
 Clear the LCD with the Background Color
 */
 JsVar *jswrap_graphics_clear(JsVar *parent, bool resetState) {
+#ifdef GRAPHICS_RECORD
+  int args[] = {resetState};
+  if (_jswrap_graphics_record(parent, GFXREC_CLEAR, args, 1, 0, 0)) {
+    JsVar *recording = _jswrap_graphics_recordPause();
+    if (resetState) jsvUnLock(jswrap_graphics_reset(parent));
+    _jswrap_graphics_recordResume(recording);
+    return jsvLockAgain(parent);
+  }
+#endif
   if (resetState) jsvUnLock(jswrap_graphics_reset(parent));
   JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return 0;
   graphicsClear(&gfx);
@@ -923,16 +1330,13 @@ void _jswrap_graphics_getRect(JsVar *opt, int *x1, int *y1, int *x2, int *y2, in
     *x1 = jsvGetInteger(opt);
 }
 
-JsVar *_jswrap_graphics_fillRect_col(JsVar *parent, JsVar *opt, int y1, int x2, int y2, bool isFgCol) {
-  int x1, r;
-  _jswrap_graphics_getRect(opt, &x1, &y1, &x2, &y2, &r);
-  JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return 0;
-  uint32_t col = isFgCol ? gfx.data.fgColor : gfx.data.bgColor;
+/// Fill a rectangle (with rounded corners if r>0)
+static void _jswrap_graphics_fillRectRounded(JsGraphics *gfx, int x1, int y1, int x2, int y2, int r, uint32_t col) {
 #ifndef SAVE_ON_FLASH
   if (r>0) {
     // rounded rects
-    graphicsToDeviceCoordinates(&gfx, &x1, &y1);
-    graphicsToDeviceCoordinates(&gfx, &x2, &y2);
+    graphicsToDeviceCoordinates(gfx, &x1, &y1);
+    graphicsToDeviceCoordinates(gfx, &x2, &y2);
     int x,y;
     if (x1 > x2) { x = x1; x1 = x2; x2 = x; }
     if (y1 > y2) { y = y1; y1 = y2; y2 = y; }
@@ -944,7 +1348,7 @@ JsVar *_jswrap_graphics_fillRect_col(JsVar *parent, JsVar *opt, int y1, int x2,
     // rect in middle
     int cx1 = x1+r, cx2 = x2-r;
     int cy1 = y1+r, cy2 = y2-r;
-    graphicsFillRectDevice(&gfx, x1, cy1, x2, cy2, col);
+    graphicsFillRectDevice(gfx, x1, cy1, x2, cy2, col);
     // draw rounded top and bottom
     int dx = 0;
     int dy = r;
@@ -958,14 +1362,26 @@ JsVar *_jswrap_graphics_fillRect_col(JsVar *parent, JsVar *opt, int y1, int x2,
       if (e2 <  (2*dx+1)*r2) { dx++; err += (2*dx+1)*r2; changed=true; }
       if (e2 > -(2*dy-1)*r2) {
         // draw only just before we change Y, to avoid a bunch of overdraw
-        graphicsFillRectDevice(&gfx, cx1-dx,cy2+dy, cx2+dx,cy2+dy, col);
-        graphicsFillRectDevice(&gfx, cx1-dx,cy1-dy, cx2+dx,cy1-dy, col);
+        graphicsFillRectDevice(gfx, cx1-dx,cy2+dy, cx2+dx,cy2+dy, col);
+        graphicsFillRectDevice(gfx, cx1-dx,cy1-dy, cx2+dx,cy1-dy, col);
         dy--; err -= (2*dy-1)*r2; changed=true;
       }
     } while (changed && dy >= 0);
   } else
 #endif
-  graphicsFillRect(&gfx, x1,y1,x2,y2,col);
+  graphicsFillRect(gfx, x1,y1,x2,y2,col);
+}
+
+JsVar *_jswrap_graphics_fillRect_col(JsVar *parent, JsVar *opt, int y1, int x2, int y2, bool isFgCol) {
+  int x1, r;
+  _jswrap_graphics_getRect(opt, &x1, &y1, &x2, &y2, &r);
+#ifdef GRAPHICS_RECORD
+  int args[] = {x1,y1,x2,y2,r};
+  if (_jswrap_graphics_record(parent, isFgCol ? GFXREC_FILLRECT : GFXREC_CLEARRECT, args, 5, 0, 0))
+    return jsvLockAgain(parent);
+#endif
+  JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return 0;
+  _jswrap_graphics_fillRectRounded(&gfx, x1, y1, x2, y2, r, isFgCol ? gfx.data.fgColor : gfx.data.bgColor);
   graphicsSetVar(&gfx); // gfx data changed because modified area
   return jsvLockAgain(parent);
 }
@@ -1038,6 +1454,11 @@ Draw an unfilled rectangle 1px wide in the Foreground Color
 JsVar *jswrap_graphics_drawRect(JsVar *parent, JsVar *opt, int y1, int x2, int y2) {
   int x1, r;
   _jswrap_graphics_getRect(opt, &x1, &y1, &x2, &y2, &r);
+#ifdef GRAPHICS_RECORD
+  int args[] = {x1,y1,x2,y2};
+  if (_jswrap_graphics_record(parent, GFXREC_DRAWRECT, args, 4, 0, 0))
+    return jsvLockAgain(parent);
+#endif
   JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return 0;
   graphicsDrawRect(&gfx, x1,y1,x2,y2);
   graphicsSetVar(&gfx); // gfx data changed because modified area
@@ -1128,6 +1549,11 @@ JsVar *jswrap_graphics_drawCircleAA(JsVar *parent, int x, int y, int r) {
 Draw a filled ellipse in the Foreground Color
 */
 JsVar *jswrap_graphics_fillEllipse(JsVar *parent, int x, int y, int x2, int y2) {
+#ifdef GRAPHICS_RECORD
+   int args[] = {x,y,x2,y2};
+   if (_jswrap_graphics_record(parent, GFXREC_FILLELLIPSE, args, 4, 0, 0))
+     return jsvLockAgain(parent);
+#endif
    JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return 0;
    graphicsFillEllipse(&gfx, x,y,x2,y2);
    graphicsSetVar(&gfx); // gfx data changed because modified area
@@ -1152,6 +1578,11 @@ JsVar *jswrap_graphics_fillEllipse(JsVar *parent, int x, int y, int x2, int y2)
 Draw an ellipse in the Foreground Color
 */
 JsVar *jswrap_graphics_drawEllipse(JsVar *parent, int x, int y, int x2, int y2) {
+#ifdef GRAPHICS_RECORD
+   int args[] = {x,y,x2,y2};
+   if (_jswrap_graphics_record(parent, GFXREC_DRAWELLIPSE, args, 4, 0, 0))
+     return jsvLockAgain(parent);
+#endif
    JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return 0;
    graphicsDrawEllipse(&gfx, x,y,x2,y2);
    graphicsSetVar(&gfx); // gfx data changed because modified area
@@ -1196,6 +1627,11 @@ JsVar *jswrap_graphics_setPixel(JsVar *parent, int x, int y, JsVar *color) {
   unsigned int col = gfx.data.fgColor;
   if (!jsvIsUndefined(color))
     col = jswrap_graphics_toColor(parent,color,0,0);
+#ifdef GRAPHICS_RECORD
+  int args[] = {x,y,(int)col};
+  if (_jswrap_graphics_record(parent, GFXREC_PIXEL, args, 3, 0, 0))
+    return jsvLockAgain(parent);
+#endif
   graphicsSetPixel(&gfx, x, y, col);
   gfx.data.cursorX = (short)x;
   gfx.data.cursorY = (short)y;
@@ -1420,6 +1856,10 @@ be a floating point value, and `g` and `b` are ignored.
 JsVar *jswrap_graphics_setColorX(JsVar *parent, JsVar *r, JsVar *g, JsVar *b, bool isForeground) {
   JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return 0;
   unsigned int color = jswrap_graphics_toColor(parent,r,g,b);
+#ifdef GRAPHICS_RECORD
+  int args[] = {(int)color};
+  _jswrap_graphics_record(parent, isForeground ? GFXREC_COLOR : GFXREC_BGCOLOR, args, 1, 0, 0);
+#endif
   if (isForeground)
     gfx.data.fgColor = color;
   else
@@ -1560,6 +2000,10 @@ JsVar *jswrap_graphics_setFontSizeX(JsVar *parent, int size, bool isVectorFont)
 #endif
   gfx.data.fontSize = (unsigned short)size;
   graphicsSetVar(&gfx);
+#endif
+#ifdef GRAPHICS_RECORD
+  int args[] = {size};
+  _jswrap_graphics_record(parent, GFXREC_FONTSIZE, args, 1, 0, 0);
 #endif
   return jsvLockAgain(parent);
 }
@@ -1587,6 +2031,19 @@ For examples of use, see the [font modules](https://www.espruino.com/Fonts#font-
 the newline character 13 will always be treated as a newline and not rendered.
 */
 #ifndef SAVE_ON_FLASH
+#ifdef USE_GLYPH_CACHE
+/// Is the font data (bitmap or widths) the same as we had before?
+static bool _jswrap_graphics_isSameFontData(JsVar *a, JsVar *b) {
+  if (!a || !b || !jsvIsBasic(a) || !jsvIsBasic(b)) return false;
+  size_t lenA, lenB;
+  char *ptrA = jsvIsString(a) ? jsvGetDataPointer(a, &lenA) : 0;
+  char *ptrB = jsvIsString(b) ? jsvGetDataPointer(b, &lenB) : 0;
+  if (ptrA && ptrA==ptrB && lenA==lenB) return true; // eg. the same file in Storage
+  if (jsvIsString(a) && jsvIsString(b) && jsvGetStringLength(a)!=jsvGetStringLength(b)) return false;
+  return jsvIsBasicVarEqual(a, b);
+}
+#endif
+
 JsVar *jswrap_graphics_setFontCustom(JsVar *parent, JsVar *bitmap, int firstChar, JsVar *width, int height) {
   JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return 0;
 
@@ -1615,12 +2072,30 @@ JsVar *jswrap_graphics_setFontCustom(JsVar *parent, JsVar *bitmap, int firstChar
     return 0;
   }
   height = height&255;
+#ifdef USE_GLYPH_CACHE
+  // Apps often call setFontCustom before every draw. Only give the font a new ID
+  // (so glyphs have to be cached again) if it's actually changed
+  JsVar *oldBitmap = jsvObjectGetChild(parent, JSGRAPHICS_CUSTOMFONT_BMP, 0);
+  JsVar *oldWidth = jsvObjectGetChild(parent, JSGRAPHICS_CUSTOMFONT_WIDTH, 0);
+  int fontId = jsvGetIntegerAndUnLock(jsvObjectGetChild(parent, JSGRAPHICS_CUSTOMFONT_ID, 0));
+  if (!fontId ||
+      jsvGetIntegerAndUnLock(jsvObjectGetChild(parent, JSGRAPHICS_CUSTOMFONT_HEIGHT, 0))!=height ||
+      jsvGetIntegerAndUnLock(jsvObjectGetChild(parent, JSGRAPHICS_CUSTOMFONT_FIRSTCHAR, 0))!=firstChar ||
+      !_jswrap_graphics_isSameFontData(oldBitmap, bitmap) ||
+      !_jswrap_graphics_isSameFontData(oldWidth, width))
+    jsvObjectSetChildAndUnLock(parent, JSGRAPHICS_CUSTOMFONT_ID, jsvNewFromInteger(glyphCacheNewFontId()));
+  jsvUnLock2(oldBitmap, oldWidth);
+#endif
   jsvObjectSetChild(parent, JSGRAPHICS_CUSTOMFONT_BMP, bitmap);
   jsvObjectSetChild(parent, JSGRAPHICS_CUSTOMFONT_WIDTH, width);
   jsvObjectSetChildAndUnLock(parent, JSGRAPHICS_CUSTOMFONT_HEIGHT, jsvNewFromInteger(height));
   jsvObjectSetChildAndUnLock(parent, JSGRAPHICS_CUSTOMFONT_FIRSTCHAR, jsvNewFromInteger(firstChar));
   gfx.data.fontSize = (unsigned short)(scale + fontType);
   graphicsSetVar(&gfx);
+#ifdef GRAPHICS_RECORD
+  int args[] = {0, firstChar, 0, height | (scale<<8) | (bpp<<16)};
+  _jswrap_graphics_record(parent, GFXREC_FONTCUSTOM, args, 4, bitmap, width);
+#endif
   return jsvLockAgain(parent);
 }
 #endif
@@ -1653,6 +2128,10 @@ JsVar *jswrap_graphics_setFontAlign(JsVar *parent, int x, int y, int r) {
   gfx.data.fontAlignY = y;
   gfx.data.fontRotate = r;
   graphicsSetVar(&gfx);
+#ifdef GRAPHICS_RECORD
+  int args[] = {x,y,r};
+  _jswrap_graphics_record(parent, GFXREC_FONTALIGN, args, 3, 0, 0);
+#endif
   return jsvLockAgain(parent);
 #else
   return 0;
@@ -1692,6 +2171,18 @@ For a list of available font names, you can use `g.getFonts()`.
 JsVar *jswrap_graphics_setFont(JsVar *parent, JsVar *fontId, int size) {
 #ifndef SAVE_ON_FLASH
   if (!jsvIsString(fontId)) return 0;
+#ifdef GRAPHICS_RECORD
+  if (graphicsRecordParent==parent) {
+    // Record the font name *and* what it resolved to, so non-custom fonts can be set quickly on replay
+    JsVar *recording = _jswrap_graphics_recordPause();
+    JsVar *r = jswrap_graphics_setFont(parent, fontId, size);
+    _jswrap_graphics_recordResume(recording);
+    JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return r;
+    int args[] = {0, size, gfx.data.fontSize};
+    _jswrap_graphics_record(parent, GFXREC_FONT, args, 3, fontId, 0);
+    return r;
+  }
+#endif
   bool isVector = false;
   int fontSizeCharIdx = -1;
 #ifndef NO_VECTOR_FONT
@@ -1861,6 +2352,13 @@ typedef struct {
   unsigned short scale;
   unsigned short scalex, scaley;
   unsigned char customFirstChar;
+#ifdef USE_GLYPH_CACHE
+  uint16_t customFontId;  ///< ID of the custom font in the glyph cache (or 0)
+  bool widthsChecked;     ///< Have we tried to get 'widths' yet?
+  JsVar *glyphCache;      ///< The glyph cache (locked while we're using 'widths')
+  const uint8_t *widths;  ///< Unscaled width of each character from the glyph cache, or 0
+  uint32_t widthsChanges; ///< glyphCacheGetChanges when we got 'widths' - if it changes, widths may have moved
+#endif
 } JsGraphicsFontInfo;
 
 static void _jswrap_graphics_getFontInfo(JsGraphics *gfx, JsGraphicsFontInfo *info) {
@@ -1878,9 +2376,84 @@ static void _jswrap_graphics_getFontInfo(JsGraphics *gfx, JsGraphicsFontInfo *in
   } else
 #endif
     info->customFirstChar = 0;
+#ifdef USE_GLYPH_CACHE
+  info->customFontId = 0;
+  if (info->font & JSGRAPHICS_FONTSIZE_CUSTOM_BIT)
+    info->customFontId = (uint16_t)jsvGetIntegerAndUnLock(jsvObjectGetChild(gfx->graphicsVar, JSGRAPHICS_CUSTOMFONT_ID, 0));
+  info->widthsChecked = false;
+  info->glyphCache = 0;
+  info->widths = 0;
+#endif
+}
+
+static void _jswrap_graphics_freeFontInfo(JsGraphicsFontInfo *info) {
+#ifdef USE_GLYPH_CACHE
+  jsvUnLock(info->glyphCache);
+  info->glyphCache = 0;
+  info->widths = 0;
+#else
+  NOT_USED(info);
+#endif
+}
+
+#ifdef USE_GLYPH_CACHE
+/// Get a table of the width of every character in the current font from the glyph cache
+static void _jswrap_graphics_getFontWidths(JsGraphics *gfx, JsGraphicsFontInfo *info) {
+  info->widthsChecked = true;
+  if (info->font != JSGRAPHICS_FONTSIZE_VECTOR && !info->customFontId) return;
+  JsVar *cache = glyphCacheGet(true);
+  if (!cache) return;
+#ifndef NO_VECTOR_FONT
+  if (info->font == JSGRAPHICS_FONTSIZE_VECTOR)
+    info->widths = graphicsVectorCharWidths(cache);
+#endif
+  if (info->font & JSGRAPHICS_FONTSIZE_CUSTOM_BIT) {
+    GlyphCacheKey key;
+    glyphCacheKeyInit(&key, info->customFontId, jsvGetRef(gfx->graphicsVar), 0);
+    key.flags = GLYPH_CACHE_WIDTHS;
+    GlyphCacheEntry *entry = glyphCacheFind(cache, &key);
+    if (!entry) {
+      JsVar *customWidth = jsvObjectGetChild(gfx->graphicsVar, JSGRAPHICS_CUSTOMFONT_WIDTH, 0);
+      if ((jsvIsString(customWidth) || (jsvIsInt(customWidth) && jsvGetInteger(customWidth)<256)) &&
+          (entry = glyphCacheAdd(cache, &key, 256))) {
+        uint8_t *widths = GLYPH_CACHE_DATA(entry);
+        if (jsvIsString(customWidth)) {
+          memset(widths, 0, 256);
+          JsvStringIterator it;
+          jsvStringIteratorNew(&it, customWidth, 0);
+          for (int ch=info->customFirstChar; ch<256 && jsvStringIteratorHasChar(&it); ch++)
+            widths[ch] = (uint8_t)jsvStringIteratorGetCharAndNext(&it);
+          jsvStringIteratorFree(&it);
+        } else
+          memset(widths, (int)jsvGetInteger(customWidth), 256);
+      }
+      jsvUnLock(customWidth);
+    }
+    if (entry) info->widths = GLYPH_CACHE_DATA(entry);
+  }
+  if (info->widths) {
+    info->glyphCache = cache;
+    info->widthsChanges = glyphCacheGetChanges(cache);
+  } else jsvUnLock(cache);
 }
+#endif
 
 static int _jswrap_graphics_getCharWidth(JsGraphics *gfx, JsGraphicsFontInfo *info, char ch) {
+#ifdef USE_GLYPH_CACHE
+  if (info->widths && glyphCacheGetChanges(info->glyphCache)!=info->widthsChanges) {
+    // glyphs were added to the cache (eg. by drawString) so our widths may have moved
+    _jswrap_graphics_freeFontInfo(info);
+    info->widthsChecked = false;
+  }
+  if (!info->widthsChecked) _jswrap_graphics_getFontWidths(gfx, info);
+  if (info->widths) {
+#ifndef NO_VECTOR_FONT
+    if (info->font == JSGRAPHICS_FONTSIZE_VECTOR)
+      return (int)graphicsVectorCharWidthFromTable(info->widths, info->scalex, ch);
+#endif
+    return info->scalex*info->widths[(unsigned char)ch];
+  }
+#endif
   if (info->font == JSGRAPHICS_FONTSIZE_VECTOR) {
 #ifndef NO_VECTOR_FONT
     return (int)graphicsVectorCharWidth(gfx, info->scalex, ch);
@@ -1898,8 +2471,8 @@ static int _jswrap_graphics_getCharWidth(JsGraphics *gfx, JsGraphicsFontInfo *in
     // character - maybe we should store this in JsGraphicsFontInfo (but then we have to unlock it)
     JsVar *customWidth = jsvObjectGetChild(gfx->graphicsVar, JSGRAPHICS_CUSTOMFONT_WIDTH, 0);
     if (jsvIsString(customWidth)) {
-      if (ch>=info->customFirstChar)
-        w = info->scalex*(unsigned char)jsvGetCharInString(customWidth, (size_t)(ch-info->customFirstChar));
+      if ((unsigned char)ch>=info->customFirstChar)
+        w = info->scalex*(unsigned char)jsvGetCharInString(customWidth, (size_t)((unsigned char)ch-info->customFirstChar));
     } else
       w = info->scalex*(int)jsvGetInteger(customWidth);
     jsvUnLock(customWidth);
@@ -1940,7 +2513,9 @@ int jswrap_graphics_getFontHeight(JsVar *parent) {
   JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return 0;
   JsGraphicsFontInfo info;
   _jswrap_graphics_getFontInfo(&gfx, &info);
-  return _jswrap_graphics_getFontHeightInternal(&gfx, &info);
+  int h = _jswrap_graphics_getFontHeightInternal(&gfx, &info);
+  _jswrap_graphics_freeFontInfo(&info);
+  return h;
 #else
   return 0;
 #endif
@@ -1986,6 +2561,7 @@ void _jswrap_graphics_stringMetrics(JsGraphics *gfx, JsVar *var, int lineStartIn
   }
   jsvStringIteratorFree(&it);
   jsvUnLock(str);
+  _jswrap_graphics_freeFontInfo(&info);
   if (stringWidth) *stringWidth = width>maxWidth ? width : maxWidth;
   if (stringHeight) *stringHeight = height;
 }
@@ -2139,9 +2715,87 @@ JsVar *jswrap_graphics_wrapString(JsVar *parent, JsVar *str, int maxWidth) {
   if (jsvGetStringLength(currentLine))
     jsvArrayPush(lines, currentLine);
   jsvUnLock2(str,currentLine);
+  _jswrap_graphics_freeFontInfo(&info);
   return lines;
 }
 
+#ifdef USE_GLYPH_CACHE
+/// Get a character of a custom font from the glyph cache, adding it if it's not there
+static GlyphCacheEntry *_jswrap_graphics_getCustomGlyph(JsGraphics *gfx, JsVar *cache, JsGraphicsFontInfo *info, char ch, JsVar *customBitmap, JsVar *customWidth, int height, int bpp) {
+  GlyphCacheKey key;
+  glyphCacheKeyInit(&key, info->customFontId, jsvGetRef(gfx->graphicsVar), ch);
+  GlyphCacheEntry *glyph = glyphCacheFind(cache, &key);
+  if (glyph) return glyph;
+  // get char width and offset in the bitmap
+  int chIdx = (unsigned char)ch - info->customFirstChar;
+  int width = 0, bmpOffset = 0;
+  if (jsvIsString(customWidth)) {
+    JsvStringIterator wit;
+    jsvStringIteratorNew(&wit, customWidth, 0);
+    while (jsvStringIteratorHasChar(&wit) && (int)jsvStringIteratorGetIndex(&wit)<chIdx)
+      bmpOffset += (unsigned char)jsvStringIteratorGetCharAndNext(&wit);
+    width = (unsigned char)jsvStringIteratorGetChar(&wit);
+    jsvStringIteratorFree(&wit);
+  } else {
+    width = (int)jsvGetInteger(customWidth);
+    bmpOffset = width*chIdx;
+  }
+  if (width<0 || width>255) return 0;
+  int bits = width*height*bpp;
+  glyph = glyphCacheAdd(cache, &key, (size_t)((bits+7)>>3));
+  if (!glyph) return 0;
+  glyph->width = (uint16_t)width;
+  glyph->height = (uint16_t)height;
+  glyph->advance = (uint16_t)width;
+  // copy the bits for this character so they start at the beginning of a byte
+  unsigned char *data = GLYPH_CACHE_DATA(glyph);
+  memset(data, 0, glyph->length);
+  bmpOffset *= height * bpp;
+  JsvStringIterator cit;
+  jsvStringIteratorNew(&cit, customBitmap, (size_t)(bmpOffset>>3));
+  int citdata = (unsigned char)jsvStringIteratorGetChar(&cit) << (bmpOffset&7);
+  bmpOffset &= 7;
+  for (int i=0;i<bits;i++) {
+    if (citdata&128) data[i>>3] |= (unsigned char)(128>>(i&7));
+    citdata <<= 1;
+    if (++bmpOffset>=8) {
+      bmpOffset = 0;
+      jsvStringIteratorNext(&cit);
+      citdata = (unsigned char)jsvStringIteratorGetChar(&cit);
+    }
+  }
+  jsvStringIteratorFree(&cit);
+  return glyph;
+}
+
+/// Draw a character of a custom font from the glyph cache, filling runs of the same colour in each column at once
+static void _jswrap_graphics_drawCustomGlyph(JsGraphics *gfx, int x, int y, GlyphCacheEntry *glyph, JsGraphicsFontInfo *info, int bpp, bool solidBackground) {
+  const unsigned char *data = GLYPH_CACHE_DATA(glyph);
+  int range = (1<<bpp)-1;
+  int bit = 0;
+  for (int cx=0;cx<glyph->width;cx++) {
+    int runStart = 0, runCol = -1;
+    for (int cy=0;cy<=glyph->height;cy++) {
+      int col = -1;
+      if (cy<glyph->height) {
+        col = (data[bit>>3] >> (8-bpp-(bit&7))) & range;
+        bit += bpp;
+      }
+      if (col==runCol) continue;
+      if (runCol>0 || (runCol==0 && solidBackground))
+        graphicsFillRect(gfx,
+            (x + cx*info->scalex),
+            (y + runStart*info->scaley),
+            (x + cx*info->scalex + info->scalex-1),
+            (y + cy*info->scaley - 1),
+            graphicsBlendGfxColor(gfx, (256*runCol)/range));
+      runStart = cy;
+      runCol = col;
+    }
+  }
+}
+#endif
+
 /*JSON{
   "type" : "method",
   "class" : "Graphics",
@@ -2177,6 +2831,11 @@ g.drawString("Hi \0\7\5\1\x82 D\x17\xC0");
 ```
 */
 JsVar *jswrap_graphics_drawString(JsVar *parent, JsVar *var, int x, int y, bool solidBackground) {
+#ifdef GRAPHICS_RECORD
+  int args[] = {0,x,y,solidBackground};
+  if (_jswrap_graphics_record(parent, GFXREC_STRING, args, 4, var, 0))
+    return jsvLockAgain(parent);
+#endif
   JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return 0;
 
   JsGraphicsFontInfo info;
@@ -2186,6 +2845,9 @@ JsVar *jswrap_graphics_drawString(JsVar *parent, JsVar *var, int x, int y, bool
 #ifndef SAVE_ON_FLASH
   JsVar *customBitmap = 0, *customWidth = 0;
   int customBPP = 1;
+#ifdef USE_GLYPH_CACHE
+  JsVar *glyphCache = 0;
+#endif
 
   if (info.font & JSGRAPHICS_FONTSIZE_CUSTOM_BIT) {
     if (info.font==JSGRAPHICS_FONTSIZE_CUSTOM_2BPP) customBPP = 2;
@@ -2275,7 +2937,7 @@ JsVar *jswrap_graphics_drawString(JsVar *parent, JsVar *var, int x, int y, bool
 #endif
     if (info.font == JSGRAPHICS_FONTSIZE_VECTOR) {
 #ifndef NO_VECTOR_FONT
-      int w = (int)graphicsVectorCharWidth(&gfx, info.scalex, ch);
+      int w = _jswrap_graphics_getCharWidth(&gfx, &info, ch);
       if (x>minX-w && x<maxX  && y>minY-fontHeight && y<=maxY) {
         if (solidBackground)
           graphicsFillRect(&gfx,x,y,x+w-1,y+fontHeight-1, gfx.data.bgColor);
@@ -2295,14 +2957,29 @@ JsVar *jswrap_graphics_drawString(JsVar *parent, JsVar *var, int x, int y, bool
 #endif
 #ifndef SAVE_ON_FLASH
     } else if (info.font & JSGRAPHICS_FONTSIZE_CUSTOM_BIT) {
+#ifdef USE_GLYPH_CACHE
+      GlyphCacheEntry *glyph = 0;
+      if (info.customFontId && (unsigned char)ch>=info.customFirstChar) {
+        if (!glyphCache) glyphCache = glyphCacheGet(true);
+        if (glyphCache)
+          glyph = _jswrap_graphics_getCustomGlyph(&gfx, glyphCache, &info, ch, customBitmap, customWidth, fontHeight/info.scaley, customBPP);
+      }
+      if (glyph) {
+        if ((x>minX-glyph->advance*info.scalex) && (x<maxX) && (y>minY-fontHeight) && y<=maxY)
+          _jswrap_graphics_drawCustomGlyph(&gfx, x, y, glyph, &info, customBPP, solidBackground);
+        x += glyph->advance*info.scalex;
+        if (jspIsInterrupted()) break;
+        continue;
+      }
+#endif
       int customBPPRange = (1<<customBPP)-1;
       // get char width and offset in string
       int width = 0, bmpOffset = 0;
       if (jsvIsString(customWidth)) {
-        if (ch>=info.customFirstChar) {
+        if ((unsigned char)ch>=info.customFirstChar) {
           JsvStringIterator wit;
           jsvStringIteratorNew(&wit, customWidth, 0);
-          while (jsvStringIteratorHasChar(&wit) && (int)jsvStringIteratorGetIndex(&wit)<(ch-info.customFirstChar)) {
+          while (jsvStringIteratorHasChar(&wit) && (int)jsvStringIteratorGetIndex(&wit)<((unsigned char)ch-info.customFirstChar)) {
             bmpOffset += (unsigned char)jsvStringIteratorGetCharAndNext(&wit);
           }
           width = (unsigned char)jsvStringIteratorGetChar(&wit);
@@ -2310,9 +2987,9 @@ JsVar *jswrap_graphics_drawString(JsVar *parent, JsVar *var, int x, int y, bool
         }
       } else {
         width = (int)jsvGetInteger(customWidth);
-        bmpOffset = width*(ch-info.customFirstChar);
+        bmpOffset = width*((unsigned char)ch-info.customFirstChar);
       }
-      if (ch>=info.customFirstChar && (x>minX-width*info.scalex) && (x<maxX) && (y>minY-fontHeight) && y<=maxY) {
+      if ((unsigned char)ch>=info.customFirstChar && (x>minX-width*info.scalex) && (x<maxX) && (y>minY-fontHeight) && y<=maxY) {
         int ch = fontHeight/info.scaley;
         bmpOffset *= ch * customBPP;
         // now render character
@@ -2321,7 +2998,7 @@ JsVar *jswrap_graphics_drawString(JsVar *parent, JsVar *var, int x, int y, bool
         bmpOffset &= 7;
         int cx,cy;
         int citdata = jsvStringIteratorGetChar(&cit);
-        citdata <<= customBPP*bmpOffset;
+        citdata <<= bmpOffset;
         for (cx=0;cx<width;cx++) {
           for (cy=0;cy<ch;cy++) {
             int col = ((citdata&255)>>(8-customBPP));
@@ -2353,6 +3030,10 @@ JsVar *jswrap_graphics_drawString(JsVar *parent, JsVar *var, int x, int y, bool
 #ifndef SAVE_ON_FLASH
   jsvUnLock2(customBitmap, customWidth);
 #endif
+#ifdef USE_GLYPH_CACHE
+  jsvUnLock(glyphCache);
+#endif
+  _jswrap_graphics_freeFontInfo(&info);
 #ifndef SAVE_ON_FLASH
   gfx.data.flags = oldFlags; // restore flags because of text rotation
   graphicsSetVar(&gfx); // gfx data changed because modified area
@@ -2385,6 +3066,11 @@ void jswrap_graphics_drawCString(JsGraphics *gfx, int x, int y, char *str) {
 Draw a line between x1,y1 and x2,y2 in the current foreground color
 */
 JsVar *jswrap_graphics_drawLine(JsVar *parent, int x1, int y1, int x2, int y2) {
+#ifdef GRAPHICS_RECORD
+  int args[] = {x1,y1,x2,y2};
+  if (_jswrap_graphics_record(parent, GFXREC_LINE, args, 4, 0, 0))
+    return jsvLockAgain(parent);
+#endif
   JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return 0;
   graphicsDrawLine(&gfx, x1,y1,x2,y2);
   graphicsSetVar(&gfx); // gfx data changed because modified area
@@ -2516,6 +3202,24 @@ JsVar *jswrap_graphics_drawPoly_X(JsVar *parent, JsVar *poly, bool closed, bool
     scale = 1;
     drawFn = graphicsDrawLine;
   }
+#ifdef GRAPHICS_RECORD
+  if (graphicsRecordParent==parent) {
+    int args[GFXREC_MAX_ARGS];
+    int argc = 1;
+    args[0] = (closed?1:0) | (antiAlias?2:0);
+    JsvIterator it;
+    jsvIteratorNew(&it, poly, JSIF_EVERY_ARRAY_ELEMENT);
+    while (jsvIteratorHasElement(&it) && argc<GFXREC_MAX_ARGS) {
+      args[argc++] = (int)((jsvIteratorGetFloatValue(&it)*scale)+0.5);
+      jsvIteratorNext(&it);
+    }
+    if (jsvIteratorHasElement(&it))
+      jsExceptionHere(JSET_ERROR, "Maximum number of points (%d) exceeded for recorded drawPoly", (GFXREC_MAX_ARGS-1)/2);
+    jsvIteratorFree(&it);
+    _jswrap_graphics_record(parent, GFXREC_POLY, args, 1+((argc-1)&~1), 0, 0); // flags, then x,y pairs
+    return jsvLockAgain(parent);
+  }
+#endif
 
   int lx,ly;
   int startx, starty;
@@ -2628,22 +3332,22 @@ JsVar *jswrap_graphics_fillPoly_X(JsVar *parent, JsVar *poly, bool antiAlias) {
   if (jsvIteratorHasElement(&it))
     jsExceptionHere(JSET_ERROR, "Maximum number of points (%d) exceeded for fillPoly", maxVerts/2);
   jsvIteratorFree(&it);
-#ifdef GRAPHICS_ANTIALIAS
-  // For antialiased fillPoly the easiest solution is just to draw AA lines
-  // around the edge first, then fill solidly
-  if (antiAlias) {
-    int lx = verts[idx-2];
-    int ly = verts[idx-1];
-    for (int i=0;i<idx;i+=2) {
-      int vx = verts[i];
-      int vy = verts[i+1];
-      graphicsDrawLineAA(&gfx, vx,vy, lx,ly);
-      lx = vx;
-      ly = vy;
-    }
+#ifdef GRAPHICS_RECORD
+  if (graphicsRecordParent==parent) {
+    int args[GFXREC_MAX_ARGS];
+    args[0] = antiAlias;
+    idx &= ~1;
+    for (int i=0;i<idx;i++) args[i+1] = verts[i];
+    _jswrap_graphics_record(parent, GFXREC_FILLPOLY, args, idx+1, 0, 0);
+    return jsvLockAgain(parent);
   }
 #endif
-  graphicsFillPoly(&gfx, idx/2, verts);
+#ifdef GRAPHICS_ANTIALIAS
+  if (antiAlias)
+    graphicsFillPolyAA(&gfx, idx/2, verts);
+  else
+#endif
+    graphicsFillPoly(&gfx, idx/2, verts);
 
   graphicsSetVar(&gfx); // gfx data changed because modified area
   return jsvLockAgain(parent);
@@ -2783,6 +3487,11 @@ g.drawImage(img, g.getWidth()/2, g.getHeight()/2,
 ```
 */
 JsVar *jswrap_graphics_drawImage(JsVar *parent, JsVar *image, int xPos, int yPos, JsVar *options) {
+#ifdef GRAPHICS_RECORD
+  int args[] = {0,xPos,yPos,0};
+  if (_jswrap_graphics_record(parent, GFXREC_IMAGE, args, 4, image, options))
+    return jsvLockAgain(parent);
+#endif
   JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return 0;
   GfxDrawImageInfo img;
   if (!_jswrap_graphics_parseImage(&gfx, image, 0, &img))
@@ -2917,18 +3626,25 @@ JsVar *jswrap_graphics_drawImage(JsVar *parent, JsVar *image, int xPos, int yPos
       l.repeat = false;
       _jswrap_drawImageLayerInit(&l);
       int x1=l.x1, y1=l.y1, x2=l.x2-1, y2=l.y2-1;
-      graphicsSetModifiedAndClip(&gfx, &x1, &y1, &x2, &y2);
+      graphicsSetModifiedAndClipUser(&gfx, &x1, &y1, &x2, &y2);
       _jswrap_drawImageLayerSetStart(&l, x1, y1);
-      JsGraphicsSetPixelFn setPixel = graphicsGetSetPixelFn(&gfx);
+      // step through device coordinates directly, rather than transforming each pixel
+      GfxDeviceMapping m;
+      graphicsGetDeviceMapping(&gfx, &m);
+      unsigned int colMask = (unsigned int)((1L<<gfx.data.bpp)-1);
 
       // scan across image
       for (y = y1; y <= y2; y++) {
         _jswrap_drawImageLayerStartX(&l);
+        int dx = m.x + m.xx*x1 + m.xy*y;
+        int dy = m.y + m.yx*x1 + m.yy*y;
         for (x = x1; x <= x2 ; x++) {
           if (_jswrap_drawImageLayerGetPixel(&l, &colData)) {
-            setPixel(&gfx, x, y, colData);
+            gfx.setPixel(&gfx, dx, dy, colData & colMask);
           }
           _jswrap_drawImageLayerNextX(&l);
+          dx += m.xx;
+          dy += m.yx;
         }
         _jswrap_drawImageLayerNextY(&l);
       }
@@ -3032,7 +3748,7 @@ JsVar *jswrap_graphics_drawImages(JsVar *parent, JsVar *layersVar, JsVar *option
   if (!jsvReadConfigObject(options, configs, sizeof(configs) / sizeof(jsvConfigObject)))
     ok =  false;
   int x2 = x+width-1, y2 = y+height-1;
-  graphicsSetModifiedAndClip(&gfx, &x, &y, &x2, &y2);
+  graphicsSetModifiedAndClipUser(&gfx, &x, &y, &x2, &y2);
   JsGraphicsSetPixelFn setPixel = graphicsGetSetPixelFn(&gfx);
 
   // If all good, start rendering!
@@ -3040,7 +3756,46 @@ JsVar *jswrap_graphics_drawImages(JsVar *parent, JsVar *layersVar, JsVar *option
     for (i=0;i<layerCount;i++) {
       jsvStringIteratorNew(&layers[i].it, layers[i].img.buffer, (size_t)layers[i].img.bitmapOffset);
       _jswrap_drawImageLayerSetStart(&layers[i], x, y);
+      layers[i].simple = layers[i].sx==256 && layers[i].sy==0 && layers[i].img.bpp<=24 &&
+                         !(layers[i].px&255) && !(layers[i].py&255);
     }
+#ifdef GRAPHICS_FAST_PATHS
+    /* Composite GFX_SPAN_PIXELS at a time, from the top layer down. Each layer is only read for
+    pixels that the layers above didn't cover, and solid pixels are written in runs with blitSpan
+    if the Graphics is 8 or 16 bit */
+    GfxDeviceMapping m;
+    graphicsGetDeviceMapping(&gfx, &m);
+    int bytesPerPixel = (gfx.data.bpp==8 || gfx.data.bpp==16) ? gfx.data.bpp>>3 : 0;
+    unsigned int cols[GFX_SPAN_PIXELS];
+    unsigned char buf[GFX_SPAN_PIXELS*2];
+    for (int yi = y; yi <= y2; yi++) {
+      for (i=0;i<layerCount;i++)
+        _jswrap_drawImageLayerStartX(&layers[i]);
+      for (int xi = x; xi <= x2; xi += GFX_SPAN_PIXELS) {
+        int w = x2+1-xi;
+        if (w>GFX_SPAN_PIXELS) w=GFX_SPAN_PIXELS;
+        uint64_t all = (w==64) ? 0xFFFFFFFFFFFFFFFFULL : ((1ULL<<w)-1);
+        uint64_t need = all;
+        for (i=layerCount-1;i>=0;i--)
+          need = _jswrap_drawImagesLayerSpan(&layers[i], w, cols, need);
+        uint64_t solid = all & ~need;
+        if (!solid) continue;
+        if (bytesPerPixel) {
+          unsigned char *p = buf;
+          for (int k=0;k<w;k++) {
+            if (bytesPerPixel==2) *(p++) = (unsigned char)(cols[k]>>8);
+            *(p++) = (unsigned char)cols[k];
+          }
+          _jswrap_drawImageSpanOut(&gfx, &m, xi, yi, w, buf, bytesPerPixel, solid, x, x2);
+        } else {
+          for (int k=0;k<w;k++)
+            if ((solid>>k)&1) setPixel(&gfx, xi+k, yi, cols[k]);
+        }
+      }
+      for (i=0;i<layerCount;i++)
+        _jswrap_drawImageLayerNextY(&layers[i]);
+    }
+#else
     // scan across image
     for (int yi = y; yi <= y2; yi++) {
       for (i=0;i<layerCount;i++)
@@ -3067,6 +3822,7 @@ JsVar *jswrap_graphics_drawImages(JsVar *parent, JsVar *layersVar, JsVar *option
       for (i=0;i<layerCount;i++)
         _jswrap_drawImageLayerNextY(&layers[i]);
     }
+#endif
     for (i=0;i<layerCount;i++)
       jsvStringIteratorFree(&layers[i].it);
   }
@@ -3195,12 +3951,21 @@ JsVar *jswrap_graphics_asImage(JsVar *parent, JsVar *imgType) {
   "params" : [
     ["reset","bool","Whether to reset the modified area or not"]
   ],
-  "return" : ["JsVar","An object {x1,y1,x2,y2} containing the modified area, or undefined if not modified"]
+  "return" : ["JsVar","An object {x1,y1,x2,y2,rects} containing the modified area, or undefined if not modified"]
 }
 Return the area of the Graphics canvas that has been modified, and optionally clear
 the modified area to 0.
 
-For instance if `g.setPixel(10,20)` was called, this would return `{x1:10, y1:20, x2:10, y2:20}`
+For instance if `g.setPixel(10,20)` was called, this would return `{x1:10, y1:20, x2:10, y2:20, rects:[...]}`
+
+As well as the overall modified area, Espruino keeps track of up to 4 separate
+non-overlapping rectangles that were modified, and `rects` is an array of
+`{x1,y1,x2,y2}` for each of them. For instance after `g.setPixel(0,0).setPixel(100,100)`,
+`rects` would be `[{x1:0,y1:0,x2:0,y2:0},{x1:100,y1:100,x2:100,y2:100}]`. Displays
+that support it only send these rectangles to the screen when `g.flip()` is called.
+
+**Note:** Coordinates are in the Graphics' device coordinates, so if `g.setRotation`
+has been used they will be rotated.
 */
 JsVar *jswrap_graphics_getModified(JsVar *parent, bool reset) {
 #ifndef NO_MODIFIED_AREA
@@ -3213,13 +3978,23 @@ JsVar *jswrap_graphics_getModified(JsVar *parent, bool reset) {
       jsvObjectSetChildAndUnLock(obj, "y1", jsvNewFromInteger(gfx.data.modMinY));
       jsvObjectSetChildAndUnLock(obj, "x2", jsvNewFromInteger(gfx.data.modMaxX));
       jsvObjectSetChildAndUnLock(obj, "y2", jsvNewFromInteger(gfx.data.modMaxY));
+      JsGraphicsClipRect rects[JSGRAPHICS_MODIFIED_RECTS];
+      int count = graphicsGetModifiedRects(&gfx, rects);
+      JsVar *arr = jsvNewEmptyArray();
+      for (int i=0;arr && i<count;i++) {
+        JsVar *r = jsvNewObject();
+        if (!r) break;
+        jsvObjectSetChildAndUnLock(r, "x1", jsvNewFromInteger(rects[i].x1));
+        jsvObjectSetChildAndUnLock(r, "y1", jsvNewFromInteger(rects[i].y1));
+        jsvObjectSetChildAndUnLock(r, "x2", jsvNewFromInteger(rects[i].x2));
+        jsvObjectSetChildAndUnLock(r, "y2", jsvNewFromInteger(rects[i].y2));
+        jsvArrayPushAndUnLock(arr, r);
+      }
+      jsvObjectSetChildAndUnLock(obj, "rects", arr);
     }
   }
   if (reset) {
-    gfx.data.modMaxX = -32768;
-    gfx.data.modMaxY = -32768;
-    gfx.data.modMinX = 32767;
-    gfx.data.modMinY = 32767;
+    graphicsResetModified(&gfx);
     graphicsSetVar(&gfx);
   }
   return obj;
@@ -3228,6 +4003,513 @@ JsVar *jswrap_graphics_getModified(JsVar *parent, bool reset) {
 #endif
 }
 
+/*JSON{
+  "type" : "method",
+  "class" : "Graphics",
+  "name" : "record",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_graphics_record",
+  "params" : [
+    ["callback","JsVar","A function that draws with this Graphics instance (it's passed the instance as an argument)"]
+  ],
+  "return" : ["JsVar","A list of drawing commands to be used with `Graphics.replay`"]
+}
+Record drawing commands into a compact list that can be drawn (as many times as
+needed) with `Graphics.replay`.
+
+`callback` is called straight away, but calls it makes to `clear`, `fillRect`,
+`clearRect`, `drawRect`, `fillCircle`, `drawCircle`, `fillEllipse`, `drawEllipse`,
+`setPixel`, `drawLine`, `drawPoly`, `fillPoly`, `drawString` and `drawImage` are
+stored rather than drawn. Calls that change state (`reset`, `setColor`, `setBgColor`,
+`setFont`, `setFontCustom`, `setFontAlign`, etc) are stored *and* take effect
+immediately, so functions like `stringWidth` still work. Any other calls are executed
+as normal and aren't recorded.
+
+```
+var list = g.record(g => {
+  g.reset().clearRect(0,24,175,175);  // commands 0 and 1
+  g.setFont("Vector",40).setFontAlign(0,0).drawString("12:00",88,80); // commands 2, 3 and 4
+  g.setFont("6x8").drawString("Battery",88,140); // commands 5 and 6
+});
+g.replay(list);              // draw everything
+g.replay(list, {4:"12:01"}); // only redraw the time
+```
+
+Strings, images and fonts used by the commands are referenced (not copied). Recorded
+polygons can have at most 64 points.
+*/
+/*JSON{
+  "type" : "method",
+  "class" : "Graphics",
+  "name" : "replay",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_graphics_replay",
+  "params" : [
+    ["list","JsVar","A list of drawing commands from `Graphics.record`"],
+    ["overrides","JsVar","[optional] An object mapping command indices to new arguments, eg `{4:[\"12:01\",88,80]}`, or `{4:\"12:01\"}` to change just the first argument"],
+    ["all","bool","[optional] If `true`, draw every command rather than just those that have changed"]
+  ],
+  "return" : ["JsVar","The instance of Graphics this was called on, to allow call chaining"],
+  "return_object" : "Graphics"
+}
+Draw a list of commands recorded with `Graphics.record`. This runs the whole list
+natively, without having to look up and call each function from JavaScript.
+
+Each command remembers the area of the screen it covered the last time it was drawn.
+Unless `all` is `true`, only commands whose arguments (or the colors/font/etc they're drawn
+with) have changed since the last `replay` are drawn, along with other commands that overlap
+the area they covered - and those are clipped to just the area that needs updating. Commands
+that lie entirely outside the clip rect aren't drawn at all. The first time a list is drawn,
+or if something else has drawn over it, use `all=true`.
+
+Command indices count every recorded call (including `setColor`/etc) from 0. For
+`drawPoly`/`fillPoly` the override should be the new array of points. Overrides
+aren't stored, so a later call to `replay` without them draws the recorded arguments again.
+
+**Note:** Changes *inside* an image or `drawImage` options object aren't detected, only
+a different image or object being used. Use `all=true`, or pass the image as an override.
+*/
+#ifdef GRAPHICS_RECORD
+JsVar *jswrap_graphics_record(JsVar *parent, JsVar *callback) {
+  if (!jsvIsFunction(callback)) {
+    jsExceptionHere(JSET_ERROR, "Expecting a function, got %t", callback);
+    return 0;
+  }
+  if (graphicsRecordParent) {
+    jsExceptionHere(JSET_ERROR, "Already recording");
+    return 0;
+  }
+  JsVar *list = 0;
+  graphicsRecordCmds = jsvNewFromEmptyString();
+  graphicsRecordVars = jsvNewEmptyArray();
+  if (graphicsRecordCmds && graphicsRecordVars) {
+    graphicsRecordParent = parent;
+    jsvUnLock(jspExecuteFunction(callback, parent, 1, &parent));
+    graphicsRecordParent = 0;
+    // Copy to a flat string so we can access (and update) the commands quickly when replaying
+    size_t len = jsvGetStringLength(graphicsRecordCmds);
+    JsVar *cmds = jsvNewFlatStringOfLength((unsigned int)len);
+    if (cmds) {
+      jsvGetStringChars(graphicsRecordCmds, 0, jsvGetFlatStringPointer(cmds), len);
+      list = jsvNewObject();
+      if (list) {
+        jsvObjectSetChild(list, "cmds", cmds);
+        jsvObjectSetChild(list, "vars", graphicsRecordVars);
+      }
+      jsvUnLock(cmds);
+    } else
+      jsExceptionHere(JSET_ERROR, "Not enough memory to store commands");
+  }
+  jsvUnLock2(graphicsRecordCmds, graphicsRecordVars);
+  graphicsRecordCmds = 0;
+  graphicsRecordVars = 0;
+  return list;
+}
+
+/// The arguments for a command that's being replayed
+typedef struct {
+  GfxRecCmd *cmd;
+  int argc;
+  const int32_t *args; ///< The recorded arguments, or 'buf' if they were overridden
+  JsVar *vars[2];      ///< Locked variables for the arguments in GFXREC_VAR_ARGS
+  int32_t buf[GFXREC_MAX_ARGS];
+} GfxRecArgs;
+
+/// Get the arguments for a command, using the ones in 'overrides' (if given) instead of the recorded ones
+static void _jswrap_graphics_replayGetArgs(JsVar *parent, JsVar *listVars, JsVar *overrides, int index, GfxRecCmd *c, GfxRecArgs *a) {
+  a->cmd = c;
+  a->argc = c->argc;
+  a->args = (int32_t*)(c+1);
+  a->vars[0] = 0;
+  a->vars[1] = 0;
+  JsVar *override = 0;
+  if (overrides) {
+    JsVar *idx = jsvNewFromInteger(index);
+    override = jspGetVarNamedField(overrides, idx, false);
+    jsvUnLock(idx);
+    if (jsvIsUndefined(override)) {
+      jsvUnLock(override);
+      override = 0;
+    }
+  }
+  if (override) {
+    memcpy(a->buf, a->args, sizeof(int32_t)*(size_t)a->argc);
+    a->args = a->buf;
+  }
+  if (override && (c->cmd==GFXREC_POLY || c->cmd==GFXREC_FILLPOLY)) {
+    int scale = (c->cmd==GFXREC_FILLPOLY || (a->buf[0]&2)) ? 16 : 1;
+#ifndef GRAPHICS_ANTIALIAS
+    if (c->cmd==GFXREC_POLY) scale = 1;
+#endif
+    int argc = 1;
+    if (jsvIsIterable(override)) {
+      JsvIterator it;
+      jsvIteratorNew(&it, override, JSIF_EVERY_ARRAY_ELEMENT);
+      while (jsvIteratorHasElement(&it) && argc<GFXREC_MAX_ARGS) {
+        a->buf[argc++] = (int32_t)((jsvIteratorGetFloatValue(&it)*scale)+0.5);
+        jsvIteratorNext(&it);
+      }
+      jsvIteratorFree(&it);
+    }
+    a->argc = 1+((argc-1)&~1);
+  } else if (override && (c->cmd==GFXREC_COLOR || c->cmd==GFXREC_BGCOLOR)) {
+    if (jsvIsArray(override)) {
+      JsVar *r = jsvGetArrayItem(override, 0), *g = jsvGetArrayItem(override, 1), *b = jsvGetArrayItem(override, 2);
+      a->buf[0] = (int32_t)jswrap_graphics_toColor(parent, r, g, b);
+      jsvUnLock3(r, g, b);
+    } else
+      a->buf[0] = (int32_t)jswrap_graphics_toColor(parent, override, 0, 0);
+  } else {
+    bool isArray = jsvIsArray(override);
+    int varIdx = 0;
+    for (int i=0;i<a->argc;i++) {
+      JsVar *v = 0;
+      if (override) {
+        v = isArray ? jsvGetArrayItem(override, i) : ((i==0) ? jsvLockAgain(override) : 0);
+        if (jsvIsUndefined(v)) {
+          jsvUnLock(v);
+          v = 0;
+        }
+      }
+      if (GFXREC_VAR_ARGS[c->cmd] & (1<<i)) {
+        if (!v && a->args[i]>=0) v = jsvGetArrayItem(listVars, a->args[i]);
+        a->vars[varIdx++] = v;
+      } else if (v) {
+        a->buf[i] = (int32_t)jsvGetIntegerAndUnLock(v);
+      }
+    }
+    if (override && c->cmd==GFXREC_FONT)
+      a->buf[2] = -1; // font may have changed - we need to look it up by name
+  }
+  jsvUnLock(override);
+}
+
+static void _jswrap_graphics_replayFreeArgs(GfxRecArgs *a) {
+  jsvUnLock2(a->vars[0], a->vars[1]);
+}
+
+static uint32_t _jswrap_graphics_replayHash(uint32_t h, uint32_t v) {
+  return (h ^ v) * 16777619; // FNV-1a, but a word at a time
+}
+
+/// Hash a command's arguments. Text for drawString is hashed by value, other variables by reference
+static uint32_t _jswrap_graphics_replayHashArgs(uint32_t h, GfxRecArgs *a) {
+  uint8_t cmd = a->cmd->cmd;
+  h = _jswrap_graphics_replayHash(h, cmd);
+  int varIdx = 0;
+  for (int i=0;i<a->argc;i++) {
+    if (GFXREC_VAR_ARGS[cmd] & (1<<i)) {
+      JsVar *v = a->vars[varIdx++];
+      if (cmd==GFXREC_STRING) {
+        JsVar *str = jsvAsString(v);
+        JsvStringIterator it;
+        jsvStringIteratorNew(&it, str, 0);
+        while (jsvStringIteratorHasChar(&it)) {
+          h = _jswrap_graphics_replayHash(h, (unsigned char)jsvStringIteratorGetCharAndNext(&it));
+        }
+        jsvStringIteratorFree(&it);
+        jsvUnLock(str);
+      } else
+        h = _jswrap_graphics_replayHash(h, v ? jsvGetRef(v) : 0);
+    } else
+      h = _jswrap_graphics_replayHash(h, (uint32_t)a->args[i]);
+  }
+  return h;
+}
+
+/// The state that affects what a command draws (used to see if it has changed)
+typedef struct {
+  uint32_t fgColor, bgColor;
+  uint32_t font;      ///< Font size, or hash of the arguments used to set a custom font
+  uint32_t fontAlign; ///< Font alignment/rotation
+} GfxRecState;
+
+static void _jswrap_graphics_replayGetState(JsVar *parent, JsGraphics *gfx, GfxRecState *state) {
+  state->fgColor = gfx->data.fgColor;
+  state->bgColor = gfx->data.bgColor;
+  state->font = gfx->data.fontSize;
+  if (gfx->data.fontSize & JSGRAPHICS_FONTSIZE_CUSTOM_BIT)
+    state->font = _jswrap_graphics_replayHash(state->font, (uint32_t)jsvGetIntegerAndUnLock(jsvObjectGetChild(parent, JSGRAPHICS_CUSTOMFONT_ID, 0)));
+  state->fontAlign = (uint32_t)(gfx->data.fontAlignX | (gfx->data.fontAlignY<<2) | (gfx->data.fontRotate<<4));
+}
+
+static uint32_t _jswrap_graphics_replayHashState(const GfxRecState *state) {
+  uint32_t h = _jswrap_graphics_replayHash(state->fgColor, state->bgColor);
+  h = _jswrap_graphics_replayHash(h, state->font);
+  return _jswrap_graphics_replayHash(h, state->fontAlign);
+}
+
+/// Set the font size, avoiding the overhead of a function call if neither font is custom
+static void _jswrap_graphics_replaySetFontSize(JsVar *parent, JsGraphics *gfx, int size) {
+  if (!(gfx->data.fontSize & JSGRAPHICS_FONTSIZE_CUSTOM_BIT) &&
+      !(size & JSGRAPHICS_FONTSIZE_CUSTOM_BIT)) {
+    gfx->data.fontSize = (unsigned short)size;
+    return;
+  }
+  graphicsSetVar(gfx);
+  jsvUnLock(jswrap_graphics_setFontSizeX(parent, size, (size & JSGRAPHICS_FONTSIZE_FONT_MASK)==JSGRAPHICS_FONTSIZE_VECTOR));
+  graphicsGetFromVar(gfx, parent);
+}
+
+static void _jswrap_graphics_replayReset(JsVar *parent, JsGraphics *gfx) {
+  graphicsSetVar(gfx);
+  jsvUnLock(jswrap_graphics_reset(parent));
+  graphicsGetFromVar(gfx, parent);
+}
+
+/// Execute one recorded command
+static void _jswrap_graphics_replayExec(JsVar *parent, JsGraphics *gfx, GfxRecArgs *a) {
+  const int32_t *args = a->args;
+  uint8_t cmd = a->cmd->cmd;
+  switch (cmd) {
+    case GFXREC_RESET: _jswrap_graphics_replayReset(parent, gfx); return;
+    case GFXREC_COLOR: gfx->data.fgColor = (unsigned int)args[0]; return;
+    case GFXREC_BGCOLOR: gfx->data.bgColor = (unsigned int)args[0]; return;
+    case GFXREC_FONTSIZE: _jswrap_graphics_replaySetFontSize(parent, gfx, args[0]); return;
+    case GFXREC_FONT:
+      if (args[2]>=0 && !(args[2] & JSGRAPHICS_FONTSIZE_CUSTOM_BIT)) {
+        _jswrap_graphics_replaySetFontSize(parent, gfx, args[2]);
+        return;
+      }
+      break; // custom fonts have to be looked up by name
+    case GFXREC_FONTALIGN:
+      gfx->data.fontAlignX = (unsigned)args[0]&3u;
+      gfx->data.fontAlignY = (unsigned)args[1]&3u;
+      gfx->data.fontRotate = (unsigned)args[2]&3u;
+      return;
+    case GFXREC_CLEAR:
+      if (args[0]) { // reset state too - but we still want to clear only within the current clip rect
+        JsGraphicsClipRect clip = gfx->data.clipRect;
+        _jswrap_graphics_replayReset(parent, gfx);
+        gfx->data.clipRect = clip;
+      }
+      graphicsClear(gfx);
+      return;
+    case GFXREC_FILLRECT: _jswrap_graphics_fillRectRounded(gfx, args[0], args[1], args[2], args[3], args[4], gfx->data.fgColor); return;
+    case GFXREC_CLEARRECT: _jswrap_graphics_fillRectRounded(gfx, args[0], args[1], args[2], args[3], args[4], gfx->data.bgColor); return;
+    case GFXREC_DRAWRECT: graphicsDrawRect(gfx, args[0], args[1], args[2], args[3]); return;
+    case GFXREC_FILLELLIPSE: graphicsFillEllipse(gfx, args[0], args[1], args[2], args[3]); return;
+    case GFXREC_DRAWELLIPSE: graphicsDrawEllipse(gfx, args[0], args[1], args[2], args[3]); return;
+    case GFXREC_PIXEL:
+      graphicsSetPixel(gfx, args[0], args[1], (unsigned int)args[2]);
+      gfx->data.cursorX = (short)args[0];
+      gfx->data.cursorY = (short)args[1];
+      return;
+    case GFXREC_LINE: graphicsDrawLine(gfx, args[0], args[1], args[2], args[3]); return;
+    case GFXREC_POLY: {
+      int scale = 1;
+      void (*drawFn)(JsGraphics *gfx, int x1, int y1, int x2, int y2) = graphicsDrawLine;
+#ifdef GRAPHICS_ANTIALIAS
+      if (args[0]&2) {
+        scale = 16;
+        drawFn = graphicsDrawLineAA;
+      }
+#endif
+      int argc = a->argc;
+      if (argc<3) return;
+      for (int i=3;i+1<argc;i+=2)
+        drawFn(gfx, args[i-2], args[i-1], args[i], args[i+1]);
+      if (args[0]&1)
+        drawFn(gfx, args[argc-2], args[argc-1], args[1], args[2]);
+      gfx->data.cursorX = (short)(args[argc-2]/scale);
+      gfx->data.cursorY = (short)(args[argc-1]/scale);
+      return;
+    }
+    case GFXREC_FILLPOLY: {
+      short verts[GFXREC_MAX_ARGS];
+      int n = a->argc-1;
+      for (int i=0;i<n;i++) verts[i] = (short)args[i+1];
+#ifdef GRAPHICS_ANTIALIAS
+      if (args[0])
+        graphicsFillPolyAA(gfx, n/2, verts);
+      else
+#endif
+        graphicsFillPoly(gfx, n/2, verts);
+      return;
+    }
+    default: break;
+  }
+  // Everything else uses the same functions as JS, which need the state in the Graphics instance
+  graphicsSetVar(gfx);
+  JsVar *r = 0;
+  switch (cmd) {
+    case GFXREC_FONT: r = jswrap_graphics_setFont(parent, a->vars[0], args[1]); break;
+    case GFXREC_FONTCUSTOM: r = jswrap_graphics_setFontCustom(parent, a->vars[0], args[1], a->vars[1], args[3]); break;
+    case GFXREC_STRING: r = jswrap_graphics_drawString(parent, a->vars[0], args[1], args[2], args[3]); break;
+    case GFXREC_IMAGE: r = jswrap_graphics_drawImage(parent, a->vars[0], args[1], args[2], a->vars[1]); break;
+  }
+  jsvUnLock(r);
+  graphicsGetFromVar(gfx, parent);
+}
+
+/// Execute a recorded drawing command, and return the area (in device coordinates) it modified
+static void _jswrap_graphics_replayDraw(JsVar *parent, JsGraphics *gfx, GfxRecArgs *a, JsGraphicsClipRect *area) {
+  JsGraphicsData old = gfx->data;
+  graphicsResetModified(gfx);
+  _jswrap_graphics_replayExec(parent, gfx, a);
+  JsGraphicsClipRect rects[JSGRAPHICS_MODIFIED_RECTS];
+  int count = graphicsGetModifiedRects(gfx, rects);
+  if (count) {
+    area->x1 = (unsigned short)gfx->data.modMinX;
+    area->y1 = (unsigned short)gfx->data.modMinY;
+    area->x2 = (unsigned short)gfx->data.modMaxX;
+    area->y2 = (unsigned short)gfx->data.modMaxY;
+  } else { // nothing drawn
+    area->x1 = area->y1 = 1;
+    area->x2 = area->y2 = 0;
+  }
+  // put back the modified area from before, and add what we just drew to it
+  gfx->data.modMinX = old.modMinX;
+  gfx->data.modMinY = old.modMinY;
+  gfx->data.modMaxX = old.modMaxX;
+  gfx->data.modMaxY = old.modMaxY;
+#if JSGRAPHICS_MODIFIED_RECTS>1
+  gfx->data.modRectCount = old.modRectCount;
+  memcpy(gfx->data.modRects, old.modRects, sizeof(old.modRects));
+#endif
+  for (int i=0;i<count;i++)
+    graphicsSetModified(gfx, rects[i].x1, rects[i].y1, rects[i].x2, rects[i].y2);
+}
+
+/// Add 'r' to the area x1,y1,x2,y2 (which is empty if x1>x2)
+static void _jswrap_graphics_replayAddArea(int *x1, int *y1, int *x2, int *y2, const JsGraphicsClipRect *r) {
+  if (r->x1>r->x2 || r->y1>r->y2) return;
+  if (*x1>*x2) {
+    *x1 = r->x1; *y1 = r->y1;
+    *x2 = r->x2; *y2 = r->y2;
+    return;
+  }
+  if (r->x1<*x1) *x1 = r->x1;
+  if (r->y1<*y1) *y1 = r->y1;
+  if (r->x2>*x2) *x2 = r->x2;
+  if (r->y2>*y2) *y2 = r->y2;
+}
+
+static bool _jswrap_graphics_replayOverlaps(const JsGraphicsClipRect *a, const JsGraphicsClipRect *b) {
+  return a->x1<=a->x2 && a->y1<=a->y2 && b->x1<=b->x2 && b->y1<=b->y2 &&
+         a->x1<=b->x2 && b->x1<=a->x2 && a->y1<=b->y2 && b->y1<=a->y2;
+}
+
+/// Get the next command in a list, or 0 if there are no more (or the list is corrupt)
+static GfxRecCmd *_jswrap_graphics_replayNext(unsigned char **ptr, unsigned char *end) {
+  GfxRecCmd *c = (GfxRecCmd*)*ptr;
+  if (*ptr + sizeof(GfxRecCmd) > end) return 0;
+  *ptr += sizeof(GfxRecCmd) + sizeof(int32_t)*c->argc;
+  if (*ptr > end || c->cmd>=GFXREC_COUNT || c->argc>GFXREC_MAX_ARGS) return 0;
+  return c;
+}
+#endif
+
+JsVar *jswrap_graphics_replay(JsVar *parent, JsVar *list, JsVar *overrides, bool all) {
+#ifdef GRAPHICS_RECORD
+  if (graphicsRecordParent==parent) {
+    jsExceptionHere(JSET_ERROR, "Can't replay while recording");
+    return 0;
+  }
+  JsVar *cmds = jsvIsObject(list) ? jsvObjectGetChild(list, "cmds", 0) : 0;
+  if (!jsvIsFlatString(cmds)) {
+    jsvUnLock(cmds);
+    jsExceptionHere(JSET_ERROR, "Expecting a list from Graphics.record, got %t", list);
+    return 0;
+  }
+  JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) { jsvUnLock(cmds); return 0; }
+  JsVar *vars = jsvObjectGetChild(list, "vars", 0);
+  if (!jsvIsObject(overrides) && !jsvIsArray(overrides)) overrides = 0;
+  unsigned char *start = (unsigned char*)jsvGetFlatStringPointer(cmds);
+  unsigned char *end = start + jsvGetStringLength(cmds);
+  unsigned char *ptr;
+  GfxRecCmd *c;
+  GfxRecArgs a;
+  int index;
+  /* First, work out which drawing commands have changed. Each one's hash includes the
+  state (color/font/etc) it'll be drawn with, which we work out from the state commands */
+  GfxRecState state, resetState;
+  _jswrap_graphics_replayGetState(parent, &gfx, &state);
+  JsGraphics resetGfx = gfx;
+  graphicsStructResetState(&resetGfx);
+  resetGfx.data.fontSize = 1+JSGRAPHICS_FONTSIZE_4X6;
+  _jswrap_graphics_replayGetState(parent, &resetGfx, &resetState);
+  int dx1 = 1, dy1 = 1, dx2 = 0, dy2 = 0; // The area we need to redraw
+  bool changed = false;
+  for (ptr=start, index=0; (c=_jswrap_graphics_replayNext(&ptr, end)); index++) {
+    _jswrap_graphics_replayGetArgs(parent, vars, overrides, index, c, &a);
+    switch (c->cmd) {
+      case GFXREC_RESET: state = resetState; break;
+      case GFXREC_COLOR: state.fgColor = (uint32_t)a.args[0]; break;
+      case GFXREC_BGCOLOR: state.bgColor = (uint32_t)a.args[0]; break;
+      case GFXREC_FONTSIZE: state.font = (uint32_t)a.args[0]; break;
+      case GFXREC_FONT:
+        if (a.args[2]>=0 && !(a.args[2] & JSGRAPHICS_FONTSIZE_CUSTOM_BIT)) {
+          state.font = (uint32_t)a.args[2];
+          break;
+        } // else fall through - custom fonts are identified by their arguments
+      case GFXREC_FONTCUSTOM: state.font = _jswrap_graphics_replayHashArgs(0, &a); break;
+      case GFXREC_FONTALIGN: state.fontAlign = _jswrap_graphics_replayHashArgs(0, &a); break;
+      default: break;
+    }
+    if (c->cmd >= GFXREC_FIRST_DRAW) {
+      uint32_t h = _jswrap_graphics_replayHashArgs(_jswrap_graphics_replayHashState(&state), &a);
+      if (c->cmd==GFXREC_CLEAR && a.args[0])
+        state = resetState;
+      c->flags &= (uint8_t)~GFXREC_FLAG_CHANGED;
+      if (!(c->flags & GFXREC_FLAG_AREA) || c->hash!=h) {
+        c->flags |= GFXREC_FLAG_CHANGED;
+        changed = true;
+        if (c->flags & GFXREC_FLAG_AREA)
+          _jswrap_graphics_replayAddArea(&dx1, &dy1, &dx2, &dy2, &c->area);
+      }
+      c->hash = h;
+    }
+    _jswrap_graphics_replayFreeArgs(&a);
+  }
+  /* Now draw. Changed commands are drawn in full, and the area they cover is added to the
+  area to redraw. Other commands are only drawn if they overlap that area, and are clipped to it */
+  if (changed || all) {
+    JsGraphicsClipRect clip = gfx.data.clipRect;
+    for (ptr=start, index=0; (c=_jswrap_graphics_replayNext(&ptr, end)) && !jspHasError(); index++) {
+      _jswrap_graphics_replayGetArgs(parent, vars, overrides, index, c, &a);
+      if (c->cmd < GFXREC_FIRST_DRAW) {
+        _jswrap_graphics_replayExec(parent, &gfx, &a);
+      } else {
+        bool cmdChanged = c->flags & GFXREC_FLAG_CHANGED;
+        JsGraphicsClipRect r = clip;
+        bool draw = true;
+        if (!cmdChanged) {
+          if (!all) {
+            if (dx1>r.x1) r.x1 = (unsigned short)dx1;
+            if (dy1>r.y1) r.y1 = (unsigned short)dy1;
+            if (dx2<r.x2) r.x2 = (unsigned short)dx2;
+            if (dy2<r.y2) r.y2 = (unsigned short)dy2;
+            if (dx1>dx2) r.x1 = r.x2+1; // nothing to redraw
+          }
+          draw = _jswrap_graphics_replayOverlaps(&c->area, &r);
+        }
+        if (draw) {
+          JsGraphicsClipRect area;
+          gfx.data.clipRect = r;
+          _jswrap_graphics_replayDraw(parent, &gfx, &a, &area);
+          if (cmdChanged || all) { // drawn without extra clipping, so this is the whole area
+            c->area = area;
+            c->flags |= GFXREC_FLAG_AREA;
+          }
+          if (cmdChanged)
+            _jswrap_graphics_replayAddArea(&dx1, &dy1, &dx2, &dy2, &area);
+        } else if (c->cmd==GFXREC_CLEAR && a.args[0]) { // not drawn, but still reset the state
+          _jswrap_graphics_replayReset(parent, &gfx);
+        }
+      }
+      _jswrap_graphics_replayFreeArgs(&a);
+    }
+    gfx.data.clipRect = clip;
+    graphicsSetVar(&gfx);
+  }
+  jsvUnLock2(cmds, vars);
+  return jsvLockAgain(parent);
+#else
+  return 0;
+#endif
+}
+
 /*JSON{
   "type" : "method",
   "class" : "Graphics",
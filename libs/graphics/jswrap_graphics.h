@@ -24,13 +24,16 @@ extern const uint16_t PALETTE_8BIT[256];
 
 bool jswrap_graphics_idle();
 void jswrap_graphics_init();
+void jswrap_graphics_kill();
+bool jswrap_graphics_freemem();
 
 JsVar *jswrap_graphics_getInstance();
 // For creating graphics classes
 JsVar *jswrap_graphics_createArrayBuffer(int width, int height, int bpp,  JsVar *options);
 JsVar *jswrap_graphics_createCallback(int width, int height, int bpp, JsVar *callback);
 #ifdef USE_LCD_SDL
-JsVar *jswrap_graphics_createSDL(int width, int height, int bpp);
+JsVar *jswrap_graphics_createSDL(int width, int height, int bpp, JsVar *options);
+JsVar *jswrap_graphics_getStats(JsVar *parent);
 #endif
 JsVar *jswrap_graphics_createImage(JsVar *data);
 
@@ -77,6 +80,8 @@ JsVar *jswrap_graphics_drawImage(JsVar *parent, JsVar *image, int xPos, int yPos
 JsVar *jswrap_graphics_drawImages(JsVar *parent, JsVar *layersVar, JsVar *options);
 JsVar *jswrap_graphics_asImage(JsVar *parent, JsVar *imgType);
 JsVar *jswrap_graphics_getModified(JsVar *parent, bool reset);
+JsVar *jswrap_graphics_record(JsVar *parent, JsVar *callback);
+JsVar *jswrap_graphics_replay(JsVar *parent, JsVar *list, JsVar *overrides, bool all);
 JsVar *jswrap_graphics_scroll(JsVar *parent, int x, int y);
 JsVar *jswrap_graphics_blit(JsVar *parent, JsVar *options);
 JsVar *jswrap_graphics_asBMP(JsVar *parent);
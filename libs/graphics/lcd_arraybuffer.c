@@ -171,9 +171,129 @@ unsigned int lcdGetPixel_ArrayBuffer_flat(JsGraphics *gfx, int x, int y) {
   return col;
 }
 
+/** Fill 'count' bytes from 'ptr' with a repeating 4 byte pattern (in memory order), only changing
+ * the bits that are set in 'mask' (another 4 byte pattern). After the first few bytes, this writes
+ * aligned 32 bit words */
+static void lcdFillBytes_ArrayBuffer_flat(uint8_t *ptr, size_t count, uint32_t pattern, uint32_t mask) {
+  uint8_t pat[8], msk[8];
+  pattern &= mask;
+  memcpy(&pat[0], &pattern, 4);
+  memcpy(&pat[4], &pattern, 4);
+  memcpy(&msk[0], &mask, 4);
+  memcpy(&msk[4], &mask, 4);
+  unsigned int phase = 0;
+  // bytes until we're word aligned
+  while (count && ((size_t)ptr&3)) {
+    *ptr = (uint8_t)((*ptr & ~msk[phase]) | pat[phase]);
+    ptr++;
+    count--;
+    phase = (phase+1)&3;
+  }
+  // whole words
+  uint32_t p32, m32;
+  memcpy(&p32, &pat[phase], 4);
+  memcpy(&m32, &msk[phase], 4);
+  uint32_t *wptr = (uint32_t*)ptr;
+  if (m32==0xFFFFFFFF) {
+    while (count>=4) {
+      *(wptr++) = p32;
+      count -= 4;
+    }
+  } else {
+    while (count>=4) {
+      *wptr = (*wptr & ~m32) | p32;
+      wptr++;
+      count -= 4;
+    }
+  }
+  // leftover bytes
+  ptr = (uint8_t*)wptr;
+  while (count--) {
+    *ptr = (uint8_t)((*ptr & ~msk[phase]) | pat[phase]);
+    ptr++;
+    phase = (phase+1)&3;
+  }
+}
+
+/** Fill pixelCount pixels from x,y with col a word at a time (handling MSB, vertical byte and
+ * interleaved layouts). Returns false if we can't handle this bit depth/layout */
+static bool lcdFillSpan_ArrayBuffer_flat(JsGraphics *gfx, int x, int y, int pixelCount, unsigned int col) {
+  uint8_t *buf = (uint8_t*)gfx->backendData;
+  unsigned int bpp = gfx->data.bpp;
+  bool msb = (gfx->data.flags & JSGRAPHICSFLAGS_ARRAYBUFFER_MSB)!=0;
+  unsigned int bppStride = bpp; // in bits
+  if (gfx->data.flags & JSGRAPHICSFLAGS_ARRAYBUFFER_INTERLEAVEX)
+    bppStride <<= 1;
+  unsigned int idx = lcdGetPixelIndex_ArrayBuffer(gfx,x,y,pixelCount);
+  if (gfx->data.flags & JSGRAPHICSFLAGS_ARRAYBUFFER_VERTICAL_BYTE) {
+    // 1 bit, 8 pixels stacked vertically in each byte - so we're setting one bit in consecutive bytes
+    if (bpp!=1) return false;
+    uint32_t mask = (uint32_t)((msb ? 0x80>>(idx&7) : 1<<(idx&7)) * 0x01010101U);
+    lcdFillBytes_ArrayBuffer_flat(&buf[idx>>3], (size_t)pixelCount, (col&1) ? 0xFFFFFFFF : 0, mask);
+    return true;
+  }
+  unsigned int pixelMask = (1U<<bpp)-1;
+  if (bpp==1 || bpp==2 || bpp==4) {
+    /* Work out what one byte looks like - the pixel slots in a byte that are ours (all
+    of them unless interleaved) and their colour */
+    uint8_t pattern = 0, slots = 0;
+    for (unsigned int i=idx%bppStride; i<8; i+=bppStride) {
+      unsigned int shift = msb ? 8-(i+bpp) : i;
+      pattern |= (uint8_t)((col&pixelMask)<<shift);
+      slots |= (uint8_t)(pixelMask<<shift);
+    }
+    // Bit range (in pixel order) that we're going to write
+    unsigned int bitStart = idx;
+    unsigned int bitEnd = idx + (unsigned int)(pixelCount-1)*bppStride + bpp;
+    uint8_t *ptr = &buf[bitStart>>3];
+    unsigned int a = bitStart&7;
+    if ((bitStart>>3) == ((bitEnd-1)>>3)) { // all within one byte
+      unsigned int b = bitEnd-(bitStart&~7U);
+      uint8_t edge = (uint8_t)(msb ? ((0xFFU>>a) & (0xFFU<<(8-b))) : (((1U<<b)-1) & ~((1U<<a)-1)));
+      *ptr = (uint8_t)((*ptr & ~(slots&edge)) | (pattern&edge));
+      return true;
+    }
+    if (a) { // first partial byte
+      uint8_t edge = (uint8_t)(msb ? (0xFFU>>a) : (0xFFU<<a));
+      *ptr = (uint8_t)((*ptr & ~(slots&edge)) | (pattern&edge));
+      ptr++;
+      bitStart = (bitStart+8)&~7U;
+    }
+    // whole bytes
+    size_t wholeBytes = (bitEnd-bitStart)>>3;
+    lcdFillBytes_ArrayBuffer_flat(ptr, wholeBytes, pattern*0x01010101U, slots*0x01010101U);
+    ptr += wholeBytes;
+    unsigned int b = bitEnd&7;
+    if (b) { // last partial byte
+      uint8_t edge = (uint8_t)(msb ? (0xFFU<<(8-b)) : ((1U<<b)-1));
+      *ptr = (uint8_t)((*ptr & ~(slots&edge)) | (pattern&edge));
+    }
+    return true;
+  }
+  if (bpp==8 || bpp==16 || (bpp==32 && bppStride==32)) {
+    // Whole bytes per pixel - build up 4 bytes of pixel data (with gaps if interleaved)
+    unsigned int bytes = bpp>>3, strideBytes = bppStride>>3;
+    uint8_t pattern[4] = {0,0,0,0}, mask[4] = {0,0,0,0};
+    for (unsigned int p=0; p<4; p+=strideBytes) {
+      for (unsigned int i=0;i<bytes;i++) {
+        pattern[p+i] = (uint8_t)(col >> (msb ? 8*(bytes-1-i) : 8*i));
+        mask[p+i] = 0xFF;
+      }
+    }
+    uint32_t pattern32, mask32;
+    memcpy(&pattern32, pattern, 4);
+    memcpy(&mask32, mask, 4);
+    lcdFillBytes_ArrayBuffer_flat(&buf[idx>>3], (size_t)((unsigned int)(pixelCount-1)*strideBytes + bytes), pattern32, mask32);
+    return true;
+  }
+  return false;
+}
+
 // set pixelCount pixels starting at x,y
 // Faster implementation for where we have a flat memory area
 void lcdSetPixels_ArrayBuffer_flat(JsGraphics *gfx, int x, int y, int pixelCount, unsigned int col) {
+  if (pixelCount>1 && lcdFillSpan_ArrayBuffer_flat(gfx, x, y, pixelCount, col))
+    return;
   unsigned char *ptr = (unsigned char*)gfx->backendData;
   unsigned int idx = lcdGetPixelIndex_ArrayBuffer(gfx,x,y,pixelCount);
   ptr += idx>>3;
@@ -233,6 +353,11 @@ void lcdSetPixel_ArrayBuffer_flat(JsGraphics *gfx, int x, int y, unsigned int co
 
 // Faster implementation for where we have a flat memory area
 void  lcdFillRect_ArrayBuffer_flat(struct JsGraphics *gfx, int x1, int y1, int x2, int y2, unsigned int col) {
+  if (x1==0 && x2==gfx->data.width-1 && !(gfx->data.flags & JSGRAPHICSFLAGS_NONLINEAR)) {
+    // full width, so it's all one area of memory
+    lcdSetPixels_ArrayBuffer_flat(gfx, 0, y1, gfx->data.width*(1+y2-y1), col);
+    return;
+  }
   int y;
   for (y=y1;y<=y2;y++)
     lcdSetPixels_ArrayBuffer_flat(gfx, x1, y, 1+x2-x1, col);
@@ -246,14 +371,7 @@ void lcdSetPixel_ArrayBuffer_flat1(JsGraphics *gfx, int x, int y, unsigned int c
 }
 
 void lcdFillRect_ArrayBuffer_flat1(JsGraphics *gfx, int x1, int y1, int x2, int y2, unsigned int col) {
-  for (int y=y1;y<=y2;y++) {
-    int p = x1 + y*gfx->data.width;
-    for (int x=x1;x<=x2;x++) {
-      if (col) ((uint8_t*)gfx->backendData)[p>>3] |= (uint8_t)(0x80 >> (p&7));
-      else ((uint8_t*)gfx->backendData)[p>>3] &= (uint8_t)(0xFF7F >> (p&7));
-      p++;
-    }
-  }
+  lcdFillRect_ArrayBuffer_flat(gfx, x1, y1, x2, y2, col);
 }
 
 void lcdSetPixel_ArrayBuffer_flat8(JsGraphics *gfx, int x, int y, unsigned int col) {
@@ -265,10 +383,65 @@ unsigned int lcdGetPixel_ArrayBuffer_flat8(struct JsGraphics *gfx, int x, int y)
 }
 
 void lcdFillRect_ArrayBuffer_flat8(JsGraphics *gfx, int x1, int y1, int x2, int y2, unsigned int col) {
-  for (int y=y1;y<=y2;y++) {
-    uint8_t *p = &((uint8_t*)gfx->backendData)[x1 + y*gfx->data.width];
-    for (int x=x1;x<=x2;x++)
-      *(p++) = (uint8_t)col;
+  if (x1==0 && x2==gfx->data.width-1) { // full width, so it's all one area of memory
+    memset(&((uint8_t*)gfx->backendData)[y1*gfx->data.width], (int)(col&255), (size_t)(gfx->data.width*(1+y2-y1)));
+    return;
+  }
+  for (int y=y1;y<=y2;y++)
+    memset(&((uint8_t*)gfx->backendData)[x1 + y*gfx->data.width], (int)(col&255), (size_t)(1+x2-x1));
+}
+
+void lcdBlitSpan_ArrayBuffer_flat8(JsGraphics *gfx, int x, int y, int w, const unsigned char *data) {
+  memcpy(&((uint8_t*)gfx->backendData)[x + y*gfx->data.width], data, (size_t)w);
+}
+
+// 16 bit, MSB first - image data is already in the right format
+void lcdBlitSpan_ArrayBuffer_flat16MSB(JsGraphics *gfx, int x, int y, int w, const unsigned char *data) {
+  memcpy(&((uint8_t*)gfx->backendData)[(x + y*gfx->data.width)*2], data, (size_t)w*2);
+}
+
+// 16 bit, LSB first - so swap the bytes of each pixel
+void lcdBlitSpan_ArrayBuffer_flat16(JsGraphics *gfx, int x, int y, int w, const unsigned char *data) {
+  uint8_t *p = &((uint8_t*)gfx->backendData)[(x + y*gfx->data.width)*2];
+  while (w--) {
+    p[0] = data[1];
+    p[1] = data[0];
+    p += 2;
+    data += 2;
+  }
+}
+
+// 8 bit column (for rotated images)
+void lcdBlitColumn_ArrayBuffer_flat8(JsGraphics *gfx, int x, int y, int h, const unsigned char *data) {
+  int stride = gfx->data.width;
+  uint8_t *p = &((uint8_t*)gfx->backendData)[x + y*stride];
+  while (h--) {
+    *p = *(data++);
+    p += stride;
+  }
+}
+
+// 16 bit column, MSB first
+void lcdBlitColumn_ArrayBuffer_flat16MSB(JsGraphics *gfx, int x, int y, int h, const unsigned char *data) {
+  int stride = gfx->data.width*2;
+  uint8_t *p = &((uint8_t*)gfx->backendData)[(x + y*gfx->data.width)*2];
+  while (h--) {
+    p[0] = data[0];
+    p[1] = data[1];
+    p += stride;
+    data += 2;
+  }
+}
+
+// 16 bit column, LSB first
+void lcdBlitColumn_ArrayBuffer_flat16(JsGraphics *gfx, int x, int y, int h, const unsigned char *data) {
+  int stride = gfx->data.width*2;
+  uint8_t *p = &((uint8_t*)gfx->backendData)[(x + y*gfx->data.width)*2];
+  while (h--) {
+    p[0] = data[1];
+    p[1] = data[0];
+    p += stride;
+    data += 2;
   }
 }
 
@@ -324,6 +497,8 @@ void lcdSetCallbacks_ArrayBuffer(JsGraphics *gfx) {
       gfx->getPixel = lcdGetPixel_ArrayBuffer_flat8;
       gfx->fillRect = lcdFillRect_ArrayBuffer_flat8;
       gfx->scroll = lcdScroll_ArrayBuffer_flat8;
+      gfx->blitSpan = lcdBlitSpan_ArrayBuffer_flat8;
+      gfx->blitColumn = lcdBlitColumn_ArrayBuffer_flat8;
     } else
 #endif
     {
@@ -331,6 +506,13 @@ void lcdSetCallbacks_ArrayBuffer(JsGraphics *gfx) {
       gfx->setPixel = lcdSetPixel_ArrayBuffer_flat;
       gfx->getPixel = lcdGetPixel_ArrayBuffer_flat;
       gfx->fillRect = lcdFillRect_ArrayBuffer_flat;
+#ifdef GRAPHICS_FAST_PATHS
+      if (gfx->data.bpp==16 && !(gfx->data.flags & JSGRAPHICSFLAGS_NONLINEAR)) {
+        bool msb = (gfx->data.flags & JSGRAPHICSFLAGS_ARRAYBUFFER_MSB)!=0;
+        gfx->blitSpan = msb ? lcdBlitSpan_ArrayBuffer_flat16MSB : lcdBlitSpan_ArrayBuffer_flat16;
+        gfx->blitColumn = msb ? lcdBlitColumn_ArrayBuffer_flat16MSB : lcdBlitColumn_ArrayBuffer_flat16;
+      }
+#endif
     }
 #else
   if (false) {
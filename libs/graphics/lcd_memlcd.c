@@ -162,22 +162,41 @@ void lcdMemLCD_scroll(struct JsGraphics *gfx, int xdir, int ydir, int x1, int y1
 // -----------------------------------------------------------------------------
 
 void lcdMemLCD_flip(JsGraphics *gfx) {
-  if (gfx->data.modMinY > gfx->data.modMaxY) return; // nothing to do!
+  JsGraphicsClipRect rects[JSGRAPHICS_MODIFIED_RECTS];
+  int count = graphicsGetModifiedRects(gfx, rects);
+  if (!count) return; // nothing to do!
 
-  int y1 = gfx->data.modMinY;
-  int y2 = gfx->data.modMaxY;
-  int l = 1+y2-y1;
+  // We can only send whole rows, so send each run of rows that contains a modified rect
+  while (count) {
+    // find the topmost rect...
+    int first = 0;
+    for (int i=1;i<count;i++)
+      if (rects[i].y1 < rects[first].y1) first = i;
+    int y1 = rects[first].y1;
+    int y2 = rects[first].y2;
+    rects[first] = rects[--count];
+    // ...and add any rects whose rows overlap or touch it
+    bool merged = true;
+    while (merged) {
+      merged = false;
+      for (int i=0;i<count;i++) {
+        if (rects[i].y1 <= y2+1) {
+          if (rects[i].y2 > y2) y2 = rects[i].y2;
+          rects[i--] = rects[--count];
+          merged = true;
+        }
+      }
+    }
+    int l = 1+y2-y1;
 
-  jshPinSetValue(LCD_SPI_CS, 1);
-  //jshDelayMicroseconds(10000);
-  jshSPISendMany(LCD_SPI, &lcdBuffer[LCD_STRIDE*y1], NULL, (l*LCD_STRIDE)+2, NULL);
-  //jshDelayMicroseconds(10000);
-  jshPinSetValue(LCD_SPI_CS, 0);
+    jshPinSetValue(LCD_SPI_CS, 1);
+    //jshDelayMicroseconds(10000);
+    jshSPISendMany(LCD_SPI, &lcdBuffer[LCD_STRIDE*y1], NULL, (l*LCD_STRIDE)+2, NULL);
+    //jshDelayMicroseconds(10000);
+    jshPinSetValue(LCD_SPI_CS, 0);
+  }
   // Reset modified-ness
-  gfx->data.modMaxX = -32768;
-  gfx->data.modMaxY = -32768;
-  gfx->data.modMinX = 32767;
-  gfx->data.modMinY = 32767;
+  graphicsResetModified(gfx);
 }
 
 void lcdMemLCD_init(JsGraphics *gfx) {
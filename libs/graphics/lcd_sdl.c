@@ -9,20 +9,50 @@
  *
  * ----------------------------------------------------------------------------
  * Graphics Backend for drawing via SDL
+ *
+ * Everything is drawn into an offscreen buffer (one uint32 per pixel, in the
+ * Graphics' own color format). The modified areas are converted and copied to
+ * the SDL window in one go when g.flip() is called. In headless mode (or if
+ * we're compiled without SDL) there is no window at all, so drawing can be
+ * tested and benchmarked without a display.
+ *
+ * SDL 1.2 only has one window, so only one SDL Graphics instance owns the
+ * buffer at a time - the last one created, which is kept in hiddenRoot. Any
+ * older instances just stop drawing.
  * ----------------------------------------------------------------------------
  */
 
 #include "platform_config.h"
 #include "jsutils.h"
+#include "jsvar.h"
+#include "jshardware.h"
+#include "jsinteractive.h"
 #include "lcd_sdl.h"
+#ifdef USE_SDL
 #include <SDL/SDL.h>
 
-#define BPP 4
-#define DEPTH 32
-
 SDL_Surface *screen = 0;
+#endif
+
+#define SDL_GRAPHICS_NAME "sdlG" ///< hiddenRoot child for the Graphics instance that owns sdlBuffer
+
+uint32_t *sdlBuffer = 0; ///< Offscreen buffer - one pixel per uint32, in the Graphics' color format
+bool sdlHeadless = true;
+bool sdlUsesFlip = false; ///< once g.flip() is called, only update the window then (not on idle)
 bool needsFlip = false;
 
+typedef struct {
+  unsigned int frames; ///< How many times g.flip() has been called
+  JsSysTime lastFlip; ///< When g.flip() was last called
+  JsVarFloat frameTime; ///< milliseconds between the last two flips
+  JsVarFloat flipTime; ///< milliseconds the last flip took
+  unsigned int pixels; ///< Pixels drawn in the last frame
+  unsigned int flushBytes; ///< Bytes copied to the window in the last flip
+  unsigned int pixelsDrawn; ///< Pixels drawn since the last flip
+} LcdSDLStats;
+LcdSDLStats sdlStats;
+
+#ifdef USE_SDL
 uint32_t palette_web[256] = {
     0x000000,0x000033,0x000066,0x000099,0x0000cc,0x0000ff,0x003300,0x003333,0x003366,0x003399,0x0033cc,
     0x0033ff,0x006600,0x006633,0x006666,0x006699,0x0066cc,0x0066ff,0x009900,0x009933,0x009966,0x009999,
@@ -45,57 +75,222 @@ uint32_t palette_web[256] = {
     0xff9900,0xff9933,0xff9966,0xff9999,0xff99cc,0xff99ff,0xffcc00,0xffcc33,0xffcc66,0xffcc99,0xffcccc,
     0xffccff,0xffff00,0xffff33,0xffff66,0xffff99,0xffffcc,0xffffff};
 
-unsigned int lcdGetPixel_SDL(JsGraphics *gfx, int x, int y) {
-  if (!screen) return 0;
-  if(SDL_MUSTLOCK(screen))
-      if(SDL_LockSurface(screen) < 0) return 0;
-  unsigned int *pixmem32 = ((unsigned int*)screen->pixels) + y*gfx->data.width + x;
-  unsigned int col = *pixmem32;
-  if(SDL_MUSTLOCK(screen)) SDL_UnlockSurface(screen);
+/// Convert a color in the Graphics' format to 0xRRGGBB
+static uint32_t lcdColorToRGB_SDL(int bpp, unsigned int col) {
+  if (bpp==8) return palette_web[col&255];
+  if (bpp==16) {
+    unsigned int r = (col>>8)&0xF8;
+    unsigned int g = (col>>3)&0xFC;
+    unsigned int b = (col<<3)&0xFF;
+    return (r<<16)|(g<<8)|b;
+  }
+  if (bpp<8) return col ? 0xFFFFFF : 0;
   return col;
 }
+#endif
+
+static unsigned int lcdColorMask_SDL(JsGraphics *gfx) {
+  return (gfx->data.bpp>=32) ? 0xFFFFFFFF : (unsigned int)((1L<<gfx->data.bpp)-1);
+}
 
+unsigned int lcdGetPixel_SDL(JsGraphics *gfx, int x, int y) {
+  return ((uint32_t*)gfx->backendData)[x + y*gfx->data.width];
+}
 
 void lcdSetPixel_SDL(JsGraphics *gfx, int x, int y, unsigned int col) {
-  if (!screen) return;
+  ((uint32_t*)gfx->backendData)[x + y*gfx->data.width] = col & lcdColorMask_SDL(gfx);
+  sdlStats.pixelsDrawn++;
+  needsFlip = true;
+}
+
+void lcdFillRect_SDL(JsGraphics *gfx, int x1, int y1, int x2, int y2, unsigned int col) {
+  col &= lcdColorMask_SDL(gfx);
+  for (int y=y1;y<=y2;y++) {
+    uint32_t *p = &((uint32_t*)gfx->backendData)[x1 + y*gfx->data.width];
+    for (int x=x1;x<=x2;x++)
+      *(p++) = col;
+  }
+  sdlStats.pixelsDrawn += (unsigned int)((x2+1-x1)*(y2+1-y1));
+  needsFlip = true;
+}
 
-  if(SDL_MUSTLOCK(screen))
-    if(SDL_LockSurface(screen) < 0) return;
-  if (gfx->data.bpp==8) col = palette_web[col&255];
+/// Write 'w' pixels (8 or 16 bit MSB-first) to the buffer starting at 'p', 'step' pixels apart
+static void lcdBlit_SDL(JsGraphics *gfx, uint32_t *p, int step, int w, const unsigned char *data) {
   if (gfx->data.bpp==16) {
-    int r = (col>>8)&0xF8;
-    int g = (col>>3)&0xFC;
-    int b = (col<<3)&0xFF;
-    col = (r<<16)|(g<<8)|b;
+    while (w--) {
+      *p = (uint32_t)((data[0]<<8) | data[1]);
+      data += 2;
+      p += step;
+    }
+  } else {
+    while (w--) {
+      *p = *(data++);
+      p += step;
+    }
   }
-  unsigned int *pixmem32 = ((unsigned int*)screen->pixels) + y*gfx->data.width + x;
-  *pixmem32 = col;
-  if(SDL_MUSTLOCK(screen)) SDL_UnlockSurface(screen);
+}
+
+void lcdBlitSpan_SDL(JsGraphics *gfx, int x, int y, int w, const unsigned char *data) {
+  lcdBlit_SDL(gfx, &((uint32_t*)gfx->backendData)[x + y*gfx->data.width], 1, w, data);
+  sdlStats.pixelsDrawn += (unsigned int)w;
+  needsFlip = true;
+}
+
+void lcdBlitColumn_SDL(JsGraphics *gfx, int x, int y, int h, const unsigned char *data) {
+  lcdBlit_SDL(gfx, &((uint32_t*)gfx->backendData)[x + y*gfx->data.width], gfx->data.width, h, data);
+  sdlStats.pixelsDrawn += (unsigned int)h;
   needsFlip = true;
 }
 
-void lcdInit_SDL(JsGraphics *gfx) {
-  if (SDL_Init(SDL_INIT_VIDEO) < 0 ) {
-    jsExceptionHere(JSET_ERROR, "SDL_Init failed\n");
-    exit(1);
+#ifdef USE_SDL
+/// Convert an area of the offscreen buffer into the window's surface
+static void lcdCopyRect_SDL(JsGraphics *gfx, int x1, int y1, int x2, int y2) {
+  for (int y=y1;y<=y2;y++) {
+    uint32_t *src = &((uint32_t*)gfx->backendData)[x1 + y*gfx->data.width];
+    uint32_t *dst = (uint32_t*)((char*)screen->pixels + y*screen->pitch) + x1;
+    for (int x=x1;x<=x2;x++)
+      *(dst++) = lcdColorToRGB_SDL(gfx->data.bpp, *(src++));
+  }
+}
+#endif
+
+/** Copy the given areas of the offscreen buffer to the window (if there is one), and update
+ * the frame stats. If count<0, copy everything */
+static void lcdPresent_SDL(JsGraphics *gfx, JsGraphicsClipRect *rects, int count) {
+  JsSysTime start = jshGetSystemTime();
+  // work out how much we'd send (even if headless) - 32 bits per pixel
+  unsigned int bytes = 0;
+  if (count<0) {
+    bytes = (unsigned int)(gfx->data.width*gfx->data.height*4);
+  } else {
+    for (int i=0;i<count;i++)
+      bytes += (unsigned int)((rects[i].x2+1-rects[i].x1)*(rects[i].y2+1-rects[i].y1)*4);
+  }
+#ifdef USE_SDL
+  if (screen && count) {
+    if (SDL_MUSTLOCK(screen) && SDL_LockSurface(screen) < 0) return;
+    if (count<0) {
+      lcdCopyRect_SDL(gfx, 0, 0, gfx->data.width-1, gfx->data.height-1);
+    } else {
+      for (int i=0;i<count;i++)
+        lcdCopyRect_SDL(gfx, rects[i].x1, rects[i].y1, rects[i].x2, rects[i].y2);
+    }
+    if (SDL_MUSTLOCK(screen)) SDL_UnlockSurface(screen);
+    if (count<0) {
+      SDL_Flip(screen);
+    } else {
+      SDL_Rect r[JSGRAPHICS_MODIFIED_RECTS];
+      for (int i=0;i<count;i++) {
+        r[i].x = (Sint16)rects[i].x1;
+        r[i].y = (Sint16)rects[i].y1;
+        r[i].w = (Uint16)(rects[i].x2+1-rects[i].x1);
+        r[i].h = (Uint16)(rects[i].y2+1-rects[i].y1);
+      }
+      SDL_UpdateRects(screen, count, r);
+    }
+  }
+#endif
+  JsSysTime now = jshGetSystemTime();
+  if (sdlStats.frames)
+    sdlStats.frameTime = jshGetMillisecondsFromTime(now - sdlStats.lastFlip);
+  sdlStats.flipTime = jshGetMillisecondsFromTime(now - start);
+  sdlStats.lastFlip = now;
+  sdlStats.frames++;
+  sdlStats.pixels = sdlStats.pixelsDrawn;
+  sdlStats.pixelsDrawn = 0;
+  sdlStats.flushBytes = bytes;
+  needsFlip = false;
+}
+
+/// g.flip(all) - send what has been modified to the window
+void lcdFlip_SDL(JsVar *parent, bool all) {
+  JsGraphics gfx;
+  if (!graphicsGetFromVar(&gfx, parent) || !gfx.backendData) return;
+  sdlUsesFlip = true;
+  if (all) {
+    lcdPresent_SDL(&gfx, 0, -1);
+  } else {
+    JsGraphicsClipRect rects[JSGRAPHICS_MODIFIED_RECTS];
+    lcdPresent_SDL(&gfx, rects, graphicsGetModifiedRects(&gfx, rects));
   }
-  if (!(screen = SDL_SetVideoMode(gfx->data.width, gfx->data.height, 32, SDL_SWSURFACE)))
-  {
-    jsExceptionHere(JSET_ERROR, "SDL_SetVideoMode failed\n");
+  graphicsResetModified(&gfx);
+  graphicsSetVar(&gfx);
+}
+
+/// Get an object containing stats about the last frame (or 0 if this isn't the instance that owns the buffer)
+JsVar *lcdGetStats_SDL(JsGraphics *gfx) {
+  if (!gfx->backendData) return 0;
+  JsVar *obj = jsvNewObject();
+  if (!obj) return 0;
+  jsvObjectSetChildAndUnLock(obj, "frames", jsvNewFromInteger((JsVarInt)sdlStats.frames));
+  jsvObjectSetChildAndUnLock(obj, "frameTime", jsvNewFromFloat(sdlStats.frameTime));
+  jsvObjectSetChildAndUnLock(obj, "flipTime", jsvNewFromFloat(sdlStats.flipTime));
+  jsvObjectSetChildAndUnLock(obj, "pixels", jsvNewFromInteger((JsVarInt)sdlStats.pixels));
+  jsvObjectSetChildAndUnLock(obj, "flushBytes", jsvNewFromInteger((JsVarInt)sdlStats.flushBytes));
+  jsvObjectSetChildAndUnLock(obj, "headless", jsvNewFromBool(sdlHeadless));
+  return obj;
+}
+
+bool lcdInit_SDL(JsGraphics *gfx, bool headless) {
+  uint32_t *buf = (uint32_t*)calloc((size_t)(gfx->data.width*gfx->data.height), sizeof(uint32_t));
+  if (!buf) {
+    jsExceptionHere(JSET_ERROR, "Not enough memory for SDL buffer");
+    return false;
+  }
+#ifdef USE_SDL
+  if (!headless) {
+    if (SDL_Init(SDL_INIT_VIDEO) < 0 ) {
+      jsExceptionHere(JSET_ERROR, "SDL_Init failed");
+      free(buf);
+      return false;
+    }
+    if (!(screen = SDL_SetVideoMode(gfx->data.width, gfx->data.height, 32, SDL_SWSURFACE)))
+    {
+      jsExceptionHere(JSET_ERROR, "SDL_SetVideoMode failed");
+      SDL_Quit();
+      free(buf);
+      return false;
+    }
+  } else if (screen) { // the last instance had a window
     SDL_Quit();
-    exit(1);
+    screen = 0;
   }
+#else
+  headless = true; // no SDL, so we can only render to memory
+#endif
+  if (sdlBuffer) free(sdlBuffer);
+  sdlBuffer = buf;
+  jsvObjectSetChild(execInfo.hiddenRoot, SDL_GRAPHICS_NAME, gfx->graphicsVar);
+  sdlHeadless = headless;
+  sdlUsesFlip = false;
+  memset(&sdlStats, 0, sizeof(sdlStats));
+  return true;
 }
 
 void lcdIdle_SDL() {
-  if (needsFlip) {
+  // If the app isn't using g.flip(), update the whole window whenever something was drawn
+  if (needsFlip && !sdlUsesFlip) {
+    JsGraphics gfx;
+    JsVar *parent = jsvObjectGetChild(execInfo.hiddenRoot, SDL_GRAPHICS_NAME, 0);
+    if (parent && graphicsGetFromVar(&gfx, parent) && gfx.backendData)
+      lcdPresent_SDL(&gfx, 0, -1);
+    jsvUnLock(parent);
     needsFlip = false;
-    SDL_Flip(screen);
   }
 }
 
 void lcdSetCallbacks_SDL(JsGraphics *gfx) {
+  // Only the instance that sdlBuffer was made for can draw - others keep the fallback (no-op) callbacks
+  JsVar *owner = jsvObjectGetChild(execInfo.hiddenRoot, SDL_GRAPHICS_NAME, 0);
+  jsvUnLock(owner); // we only need to compare the pointer
+  if (!sdlBuffer || !owner || owner!=gfx->graphicsVar) {
+    gfx->backendData = 0;
+    return;
+  }
+  gfx->backendData = sdlBuffer;
   gfx->setPixel = lcdSetPixel_SDL;
   gfx->getPixel = lcdGetPixel_SDL;
-  // FIXME: idle callback would be a great idea to save lock/unlock
+  gfx->fillRect = lcdFillRect_SDL;
+  gfx->blitSpan = lcdBlitSpan_SDL;
+  gfx->blitColumn = lcdBlitColumn_SDL;
 }
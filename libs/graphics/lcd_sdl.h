@@ -14,6 +14,8 @@
 #include "graphics.h"
 
 
-void lcdInit_SDL(JsGraphics *gfx);
+bool lcdInit_SDL(JsGraphics *gfx, bool headless);
 void lcdIdle_SDL();
 void lcdSetCallbacks_SDL(JsGraphics *gfx);
+void lcdFlip_SDL(JsVar *parent, bool all);
+JsVar *lcdGetStats_SDL(JsGraphics *gfx);
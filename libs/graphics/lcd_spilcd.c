@@ -172,51 +172,69 @@ void lcdBlit_SPILCD(struct JsGraphics *gfx, int x1, int y1, int w, int h, int x2
 }
 #endif
 
+#if LCD_BPP==8 || LCD_BPP==16
+// Image data is stored MSB first, which is what the LCD wants anyway
+void lcdBlitSpan_SPILCD(struct JsGraphics *gfx, int x, int y, int w, const unsigned char *data) {
+  memcpy(&lcdBuffer[(x*(LCD_BPP>>3)) + (y*LCD_STRIDE)], data, w*(LCD_BPP>>3));
+}
+
+// Write a column of pixels (for rotated images)
+void lcdBlitColumn_SPILCD(struct JsGraphics *gfx, int x, int y, int h, const unsigned char *data) {
+  unsigned char *p = &lcdBuffer[(x*(LCD_BPP>>3)) + (y*LCD_STRIDE)];
+  while (h--) {
+    p[0] = *(data++);
+#if LCD_BPP==16
+    p[1] = *(data++);
+#endif
+    p += LCD_STRIDE;
+  }
+}
+#endif
+
 void lcdFlip_SPILCD_callback() {
   // just an empty stub for SPIsend - we'll just push data as fast as we can
 }
 
-void lcdFlip_SPILCD(JsGraphics *gfx) {
-  if (gfx->data.modMinX > gfx->data.modMaxX) return; // nothing to do!
-
-  // use nearest 2 pixels as we're sending 12 bits
-  gfx->data.modMinX = (gfx->data.modMinX)&~1;
-  gfx->data.modMaxX = (gfx->data.modMaxX+2)&~1;
+/// Send one modified area of lcdBuffer to the LCD (CS should already be asserted)
+static void lcdFlip_SPILCD_rect(int x1, int y1, int x2, int y2) {
+  unsigned char buffer1[LCD_STRIDE];
 #if LCD_BPP==12 || LCD_BPP==16
-  // Just send full rows as this allows us to issue a single SPI
-  // transfer.
-  // TODO: could swap to a transfer per row if we're filling less than half a row
-  gfx->data.modMinX = 0;
-  gfx->data.modMaxX = LCD_WIDTH-1;
+  // use nearest 2 pixels as we're sending 12 bits
+  x1 = x1&~1;
+  x2 = x2|1;
+  if (x2>=LCD_WIDTH) x2 = LCD_WIDTH-1;
+  /* If we're sending over half a row, just send full rows as this
+  allows us to issue a single SPI transfer. */
+  bool fullRows = (x2+1-x1)*2 > LCD_WIDTH;
+  if (fullRows) {
+    x1 = 0;
+    x2 = LCD_WIDTH-1;
+  }
 #else
-  int xlen = gfx->data.modMaxX - gfx->data.modMinX;
-  int xstart = gfx->data.modMinX;
-#endif
-  unsigned char buffer1[LCD_STRIDE];
-
-#ifdef ESPR_USE_SPI3
-  // anomaly 195 workaround - enable SPI before use
-  *(volatile uint32_t *)0x4002F500 = 7;
+  // use nearest 2 pixels as we're sending 12 bits
+  x1 = x1&~1;
+  x2 = (x2+2)&~1;
+  int xlen = x2 - x1;
+  int xstart = x1;
 #endif
 
-  jshPinSetValue(LCD_SPI_CS, 0);
   jshPinSetValue(LCD_SPI_DC, 0); // command
   buffer1[0] = SPILCD_CMD_WINDOW_X;
   jshSPISendMany(LCD_SPI, buffer1, NULL, 1, NULL);
   jshPinSetValue(LCD_SPI_DC, 1); // data
   buffer1[0] = 0;
-  buffer1[1] = gfx->data.modMinX;
+  buffer1[1] = x1;
   buffer1[2] = 0;
-  buffer1[3] = gfx->data.modMaxX;
+  buffer1[3] = x2;
   jshSPISendMany(LCD_SPI, buffer1, NULL, 4, NULL);
   jshPinSetValue(LCD_SPI_DC, 0); // command
   buffer1[0] = SPILCD_CMD_WINDOW_Y;
   jshSPISendMany(LCD_SPI, buffer1, NULL, 1, NULL);
   jshPinSetValue(LCD_SPI_DC, 1); // data
   buffer1[0] = 0;
-  buffer1[1] = gfx->data.modMinY;
+  buffer1[1] = y1;
   buffer1[2] = 0;
-  buffer1[3] = gfx->data.modMaxY;
+  buffer1[3] = y2;
   jshSPISendMany(LCD_SPI, buffer1, NULL, 4, NULL);
   jshPinSetValue(LCD_SPI_DC, 0); // command
   buffer1[0] = SPILCD_CMD_DATA;
@@ -224,26 +242,37 @@ void lcdFlip_SPILCD(JsGraphics *gfx) {
   jshPinSetValue(LCD_SPI_DC, 1); // data
 
 #if LCD_BPP==12 || LCD_BPP==16
-  // FIXME: hack because SPI send on NRF52 fails for >65k transfers
-  // we should fix this in jshardware.c
-  unsigned char *p = &lcdBuffer[LCD_STRIDE*gfx->data.modMinY];
-  int c = (gfx->data.modMaxY+1-gfx->data.modMinY)*LCD_STRIDE;
-  while (c) {
-    int n = c;
-    if (n>65535) n=65535;
-    jshSPISendMany(
-        LCD_SPI,
-        p,
-        0,
-        n,
-        NULL);
-    if (jspIsInterrupted()) break;
-    p+=n;
-    c-=n;
+  if (fullRows) {
+    // FIXME: hack because SPI send on NRF52 fails for >65k transfers
+    // we should fix this in jshardware.c
+    unsigned char *p = &lcdBuffer[LCD_STRIDE*y1];
+    int c = (y2+1-y1)*LCD_STRIDE;
+    while (c) {
+      int n = c;
+      if (n>65535) n=65535;
+      jshSPISendMany(
+          LCD_SPI,
+          p,
+          0,
+          n,
+          NULL);
+      if (jspIsInterrupted()) break;
+      p+=n;
+      c-=n;
+    }
+  } else {
+    // send just the modified part of each row
+    int xoffset = (x1*LCD_BPP)>>3;
+    int xbytes = (((x2+1)*LCD_BPP)>>3) - xoffset;
+    for (int y=y1;y<=y2;y++) {
+      jshSPISendMany(LCD_SPI, &lcdBuffer[y*LCD_STRIDE + xoffset], 0, xbytes, lcdFlip_SPILCD_callback);
+      if (jspIsInterrupted()) break;
+    }
+    jshSPIWait(LCD_SPI);
   }
 #else
   unsigned char buffer2[LCD_STRIDE];
-  for (int y=gfx->data.modMinY;y<=gfx->data.modMaxY;y++) {
+  for (int y=y1;y<=y2;y++) {
     unsigned char *buffer = (y&1)?buffer1:buffer2;
     // skip any lines that don't need updating
 #if LCD_BPP==4
@@ -273,6 +302,24 @@ void lcdFlip_SPILCD(JsGraphics *gfx) {
   }
   jshSPIWait(LCD_SPI);
 #endif
+}
+
+void lcdFlip_SPILCD(JsGraphics *gfx) {
+  JsGraphicsClipRect rects[JSGRAPHICS_MODIFIED_RECTS];
+  int count = graphicsGetModifiedRects(gfx, rects);
+  if (!count) return; // nothing to do!
+
+#ifdef ESPR_USE_SPI3
+  // anomaly 195 workaround - enable SPI before use
+  *(volatile uint32_t *)0x4002F500 = 7;
+#endif
+
+  jshPinSetValue(LCD_SPI_CS, 0);
+  // Only send the areas that were modified
+  for (int i=0;i<count;i++) {
+    lcdFlip_SPILCD_rect(rects[i].x1, rects[i].y1, rects[i].x2, rects[i].y2);
+    if (jspIsInterrupted()) break;
+  }
   jshPinSetValue(LCD_SPI_CS,1);
 #ifdef ESPR_USE_SPI3
   // anomaly 195 workaround - disable SPI when done
@@ -281,10 +328,7 @@ void lcdFlip_SPILCD(JsGraphics *gfx) {
 #endif
 
   // Reset modified-ness
-  gfx->data.modMaxX = -32768;
-  gfx->data.modMaxY = -32768;
-  gfx->data.modMinX = 32767;
-  gfx->data.modMinY = 32767;
+  graphicsResetModified(gfx);
 }
 
 
@@ -348,6 +392,10 @@ void lcdSetCallbacks_SPILCD(JsGraphics *gfx) {
 #if LCD_BPP==16
   gfx->fillRect = lcdFillRect_SPILCD;
   gfx->blit = lcdBlit_SPILCD;
+#endif
+#if LCD_BPP==8 || LCD_BPP==16
+  gfx->blitSpan = lcdBlitSpan_SPILCD;
+  gfx->blitColumn = lcdBlitColumn_SPILCD;
 #endif
   gfx->getPixel = lcdGetPixel_SPILCD;
   //gfx->idle = lcdIdle_PCD8544;
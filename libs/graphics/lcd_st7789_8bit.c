@@ -223,6 +223,30 @@ LCDST7789Mode lcdST7789_getMode() {
   return lcdMode;
 }
 
+static void lcdST7789_blit8BitStride(int x, int y, int w, int h, int scale, int stride, JsvStringIterator *pixels, const uint16_t *palette);
+
+/// Blit only the modified areas of the offscreen buffer to the LCD, scaling up by 'scale'
+static void lcdST7789_flipBuffer(JsGraphics *gfx, int scale) {
+  JsGraphicsClipRect rects[JSGRAPHICS_MODIFIED_RECTS];
+  int count = graphicsGetModifiedRects(gfx, rects);
+  if (!count) return; // nothing to do!
+  JsVar *buffer = jsvObjectGetChild(gfx->graphicsVar, "buffer", 0);
+  JsVar *str = jsvGetArrayBufferBackingString(buffer, NULL);
+  if (str) {
+    int stride = gfx->data.width;
+    for (int i=0;i<count;i++) {
+      JsvStringIterator it;
+      jsvStringIteratorNew(&it, str, (size_t)(rects[i].y1*stride + rects[i].x1));
+      lcdST7789_blit8BitStride(rects[i].x1*scale, rects[i].y1*scale,
+          rects[i].x2+1-rects[i].x1, rects[i].y2+1-rects[i].y1,
+          scale, stride, &it, PALETTE_8BIT);
+      jsvStringIteratorFree(&it);
+    }
+  }
+  jsvUnLock2(str,buffer);
+  graphicsResetModified(gfx);
+}
+
 void lcdST7789_flip(JsGraphics *gfx) {
   switch (lcdMode) {
     case LCDST7789_MODE_NULL: break;
@@ -238,30 +262,14 @@ void lcdST7789_flip(JsGraphics *gfx) {
       }
       lcdST7789_scrollCmd();
     } break;
-    case LCDST7789_MODE_BUFFER_120x120: {
+    case LCDST7789_MODE_BUFFER_120x120:
       // offscreen buffer - BLIT
-      JsVar *buffer = jsvObjectGetChild(gfx->graphicsVar, "buffer", 0);
-      JsVar *str = jsvGetArrayBufferBackingString(buffer, NULL);
-      if (str) {
-        JsvStringIterator it;
-        jsvStringIteratorNew(&it, str, 0);
-        lcdST7789_blit8Bit(0,0,120,120,2,&it,PALETTE_8BIT);
-        jsvStringIteratorFree(&it);
-      }
-      jsvUnLock2(str,buffer);
-    } break;
-    case LCDST7789_MODE_BUFFER_80x80: {
+      lcdST7789_flipBuffer(gfx, 2);
+      break;
+    case LCDST7789_MODE_BUFFER_80x80:
       // offscreen buffer - BLIT
-      JsVar *buffer = jsvObjectGetChild(gfx->graphicsVar, "buffer", 0);
-      JsVar *str = jsvGetArrayBufferBackingString(buffer, NULL);
-      if (str) {
-        JsvStringIterator it;
-        jsvStringIteratorNew(&it, str, 0);
-        lcdST7789_blit8Bit(0,0,80,80,3,&it,PALETTE_8BIT);
-        jsvStringIteratorFree(&it);
-      }
-      jsvUnLock2(str,buffer);
-    } break;
+      lcdST7789_flipBuffer(gfx, 3);
+      break;
   }
 }
 
@@ -384,6 +392,11 @@ void lcdST7789_blit1Bit(int x, int y, int w, int h, int scale, JsvStringIterator
 }
 
 void lcdST7789_blit8Bit(int x, int y, int w, int h, int scale, JsvStringIterator *pixels, const uint16_t *palette) {
+  lcdST7789_blit8BitStride(x, y, w, h, scale, w, pixels, palette);
+}
+
+/// As lcdST7789_blit8Bit, but each row of 'pixels' is 'stride' bytes long (so we can blit part of a bigger image)
+static void lcdST7789_blit8BitStride(int x, int y, int w, int h, int scale, int stride, JsvStringIterator *pixels, const uint16_t *palette) {
   int y1 = y + lcdScrollY;
   int y2 = y + h*scale + lcdScrollY;
   if (y1>=LCD_BUFFER_HEIGHT) y1-=LCD_BUFFER_HEIGHT;
@@ -429,6 +442,9 @@ void lcdST7789_blit8Bit(int x, int y, int w, int h, int scale, JsvStringIterator
       }
     }
     jsvStringIteratorFree(&lastPixels);
+    // skip to the start of the next row
+    for (int i=w;i<stride;i++)
+      jsvStringIteratorNext(pixels);
   }
   lcdST7789_blitEnd();
 }
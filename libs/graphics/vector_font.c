@@ -13,7 +13,7 @@
  */
 
 #ifndef NO_VECTOR_FONT
-#include "graphics.h"
+#include "vector_font.h"
 
 const uint8_t vfFirstChar = 33;
 const uint8_t vfLastChar = 255;
@@ -480,11 +480,176 @@ unsigned int graphicsVectorCharWidth(JsGraphics *gfx, unsigned int sizex, char c
   return ((unsigned int)(w+1+VF_CHAR_SPACING)*sizex*16/VF_SCALE+7)>>4;
 }
 
+#ifdef USE_GLYPH_CACHE
+// Bitmap that vfCacheSpan renders into
+typedef struct {
+  unsigned char *data;
+  int x, y;   // pixel coordinates of the top-left of the bitmap
+  int stride; // bytes per row
+} VfCacheBitmap;
+
+static void vfCacheSpan(JsGraphics *gfx, int y, int x1, int x2, void *data) {
+  NOT_USED(gfx);
+  VfCacheBitmap *bmp = (VfCacheBitmap*)data;
+  // same rounding as graphicsFillPoly
+  x1 = ((x1+15)>>4) - bmp->x;
+  x2 = ((x2+15)>>4) - bmp->x;
+  unsigned char *row = &bmp->data[((y>>4) - bmp->y)*bmp->stride];
+  for (int x=x1;x<x2;x++)
+    row[x>>3] |= (unsigned char)(0x80>>(x&7));
+}
+
+/* Rasterise a character into the glyph cache. The glyph is rendered in device orientation, relative
+ * to the device pixel that the character's origin maps to. Because the origin is always a whole pixel
+ * this gives exactly the same pixels as vfDrawCharPtr would. */
+static GlyphCacheEntry *vfCacheChar(JsVar *cache, const GlyphCacheKey *key, int sizex, int sizey, const uint8_t *charPtr, int charLen) {
+  // work out the bounds of all polygons in 1/16th pixels
+  int minx = 0x7FFF, miny = 0x7FFF, maxx = -0x8000, maxy = -0x8000;
+  int w = 0;
+  for (int i = 0; i < charLen; ++i) {
+    int polyLen;
+    const uint8_t *p = vfGetPolyPtr(charPtr[i], &polyLen);
+    for (int j = 0; j < polyLen; ++j) {
+      int vx = p[j] % VF_CHAR_WIDTH;
+      int vy = p[j] / VF_CHAR_WIDTH;
+      if (vx>w) w=vx;
+      int px = vx*sizex*16/VF_SCALE - 8;
+      int py = (vy+VF_OFFSET_Y)*sizey*16/VF_SCALE - 8;
+      if (key->flags & JSGRAPHICSFLAGS_SWAP_XY) { int t = px; px = py; py = t; }
+      if (key->flags & JSGRAPHICSFLAGS_INVERT_X) px = -px;
+      if (key->flags & JSGRAPHICSFLAGS_INVERT_Y) py = -py;
+      if (px<minx) minx=px;
+      if (px>maxx) maxx=px;
+      if (py<miny) miny=py;
+      if (py>maxy) maxy=py;
+    }
+  }
+  // the pixels graphicsFillPoly would fill
+  int x1 = (minx+15)>>4, x2 = (maxx+15)>>4;
+  int y1 = (miny+15)>>4, y2 = (maxy+15)>>4;
+  if (x2<x1) x2=x1;
+  if (y2<y1) y2=y1;
+  int stride = (x2-x1+7)>>3;
+  GlyphCacheEntry *entry = glyphCacheAdd(cache, key, (size_t)(stride*(y2-y1)));
+  if (!entry) return 0;
+  entry->x = (int16_t)x1;
+  entry->y = (int16_t)y1;
+  entry->width = (uint16_t)(x2-x1);
+  entry->height = (uint16_t)(y2-y1);
+  entry->advance = (uint16_t)(((w+1+VF_CHAR_SPACING)*sizex*16/VF_SCALE+7)>>4);
+  VfCacheBitmap bmp;
+  bmp.data = GLYPH_CACHE_DATA(entry);
+  bmp.x = x1;
+  bmp.y = y1;
+  bmp.stride = stride;
+  memset(bmp.data, 0, entry->length);
+  if (y2<=y1) return entry;
+  for (int i = 0; i < charLen; ++i) {
+    short poly[86];
+    int polyLen;
+    const uint8_t *p = vfGetPolyPtr(charPtr[i], &polyLen);
+    for (int j = 0; j < polyLen; ++j) {
+      int px = (p[j] % VF_CHAR_WIDTH)*sizex*16/VF_SCALE - 8;
+      int py = ((p[j] / VF_CHAR_WIDTH)+VF_OFFSET_Y)*sizey*16/VF_SCALE - 8;
+      if (key->flags & JSGRAPHICSFLAGS_SWAP_XY) { int t = px; px = py; py = t; }
+      if (key->flags & JSGRAPHICSFLAGS_INVERT_X) px = -px;
+      if (key->flags & JSGRAPHICSFLAGS_INVERT_Y) py = -py;
+      poly[j*2  ] = (short)px;
+      poly[j*2+1] = (short)py;
+    }
+    graphicsFillPolyScan(NULL, polyLen, poly, y1*16, (y2-1)*16, 16, vfCacheSpan, &bmp);
+  }
+  return entry;
+}
+
+// Draw a glyph from the glyph cache with its origin at x,y
+static void vfDrawCachedChar(JsGraphics *gfx, int x, int y, GlyphCacheEntry *entry) {
+  graphicsToDeviceCoordinates(gfx, &x, &y);
+  x += entry->x;
+  y += entry->y;
+  int stride = (entry->width+7)>>3;
+  const unsigned char *row = GLYPH_CACHE_DATA(entry);
+  for (int cy=0;cy<entry->height;cy++, row+=stride) {
+    int cx = 0;
+    while (cx<entry->width) {
+      // skip empty pixels (whole bytes at a time if we can)
+      if (!(cx&7) && !row[cx>>3]) { cx+=8; continue; }
+      if (!(row[cx>>3] & (0x80>>(cx&7)))) { cx++; continue; }
+      // find the end of the run of set pixels
+      int start = cx;
+      while (cx<entry->width && (row[cx>>3] & (0x80>>(cx&7)))) cx++;
+      graphicsFillRectDevice(gfx, x+start, y+cy, x+cx-1, y+cy, gfx->data.fgColor);
+    }
+  }
+}
+
+// Returns a table of the unscaled width of every character, as used by graphicsVectorCharWidthFromTable
+const uint8_t *graphicsVectorCharWidths(JsVar *cache) {
+  GlyphCacheKey key;
+  glyphCacheKeyInit(&key, GLYPH_CACHE_FONT_VECTOR, 0, 0);
+  key.flags = GLYPH_CACHE_WIDTHS;
+  GlyphCacheEntry *entry = glyphCacheFind(cache, &key);
+  if (entry) return GLYPH_CACHE_DATA(entry);
+  entry = glyphCacheAdd(cache, &key, 256);
+  if (!entry) return 0;
+  uint8_t *widths = GLYPH_CACHE_DATA(entry);
+  // Get the width of each polygon, then each character is the widest of its polygons
+  uint8_t polyWidths[sizeof(vfPolyLengths)];
+  const uint8_t *p = vfPolyVerts;
+  for (unsigned int i=0;i<sizeof(vfPolyLengths);i++) {
+    int w = 0;
+    for (int j=0;j<vfPolyLengths[i];j++) {
+      int vx = p[j] % VF_CHAR_WIDTH;
+      if (vx>w) w=vx;
+    }
+    polyWidths[i] = (uint8_t)w;
+    p += vfPolyLengths[i];
+  }
+  memset(widths, 0, 256);
+  p = vfCharPolys;
+  for (int ch=vfFirstChar;ch<=vfLastChar;ch++) {
+    int charLen = vfCharLengths[ch-vfFirstChar];
+    int w = 0;
+    for (int i=0;i<charLen;i++)
+      if (polyWidths[p[i]]>w) w=polyWidths[p[i]];
+    widths[ch] = (uint8_t)(w+1+VF_CHAR_SPACING);
+    p += charLen;
+  }
+  return widths;
+}
+
+// returns the width of a character from the table returned by graphicsVectorCharWidths
+unsigned int graphicsVectorCharWidthFromTable(const uint8_t *widths, unsigned int sizex, char ch) {
+  unsigned int w = widths[(unsigned char)ch];
+  if (!w) return sizex/2; // space
+  return (w*sizex*16/VF_SCALE+7)>>4;
+}
+#endif
+
 // prints character, returns width
 unsigned int graphicsFillVectorChar(JsGraphics *gfx, int x1, int y1, int sizex, int sizey, char ch) {
   int charLen;
   const uint8_t *charPtr = vfGetCharPtr(ch, &charLen);
   if (!charPtr) return (unsigned int)(sizex/2); // space
+#ifdef USE_GLYPH_CACHE
+  JsVar *cache = glyphCacheGet(true);
+  if (cache) {
+    GlyphCacheKey key;
+    glyphCacheKeyInit(&key, GLYPH_CACHE_FONT_VECTOR, 0, ch);
+    key.sizex = (uint16_t)sizex;
+    key.sizey = (uint16_t)sizey;
+    key.flags = (uint8_t)(gfx->data.flags & JSGRAPHICSFLAGS_MAPPEDXY);
+    GlyphCacheEntry *entry = glyphCacheFind(cache, &key);
+    if (!entry) entry = vfCacheChar(cache, &key, sizex, sizey, charPtr, charLen);
+    if (entry) {
+      vfDrawCachedChar(gfx, x1, y1, entry);
+      unsigned int w = entry->advance;
+      jsvUnLock(cache);
+      return w;
+    }
+    jsvUnLock(cache);
+  }
+#endif
   return vfDrawCharPtr(gfx, x1, y1, sizex, sizey, charPtr, charLen);
 }
 
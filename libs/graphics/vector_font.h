@@ -14,9 +14,16 @@
 
 #ifndef NO_VECTOR_FONT
 #include "graphics.h"
+#include "glyph_cache.h"
 
 // returns the width of a character
 unsigned int graphicsVectorCharWidth(JsGraphics *gfx, unsigned int sizex, char ch);
+#ifdef USE_GLYPH_CACHE
+// returns a table of the unscaled width of every character (from the glyph cache), for graphicsVectorCharWidthFromTable
+const uint8_t *graphicsVectorCharWidths(JsVar *cache);
+// returns the width of a character from the table returned by graphicsVectorCharWidths
+unsigned int graphicsVectorCharWidthFromTable(const uint8_t *widths, unsigned int sizex, char ch);
+#endif
 // prints character, returns width
 unsigned int graphicsFillVectorChar(JsGraphics *gfx, int x1, int y1, int sizex, int sizey, char ch);
 #endif
@@ -96,6 +96,15 @@ The URL requested in this HTTP request, for instance:
 * `"/"` - the main page
 * `"/favicon.ico"` - the web page's icon
 *//*Documentation only*/
+/*JSON{
+    "type" : "property",
+    "class" : "httpSRq",
+    "name" : "httpVersion",
+    "generate" : false,
+    "return" : ["JsVar", "A string" ]
+}
+The HTTP version sent by the client - usually `"1.1"`
+*//*Documentation only*/
 
 /*JSON{
   "type" : "method",
@@ -301,6 +310,12 @@ Pipe this to a stream (an object with a 'write' method)
 Create an HTTP Server
 
 When a request to the server is made, the callback is called. In the callback you can use the methods on the response (`httpSRs`) to send data. You can also add `request.on('data',function() { ... })` to listen for POSTed data
+
+If the client asks for it (the default for HTTP/1.1) and the response has a `Content-Length`
+or is `Transfer-Encoding: chunked`, the connection is kept open after the response for
+further requests (which can be pipelined). Otherwise `Connection: close` is sent.
+Responses to HTTP/1.1 clients with neither header are sent `Transfer-Encoding: chunked`
+automatically, so they can still be kept alive.
 */
 
 JsVar *jswrap_http_createServer(JsVar *callback) {
@@ -335,7 +350,8 @@ var options = {
     path: '/',           // path sent to server
     method: 'GET',       // HTTP command sent to server (must be uppercase 'GET', 'POST', etc)
     protocol: 'http:',   // optional protocol - https: or http:
-    headers: { key : value, key : value } // (optional) HTTP headers
+    headers: { key : value, key : value }, // (optional) HTTP headers
+    keepAlive: false     // (optional) if true, keep the connection open afterwards so other requests to the same server can use it
   };
 var req = require("http").request(options, function(res) {
   res.on('data', function(data) {
@@ -353,6 +369,11 @@ You can easily pre-populate `options` from a URL using `var options = url.parse(
 
 There's an example of using [`http.request` for HTTP POST here](/Internet#http-post)
 
+With `keepAlive:true`, once the response has been received the connection is kept
+open (for up to 5 seconds) and reused by the next `keepAlive` request to the same
+host and port. Requests made while one is already in progress are pipelined - sent
+straight away on the same connection, with the responses received in order.
+
 **Note:** if TLS/HTTPS is enabled, options can have `ca`, `key` and `cert` fields. See `tls.connect` for
 more information about these and how to use them.
 
@@ -494,6 +515,42 @@ void jswrap_httpSRs_end(JsVar *parent, JsVar *data) {
 }
 
 
+/*JSON{
+  "type" : "method",
+  "class" : "httpSRs",
+  "name" : "sendFile",
+  "generate" : "jswrap_httpSRs_sendFile",
+  "params" : [
+    ["filename","JsVar","The name of a file in Storage"]
+  ],
+  "return" : ["bool","`true` if the file was found and is being sent, `false` if it doesn't exist"]
+}
+Send the contents of a file from `require("Storage")` as the response, and then
+end it. If headers haven't been sent yet this is done with status code 200 and a
+`Content-Length` header, otherwise the data is appended to what has already been
+written.
+
+The file is read from flash memory (and decompressed if it was written with
+`{compress:true}`) a chunk at a time as the socket is ready for it, so even large
+files can be sent without using much RAM. If the file is erased or changed before
+it has all been sent, the connection is closed early.
+
+```
+require("http").createServer(function (req, res) {
+  if (!res.sendFile(req.url.substr(1))) {
+    res.writeHead(404);
+    res.end("Not found");
+  }
+}).listen(8080);
+```
+
+**Note:** This only sends files written with `require("Storage").write`, not
+`StorageFile`s created with `require("Storage").open`.
+*/
+bool jswrap_httpSRs_sendFile(JsVar *parent, JsVar *filename) {
+  return serverResponseSendFile(parent, filename);
+}
+
 /*JSON{
   "type" : "method",
   "class" : "httpSRs",
@@ -23,6 +23,7 @@ void jswrap_httpSRs_setHeader(JsVar *parent, JsVar *name, JsVar *value);
 void jswrap_httpSRs_writeHead(JsVar *parent, int statusCode, JsVar *headers);
 bool jswrap_httpSRs_write(JsVar *parent, JsVar *data);
 void jswrap_httpSRs_end(JsVar *parent, JsVar *data);
+bool jswrap_httpSRs_sendFile(JsVar *parent, JsVar *filename);
 
 bool jswrap_httpCRq_write(JsVar *parent, JsVar *data);
 void jswrap_httpCRq_end(JsVar *parent, JsVar *data);
@@ -28,6 +28,7 @@
   #include <sys/select.h>
   #include <arpa/inet.h>
   #include <netinet/in.h>
+  #include <netinet/tcp.h>
   #include <resolv.h>
  #endif
  #include <sys/socket.h>
@@ -42,6 +43,38 @@
 
 #define closesocket(SOCK) close(SOCK)
 
+#ifdef LINUX
+#include "jshardware_linux.h"
+#endif
+#ifdef USE_EPOLL
+/* Rather than polling each socket with select, we try to read/write and if
+ * the socket isn't ready we ask the input thread to wake us when it is. */
+/// Bitmap of sockets whose last send couldn't complete, so we also need waking when they're writable
+static uint8_t sendBlocked[FD_SETSIZE/8];
+static bool net_linux_isSendBlocked(int sckt) {
+  return sckt<FD_SETSIZE && (sendBlocked[sckt>>3] & (1<<(sckt&7)));
+}
+static void net_linux_setSendBlocked(int sckt, bool blocked) {
+  if (sckt>=FD_SETSIZE) return;
+  if (blocked) sendBlocked[sckt>>3] |= (uint8_t)(1<<(sckt&7));
+  else sendBlocked[sckt>>3] &= (uint8_t)~(1<<(sckt&7));
+}
+/// Nothing more to do on this socket for now - wake the idle loop when there is
+static void net_linux_watch(int sckt) {
+  jshLinuxWatchSocket(sckt, net_linux_isSendBlocked(sckt));
+}
+#endif
+
+/* We combine small writes ourselves before sending (see socketSendData), so Nagle's
+ * algorithm would only delay replies (eg. pipelined HTTP responses) waiting for an ACK */
+static void net_linux_setNoDelay(int sckt) {
+#ifdef TCP_NODELAY
+  int optval = 1;
+  if (setsockopt(sckt,IPPROTO_TCP,TCP_NODELAY,(const char *)&optval,sizeof(optval))<0)
+    jsWarn("setsockopt(TCP_NODELAY) failed\n");
+#endif
+}
+
 #if NET_DBG > 0
  #include "jsinteractive.h"
  #define DBG(format, ...) jsiConsolePrintf(format, ## __VA_ARGS__)
@@ -116,6 +149,7 @@ int net_linux_createsocket(JsNetwork *net, SocketType socketType, uint32_t host,
          return -1;
        }
       }
+      net_linux_setNoDelay(sckt);
     }
 
   } else { // ------------------------------------------------- no host (=server)
@@ -174,6 +208,11 @@ int net_linux_createsocket(JsNetwork *net, SocketType socketType, uint32_t host,
         setsockopt (sckt, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
     }
 
+#ifdef USE_EPOLL
+    // we accept/recv without checking first, so we must never block
+    fcntl(sckt, F_SETFL, fcntl(sckt, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
     if (scktType == SOCK_STREAM) { // only for TCP
       // Make the socket listen
       nret = listen(sckt, 10); // 10 connections (but this ignored on CC30000)
@@ -205,6 +244,10 @@ int net_linux_createsocket(JsNetwork *net, SocketType socketType, uint32_t host,
 /// destroys the given socket
 void net_linux_closesocket(JsNetwork *net, int sckt) {
   NOT_USED(net);
+#ifdef USE_EPOLL
+  jshLinuxUnwatchSocket(sckt);
+  net_linux_setSendBlocked(sckt, false);
+#endif
   closesocket(sckt);
 }
 
@@ -212,6 +255,12 @@ void net_linux_closesocket(JsNetwork *net, int sckt) {
 int net_linux_accept(JsNetwork *net, int sckt) {
   NOT_USED(net);
   // TODO: look for unreffed servers?
+#ifdef USE_EPOLL
+  int theClient = accept(sckt,0,0);
+  if (theClient<0) net_linux_watch(sckt);
+  else net_linux_setNoDelay(theClient);
+  return theClient;
+#else
   fd_set s;
   FD_ZERO(&s);
   FD_SET(sckt,&s);
@@ -223,9 +272,11 @@ int net_linux_accept(JsNetwork *net, int sckt) {
   if (n>0) {
     // we have a client waiting to connect... try to connect and see what happens
     int theClient = accept(sckt,0,0);
+    if (theClient>=0) net_linux_setNoDelay(theClient);
     return theClient;
   }
   return -1;
+#endif
 }
 
 /// Receive data if possible. returns nBytes on success, 0 on no data, or -1 on failure
@@ -234,6 +285,27 @@ int net_linux_recv(JsNetwork *net, SocketType socketType, int sckt, void *buf, s
   struct sockaddr_in fromAddr;
   int fromAddrLen = sizeof(fromAddr);
   int num = 0;
+#ifdef USE_EPOLL
+  if (socketType & ST_UDP) {
+    JsNetUDPPacketHeader *header = (JsNetUDPPacketHeader*)buf;
+    num = (int)recvfrom(sckt,buf+sizeof(JsNetUDPPacketHeader),len-sizeof(JsNetUDPPacketHeader),MSG_DONTWAIT,(struct sockaddr *)&fromAddr,(socklen_t*)&fromAddrLen);
+    if (num>=0) {
+      *(in_addr_t*)&header->host = fromAddr.sin_addr.s_addr;
+      header->port = ntohs(fromAddr.sin_port);
+      header->length = (uint16_t)num;
+      DBG("Recv %d %x:%d", num, *(uint32_t*)&header->host, header->port);
+      num += sizeof(JsNetUDPPacketHeader);
+    }
+  } else {
+    num = (int)recv(sckt,buf,len,MSG_DONTWAIT);
+    if (num==0) return -1; // recv returning 0 means connection is closed
+  }
+  if (num<0) {
+    if (errno!=EAGAIN && errno!=EWOULDBLOCK) return -1;
+    net_linux_watch(sckt);
+    num = 0;
+  }
+#else
   fd_set s;
   FD_ZERO(&s);
   FD_SET(sckt,&s);
@@ -262,6 +334,7 @@ int net_linux_recv(JsNetwork *net, SocketType socketType, int sckt, void *buf, s
       if (num==0) return -1; // select says data, but recv says 0 means connection is closed
     }
   }
+#endif
 
   return num;
 }
@@ -269,6 +342,9 @@ int net_linux_recv(JsNetwork *net, SocketType socketType, int sckt, void *buf, s
 /// Send data if possible. returns nBytes on success, 0 on no data, or -1 on failure
 int net_linux_send(JsNetwork *net, SocketType socketType, int sckt, const void *buf, size_t len) {
   NOT_USED(net);
+#ifdef USE_EPOLL
+  int n;
+#else
   fd_set writefds;
   FD_ZERO(&writefds);
   FD_SET(sckt, &writefds);
@@ -279,8 +355,13 @@ int net_linux_send(JsNetwork *net, SocketType socketType, int sckt, const void *
   if (n==SOCKET_ERROR ) {
      // we probably disconnected so just get rid of this
     return -1;
-  } else if (FD_ISSET(sckt, &writefds)) {
+  } else if (FD_ISSET(sckt, &writefds))
+#endif
+  {
     int flags = 0;
+#ifdef USE_EPOLL
+    flags |= MSG_DONTWAIT;
+#endif
 #if !defined(SO_NOSIGPIPE) && defined(MSG_NOSIGNAL)
     flags |= MSG_NOSIGNAL;
 #endif
@@ -293,13 +374,24 @@ int net_linux_send(JsNetwork *net, SocketType socketType, int sckt, const void *
 
       DBG("Send %d %x:%d", len - sizeof(JsNetUDPPacketHeader), header->host, header->port);
       n = (int)sendto(sckt, buf + sizeof(JsNetUDPPacketHeader), header->length, flags, (struct sockaddr *)&sin, sizeof(sockaddr_in));
-      n += sizeof(JsNetUDPPacketHeader);
+      if (n>=0) n += sizeof(JsNetUDPPacketHeader);
     } else {
       n = (int)send(sckt, buf, len, flags);
     }
+#ifdef USE_EPOLL
+    bool blocked = n<0 && (errno==EAGAIN || errno==EWOULDBLOCK);
+    net_linux_setSendBlocked(sckt, blocked);
+    if (blocked) {
+      net_linux_watch(sckt); // wake us when we can send more
+      return 0;
+    }
+#endif
     return n;
-  } else
+  }
+#ifndef USE_EPOLL
+  else
     return 0; // just not ready
+#endif
 }
 
 void netSetCallbacks_linux(JsNetwork *net) {
@@ -312,4 +404,7 @@ void netSetCallbacks_linux(JsNetwork *net) {
   net->recv = net_linux_recv;
   net->send = net_linux_send;
   net->chunkSize = 536;
+#ifdef USE_EPOLL
+  net->canSleep = true;
+#endif
 }
@@ -66,6 +66,7 @@ typedef struct JsNetwork {
   unsigned char _blank; ///< this is needed as jsvGetString for 'data' wants to add a trailing zero  
 
   int chunkSize; ///< Amount of memory to allocate for chunks of data when using send/recv
+  bool canSleep; ///< If true, the idle loop gets woken when a socket needs attention - so we don't have to keep polling while sockets are open
 
   /// Called on idle. Do any checks required for this device
   void (*idle)(struct JsNetwork *net);
@@ -20,6 +20,7 @@
 #include "jswrap_stream.h"
 #include "jswrap_string.h"
 #include "jswrap_functions.h"
+#include "jsflash.h"
 
 #define HTTP_NAME_SOCKETTYPE "type" // normal socket or HTTP
 #define HTTP_NAME_PORT "port"
@@ -28,7 +29,8 @@
 #define HTTP_NAME_ENDED "endd"
 #define HTTP_NAME_RECEIVE_DATA "dRcv"
 #define HTTP_NAME_RECEIVE_COUNT "cRcv"
-#define HTTP_NAME_SEND_DATA "dSnd"
+#define HTTP_NAME_SEND_DATA "dSnd" // array of strings waiting to be sent
+#define HTTP_NAME_SEND_OFFSET "oSnd" // how much of the first string in HTTP_NAME_SEND_DATA has already been sent
 #define HTTP_NAME_RESPONSE_VAR "res"
 #define HTTP_NAME_OPTIONS_VAR "opt"
 #define HTTP_NAME_SERVER_VAR "svr"
@@ -37,6 +39,16 @@
 #define HTTP_NAME_CLOSENOW "clsNow"  // boolean: gotta close
 #define HTTP_NAME_CONNECTED "conn"     // boolean: we are connected
 #define HTTP_NAME_CLOSE "cls"        // close after sending
+#define HTTP_NAME_KEEPALIVE "kA"     // boolean: keep the socket open for another request after this one
+#define HTTP_NAME_HOST_KEY "hKey"    // type/address/port of a keep-alive client socket, so it can be reused
+#define HTTP_NAME_TIME "time"        // when a keep-alive client socket became idle
+#define HTTP_NAME_PARSE_POS "hPos"   // how far through the received data we've looked for the end of the headers
+#define HTTP_NAME_PARSE_LINE "hLin"  // where the header line we're looking at started
+#define HTTP_NAME_CAN_CHUNK "cChk"   // boolean: the client can accept a 'Transfer-Encoding: chunked' response
+#define HTTP_NAME_FILE_NAME "fNam"   // name of the Storage file we're sending with res.sendFile
+#define HTTP_NAME_FILE_OFFSET "fOfs" // how much of the file we have queued so far
+#define HTTP_NAME_FILE_LENGTH "fLen" // the file's (uncompressed) length when we started sending it
+#define HTTP_NAME_FILE_DATA "fDat"   // native/flash string pointing at the file in flash, so compaction keeps it up to date
 #define HTTP_NAME_ON_CONNECT JS_EVENT_PREFIX"connect"
 #define HTTP_NAME_ON_CLOSE JS_EVENT_PREFIX"close"
 #define HTTP_NAME_ON_END JS_EVENT_PREFIX"end"
@@ -48,6 +60,15 @@
 #define HTTP_ARRAY_HTTP_CLIENT_CONNECTIONS "HttpCC"
 #define HTTP_ARRAY_HTTP_SERVERS "HttpS"
 #define HTTP_ARRAY_HTTP_SERVER_CONNECTIONS "HttpSC"
+#define HTTP_ARRAY_HTTP_CLIENT_IDLE "HttpCI" // keep-alive client sockets waiting to be reused
+
+#define HTTP_KEEPALIVE_IDLE_TIMEOUT 5000 // milliseconds before an unused keep-alive client socket is closed
+
+/// res.sendFile reads this much of the file into RAM each time the send queue empties
+#define HTTP_SEND_FILE_CHUNK 1024
+
+/// Small writes are appended to the last string in the send queue (up to this length) so we don't send lots of tiny packets
+#define SOCKET_SEND_MERGE_LENGTH 512
 
 #ifdef ESP8266
 // esp8266 debugging, need to remove this eventually
@@ -71,6 +92,13 @@ static ALWAYS_INLINE bool compareTransferEncodingAndUnlock(JsVar *encoding, char
     return jsvIsStringIEqualAndUnLock(encoding, value);
 }
 
+static bool httpHasHeader(JsVar *headerObject, const char *name) {
+  JsVar *header = jsvObjectGetChildI(headerObject, name);
+  bool hasHeader = header!=0;
+  jsvUnLock(header);
+  return hasHeader;
+}
+
 static void httpAppendHeaders(JsVar *string, JsVar *headerObject) {
   // append headers
   JsvObjectIterator it;
@@ -90,76 +118,113 @@ static void httpAppendHeaders(JsVar *string, JsVar *headerObject) {
   // free headers
 }
 
-// httpParseHeaders(&receiveData, reqVar, true) // server
-// httpParseHeaders(&receiveData, resVar, false) // client
+/// Parse the first line of an HTTP request ("GET /url HTTP/1.1") or response ("HTTP/1.1 200 OK") between start and end
+static void httpParseFirstLine(JsVar *receiveData, size_t start, size_t end, JsVar *objectForData, bool isServer) {
+  size_t firstSpace = end;
+  size_t secondSpace = end;
+  size_t i;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, receiveData, start);
+  for (i=start;i<end;i++) {
+    if (jsvStringIteratorGetCharAndNext(&it)==' ') {
+      if (firstSpace==end) firstSpace = i;
+      else { secondSpace = i; break; }
+    }
+  }
+  jsvStringIteratorFree(&it);
+  size_t afterFirst = (firstSpace<end) ? firstSpace+1 : end;
+  size_t afterSecond = (secondSpace<end) ? secondSpace+1 : end;
+  if (isServer) {
+    jsvObjectSetChildAndUnLock(objectForData, "method", jsvNewFromStringVar(receiveData, start, firstSpace-start));
+    jsvObjectSetChildAndUnLock(objectForData, "url", jsvNewFromStringVar(receiveData, afterFirst, secondSpace-afterFirst));
+    if (afterSecond+5 < end) // skip 'HTTP/'
+      jsvObjectSetChildAndUnLock(objectForData, "httpVersion", jsvNewFromStringVar(receiveData, afterSecond+5, end-(afterSecond+5)));
+  } else {
+    if (start+5 < firstSpace) // skip 'HTTP/'
+      jsvObjectSetChildAndUnLock(objectForData, "httpVersion", jsvNewFromStringVar(receiveData, start+5, firstSpace-(start+5)));
+    jsvObjectSetChildAndUnLock(objectForData, "statusCode", jsvNewFromStringVar(receiveData, afterFirst, secondSpace-afterFirst));
+    jsvObjectSetChildAndUnLock(objectForData, "statusMessage", jsvNewFromStringVar(receiveData, afterSecond, end-afterSecond));
+  }
+}
+
+/// Parse a 'Key: Value' header line between start and end, and add it to the headers object
+static void httpParseHeaderLine(JsVar *receiveData, size_t start, size_t end, JsVar *vHeaders) {
+  size_t colonPos = end;
+  size_t valueStart = end;
+  size_t i;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, receiveData, start);
+  for (i=start;i<end;i++) {
+    char ch = jsvStringIteratorGetCharAndNext(&it);
+    if (colonPos==end) {
+      if (ch==':') colonPos = i;
+    } else if (ch!=' ' && ch!='\t') {
+      valueStart = i;
+      break;
+    }
+  }
+  jsvStringIteratorFree(&it);
+  if (colonPos==end || colonPos==start) return; // not a header
+  JsVar *hVal = jsvNewFromStringVar(receiveData, valueStart, end-valueStart);
+  JsVar *hKey = jsvNewFromEmptyString();
+  if (hKey) {
+    jsvMakeIntoVariableName(hKey, hVal);
+    jsvAppendStringVar(hKey, receiveData, start, colonPos-start);
+    jsvAddName(vHeaders, hKey);
+    jsvUnLock(hKey);
+  }
+  jsvUnLock(hVal);
+}
+
+/* Parse HTTP headers as they arrive. We store how far through receiveData we got
+ * (and where the current line started) in objectForData, so each packet only
+ * gets scanned once, and each line is parsed as soon as it is complete.
+ * Returns true when all the headers have been received (and removed from receiveData)
+ *
+ * httpParseHeaders(&receiveData, reqVar, true) // server
+ * httpParseHeaders(&receiveData, resVar, false) // client */
 bool httpParseHeaders(JsVar **receiveData, JsVar *objectForData, bool isServer) {
-  // find /r/n/r/n
-  int newlineIdx = 0;
-  int strIdx = 0;
-  int headerEnd = -1;
+  size_t strIdx = (size_t)jsvGetIntegerAndUnLock(jsvObjectGetChild(objectForData, HTTP_NAME_PARSE_POS, 0));
+  size_t lineStart = (size_t)jsvGetIntegerAndUnLock(jsvObjectGetChild(objectForData, HTTP_NAME_PARSE_LINE, 0));
+  JsVar *vHeaders = jsvObjectGetChild(objectForData, HTTP_NAME_HEADERS, 0); // only created after the first line
+  char lastCh = strIdx ? jsvGetCharInString(*receiveData, strIdx-1) : 0;
+  size_t headerEnd = 0;
   JsvStringIterator it;
-  jsvStringIteratorNew(&it, *receiveData, 0);
+  jsvStringIteratorNew(&it, *receiveData, strIdx);
   while (jsvStringIteratorHasChar(&it)) {
     char ch = jsvStringIteratorGetCharAndNext(&it);
-    if (ch == '\r') {
-      if (newlineIdx==0) newlineIdx=1;
-      else if (newlineIdx==2) newlineIdx=3;
-    } else if (ch == '\n') {
-      if (newlineIdx==1) newlineIdx=2;
-      else if (newlineIdx==3) {
-        headerEnd = strIdx+1;
-        break;
-      }
-    } else newlineIdx=0;
     strIdx++;
-  }
-  jsvStringIteratorFree(&it);
-  // skip if we have no header
-  if (headerEnd<0) return false;
-  // Now parse the header
-  JsVar *vHeaders = jsvNewObject();
-  if (!vHeaders) return true;
-  jsvUnLock(jsvAddNamedChild(objectForData, vHeaders, HTTP_NAME_HEADERS));
-  strIdx = 0;
-  int firstSpace = -1;
-  int secondSpace = -1;
-  int firstEOL = -1;
-  int lineNumber = 0;
-  int lastLineStart = 0;
-  int colonPos = 0;
-  //jsiConsolePrintStringVar(receiveData);
-  jsvStringIteratorNew(&it, *receiveData, 0);
-    while (jsvStringIteratorHasChar(&it)) {
-      char ch = jsvStringIteratorGetCharAndNext(&it);
-      if (ch==' ' || ch=='\r') {
-        if (firstSpace<0) firstSpace = strIdx;
-        else if (secondSpace<0) secondSpace = strIdx;
-      }
-      if (ch == ':' && colonPos<0) colonPos = strIdx;
-      if (ch == '\r') {
-        if (firstEOL<0) firstEOL=strIdx;
-        if (lineNumber>0 && colonPos>lastLineStart && lastLineStart<strIdx) {
-          JsVar *hVal = jsvNewFromEmptyString();
-          if (hVal)
-            jsvAppendStringVar(hVal, *receiveData, (size_t)colonPos+2, (size_t)(strIdx-(colonPos+2)));
-          JsVar *hKey = jsvNewFromEmptyString();
-          if (hKey) {
-            jsvMakeIntoVariableName(hKey, hVal);
-            jsvAppendStringVar(hKey, *receiveData, (size_t)lastLineStart, (size_t)(colonPos-lastLineStart));
-            jsvAddName(vHeaders, hKey);
-            jsvUnLock(hKey);
-          }
-          jsvUnLock(hVal);
+    if (ch=='\n') {
+      size_t lineEnd = strIdx-1;
+      if (lastCh=='\r' && lineEnd>lineStart) lineEnd--;
+      if (lineEnd==lineStart) {
+        // an empty line - the end of the headers (or a stray newline before a request)
+        if (vHeaders) {
+          headerEnd = strIdx;
+          break;
         }
-        lineNumber++;
-        colonPos=-1;
-      }
-      if (ch == '\r' || ch == '\n') {
-        lastLineStart = strIdx+1;
+      } else if (!vHeaders) {
+        vHeaders = jsvNewObject();
+        if (!vHeaders) break; // out of memory
+        jsvObjectSetChild(objectForData, HTTP_NAME_HEADERS, vHeaders);
+        httpParseFirstLine(*receiveData, lineStart, lineEnd, objectForData, isServer);
+      } else {
+        httpParseHeaderLine(*receiveData, lineStart, lineEnd, vHeaders);
       }
-      strIdx++;
+      lineStart = strIdx;
     }
-    jsvStringIteratorFree(&it);
+    lastCh = ch;
+  }
+  jsvStringIteratorFree(&it);
+  if (!headerEnd) {
+    // skip if we don't have all the headers yet - carry on from here next time
+    jsvObjectSetChildAndUnLock(objectForData, HTTP_NAME_PARSE_POS, jsvNewFromInteger((JsVarInt)strIdx));
+    jsvObjectSetChildAndUnLock(objectForData, HTTP_NAME_PARSE_LINE, jsvNewFromInteger((JsVarInt)lineStart));
+    jsvUnLock(vHeaders);
+    return false;
+  }
+  jsvObjectRemoveChild(objectForData, HTTP_NAME_PARSE_POS);
+  jsvObjectRemoveChild(objectForData, HTTP_NAME_PARSE_LINE);
   // flag the req/response if Transfer-Encoding:chunked was set
   JsVarInt contentToReceive;
   if (compareTransferEncodingAndUnlock(jsvObjectGetChildI(vHeaders, "Transfer-Encoding"), "chunked")) {
@@ -170,35 +235,26 @@ bool httpParseHeaders(JsVar **receiveData, JsVar *objectForData, bool isServer)
   }
   jsvObjectSetChildAndUnLock(objectForData, HTTP_NAME_RECEIVE_COUNT, jsvNewFromInteger(contentToReceive));
   jsvUnLock(vHeaders);
-  // try and pull out methods/etc
-  if (isServer) {
-    jsvObjectSetChildAndUnLock(objectForData, "method", jsvNewFromStringVar(*receiveData, 0, (size_t)firstSpace));
-    jsvObjectSetChildAndUnLock(objectForData, "url", jsvNewFromStringVar(*receiveData, (size_t)(firstSpace+1), (size_t)(secondSpace-(firstSpace+1))));
-  } else {
-    jsvObjectSetChildAndUnLock(objectForData, "httpVersion", jsvNewFromStringVar(*receiveData, 5, (size_t)firstSpace-5));
-    jsvObjectSetChildAndUnLock(objectForData, "statusCode", jsvNewFromStringVar(*receiveData, (size_t)(firstSpace+1), (size_t)(secondSpace-(firstSpace+1))));
-    jsvObjectSetChildAndUnLock(objectForData, "statusMessage", jsvNewFromStringVar(*receiveData, (size_t)(secondSpace+1), (size_t)(firstEOL-(secondSpace+1))));
-  }
   // strip out the header
-  JsVar *afterHeaders = jsvNewFromStringVar(*receiveData, (size_t)headerEnd, JSVAPPENDSTRINGVAR_MAXLENGTH);
+  JsVar *afterHeaders = jsvNewFromStringVar(*receiveData, headerEnd, JSVAPPENDSTRINGVAR_MAXLENGTH);
   jsvUnLock(*receiveData);
   *receiveData = afterHeaders;
   return true;
 }
 
-size_t httpStringGet(JsVar *v, char *str, size_t len) {
-  size_t l = len;
-  JsvStringIterator it;
-  jsvStringIteratorNew(&it, v, 0);
-  while (jsvStringIteratorHasChar(&it)) {
-    if (l--==0) {
-      jsvStringIteratorFree(&it);
-      return len;
-    }
-    *(str++) = jsvStringIteratorGetCharAndNext(&it);
-  }
-  jsvStringIteratorFree(&it);
-  return len-l;
+/** Once the headers of a request/response are parsed, can the connection be kept open afterwards?
+ * HTTP/1.1 defaults to keep-alive, HTTP/1.0 only if asked for with 'Connection: keep-alive' */
+static bool httpWantsKeepAlive(JsVar *reader) {
+  JsVar *headers = jsvObjectGetChild(reader, HTTP_NAME_HEADERS, 0);
+  bool keepAlive;
+  if (jsvIsStringIEqualAndUnLock(jsvObjectGetChildI(headers, "Connection"), "close"))
+    keepAlive = false;
+  else if (jsvIsStringIEqualAndUnLock(jsvObjectGetChildI(headers, "Connection"), "keep-alive"))
+    keepAlive = true;
+  else
+    keepAlive = jsvGetFloatAndUnLock(jsvObjectGetChild(reader, "httpVersion", 0)) >= 1.1;
+  jsvUnLock(headers);
+  return keepAlive;
 }
 
 // -----------------------------
@@ -254,51 +310,278 @@ NO_INLINE static void _socketCloseAllConnections(JsNetwork *net) {
   // shut down connections
   _socketCloseAllConnectionsFor(net, HTTP_ARRAY_HTTP_SERVER_CONNECTIONS);
   _socketCloseAllConnectionsFor(net, HTTP_ARRAY_HTTP_CLIENT_CONNECTIONS);
+  _socketCloseAllConnectionsFor(net, HTTP_ARRAY_HTTP_CLIENT_IDLE);
   _socketCloseAllConnectionsFor(net, HTTP_ARRAY_HTTP_SERVERS);
 }
 
-// returns 0 on success and a (negative) error number on failure
-int socketSendData(JsNetwork *net, JsVar *connection, int sckt, JsVar **sendData) {
-  SocketType socketType = socketGetType(connection);
+/// Is there nothing waiting to be sent in this send queue (HTTP_NAME_SEND_DATA)?
+static bool socketSendQueueIsEmpty(JsVar *sendQueue) {
+  return !sendQueue || jsvArrayIsEmpty(sendQueue);
+}
 
-  assert(!jsvIsEmptyString(*sendData));
+/* Add a string to the end of a send queue. Flat and native strings (eg. from
+ * E.toString(arrayBuffer), or a Storage file in memory-mapped flash) are queued as-is
+ * so they can be sent without copying, as are flash strings (a Storage file in SPI
+ * flash) which are read into the send buffer a chunk at a time as they're sent. */
+static void socketSendQueueAppend(JsVar *sendQueue, JsVar *str) {
+  if (!str) return; // out of memory
+  size_t len = jsvGetStringLength(str);
+  if (!len) return;
+  size_t dataLen;
+  if (!jsvGetDataPointer(str, &dataLen) && !jsvIsFlashString(str)) {
+    if (len <= SOCKET_SEND_MERGE_LENGTH) {
+      // Append to the last string if nobody else has a reference to it (so we'd have made it)
+      JsVar *last = jsvGetLastChild(sendQueue) ? jsvSkipNameAndUnLock(jsvLock(jsvGetLastChild(sendQueue))) : 0;
+      bool merged = jsvIsBasicString(last) && jsvGetRefs(last)==1 &&
+                    jsvGetStringLength(last)+len <= SOCKET_SEND_MERGE_LENGTH;
+      if (merged) jsvAppendStringVarComplete(last, str);
+      jsvUnLock(last);
+      if (merged) return;
+    } else {
+      // Big and split over many blocks - copy it once into a flat string so we can send straight from it
+      JsVar *flat = jsvNewFlatStringOfLength((unsigned int)len);
+      if (flat) {
+        jsvGetStringChars(str, 0, jsvGetFlatStringPointer(flat), len);
+        jsvArrayPushAndUnLock(sendQueue, flat);
+        return;
+      }
+    }
+  }
+  jsvArrayPush(sendQueue, str);
+}
 
-  size_t sndBufLen;
-  if ((socketType&ST_TYPE_MASK)==ST_UDP) {
-      sndBufLen = (size_t)jsvGetStringLength(*sendData);
-      if (sndBufLen+1024 > jsuGetFreeStack()) {
+static void socketSendQueueAppendAndUnLock(JsVar *sendQueue, JsVar *str) {
+  socketSendQueueAppend(sendQueue, str);
+  jsvUnLock(str);
+}
+
+/// Append data to the send queue, wrapping it up for 'Transfer-Encoding: chunked' if needed
+static void socketSendQueueAppendData(JsVar *sendQueue, JsVar *str, bool chunked) {
+  // If we asked to send 'chunked' data, we need to wrap it up, prefixed with the length
+  if (chunked)
+    socketSendQueueAppendAndUnLock(sendQueue, jsvVarPrintf("%x\r\n", jsvGetStringLength(str)));
+  socketSendQueueAppend(sendQueue, str);
+  if (chunked)
+    socketSendQueueAppendAndUnLock(sendQueue, jsvNewFromString("\r\n"));
+}
+
+/// Copy as much of the send queue as will fit into buf (starting 'offset' into the first string)
+static size_t socketSendQueueGather(JsVar *sendQueue, size_t offset, char *buf, size_t bufLen) {
+  size_t len = 0;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, sendQueue);
+  while (len<bufLen && jsvObjectIteratorHasValue(&it)) {
+    JsVar *chunk = jsvObjectIteratorGetValue(&it);
+    len += jsvGetStringChars(chunk, offset, &buf[len], bufLen-len);
+    offset = 0;
+    jsvUnLock(chunk);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  return len;
+}
+
+/// Remove 'num' sent bytes from the front of the send queue
+static void socketSendQueueRemove(JsVar *sendQueue, size_t *offset, size_t num) {
+  while (num && !jsvArrayIsEmpty(sendQueue)) {
+    JsVar *chunk = jsvSkipNameAndUnLock(jsvLock(jsvGetFirstChild(sendQueue)));
+    size_t remaining = jsvGetStringLength(chunk) - *offset;
+    jsvUnLock(chunk);
+    if (num < remaining) {
+      *offset += num;
+      return;
+    }
+    jsvUnLock(jsvArrayPopFirst(sendQueue));
+    num -= remaining;
+    *offset = 0;
+  }
+}
+
+/** Find the Storage file we're sending as the response (serverResponseSendFile). fileData points straight at it
+ * in flash and is updated if compaction moves the file, so if the file has been erased or rewritten since we
+ * started (even with the same length) the file we find by name won't be where fileData points - unless compaction
+ * has since moved the new file to exactly where the old one was. Returns the file's address, or 0 if it has gone or changed */
+static uint32_t serverResponseFindFile(JsVar *httpServerResponseVar, JsVar *fileData, JsfFileHeader *header) {
+  JsVar *fileName = jsvObjectGetChild(httpServerResponseVar, HTTP_NAME_FILE_NAME, 0);
+  if (!fileName) return 0;
+  uint32_t addr = jsfFindFile(jsfNameFromVarAndUnLock(fileName), header);
+  if (addr && jsvIsFlashString(fileData)) {
+    if ((size_t)fileData->varData.nativeStr.ptr != addr) addr = 0;
+  } else if (addr && jsvIsNativeString(fileData)) {
+    if ((size_t)fileData->varData.nativeStr.ptr != jshFlashGetMemMapAddress(addr)) addr = 0;
+  } // else flash couldn't be mapped (Linux) so the file was copied into RAM and we can't tell
+  return addr;
+}
+
+/** If a Storage file is being sent as the response (serverResponseSendFile), queue the rest of it, or end the
+ * response if it has all been sent. Returns 0 if there's no file to send, 1 if data was queued, or a (negative)
+ * error number if the file has changed or we're out of memory and we should give up */
+static int serverResponseSendFileNext(JsVar *httpServerResponseVar) {
+  JsVar *fileData = jsvObjectGetChild(httpServerResponseVar, HTTP_NAME_FILE_DATA, 0);
+  if (!fileData) return 0;
+  uint32_t offset = (uint32_t)jsvGetIntegerAndUnLock(jsvObjectGetChild(httpServerResponseVar, HTTP_NAME_FILE_OFFSET, 0));
+  uint32_t length = (uint32_t)jsvGetIntegerAndUnLock(jsvObjectGetChild(httpServerResponseVar, HTTP_NAME_FILE_LENGTH, 0));
+  if (offset >= length) {
+    jsvUnLock(fileData);
+    jsvObjectRemoveChild(httpServerResponseVar, HTTP_NAME_FILE_NAME);
+    jsvObjectRemoveChild(httpServerResponseVar, HTTP_NAME_FILE_DATA);
+    jsvObjectRemoveChild(httpServerResponseVar, HTTP_NAME_FILE_OFFSET);
+    jsvObjectRemoveChild(httpServerResponseVar, HTTP_NAME_FILE_LENGTH);
+    serverResponseEnd(httpServerResponseVar);
+    return 1;
+  }
+  uint32_t len = length - offset;
+  JsVar *data = 0;
+  int error = SOCKET_ERR_NOT_FOUND; // file was erased or rewritten
+  JsfFileHeader header;
+  uint32_t addr = serverResponseFindFile(httpServerResponseVar, fileData, &header);
+#ifdef JSF_COMPRESSED_FILES
+  if (addr && (jsfGetFileFlags(&header)&JSFF_COMPRESSED_BLOCKS)) {
+    // Compressed data can't be sent straight from flash, so decompress it into RAM a chunk at a time
+    if (len > HTTP_SEND_FILE_CHUNK) len = HTTP_SEND_FILE_CHUNK;
+    error = SOCKET_ERR_MEM;
+    data = jsvNewFlatStringOfLength(len);
+    if (data) jsfReadDecompressed(addr, offset, jsvGetFlatStringPointer(data), len);
+  } else
+#endif
+  if (addr) {
+    // Queue all of the file in one go, pointing straight at it in flash (socketSendData checks it hasn't changed before sending)
+    data = jsvLockAgain(fileData);
+  }
+  jsvUnLock(fileData);
+  if (!data) {
+    // We've already promised this data in the headers, so we can't end the response normally
+    jsvObjectSetChildAndUnLock(httpServerResponseVar, HTTP_NAME_CLOSENOW, jsvNewFromBool(true));
+    return error;
+  }
+  serverResponseWrite(httpServerResponseVar, data);
+  jsvUnLock(data);
+  jsvObjectSetChildAndUnLock(httpServerResponseVar, HTTP_NAME_FILE_OFFSET, jsvNewFromInteger((JsVarInt)(offset+len)));
+  return 1;
+}
+
+/// Send as much as we can from the send queue. Returns the number of bytes sent, or a (negative) error number on failure
+int socketSendData(JsNetwork *net, JsVar *connection, int sckt, JsVar *sendQueue) {
+  SocketType socketType = socketGetType(connection);
+  bool isUDP = (socketType&ST_TYPE_MASK)==ST_UDP;
+
+  assert(!socketSendQueueIsEmpty(sendQueue));
+
+  /* If we're sending a Storage file straight from flash, make sure it hasn't been erased or rewritten first.
+   * If it has, drop it (and anything after it) from the queue and send what came before - serverResponseSendFileNext
+   * will then fail and close the connection */
+  JsVar *fileData = jsvObjectGetChild(connection, HTTP_NAME_FILE_DATA, 0);
+  JsVar *fileIndex = fileData ? jsvGetIndexOf(sendQueue, fileData, true/*exact*/) : 0;
+  if (fileIndex) {
+    JsfFileHeader header;
+    if (!serverResponseFindFile(connection, fileData, &header)) {
+      JsVar *last;
+      while ((last = jsvArrayPop(sendQueue))) {
+        jsvUnLock(last);
+        if (last == fileIndex) break;
+      }
+      jsvObjectSetChildAndUnLock(connection, HTTP_NAME_FILE_OFFSET, jsvNewFromInteger(0)); // not sent after all
+      jsvObjectSetChildAndUnLock(connection, HTTP_NAME_CLOSENOW, jsvNewFromBool(true));
+    }
+    jsvUnLock(fileIndex);
+  }
+  jsvUnLock(fileData);
+  if (socketSendQueueIsEmpty(sendQueue)) return SOCKET_ERR_NOT_FOUND;
+
+  size_t offset = (size_t)jsvGetIntegerAndUnLock(jsvObjectGetChild(connection, HTTP_NAME_SEND_OFFSET, 0));
+  char *buf = isUDP ? 0 : alloca((size_t)net->chunkSize); // only used for strings we can't send from directly
+  JsvStringIterator it; // ...which we copy from with an iterator, so we only search for 'offset' once per call
+  bool hasIterator = false;
+  int sent = 0;
+  while (!jsvArrayIsEmpty(sendQueue)) {
+    JsVar *chunk = jsvSkipNameAndUnLock(jsvLock(jsvGetFirstChild(sendQueue)));
+    size_t chunkLen = jsvGetStringLength(chunk);
+    if (!isUDP && chunkLen-offset < (size_t)net->chunkSize && jsvGetFirstChild(sendQueue)!=jsvGetLastChild(sendQueue)) {
+      /* If there's a small string followed by others (eg. HTTP headers then data) copy as
+       * much as we can into one buffer, so it goes in one packet rather than getting held
+       * up by Nagle's algorithm waiting for an ACK */
+      jsvUnLock(chunk);
+      if (hasIterator) jsvStringIteratorFree(&it);
+      hasIterator = false;
+      size_t len = socketSendQueueGather(sendQueue, offset, buf, (size_t)net->chunkSize);
+      int num = netSend(net, socketType, sckt, buf, len);
+      DBG("socketSendData gathered %d -> %d\n", len, num);
+      if (num < 0) return num; // an error occurred
+      sent += num;
+      socketSendQueueRemove(sendQueue, &offset, (size_t)num);
+      if ((size_t)num < len) break; // can't send any more right now
+      continue;
+    }
+    // UDP packets (header+data) have to go in one go
+    size_t len = chunkLen - offset;
+    if (!isUDP && len > (size_t)net->chunkSize) len = (size_t)net->chunkSize;
+    size_t dataLen;
+    char *data = jsvGetDataPointer(chunk, &dataLen);
+    if (data) {
+      data += offset;
+    } else {
+      if (isUDP) {
+        if (len+1024 > jsuGetFreeStack()) {
           jsExceptionHere(JSET_ERROR, "Not enough free stack to send this amount of data");
+          jsvUnLock(chunk);
           return -1;
+        }
+        buf = alloca(len); // we only send one UDP packet per call
       }
-  } else {
-      sndBufLen = (size_t)net->chunkSize;
-  }
-  char *buf = alloca(sndBufLen); // allocate on stack
-
-  size_t bufLen = httpStringGet(*sendData, buf, sndBufLen);
-  int num = netSend(net, socketType, sckt, buf, bufLen);
-  DBG("socketSendData %x:%d (%d -> %d)\n", *(uint32_t*)buf, *(unsigned short*)(buf+sizeof(uint32_t)), bufLen, num);
-  if (num < 0) return num; // an error occurred
-  // Now cut what we managed to send off the beginning of sendData
-  if (num > 0) {
-    JsVar *newSendData = 0;
-    if (num < (int)jsvGetStringLength(*sendData)) {
-      // we didn't send all of it... cut out what we did send
-      newSendData = jsvNewFromStringVar(*sendData, (size_t)num, JSVAPPENDSTRINGVAR_MAXLENGTH);
-    } else {
-      // we sent all of it! Issue a drain event, unless we want to close, then we shouldn't
-      // callback for more data
-      bool wantClose = jsvGetBoolAndUnLock(jsvObjectGetChild(connection,HTTP_NAME_CLOSE,0));
-      if (!wantClose) {
-        jsiQueueObjectCallbacks(connection, HTTP_NAME_ON_DRAIN, &connection, 1);
+#ifdef SPIFLASH_BASE
+      if (jsvIsFlashString(chunk)) {
+        jshFlashRead(buf, (uint32_t)(size_t)chunk->varData.nativeStr.ptr + (uint32_t)offset, (uint32_t)len);
+      } else
+#endif
+      {
+        if (!hasIterator) {
+          jsvStringIteratorNew(&it, chunk, offset);
+          hasIterator = true;
+        }
+        size_t i;
+        for (i=0;i<len;i++)
+          buf[i] = jsvStringIteratorGetCharAndNext(&it);
       }
-      newSendData = jsvNewFromEmptyString();
+      data = buf;
+    }
+    int num = netSend(net, socketType, sckt, data, len);
+    DBG("socketSendData %d -> %d\n", len, num);
+    if (num < 0) { // an error occurred
+      if (hasIterator) jsvStringIteratorFree(&it);
+      jsvUnLock(chunk);
+      return num;
+    }
+    sent += num;
+    offset += (size_t)num;
+    bool finished = (size_t)num < len || isUDP; // can't send any more right now
+    if (offset >= chunkLen || finished) {
+      if (hasIterator) jsvStringIteratorFree(&it);
+      hasIterator = false;
+    }
+    if (offset >= chunkLen) { // sent all of this string - remove it
+      jsvUnLock(jsvArrayPopFirst(sendQueue));
+      offset = 0;
     }
-    jsvUnLock(*sendData);
-    *sendData = newSendData;
+    jsvUnLock(chunk);
+    if (finished) break;
   }
-
-  return 0;
+  if (offset)
+    jsvObjectSetChildAndUnLock(connection, HTTP_NAME_SEND_OFFSET, jsvNewFromInteger((JsVarInt)offset));
+  else
+    jsvObjectRemoveChild(connection, HTTP_NAME_SEND_OFFSET);
+
+  if (sent > 0 && jsvArrayIsEmpty(sendQueue)) {
+    // we sent all of it! If we're sending a file, queue the next part of it
+    int fileSent = serverResponseSendFileNext(connection);
+    if (fileSent < 0) return fileSent;
+    // Otherwise issue a drain event, unless we want to close, then we shouldn't
+    // callback for more data
+    bool wantClose = jsvGetBoolAndUnLock(jsvObjectGetChild(connection,HTTP_NAME_CLOSE,0));
+    if (!fileSent && !wantClose) {
+      jsiQueueObjectCallbacks(connection, HTTP_NAME_ON_DRAIN, &connection, 1);
+    }
+  }
+  return sent;
 }
 
 void socketPushReceiveData(JsVar *reader, JsVar **receiveData, bool isHttp, bool force) {
@@ -309,6 +592,8 @@ void socketPushReceiveData(JsVar *reader, JsVar **receiveData, bool isHttp, bool
 
   JsVar *nextChunk = 0;
   JsVar *partialChunk = 0;
+  JsVarInt contentToReceive = 0;
+  bool updateCount = false; // not chunked, so update HTTP_NAME_RECEIVE_COUNT once the data has been handled
 
   // Keep track of how much we received (so we can close once we have it)
   if (isHttp) {
@@ -330,9 +615,12 @@ void socketPushReceiveData(JsVar *reader, JsVar **receiveData, bool isHttp, bool
       // for 'chunked' set the counter to 1 to read on or 0 if at last chunk
       jsvObjectSetChildAndUnLock(reader, HTTP_NAME_RECEIVE_COUNT, jsvNewFromInteger(chunkLen ? 1 : 0));
       if (!chunkLen) { // no 'data' callback
-        // clear received data
+        // clear received data - but on a keep-alive connection, anything after the final CRLF is the next request/response
+        JsVar *afterChunks = 0;
+        if (jsvGetBoolAndUnLock(jsvObjectGetChild(reader, HTTP_NAME_KEEPALIVE, 0)) && startIdx+4 < len)
+          afterChunks = jsvNewFromStringVar(*receiveData, startIdx+4, JSVAPPENDSTRINGVAR_MAXLENGTH);
         jsvUnLock(*receiveData);
-        *receiveData = 0;
+        *receiveData = afterChunks;
         return;
       }
 
@@ -358,18 +646,36 @@ void socketPushReceiveData(JsVar *reader, JsVar **receiveData, bool isHttp, bool
       jsvUnLock(*receiveData);
       *receiveData = chunkData;
     } else {
-      jsvObjectSetChildAndUnLock(reader, HTTP_NAME_RECEIVE_COUNT,
-        jsvNewFromInteger(
-          jsvGetIntegerAndUnLock(jsvObjectGetChild(reader, HTTP_NAME_RECEIVE_COUNT, JSV_INTEGER)) - (JsVarInt)len)
-        );
+      updateCount = true;
+      contentToReceive = jsvGetIntegerAndUnLock(jsvObjectGetChild(reader, HTTP_NAME_RECEIVE_COUNT, 0));
+      if ((JsVarInt)len > contentToReceive &&
+          jsvGetBoolAndUnLock(jsvObjectGetChild(reader, HTTP_NAME_KEEPALIVE, 0))) {
+        // on a keep-alive connection, anything after the body is the next request/response
+        if (contentToReceive <= 0) return;
+        nextChunk = jsvNewFromStringVar(*receiveData, (size_t)contentToReceive, JSVAPPENDSTRINGVAR_MAXLENGTH);
+        if (!nextChunk) return; // out of memory
+        JsVar *body = jsvNewFromStringVar(*receiveData, 0, (size_t)contentToReceive);
+        if (!body) { // out of memory
+          jsvUnLock(nextChunk);
+          return;
+        }
+        jsvUnLock(*receiveData);
+        *receiveData = body;
+        len = (size_t)contentToReceive;
+      }
+      contentToReceive -= (JsVarInt)len;
     }
   }
 
   // execute 'data' callback or save data
   if (!jswrap_stream_pushData(reader, *receiveData, force)) {
+    if (updateCount && nextChunk) // put back what we split off, so we can try again later
+      jsvAppendStringVarComplete(*receiveData, nextChunk);
     jsvUnLock2(nextChunk, partialChunk);
     return;
   }
+  if (updateCount)
+    jsvObjectSetChildAndUnLock(reader, HTTP_NAME_RECEIVE_COUNT, jsvNewFromInteger(contentToReceive));
 
   // clear received data
   jsvUnLock(*receiveData);
@@ -408,6 +714,48 @@ void socketReceivedUDP(JsVar *connection, JsVar **receiveData) {
   }
 }
 
+/// Has data been received (left over from the last request/response on a keep-alive connection) before we have the headers?
+static bool socketHasUnparsedData(JsVar *reader, JsVar *receiveData) {
+  return receiveData && !jsvIsEmptyString(receiveData) &&
+         !jsvGetBoolAndUnLock(jsvObjectGetChild(reader,HTTP_NAME_HAD_HEADERS,0));
+}
+
+/** Once we have the headers, work out if the connection can be kept open for another request/response
+ * afterwards (and flag HTTP_NAME_KEEPALIVE). This also means we know exactly where the body ends, so
+ * socketPushReceiveData leaves anything after it for the next request/response */
+static void httpCheckKeepAlive(JsVar *connection, JsVar *socket, bool isServer) {
+  bool keepAlive;
+  if (isServer) {
+    keepAlive = httpWantsKeepAlive(connection);
+  } else {
+    // only if we asked for it, and we know where the response ends
+    JsVar *options = jsvObjectGetChild(connection, HTTP_NAME_OPTIONS_VAR, 0);
+    JsVar *headers = jsvObjectGetChild(socket, HTTP_NAME_HEADERS, 0);
+    int statusCode = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(socket, "statusCode", 0));
+    bool noBody = statusCode==204 || statusCode==304 ||
+                  jsvIsStringIEqualAndUnLock(jsvObjectGetChild(options, "method", 0), "HEAD");
+    if (noBody) {
+      jsvObjectRemoveChild(socket, HTTP_NAME_CHUNKED);
+      jsvObjectSetChildAndUnLock(socket, HTTP_NAME_RECEIVE_COUNT, jsvNewFromInteger(0));
+    }
+    keepAlive = jsvGetBoolAndUnLock(jsvObjectGetChild(connection, HTTP_NAME_KEEPALIVE, 0)) &&
+                httpWantsKeepAlive(socket) &&
+                (noBody || httpHasHeader(headers, "Content-Length") || jsvGetBoolAndUnLock(jsvObjectGetChild(socket, HTTP_NAME_CHUNKED, 0)));
+    jsvUnLock2(options, headers);
+  }
+  if (keepAlive) {
+    jsvObjectSetChildAndUnLock(connection, HTTP_NAME_KEEPALIVE, jsvNewFromBool(true));
+    jsvObjectSetChildAndUnLock(socket, HTTP_NAME_KEEPALIVE, jsvNewFromBool(true));
+    // HTTP/1.1 clients have to understand chunked responses (but a response to HEAD has no body at all)
+    if (isServer && jsvGetFloatAndUnLock(jsvObjectGetChild(connection, "httpVersion", 0)) >= 1.1 &&
+        !jsvIsStringIEqualAndUnLock(jsvObjectGetChild(connection, "method", 0), "HEAD"))
+      jsvObjectSetChildAndUnLock(socket, HTTP_NAME_CAN_CHUNK, jsvNewFromBool(true));
+  } else {
+    jsvObjectRemoveChild(connection, HTTP_NAME_KEEPALIVE);
+    jsvObjectRemoveChild(socket, HTTP_NAME_KEEPALIVE);
+  }
+}
+
 void socketReceived(JsVar *connection, JsVar *socket, SocketType socketType, JsVar **receiveData, bool isServer) {
   if ((socketType&ST_TYPE_MASK)==ST_UDP) {
     socketReceivedUDP(connection, receiveData);
@@ -421,6 +769,7 @@ void socketReceived(JsVar *connection, JsVar *socket, SocketType socketType, JsV
       hadHeaders = true;
     } else if (httpParseHeaders(receiveData, reader, isServer)) {
       hadHeaders = true;
+      httpCheckKeepAlive(connection, socket, isServer);
 
       // on connect only when just parsed the HTTP headers
       if (isServer) {
@@ -483,6 +832,30 @@ static bool fireErrorEvent(int error, JsVar *obj1, JsVar *obj2) {
 
 // -----------------------------
 
+/** Create the request and response objects for the next HTTP request the server receives on
+ * the given socket, and add them to the list of connections. Returns the request */
+static JsVar *socketNewHttpServerConnection(JsVar *server, int sckt) {
+  JsVar *req = jspNewObject(0, "httpSRq");
+  JsVar *res = jspNewObject(0, "httpSRs");
+  if (res && req) { // out of memory?
+    socketSetType(req, ST_HTTP);
+    JsVar *arr = socketGetArray(HTTP_ARRAY_HTTP_SERVER_CONNECTIONS, true);
+    if (arr) {
+      jsvArrayPush(arr, req);
+      jsvUnLock(arr);
+    }
+    jsvObjectSetChild(req, HTTP_NAME_RESPONSE_VAR, res);
+    jsvObjectSetChild(req, HTTP_NAME_SERVER_VAR, server);
+    jsvObjectSetChildAndUnLock(req, HTTP_NAME_SOCKET, jsvNewFromInteger(sckt+1));
+    jsvObjectSetChildAndUnLock(res, HTTP_NAME_SOCKET, jsvNewFromInteger(sckt+1));
+  } else {
+    jsvUnLock(req);
+    req = 0;
+  }
+  jsvUnLock(res);
+  return req;
+}
+
 bool socketServerConnectionsIdle(JsNetwork *net) {
   char *buf = alloca((size_t)net->chunkSize); // allocate on stack
 
@@ -490,6 +863,7 @@ bool socketServerConnectionsIdle(JsNetwork *net) {
   if (!arr) return false;
 
   bool hadSockets = false;
+  bool wasBusy = false;
   JsvObjectIterator it;
   jsvObjectIteratorNew(&it, arr);
   while (jsvObjectIteratorHasValue(&it)) {
@@ -503,31 +877,35 @@ bool socketServerConnectionsIdle(JsNetwork *net) {
 
     int sckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(connection,HTTP_NAME_SOCKET,0))-1; // so -1 if undefined
     bool closeConnectionNow = jsvGetBoolAndUnLock(jsvObjectGetChild(connection, HTTP_NAME_CLOSENOW, false));
+    bool keepAlive = false; // the response is finished but we're keeping the socket open for another request
     int error = 0;
 
     if (!closeConnectionNow) {
       int num = netRecv(net, socketType, sckt, buf, (size_t)net->chunkSize);
+      bool pipelined = false; // do we have a request left over from the last one on a keep-alive connection?
       if (num<0) {
         // we probably disconnected so just get rid of this
         closeConnectionNow = true;
         error = num;
       } else {
-        if (num>0) {
-          JsVar *receiveData = jsvObjectGetChild(connection,HTTP_NAME_RECEIVE_DATA,0);
+        JsVar *receiveData = jsvObjectGetChild(connection,HTTP_NAME_RECEIVE_DATA,0);
+        pipelined = isHttp && socketHasUnparsedData(connection, receiveData);
+        if (num>0 || pipelined) {
+          if (num>0) wasBusy = true;
           if (!receiveData) receiveData = jsvNewFromEmptyString();
           if (receiveData) {
             jsvAppendStringBuf(receiveData, buf, (size_t)num);
             socketReceived(connection, socket, socketType, &receiveData, true);
             jsvObjectSetChild(connection,HTTP_NAME_RECEIVE_DATA,receiveData);
-            jsvUnLock(receiveData);
           }
         }
+        jsvUnLock(receiveData);
       }
 
       // send data if possible
       JsVar *sendData = jsvObjectGetChild(socket,HTTP_NAME_SEND_DATA,0);
-      if (sendData && !jsvIsEmptyString(sendData)) {
-        int sent = socketSendData(net, socket, sckt, &sendData);
+      if (!socketSendQueueIsEmpty(sendData)) {
+        int sent = socketSendData(net, socket, sckt, sendData);
         // FIXME? checking for errors is a bit iffy. With the esp8266 network that returns
         // varied error codes we'd want to skip SOCKET_ERR_CLOSED and let the recv side deal
         // with normal closing so we don't miss the tail of what's received, but other drivers
@@ -536,11 +914,11 @@ bool socketServerConnectionsIdle(JsNetwork *net) {
         if (sent < 0) {
           closeConnectionNow = true;
           error = sent;
-        }
-        jsvObjectSetChild(socket, HTTP_NAME_SEND_DATA, sendData); // socketSendData updated sendData
+        } else if (sent > 0)
+          wasBusy = true;
       }
       // only close if we want to close, have no data to send, and aren't receiving data
-      if ((!sendData || jsvIsEmptyString(sendData)) && num<=0) {
+      if (socketSendQueueIsEmpty(sendData) && num<=0 && !pipelined) {
         bool reallyCloseNow = jsvGetBoolAndUnLock(jsvObjectGetChild(socket,HTTP_NAME_CLOSE,0));
         if (isHttp) {
           bool hadHeaders = jsvGetBoolAndUnLock(jsvObjectGetChild(connection,HTTP_NAME_HAD_HEADERS,0));
@@ -552,18 +930,32 @@ bool socketServerConnectionsIdle(JsNetwork *net) {
             jsiQueueObjectCallbacks(connection, HTTP_NAME_ON_END, NULL, 0);
             DBG("ONEND %d (%d)\n", contentToReceive, reallyCloseNow);
           }
+          keepAlive = reallyCloseNow && !error &&
+                      jsvGetBoolAndUnLock(jsvObjectGetChild(socket, HTTP_NAME_KEEPALIVE, 0));
         }
         closeConnectionNow = reallyCloseNow;
-      } else if (num > 0)
+      } else if (num > 0 || pipelined)
         closeConnectionNow = false; // guarantee that anything received is processed
+      // the response couldn't be completed (eg. res.sendFile's file changed) - just close the socket
+      if (isHttp && jsvGetBoolAndUnLock(jsvObjectGetChild(socket, HTTP_NAME_CLOSENOW, false)))
+        closeConnectionNow = true;
       jsvUnLock(sendData);
     }
     if (closeConnectionNow) {
       DBG("CLOSE NOW\n");
+      wasBusy = true;
+
+      // On a keep-alive connection, create new request/response objects for the next request on this socket
+      JsVar *nextConnection = 0;
+      if (keepAlive) {
+        JsVar *server = jsvObjectGetChild(connection, HTTP_NAME_SERVER_VAR, 0);
+        nextConnection = socketNewHttpServerConnection(server, sckt);
+        jsvUnLock(server);
+      }
 
       // send out any data that we were POSTed
       bool hadHeaders = jsvGetBoolAndUnLock(jsvObjectGetChild(connection,HTTP_NAME_HAD_HEADERS,0));
-      if (hadHeaders) {
+      if (hadHeaders && !nextConnection) {
         // execute 'data' callback or save data
         JsVar *receiveData = jsvObjectGetChild(connection,HTTP_NAME_RECEIVE_DATA,0);
         socketPushReceiveData(connection, &receiveData, isHttp, true);
@@ -583,7 +975,14 @@ bool socketServerConnectionsIdle(JsNetwork *net) {
       jsiQueueObjectCallbacks(socket, HTTP_NAME_ON_CLOSE, params, 1);
       jsvUnLock(params[0]);
 
-      _socketConnectionKill(net, connection);
+      if (nextConnection) {
+        // anything else we received is the start of the next request (pipelining) - it's parsed next time around
+        JsVar *receiveData = jsvObjectGetChild(connection,HTTP_NAME_RECEIVE_DATA,0);
+        if (receiveData && !jsvIsEmptyString(receiveData))
+          jsvObjectSetChild(nextConnection,HTTP_NAME_RECEIVE_DATA,receiveData);
+        jsvUnLock2(receiveData, nextConnection);
+      } else
+        _socketConnectionKill(net, connection);
       JsVar *connectionName = jsvObjectIteratorGetKey(&it);
       jsvObjectIteratorNext(&it);
       jsvRemoveChild(arr, connectionName);
@@ -595,9 +994,130 @@ bool socketServerConnectionsIdle(JsNetwork *net) {
   jsvObjectIteratorFree(&it);
   jsvUnLock(arr);
 
-  return hadSockets;
+  return net->canSleep ? wasBusy : hadSockets;
+}
+
+/* Keep-alive HTTP client sockets can have several requests pipelined on them. These are
+ * in HTTP_ARRAY_HTTP_CLIENT_CONNECTIONS in the order they were made, and only the first
+ * one for a socket receives. When its response is complete the socket is passed on to the
+ * next request, or put in HTTP_ARRAY_HTTP_CLIENT_IDLE if there are no more. */
+
+/// Return the client request just before 'connection' that uses the same socket (or 0)
+static JsVar *socketGetRequestAhead(JsVar *arr, JsVar *connection, int sckt) {
+  JsVar *requestAhead = 0;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, arr);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *request = jsvObjectIteratorGetValue(&it);
+    if (request==connection) {
+      jsvUnLock(request);
+      break;
+    }
+    if ((int)jsvGetIntegerAndUnLock(jsvObjectGetChild(request,HTTP_NAME_SOCKET,0))-1 == sckt) {
+      jsvUnLock(requestAhead);
+      requestAhead = request;
+    } else
+      jsvUnLock(request);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  return requestAhead;
+}
+
+/// Return the client request just after 'connection' that uses the same socket (or 0)
+static JsVar *socketGetRequestBehind(JsVar *arr, JsVar *connection, int sckt) {
+  JsVar *requestBehind = 0;
+  bool foundConnection = false;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, arr);
+  while (!requestBehind && jsvObjectIteratorHasValue(&it)) {
+    JsVar *request = jsvObjectIteratorGetValue(&it);
+    if (request==connection)
+      foundConnection = true;
+    else if (foundConnection && (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(request,HTTP_NAME_SOCKET,0))-1 == sckt)
+      requestBehind = jsvLockAgain(request);
+    jsvUnLock(request);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  return requestBehind;
 }
 
+/// Has this client request been ended and completely sent (so a request pipelined behind it can be sent)?
+static bool socketRequestSent(JsVar *connection) {
+  if (!jsvGetBoolAndUnLock(jsvObjectGetChild(connection, HTTP_NAME_CLOSE, false)))
+    return false;
+  JsVar *sendData = jsvObjectGetChild(connection,HTTP_NAME_SEND_DATA,0);
+  bool sent = socketSendQueueIsEmpty(sendData);
+  jsvUnLock(sendData);
+  return sent;
+}
+
+/// The socket of this client request is closing - fail any requests pipelined behind it
+static void socketAbortRequestsBehind(JsVar *arr, JsVar *connection, int sckt) {
+  bool foundConnection = false;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, arr);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *request = jsvObjectIteratorGetValue(&it);
+    if (request==connection) {
+      foundConnection = true;
+      jsvObjectIteratorNext(&it);
+    } else if (foundConnection && (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(request,HTTP_NAME_SOCKET,0))-1 == sckt) {
+      jsvObjectIteratorRemoveAndGotoNext(&it, arr);
+      bool hadError = fireErrorEvent(SOCKET_ERR_NO_RESP, request, NULL);
+      JsVar *response = jsvObjectGetChild(request,HTTP_NAME_RESPONSE_VAR,0);
+      JsVar *params[1] = { jsvNewFromBool(hadError) };
+      if (response) jsiQueueObjectCallbacks(response, HTTP_NAME_ON_CLOSE, params, 1);
+      jsvUnLock2(params[0], response);
+    } else
+      jsvObjectIteratorNext(&it);
+    jsvUnLock(request);
+  }
+  jsvObjectIteratorFree(&it);
+}
+
+/// Put the socket of a finished keep-alive client request into the idle pool so it can be reused
+static void socketAddToIdlePool(JsNetwork *net, JsVar *connection, int sckt) {
+  JsVar *arr = socketGetArray(HTTP_ARRAY_HTTP_CLIENT_IDLE, true);
+  JsVar *idle = jsvNewObject();
+  if (arr && idle) {
+    socketSetType(idle, socketGetType(connection));
+    jsvObjectSetChildAndUnLock(idle, HTTP_NAME_SOCKET, jsvNewFromInteger(sckt+1));
+    jsvObjectSetChildAndUnLock(idle, HTTP_NAME_HOST_KEY, jsvObjectGetChild(connection, HTTP_NAME_HOST_KEY, 0));
+    jsvObjectSetChildAndUnLock(idle, HTTP_NAME_TIME, jsvNewFromLongInteger((long long)jshGetSystemTime()));
+    jsvArrayPush(arr, idle);
+  } else {
+    _socketConnectionKill(net, connection); // out of memory
+  }
+  jsvUnLock2(arr, idle);
+}
+
+/// Close idle keep-alive client sockets that the server has closed (or that haven't been used for a while)
+static bool socketIdlePoolIdle(JsNetwork *net, char *buf) {
+  JsVar *arr = socketGetArray(HTTP_ARRAY_HTTP_CLIENT_IDLE, false);
+  if (!arr) return false;
+  bool wasBusy = false;
+  JsSysTime timeout = jshGetSystemTime() - jshGetTimeFromMilliseconds(HTTP_KEEPALIVE_IDLE_TIMEOUT);
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, arr);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *idle = jsvObjectIteratorGetValue(&it);
+    int sckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(idle,HTTP_NAME_SOCKET,0))-1;
+    JsSysTime time = (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChild(idle,HTTP_NAME_TIME,0));
+    // we don't expect any data, so if we get some (or the socket closed) just close it
+    if (time < timeout || netRecv(net, socketGetType(idle), sckt, buf, (size_t)net->chunkSize)!=0) {
+      _socketConnectionKill(net, idle);
+      jsvObjectIteratorRemoveAndGotoNext(&it, arr);
+      wasBusy = true;
+    } else
+      jsvObjectIteratorNext(&it);
+    jsvUnLock(idle);
+  }
+  jsvObjectIteratorFree(&it);
+  jsvUnLock(arr);
+  return wasBusy;
+}
 
 bool socketClientConnectionsIdle(JsNetwork *net) {
   char *buf = alloca((size_t)net->chunkSize); // allocate on stack
@@ -606,6 +1126,7 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
   if (!arr) return false;
 
   bool hadSockets = false;
+  bool wasBusy = false;
   JsvObjectIterator it;
   jsvObjectIteratorNew(&it, arr);
   while (jsvObjectIteratorHasValue(&it)) {
@@ -620,10 +1141,13 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
     JsVar *receiveData = 0;
 
     bool hadHeaders = false;
+    bool keepAlive = false; // the response is finished but we're keeping the socket open for another request
     int error = 0; // error code received from netXxxx functions
     bool closeConnectionNow = jsvGetBoolAndUnLock(jsvObjectGetChild(connection, HTTP_NAME_CLOSENOW, false));
     bool alreadyConnected = jsvGetBoolAndUnLock(jsvObjectGetChild(connection, HTTP_NAME_CONNECTED, false));
     int sckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(connection,HTTP_NAME_SOCKET,0))-1; // so -1 if undefined
+    // If this request is pipelined behind another on a keep-alive socket, this is the request in front
+    JsVar *requestAhead = (isHttp && sckt>=0) ? socketGetRequestAhead(arr, connection, sckt) : 0;
     if (sckt>=0) {
       if (isHttp)
         hadHeaders = jsvGetBoolAndUnLock(jsvObjectGetChild(socket,HTTP_NAME_HAD_HEADERS,0));
@@ -639,11 +1163,21 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
       if (!closeConnectionNow) {
         JsVar *sendData = jsvObjectGetChild(connection,HTTP_NAME_SEND_DATA,0);
         // send data if possible
-        if (sendData && !jsvIsEmptyString(sendData)) {
+        if (requestAhead) {
+          // wait for the requests in front to be sent, and for our turn to receive a response
+          if (!socketSendQueueIsEmpty(sendData) && socketRequestSent(requestAhead)) {
+            int num = socketSendData(net, connection, sckt, sendData);
+            if (num < 0) {
+              closeConnectionNow = true;
+              error = num;
+            } else if (num > 0)
+              wasBusy = true;
+          }
+        } else if (!socketSendQueueIsEmpty(sendData)) {
           // don't try to send if we're already in error state
           int num = 0;
           if (error == 0) {
-              num = socketSendData(net, connection, sckt, &sendData);
+              num = socketSendData(net, connection, sckt, sendData);
           }
           if (num > 0 && !alreadyConnected && !isHttp) { // whoa, we sent something, must be connected!
             jsiQueueObjectCallbacks(connection, HTTP_NAME_ON_CONNECT, &connection, 1);
@@ -653,8 +1187,8 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
           if (num < 0) {
             closeConnectionNow = true;
             error = num;
-          }
-          jsvObjectSetChild(connection, HTTP_NAME_SEND_DATA, sendData); // socketSendData updated sendData
+          } else if (num > 0)
+            wasBusy = true;
         } else {
           // no data to send, do we want to close? do so.
           if (jsvGetBoolAndUnLock(jsvObjectGetChild(connection, HTTP_NAME_CLOSE, false)))
@@ -668,14 +1202,16 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
               jsiQueueObjectCallbacks(socket, HTTP_NAME_ON_END, NULL, 0);
               DBG("onEnd %d (%d) %d\n", contentToReceive, closeConnectionNow, hadHeaders);
             }
+            keepAlive = closeConnectionNow && jsvGetBoolAndUnLock(jsvObjectGetChild(socket, HTTP_NAME_KEEPALIVE, 0));
           }
         }
-        // Now read data if possible (and we have space for it)
-        int num = netRecv(net, socketType, sckt, buf, (size_t)net->chunkSize);
+        // Now read data if possible (and we have space for it) - only the request at the front of a keep-alive socket gets its response
+        int num = requestAhead ? 0 : netRecv(net, socketType, sckt, buf, (size_t)net->chunkSize);
         if (!alreadyConnected && num == SOCKET_ERR_NO_CONN) {
           ; // ignore... it's just telling us we're not connected yet
         } else if (num < 0) {
           closeConnectionNow = true;
+          keepAlive = false;
           // only error out when the response was not completely received
           if (num == SOCKET_ERR_CLOSED) {
             JsVarInt contentToReceive = jsvGetIntegerAndUnLock(jsvObjectGetChild(socket, HTTP_NAME_RECEIVE_COUNT, 0));
@@ -694,11 +1230,12 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
             jsvObjectSetChildAndUnLock(connection, HTTP_NAME_CONNECTED, jsvNewFromBool(true));
             alreadyConnected = true;
             // if we do not have any data to send, issue a drain event
-            if (!sendData || (int)jsvGetStringLength(sendData) == 0)
+            if (socketSendQueueIsEmpty(sendData))
               jsiQueueObjectCallbacks(connection, HTTP_NAME_ON_DRAIN, &connection, 1);
           }
-          // got data add it to our receive buffer
-          if (num > 0) {
+          // got data add it to our receive buffer (or we have a response left over from the last request on a keep-alive socket)
+          if (num > 0 || (isHttp && socketHasUnparsedData(socket, receiveData))) {
+            if (num > 0) wasBusy = true;
             if (!receiveData)
               receiveData = jsvNewFromEmptyString();
             if (receiveData) { // could be out of memory
@@ -712,17 +1249,42 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
       }
     }
 
-    if (closeConnectionNow) {
+    if (closeConnectionNow && keepAlive && !error) {
+      DBG("keep-alive\n");
+      wasBusy = true;
+      // The response is complete - keep the socket open and hand anything else we received to the next request
+      JsVar *requestBehind = socketGetRequestBehind(arr, connection, sckt);
+      if (requestBehind) {
+        // it's parsed when requestBehind gets to the front
+        if (receiveData && !jsvIsEmptyString(receiveData))
+          jsvObjectSetChild(requestBehind, HTTP_NAME_RECEIVE_DATA, receiveData);
+        jsvUnLock(requestBehind);
+      } else if (receiveData && !jsvIsEmptyString(receiveData)) {
+        _socketConnectionKill(net, connection); // we got data we didn't ask for
+      } else {
+        socketAddToIdlePool(net, connection, sckt);
+      }
+      jsvObjectIteratorRemoveAndGotoNext(&it, arr);
+      socketClosed = true;
+
+      JsVar *params[1] = { jsvNewFromBool(false) };
+      jsiQueueObjectCallbacks(socket, HTTP_NAME_ON_CLOSE, params, 1);
+      jsvUnLock(params[0]);
+    } else if (closeConnectionNow) {
       DBG("close now\n");
+      wasBusy = true;
 
       socketPushReceiveData(socket, &receiveData, isHttp, true);
       if (!receiveData || jsvIsEmptyString(receiveData)) {
         // If we had data to send but the socket closed, this is an error
         JsVar *sendData = jsvObjectGetChild(connection,HTTP_NAME_SEND_DATA,0);
-        if (sendData && jsvGetStringLength(sendData) > 0 && error == SOCKET_ERR_CLOSED)
+        if (!socketSendQueueIsEmpty(sendData) && error == SOCKET_ERR_CLOSED)
           error = SOCKET_ERR_UNSENT_DATA;
         jsvUnLock(sendData);
 
+        // any requests pipelined behind us on this socket won't get a response now
+        if (isHttp)
+          socketAbortRequestsBehind(arr, connection, sckt);
         _socketConnectionKill(net, connection);
         JsVar *connectionName = jsvObjectIteratorGetKey(&it);
         jsvObjectIteratorNext(&it);
@@ -751,11 +1313,12 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
       jsvObjectIteratorNext(&it);
     }
 
-    jsvUnLock3(receiveData, connection, socket);
+    jsvUnLock4(receiveData, connection, socket, requestAhead);
   }
   jsvUnLock(arr);
+  if (socketIdlePoolIdle(net, buf)) wasBusy = true;
 
-  return hadSockets;
+  return net->canSleep ? wasBusy : hadSockets;
 }
 
 
@@ -766,6 +1329,7 @@ bool socketIdle(JsNetwork *net) {
     return false;
   }
   bool hadSockets = false;
+  bool wasBusy = false;
   JsVar *arr = socketGetArray(HTTP_ARRAY_HTTP_SERVERS,false);
   if (arr) {
     JsvObjectIterator it;
@@ -783,28 +1347,9 @@ bool socketIdle(JsNetwork *net) {
           theClient = netAccept(net, sckt);
       }
       if (theClient >= 0) { // We have a new connection
+        wasBusy = true;
         if ((socketType&ST_TYPE_MASK) == ST_HTTP) {
-          JsVar *req = jspNewObject(0, "httpSRq");
-          JsVar *res = jspNewObject(0, "httpSRs");
-          if (res && req) { // out of memory?
-            socketSetType(req, ST_HTTP);
-            JsVar *arr = socketGetArray(HTTP_ARRAY_HTTP_SERVER_CONNECTIONS, true);
-            if (arr) {
-              jsvArrayPush(arr, req);
-              jsvUnLock(arr);
-            }
-            jsvObjectSetChild(req, HTTP_NAME_RESPONSE_VAR, res);
-            jsvObjectSetChild(req, HTTP_NAME_SERVER_VAR, server);
-            jsvObjectSetChildAndUnLock(req, HTTP_NAME_SOCKET, jsvNewFromInteger(theClient+1));
-            jsvObjectSetChildAndUnLock(res, HTTP_NAME_SOCKET, jsvNewFromInteger(theClient+1));
-            // Auto-add connection close header (in HTTP/1.0 this seemed implicit, now it must be explicit)
-            // This can always be overwritten with setHeader or writeHead
-            JsVar *name = jsvNewFromString("Connection");
-            JsVar *value = jsvNewFromString("close");
-            serverResponseSetHeader(res, name, value);
-            jsvUnLock2(name, value);
-          }
-          jsvUnLock2(req, res);
+          jsvUnLock(socketNewHttpServerConnection(server, theClient));
         } else {
           // Normal sockets
           JsVar *sock = jspNewObject(0, "Socket");
@@ -829,10 +1374,24 @@ bool socketIdle(JsNetwork *net) {
     jsvUnLock(arr);
   }
 
-  if (socketServerConnectionsIdle(net)) hadSockets = true;
-  if (socketClientConnectionsIdle(net)) hadSockets = true;
+  if (socketServerConnectionsIdle(net)) wasBusy = true;
+  if (socketClientConnectionsIdle(net)) wasBusy = true;
   netCheckError(net);
-  return hadSockets;
+  /* If the network wakes us when a socket needs attention we only have to
+   * stay busy if something happened - otherwise keep polling while there are sockets */
+  return net->canSleep ? wasBusy : (hadSockets || wasBusy);
+}
+
+bool socketHasConnections() {
+  const char *arrays[] = { HTTP_ARRAY_HTTP_SERVERS, HTTP_ARRAY_HTTP_SERVER_CONNECTIONS, HTTP_ARRAY_HTTP_CLIENT_CONNECTIONS };
+  unsigned int i;
+  for (i=0;i<sizeof(arrays)/sizeof(arrays[0]);i++) {
+    JsVar *arr = socketGetArray(arrays[i], false);
+    bool hasConnections = arr && !jsvArrayIsEmpty(arr);
+    jsvUnLock(arr);
+    if (hasConnections) return true;
+  }
+  return false;
 }
 
 // -----------------------------
@@ -900,6 +1459,23 @@ void serverClose(JsNetwork *net, JsVar *server) {
       jsWarn("Server not found!");
     jsvUnLock(arr);
   }
+  // close any keep-alive connections to this server that are waiting for another request
+  arr = socketGetArray(HTTP_ARRAY_HTTP_SERVER_CONNECTIONS,false);
+  if (arr) {
+    JsvObjectIterator it;
+    jsvObjectIteratorNew(&it, arr);
+    while (jsvObjectIteratorHasValue(&it)) {
+      JsVar *connection = jsvObjectIteratorGetValue(&it);
+      JsVar *connectionServer = jsvObjectGetChild(connection, HTTP_NAME_SERVER_VAR, 0);
+      JsVar *receiveData = jsvObjectGetChild(connection, HTTP_NAME_RECEIVE_DATA, 0);
+      if (connectionServer==server && !receiveData)
+        jsvObjectSetChildAndUnLock(connection, HTTP_NAME_CLOSENOW, jsvNewFromBool(true));
+      jsvUnLock3(connection, connectionServer, receiveData);
+      jsvObjectIteratorNext(&it);
+    }
+    jsvObjectIteratorFree(&it);
+    jsvUnLock(arr);
+  }
 }
 
 
@@ -940,6 +1516,7 @@ void clientRequestWrite(JsNetwork *net, JsVar *httpClientReqVar, JsVar *data, Js
   // Append data to sendData
   JsVar *sendData = jsvObjectGetChild(httpClientReqVar, HTTP_NAME_SEND_DATA, 0);
   if (!sendData) {
+    sendData = jsvNewEmptyArray();
     JsVar *options = 0;
     // Only append a header if we're doing HTTP AND we haven't already connected
     if ((socketType&ST_TYPE_MASK) == ST_HTTP)
@@ -949,7 +1526,9 @@ void clientRequestWrite(JsNetwork *net, JsVar *httpClientReqVar, JsVar *data, Js
       // We're an HTTP client - make a header
       JsVar *method = jsvObjectGetChild(options, "method", 0);
       JsVar *path = jsvObjectGetChild(options, "path", 0);
-      sendData = jsvVarPrintf("%v %v HTTP/1.1\r\nUser-Agent: Espruino "JS_VERSION"\r\nConnection: close\r\n", method, path);
+      bool keepAlive = jsvGetBoolAndUnLock(jsvObjectGetChild(options, "keepAlive", 0));
+      if (keepAlive) jsvObjectSetChildAndUnLock(httpClientReqVar, HTTP_NAME_KEEPALIVE, jsvNewFromBool(true));
+      JsVar *header = jsvVarPrintf("%v %v HTTP/1.1\r\nUser-Agent: Espruino "JS_VERSION"\r\nConnection: %s\r\n", method, path, keepAlive?"keep-alive":"close");
       jsvUnLock2(method, path);
       JsVar *headers = jsvObjectGetChild(options, HTTP_NAME_HEADERS, 0);
       bool hasHostHeader = false;
@@ -957,7 +1536,7 @@ void clientRequestWrite(JsNetwork *net, JsVar *httpClientReqVar, JsVar *data, Js
         JsVar *hostHeader = jsvObjectGetChildI(headers, "Host");
         hasHostHeader = hostHeader!=0;
         jsvUnLock(hostHeader);
-        httpAppendHeaders(sendData, headers);
+        httpAppendHeaders(header, headers);
         // if Transfer-Encoding:chunked was set, subsequent writes need to 'chunk' the data that is sent
         if (compareTransferEncodingAndUnlock(jsvObjectGetChild(headers, "Transfer-Encoding", 0), "chunked")) {
           jsvObjectSetChildAndUnLock(httpClientReqVar, HTTP_NAME_CHUNKED, jsvNewFromBool(true));
@@ -968,18 +1547,17 @@ void clientRequestWrite(JsNetwork *net, JsVar *httpClientReqVar, JsVar *data, Js
         JsVar *host = jsvObjectGetChild(options, "host", 0);
         int port = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(options, "port", 0));
         if (port>0 && port!=80)
-          jsvAppendPrintf(sendData, "Host: %v:%d\r\n", host, port);
+          jsvAppendPrintf(header, "Host: %v:%d\r\n", host, port);
         else
-          jsvAppendPrintf(sendData, "Host: %v\r\n", host);
+          jsvAppendPrintf(header, "Host: %v\r\n", host);
         jsvUnLock(host);
       }
       // finally add ending newline
-      jsvAppendString(sendData, "\r\n");
-    } else { // !options
-      // We're not HTTP (or were already connected), so don't send any header
-      sendData = jsvNewFromString("");
-    }
-    jsvObjectSetChild(httpClientReqVar, HTTP_NAME_SEND_DATA, sendData);
+      jsvAppendString(header, "\r\n");
+      if (sendData) socketSendQueueAppend(sendData, header);
+      jsvUnLock(header);
+    } // else we're not HTTP (or were already connected), so don't send any header
+    if (sendData) jsvObjectSetChild(httpClientReqVar, HTTP_NAME_SEND_DATA, sendData);
     jsvUnLock(options);
   }
   // We have data and aren't out of memory...
@@ -987,21 +1565,26 @@ void clientRequestWrite(JsNetwork *net, JsVar *httpClientReqVar, JsVar *data, Js
     // append the data to what we want to send
     JsVar *s = jsvAsString(data);
     if (s) {
-      if (jsvGetBoolAndUnLock(jsvObjectGetChild(httpClientReqVar, HTTP_NAME_CHUNKED, 0))) {
-        // If we asked to send 'chunked' data, we need to wrap it up,
-        // prefixed with the length
-        jsvAppendPrintf(sendData, "%x\r\n%v\r\n", jsvGetStringLength(s), s);
-      } else {
-        if ((socketType&ST_TYPE_MASK) == ST_UDP) {
-          char hostName[128];
-          jsvGetString(host, hostName, sizeof(hostName));
-          JsNetUDPPacketHeader header;
-          networkGetHostByName(net, hostName, (uint32_t*)&header.host);
-          header.port = portNumber;
-          header.length = (uint16_t)jsvGetStringLength(s);
-          jsvAppendStringBuf(sendData, (const char*)&header, sizeof(header));
+      if ((socketType&ST_TYPE_MASK) == ST_UDP) {
+        char hostName[128];
+        jsvGetString(host, hostName, sizeof(hostName));
+        JsNetUDPPacketHeader header;
+        networkGetHostByName(net, hostName, (uint32_t*)&header.host);
+        header.port = portNumber;
+        header.length = (uint16_t)jsvGetStringLength(s);
+        // each packet (header+data) is sent in one go, so must be in one string
+        JsVar *packet = jsvNewFlatStringOfLength((unsigned int)(sizeof(header)+header.length));
+        if (packet) {
+          memcpy(jsvGetFlatStringPointer(packet), &header, sizeof(header));
+          jsvGetStringChars(s, 0, jsvGetFlatStringPointer(packet)+sizeof(header), header.length);
+        } else {
+          packet = jsvNewFromEmptyString();
+          jsvAppendStringBuf(packet, (const char*)&header, sizeof(header));
+          jsvAppendStringVarComplete(packet, s);
         }
-        jsvAppendStringVarComplete(sendData,s);
+        if (packet) jsvArrayPushAndUnLock(sendData, packet);
+      } else {
+        socketSendQueueAppendData(sendData, s, jsvGetBoolAndUnLock(jsvObjectGetChild(httpClientReqVar, HTTP_NAME_CHUNKED, 0)));
       }
       jsvUnLock(s);
     }
@@ -1013,6 +1596,51 @@ void clientRequestWrite(JsNetwork *net, JsVar *httpClientReqVar, JsVar *data, Js
   }
 }
 
+/** Find a keep-alive socket that's connected to hostKey. If one is in the idle pool we remove it and
+ * use it, otherwise if a request is already using one we can pipeline another request behind it */
+static int socketGetKeepAliveSocket(JsVar *hostKey) {
+  int sckt = -1;
+  JsVar *arr = socketGetArray(HTTP_ARRAY_HTTP_CLIENT_IDLE, false);
+  if (arr) {
+    JsvObjectIterator it;
+    jsvObjectIteratorNew(&it, arr);
+    while (sckt<0 && jsvObjectIteratorHasValue(&it)) {
+      JsVar *idle = jsvObjectIteratorGetValue(&it);
+      JsVar *key = jsvObjectGetChild(idle, HTTP_NAME_HOST_KEY, 0);
+      if (jsvCompareString(key, hostKey, 0, 0, false)==0) {
+        sckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(idle, HTTP_NAME_SOCKET, 0))-1;
+        jsvObjectIteratorRemoveAndGotoNext(&it, arr);
+      } else
+        jsvObjectIteratorNext(&it);
+      jsvUnLock2(key, idle);
+    }
+    jsvObjectIteratorFree(&it);
+    jsvUnLock(arr);
+  }
+  if (sckt>=0) return sckt;
+  arr = socketGetArray(HTTP_ARRAY_HTTP_CLIENT_CONNECTIONS, false);
+  if (arr) {
+    // use the most recent request, as it's the one we'd be queued behind
+    JsvObjectIterator it;
+    jsvObjectIteratorNew(&it, arr);
+    while (jsvObjectIteratorHasValue(&it)) {
+      JsVar *connection = jsvObjectIteratorGetValue(&it);
+      JsVar *key = jsvObjectGetChild(connection, HTTP_NAME_HOST_KEY, 0);
+      if (key && jsvCompareString(key, hostKey, 0, 0, false)==0 &&
+          jsvGetBoolAndUnLock(jsvObjectGetChild(connection, HTTP_NAME_KEEPALIVE, 0)) &&
+          !jsvGetBoolAndUnLock(jsvObjectGetChild(connection, HTTP_NAME_CLOSENOW, 0))) {
+        int connectionSckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(connection, HTTP_NAME_SOCKET, 0))-1;
+        if (connectionSckt>=0) sckt = connectionSckt;
+      }
+      jsvUnLock2(key, connection);
+      jsvObjectIteratorNext(&it);
+    }
+    jsvObjectIteratorFree(&it);
+    jsvUnLock(arr);
+  }
+  return sckt;
+}
+
 // Connect this connection/socket
 void clientRequestConnect(JsNetwork *net, JsVar *httpClientReqVar) {
   DBG("clientRequestConnect\n");
@@ -1057,7 +1685,17 @@ void clientRequestConnect(JsNetwork *net, JsVar *httpClientReqVar) {
     if (port==0) port = 80;
   }
 
-  int sckt =  netCreateSocket(net, socketType, host_addr, port, options);
+  int sckt = -1;
+  if (jsvGetBoolAndUnLock(jsvObjectGetChild(httpClientReqVar, HTTP_NAME_KEEPALIVE, 0))) {
+    // Can we reuse a keep-alive connection to the same place?
+    JsVar *hostKey = jsvVarPrintf("%d:%x:%d", socketType, host_addr, port);
+    jsvObjectSetChild(httpClientReqVar, HTTP_NAME_HOST_KEY, hostKey);
+    sckt = socketGetKeepAliveSocket(hostKey);
+    jsvUnLock(hostKey);
+    if (sckt>=0) jsvObjectSetChildAndUnLock(httpClientReqVar, HTTP_NAME_CONNECTED, jsvNewFromBool(true));
+  }
+  if (sckt<0)
+    sckt = netCreateSocket(net, socketType, host_addr, port, options);
   if (sckt<0) {
     jsExceptionHere(JSET_INTERNALERROR, "Unable to create socket\n");
     // As this is already in the list of connections, an error will be thrown on idle anyway
@@ -1087,7 +1725,7 @@ void clientRequestEnd(JsNetwork *net, JsVar *httpClientReqVar) {
   } else {
     // if we never sent any data, make sure we close 'now'
     JsVar *sendData = jsvObjectGetChild(httpClientReqVar, HTTP_NAME_SEND_DATA, 0);
-    if (!sendData || jsvIsEmptyString(sendData))
+    if (socketSendQueueIsEmpty(sendData))
       jsvObjectSetChildAndUnLock(httpClientReqVar, HTTP_NAME_CLOSENOW, jsvNewFromBool(true));
     jsvUnLock(sendData);
   }
@@ -1128,9 +1766,32 @@ void serverResponseWriteHead(JsVar *httpServerResponseVar, int statusCode, JsVar
   if (jsvIsObject(explicitHeaders)) jsvObjectAppendAll(headers, explicitHeaders);
 
 
-  sendData = jsvVarPrintf("HTTP/1.1 %d OK\r\nServer: Espruino "JS_VERSION"\r\n", statusCode);
+  /* If the request allowed it, keep the connection open after this response - but only if the
+   * client can tell where the response ends. Add a 'Connection' header unless one was given */
+  bool keepAlive = jsvGetBoolAndUnLock(jsvObjectGetChild(httpServerResponseVar, HTTP_NAME_KEEPALIVE, 0));
   if (headers) {
-    httpAppendHeaders(sendData, headers);
+    JsVar *connection = jsvObjectGetChildI(headers, "Connection");
+    if (keepAlive)
+      keepAlive = !jsvIsStringIEqualAndUnLock(jsvLockAgainSafe(connection), "close");
+    /* If we don't know how long the response will be, send it chunked so we don't have to
+     * close the connection to show where it ends */
+    if (keepAlive && statusCode>=200 && statusCode!=204 && statusCode!=304 &&
+        !httpHasHeader(headers, "Content-Length") && !httpHasHeader(headers, "Transfer-Encoding") &&
+        jsvGetBoolAndUnLock(jsvObjectGetChild(httpServerResponseVar, HTTP_NAME_CAN_CHUNK, 0)))
+      jsvObjectSetChildAndUnLock(headers, "Transfer-Encoding", jsvNewFromString("chunked"));
+    if (keepAlive)
+      keepAlive = httpHasHeader(headers, "Content-Length") ||
+                  compareTransferEncodingAndUnlock(jsvObjectGetChildI(headers, "Transfer-Encoding"), "chunked");
+    if (!connection)
+      jsvObjectSetChildAndUnLock(headers, "Connection", jsvNewFromString(keepAlive ? "keep-alive" : "close"));
+    jsvUnLock(connection);
+  }
+  if (!keepAlive)
+    jsvObjectRemoveChild(httpServerResponseVar, HTTP_NAME_KEEPALIVE);
+
+  JsVar *header = jsvVarPrintf("HTTP/1.1 %d OK\r\nServer: Espruino "JS_VERSION"\r\n", statusCode);
+  if (headers) {
+    httpAppendHeaders(header, headers);
     // if Transfer-Encoding:chunked was set, subsequent writes need to 'chunk' the data that is sent
     if (compareTransferEncodingAndUnlock(jsvObjectGetChildI(headers, "Transfer-Encoding"), "chunked")) {
       jsvObjectSetChildAndUnLock(httpServerResponseVar, HTTP_NAME_CHUNKED, jsvNewFromBool(true));
@@ -1138,7 +1799,10 @@ void serverResponseWriteHead(JsVar *httpServerResponseVar, int statusCode, JsVar
   }
   jsvUnLock(headers);
   // finally add ending newline
-  jsvAppendString(sendData, "\r\n");
+  jsvAppendString(header, "\r\n");
+  sendData = jsvNewEmptyArray();
+  if (sendData) socketSendQueueAppend(sendData, header);
+  jsvUnLock(header);
   jsvObjectSetChildAndUnLock(httpServerResponseVar, HTTP_NAME_SEND_DATA, sendData);
 }
 
@@ -1160,21 +1824,48 @@ void serverResponseWrite(JsVar *httpServerResponseVar, JsVar *data) {
   // check, just in case!
   if (sendData && !jsvIsUndefined(data)) {
     JsVar *s = jsvAsString(data);
-    if (s) {
-      if (jsvGetBoolAndUnLock(jsvObjectGetChild(httpServerResponseVar, HTTP_NAME_CHUNKED, 0))) {
-        // If we asked to send 'chunked' data, we need to wrap it up,
-        // prefixed with the length
-        jsvAppendPrintf(sendData, "%x\r\n%v\r\n", jsvGetStringLength(s), s);
-      } else {
-        jsvAppendStringVarComplete(sendData,s);
-      }
-    }
+    if (s)
+      socketSendQueueAppendData(sendData, s, jsvGetBoolAndUnLock(jsvObjectGetChild(httpServerResponseVar, HTTP_NAME_CHUNKED, 0)));
     jsvUnLock(s);
   }
   DBG("serverResponseWrite %v\n", sendData);
   jsvUnLock(sendData);
 }
 
+/** Send a file from Storage as the response and end it. The file is sent straight from flash (or
+ * decompressed into RAM a chunk at a time each time the send queue empties if it's compressed). It
+ * can be moved by compaction while it's being sent, but if it's erased or rewritten the connection
+ * is closed early. Returns false (and does nothing) if the file doesn't exist */
+bool serverResponseSendFile(JsVar *httpServerResponseVar, JsVar *fileName) {
+  JsfFileHeader header;
+  JsfFileName name = jsfNameFromVar(fileName);
+  uint32_t addr = jsfFindFile(name, &header);
+  if (!addr) return false;
+  JsVar *fileData = jsvAddressToVar(addr, jsfGetFileSize(&header));
+  if (!fileData) return false; // out of memory
+  uint32_t length = jsfGetFileSize(&header);
+#ifdef JSF_COMPRESSED_FILES
+  if (jsfGetFileFlags(&header)&JSFF_COMPRESSED_BLOCKS)
+    length = jsfGetDecompressedSize(addr);
+#endif
+  JsVar *sendData = jsvObjectGetChild(httpServerResponseVar, HTTP_NAME_SEND_DATA, 0);
+  if (!sendData) {
+    // We haven't sent headers yet, so we can say how long the response is
+    JsVar *headers = jsvNewObject();
+    if (headers) jsvObjectSetChildAndUnLock(headers, "Content-Length", jsvNewFromInteger((JsVarInt)length));
+    serverResponseWriteHead(httpServerResponseVar, 200, headers);
+    jsvUnLock(headers);
+  }
+  jsvUnLock(sendData);
+  jsvObjectSetChildAndUnLock(httpServerResponseVar, HTTP_NAME_FILE_NAME, jsfVarFromName(name));
+  jsvObjectSetChildAndUnLock(httpServerResponseVar, HTTP_NAME_FILE_DATA, fileData);
+  jsvObjectSetChildAndUnLock(httpServerResponseVar, HTTP_NAME_FILE_OFFSET, jsvNewFromInteger(0));
+  jsvObjectSetChildAndUnLock(httpServerResponseVar, HTTP_NAME_FILE_LENGTH, jsvNewFromInteger((JsVarInt)length));
+  // queue the file (or the first part if it's compressed) - the rest is queued from socketSendData as it's sent
+  serverResponseSendFileNext(httpServerResponseVar);
+  return true;
+}
+
 void serverResponseEnd(JsVar *httpServerResponseVar) {
   JsVar *finalData = 0;
   if (jsvGetBoolAndUnLock(jsvObjectGetChild(httpServerResponseVar, HTTP_NAME_CHUNKED, 0))) {
@@ -23,6 +23,8 @@
 void socketInit();
 void socketKill(JsNetwork *net);
 bool socketIdle(JsNetwork *net);
+/// Are there any servers or connections open (so we could still get events from them)?
+bool socketHasConnections();
 
 // -----------------------------
 JsVar *serverNew(SocketType socketType, JsVar *callback);
@@ -39,5 +41,6 @@ void serverResponseSetHeader(JsVar *parent, JsVar *name, JsVar *value); // for H
 void serverResponseWriteHead(JsVar *httpServerResponseVar, int statusCode, JsVar *headers); // for HTTP
 void serverResponseWrite(JsVar *httpServerResponseVar, JsVar *data);
 void serverResponseEnd(JsVar *httpServerResponseVar);
+bool serverResponseSendFile(JsVar *httpServerResponseVar, JsVar *fileName);
 
 #endif // SOCKETSERVER_H
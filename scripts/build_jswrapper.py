@@ -701,6 +701,14 @@ for jsondata in jsondatas:
     codeOut("  "+jsondata["generate"]+"();")
 codeOut('}')
 
+codeOut("/** Tasks to run when we're low on memory. Returns true if any memory was freed */")
+codeOut('bool jswFreeMoreMemory() {')
+for jsondata in jsondatas:
+  if "type" in jsondata and jsondata["type"]=="freemem":
+    codeOut("  if ("+jsondata["generate"]+"()) return true;")
+codeOut('  return false;')
+codeOut('}')
+
 codeOut("/** Tasks to run when a character event is received */")
 codeOut('bool jswOnCharEvent(IOEventFlags channel, char charData) {')
 for jsondata in jsondatas:
@@ -263,9 +263,84 @@ void jshTransmit(
   jshUSARTKick(device); // set up interrupts if required
 }
 
+/**
+ * Queue a block of data for transmission. Where the device just uses the
+ * transmit queue, as much data as will fit is copied in at once (rather
+ * than a character at a time) and made visible to the IRQ in one go.
+ * IRQs are disabled while copying so a jshTransmit from an IRQ can't
+ * overwrite it.
+ */
+void jshTransmitBlock(
+    IOEventFlags device,        //!< The device to be used for transmission.
+    const unsigned char *data,  //!< The data to transmit
+    unsigned int len            //!< The number of bytes to transmit
+  ) {
+  if (device==EV_LOOPBACKA || device==EV_LOOPBACKB) {
+    jshPushIOCharEvents(device==EV_LOOPBACKB ? EV_LOOPBACKA : EV_LOOPBACKB, (char*)data, len);
+    return;
+  }
+#ifdef LINUX
+  if (device==DEFAULT_CONSOLE_DEVICE) {
+    fwrite(data, 1, len, stdout);
+    fflush(stdout);
+    return;
+  }
+#endif
+  bool isSimple = device!=EV_NONE;
+#ifdef USE_TELNET
+  if (device==EV_TELNET) isSimple = false;
+#endif
+#ifdef USE_TERMINAL
+  if (device==EV_TERMINAL) isSimple = false;
+#endif
+#ifndef LINUX
+#ifdef USB
+  if (device==EV_USBSERIAL && !jshIsUSBSERIALConnected()) isSimple = false;
+#endif
+#ifdef BLUETOOTH
+  if (device==EV_BLUETOOTH && !jsble_has_peripheral_connection()) isSimple = false;
+#endif
+#endif
+  if (!isSimple) {
+    // jshTransmit knows how to deal with these
+    while (len--) jshTransmit(device, *(data++));
+    return;
+  }
+
+  while (len) {
+    /* IRQs off while we copy and publish, as jshTransmit may be called
+    from an IRQ (eg. console echo) and would write to the same place */
+    jshInterruptOff();
+    unsigned char head = txHead;
+    unsigned int space = (unsigned int)((txTail+TXBUFFERMASK-head)&TXBUFFERMASK);
+    if (!space) {
+      jshInterruptOn();
+      // Buffer full - jshTransmit knows how to wait for space
+      jshTransmit(device, *(data++));
+      len--;
+      if (device==EV_LIMBO && jsiGetConsoleDevice()!=EV_LIMBO) {
+        // Console moved while we were waiting - see the comments in jshTransmit
+        jshTransmitBlock(jsiGetConsoleDevice(), data, len);
+        return;
+      }
+      continue;
+    }
+    if (space>len) space=len;
+    len -= space;
+    while (space--) {
+      txBuffer[head].flags = device;
+      txBuffer[head].data = *(data++);
+      head = (unsigned char)((head+1)&TXBUFFERMASK);
+    }
+    txHead = head;
+    jshInterruptOn();
+    jshUSARTKick(device); // set up interrupts if required
+  }
+}
+
 static void jshTransmitPrintfCallback(const char *str, void *user_data) {
   IOEventFlags device = (IOEventFlags)user_data;
-  while (*str) jshTransmit(device, (unsigned char)*(str++));
+  jshTransmitBlock(device, (const unsigned char *)str, (unsigned int)strlen(str));
 }
 
 void jshTransmitPrintf(IOEventFlags device, const char *fmt, ...) {
@@ -322,6 +397,34 @@ int jshGetCharToTransmit(
   return -1; // no data :(
 }
 
+/**
+ * Get as much data for transmission on the given device as will fit in buf,
+ * for drivers that can send more than one character at a time (DMA, write()).
+ * \return The number of bytes copied into buf.
+ */
+unsigned int jshGetDataToTransmit(
+    IOEventFlags device, // The device being looked at for a transmission.
+    unsigned char *buf,  // Where to put the data
+    unsigned int max     // The size of buf
+  ) {
+  unsigned int len = 0;
+  while (len<max) {
+    /* jshGetCharToTransmit handles XON/XOFF, and data that
+    isn't at the top of the queue */
+    int c = jshGetCharToTransmit(device);
+    if (c<0) break;
+    buf[len++] = (unsigned char)c;
+    // Then take the contiguous run of data for this device from the top of the queue
+    unsigned char tail = txTail;
+    while (len<max && tail!=txHead && IOEVENTFLAGS_GETTYPE(txBuffer[tail].flags)==device) {
+      buf[len++] = txBuffer[tail].data;
+      tail = (unsigned char)((tail+1)&TXBUFFERMASK);
+    }
+    txTail = tail;
+  }
+  return len;
+}
+
 void jshTransmitFlush() {
   jsiSetBusy(BUSY_TRANSMIT, true);
   while (jshHasTransmitData()) ; // wait for send to finish
@@ -451,10 +554,51 @@ void jshPushIOCharEvent(
   jshPushIOCharEventFlowControl(channel);
 }
 
+/** Push a block of characters that have already been checked with
+ * jshPushIOCharEventHandler. The new events are filled in beyond ioHead
+ * and then published with a single write of ioHead, so the consumer
+ * never sees a partially written event */
+static void jshPushIOCharEventsBlock(IOEventFlags channel, char *data, unsigned int count) {
+  if (!count) return;
+  jshInterruptOff();
+  // top up the last event in the queue if it was for this device
+  while (count && jshPushIOCharEventAppend(channel, *data)) {
+    data++;
+    count--;
+  }
+  IOBufferIdx head = ioHead;
+  while (count) {
+    IOBufferIdx nextHead = (IOBufferIdx)((head+1) & IOBUFFERMASK);
+    if (ioTail == nextHead) {
+      jshIOEventOverflowed();
+      break; // queue full - dump the rest
+    }
+    unsigned int i, chars = (count>IOEVENT_MAXCHARS) ? IOEVENT_MAXCHARS : count;
+    IOEventFlags flags = channel;
+    IOEVENTFLAGS_SETCHARS(flags, chars);
+    for (i=0;i<chars;i++)
+      ioBuffer[head].data.chars[i] = data[i];
+    ioBuffer[head].flags = flags;
+    data += chars;
+    count -= chars;
+    head = nextHead;
+  }
+  ioHead = head;
+  jshInterruptOn();
+  // Set flow control (as we're going to use more data)
+  jshPushIOCharEventFlowControl(channel);
+}
+
 void jshPushIOCharEvents(IOEventFlags channel, char *data, unsigned int count) {
-  // TODO: optimise me!
-  unsigned int i;
-  for (i=0;i<count;i++) jshPushIOCharEvent(channel, data[i]);
+  unsigned int i, start = 0;
+  for (i=0;i<count;i++) {
+    // characters handled in the IRQ (eg. Ctrl-C) split the block
+    if (jshPushIOCharEventHandler(channel, data[i])) {
+      jshPushIOCharEventsBlock(channel, &data[start], i-start);
+      start = i+1;
+    }
+  }
+  jshPushIOCharEventsBlock(channel, &data[start], count-start);
 }
 
 /* Signal an IO watch event as having happened.
@@ -513,6 +657,29 @@ bool jshPopIOEvent(IOEvent *result) {
   return true;
 }
 
+/** Pop a contiguous run of character events for the given (serial) device
+ * from the top of the queue into buf. Events are never split, so this stops
+ * early rather than overflowing 'max'. Returns the number of characters copied,
+ * and adds the number of events popped to *events */
+unsigned int jshPopIOEvents(IOEventFlags device, char *buf, unsigned int max, int *events) {
+  unsigned int len = 0;
+  IOBufferIdx tail = ioTail;
+  while (tail != ioHead) {
+    IOEventFlags flags = ioBuffer[tail].flags;
+    if (IOEVENTFLAGS_GETTYPE(flags) != device) break;
+    unsigned int i, chars = (unsigned int)IOEVENTFLAGS_GETCHARS(flags);
+    if (len+chars > max) break;
+    for (i=0;i<chars;i++)
+      buf[len++] = ioBuffer[tail].data.chars[i];
+    tail = (IOBufferIdx)((tail+1) & IOBUFFERMASK);
+    /* Update the tail after every event - jshPushIOCharEventAppend may add
+    characters to the last event in the queue as long as it isn't the tail */
+    ioTail = tail;
+    (*events)++;
+  }
+  return len;
+}
+
 // returns true on success
 bool jshPopIOEventOfType(IOEventFlags eventType, IOEvent *result) {
   // Special case for top - it's easier!
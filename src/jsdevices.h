@@ -192,6 +192,8 @@ void jshPushIOCharEvents(IOEventFlags channel, char *data, unsigned int count);
 
 bool jshPopIOEvent(IOEvent *result); ///< returns true on success
 bool jshPopIOEventOfType(IOEventFlags eventType, IOEvent *result); ///< returns true on success
+/// Pop a contiguous run of character events for one device into buf. Returns the number of characters, and adds the number of events to *events
+unsigned int jshPopIOEvents(IOEventFlags device, char *buf, unsigned int max, int *events);
 /// Do we have any events pending? Will jshPopIOEvent return true?
 bool jshHasEvents();
 /// Check if the top event is for the given device
@@ -213,6 +215,8 @@ JsVar *jshGetDeviceObject(IOEventFlags device);
 //                                                         DATA TRANSMIT BUFFER
 /// Queue a character for transmission
 void jshTransmit(IOEventFlags device, unsigned char data);
+/// Queue a block of data for transmission
+void jshTransmitBlock(IOEventFlags device, const unsigned char *data, unsigned int len);
 // Queue a formatted string for transmission
 void jshTransmitPrintf(IOEventFlags device, const char *fmt, ...);
 /// Wait for transmit to finish
@@ -227,6 +231,8 @@ bool jshHasTransmitData();
 IOEventFlags jshGetDeviceToTransmit();
 /// Try and get a character for transmission - could just return -1 if nothing
 int jshGetCharToTransmit(IOEventFlags device);
+/// Get as much data for transmission as will fit in buf (for DMA/block writes). Returns the number of bytes
+unsigned int jshGetDataToTransmit(IOEventFlags device, unsigned char *buf, unsigned int max);
 
 
 /// Set whether the host should transmit or not
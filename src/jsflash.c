@@ -53,7 +53,145 @@
 
 #define JSF_CACHE_NOT_FOUND 0xFFFFFFFF
 
-#if ESPR_USE_STORAGE_CACHE
+/// Name of the file used to record what an incremental compaction step is doing, in case we lose power
+#define JSF_COMPACT_JOURNAL ".compact"
+/// When this many bytes of files have been erased, check whether we should start compacting in the background
+#define JSF_COMPACT_CHECK_BYTES 4096
+/// Start compacting in the background when trash is more than 1/JSF_COMPACT_TRASH_RATIO of the space we could be writing to
+#define JSF_COMPACT_TRASH_RATIO 4
+/// The most pages we'll erase in one incremental compaction step
+#define JSF_COMPACT_ERASE_PAGES 4
+/// The most files we'll copy into a page of trash in one incremental compaction step
+#define JSF_COMPACT_FILL_FILES 8
+
+#if ESPR_USE_STORAGE_INDEX
+/* A complete index of the files in Storage, held in RAM. It's an open-addressed
+(linear probing) hash table of filename -> address and header, built from one
+scan of flash the first time a file is looked up, and then kept up to date as
+files are created, erased and moved by compaction. Because it contains every
+file, a miss means the file doesn't exist, so we don't have to scan flash for that
+either - and listing/hashing files doesn't need to read flash at all.
+
+To use this, add '-DESPR_USE_STORAGE_INDEX=256' (the maximum number of files to
+index) to the BOARD.py file. If there are more files than that the index isn't
+used and we search flash as before.
+*/
+typedef struct {
+  uint32_t addr; ///< Address as returned by jsfFindFile (0 = empty slot)
+  JsfFileHeader header; ///< The file header
+} JsfCacheEntry;
+
+#define JSF_INDEX_MAX_SLOTS (ESPR_USE_STORAGE_INDEX*2)
+#define JSF_INDEX_MIN_SLOTS 16
+
+typedef enum {
+  JSFI_NONE,   ///< Not built yet (or Storage changed in a way we didn't track)
+  JSFI_VALID,  ///< Every file in Storage is in the index
+  JSFI_TOO_BIG ///< Too many files to fit - don't use the index
+} PACKED_FLAGS JsfIndexState;
+
+JsfCacheEntry jsfIndex[JSF_INDEX_MAX_SLOTS];
+static uint32_t jsfIndexSize = 0; ///< How many slots we're using (worked out from the file count)
+static uint32_t jsfIndexCount = 0; ///< How many files are in the index
+static JsfIndexState jsfIndexState = JSFI_NONE;
+
+static void jsfIndexBuild(); // defined below, once we can read file headers
+
+static uint32_t jsfIndexHash(JsfFileName *name) {
+  uint32_t h = 2166136261u; // FNV-1a
+  for (unsigned int i=0;i<sizeof(name->c) && name->c[i];i++)
+    h = (h ^ (unsigned char)name->c[i]) * 16777619u;
+  return h % jsfIndexSize;
+}
+
+/// Find the slot for this name - either the one containing it, or the empty one where it should go
+static uint32_t jsfIndexSlot(JsfFileName *name) {
+  uint32_t i = jsfIndexHash(name);
+  while (jsfIndex[i].addr && memcmp(jsfIndex[i].header.name.c, name->c, sizeof(name->c))!=0)
+    i = (i+1) % jsfIndexSize;
+  return i;
+}
+
+static void jsfCacheClear() {
+  jsfIndexState = JSFI_NONE;
+}
+
+/// Add a file to the index (or update its address). Returns false if there's no space
+static bool jsfIndexPut(JsfFileHeader *header, uint32_t addr) {
+  uint32_t i = jsfIndexSlot(&header->name);
+  if (!jsfIndex[i].addr) {
+    if ((jsfIndexCount+1)*4 > jsfIndexSize*3) return false; // keep the table at most 3/4 full
+    jsfIndexCount++;
+  }
+  jsfIndex[i].header = *header;
+  jsfIndex[i].addr = addr;
+  return true;
+}
+
+static void jsfCacheClearFile(JsfFileName name) {
+  if (jsfIndexState != JSFI_VALID) return;
+  uint32_t i = jsfIndexSlot(&name);
+  if (!jsfIndex[i].addr) return;
+  // remove it, and shift back any entries after it that would no longer be found
+  jsfIndex[i].addr = 0;
+  jsfIndexCount--;
+  uint32_t j = i;
+  while (true) {
+    j = (j+1) % jsfIndexSize;
+    if (!jsfIndex[j].addr) return;
+    uint32_t k = jsfIndexHash(&jsfIndex[j].header.name);
+    // if k (where the entry wants to be) is cyclically in (i,j] it's fine where it is
+    if ((i<=j) ? (i<k && k<=j) : (i<k || k<=j)) continue;
+    jsfIndex[i] = jsfIndex[j];
+    jsfIndex[j].addr = 0;
+    i = j;
+  }
+}
+
+// Find an item in the index - returns JSF_CACHE_NOT_FOUND if we don't know (so we must search flash)
+static uint32_t jsfCacheFind(JsfFileName name, JsfFileHeader *returnedHeader) {
+  if (jsfIndexState == JSFI_NONE) jsfIndexBuild();
+  if (jsfIndexState != JSFI_VALID) return JSF_CACHE_NOT_FOUND;
+  uint32_t i = jsfIndexSlot(&name);
+  if (returnedHeader) {
+    if (jsfIndex[i].addr) {
+      *returnedHeader = jsfIndex[i].header;
+    } else {
+      memset(returnedHeader, 0, sizeof(JsfFileHeader));
+      returnedHeader->name = name;
+    }
+  }
+  return jsfIndex[i].addr;
+}
+static void jsfCachePut(JsfFileHeader *header, uint32_t addr) {
+  if (jsfIndexState != JSFI_VALID || !addr) return;
+  if (!jsfIndexPut(header, addr))
+    jsfIndexState = JSFI_NONE; // too full - rebuild a bigger index next time
+}
+/// A file has been moved to newAddr (by compaction)
+static void jsfCacheMoveFile(JsfFileHeader *header, uint32_t newAddr) {
+  if (jsfIndexState != JSFI_VALID) return;
+  uint32_t i = jsfIndexSlot(&header->name);
+  if (jsfIndex[i].addr) jsfIndex[i].addr = newAddr;
+}
+
+/// Get the addresses of all files in the index between startAddr and endAddr, in order. Returns the number of files
+static uint32_t jsfIndexGetFiles(uint32_t startAddr, uint32_t endAddr, uint32_t *slots) {
+  uint32_t n = 0;
+  for (uint32_t i=0;i<jsfIndexSize;i++) {
+    uint32_t a = jsfIndex[i].addr;
+    if (!a || a<startAddr || a>endAddr) continue;
+    // insertion sort by address
+    uint32_t j = n++;
+    while (j && jsfIndex[slots[j-1]].addr > a) {
+      slots[j] = slots[j-1];
+      j--;
+    }
+    slots[j] = i;
+  }
+  return n;
+}
+#elif ESPR_USE_STORAGE_CACHE
 /* Filename lookups can take over 1ms per file even on a reasonably empty SPI Flash memory,
 so we can have a cache of the most used file *addresses* in RAM. The data is still in
 flash but not having to do the search really helps us.
@@ -118,11 +256,17 @@ static void jsfCachePut(JsfFileHeader *header, uint32_t addr) {
   jsfCache[0].header = *header;
   jsfCache[0].addr = addr;
 }
+static void jsfCacheMoveFile(JsfFileHeader *header, uint32_t newAddr) {
+  for (int i=0;i<jsfCacheEntries;i++)
+    if (memcmp(jsfCache[i].header.name.c, header->name.c, sizeof(header->name.c))==0)
+      jsfCache[i].addr = newAddr;
+}
 #else // no cache, just stub with code that does nothing
 static void jsfCacheClear() {}
 static void jsfCacheClearFile(JsfFileName name) {}
 static uint32_t jsfCacheFind(JsfFileName name, JsfFileHeader *header) { return JSF_CACHE_NOT_FOUND; }
 static void jsfCachePut(JsfFileHeader *header, uint32_t addr) { }
+static void jsfCacheMoveFile(JsfFileHeader *header, uint32_t newAddr) { }
 #endif
 
 // ------------------------------------------------------------------------------------------------
@@ -132,6 +276,13 @@ static void jsfCachePut(JsfFileHeader *header, uint32_t addr) { }
 // ------------------------------------------------------------------------------------------------
 
 static uint32_t jsfCreateFile(JsfFileName name, uint32_t size, JsfFileFlags flags, JsfFileHeader *returnedHeader);
+static void jsfCompactStop();
+#ifdef JSF_COMPRESSED_FILES
+static JsVar *jsfReadCompressedFile(uint32_t addr, int offset, int length);
+static uint32_t jsfGetCompressedTableSize(uint32_t length);
+static uint32_t jsfGetCompressedTable(const char *data, uint32_t length, uint32_t *table);
+static bool jsfWriteCompressedFile(JsfFileName name, const char *data, uint32_t length, uint32_t *table, uint32_t compressedSize);
+#endif
 
 /// Aligns a block, pushing it along in memory until it reaches the required alignment
 static uint32_t jsfAlignAddress(uint32_t addr) {
@@ -260,16 +411,25 @@ static bool jsfEraseArea(uint32_t startAddr, uint32_t endAddr) {
 bool jsfEraseAll() {
   jsDebug(DBG_INFO,"EraseAll\n");
   jsfCacheClear();
+  jsfCompactStop();
 #ifdef JSF_BANK2_START_ADDRESS
   if (!jsfEraseArea(JSF_BANK2_START_ADDRESS, JSF_BANK2_END_ADDRESS)) return false;
 #endif
   return jsfEraseArea(JSF_START_ADDRESS, JSF_END_ADDRESS);
 }
 
+#ifndef SAVE_ON_FLASH
+/// How many bytes of files have been erased since we last checked if we should start compacting in the background
+static uint32_t jsfCompactTrashSinceCheck = JSF_COMPACT_CHECK_BYTES;
+#endif
+
 /// When a file is found in memory, erase it (by setting first bytes of name to 0). addr=ptr to data, NOT header
 static void jsfEraseFileInternal(uint32_t addr, JsfFileHeader *header) {
   jsDebug(DBG_INFO,"EraseFile 0x%08x\n", addr);
-
+  jsfCacheClearFile(header->name);
+#ifndef SAVE_ON_FLASH
+  jsfCompactTrashSinceCheck += jsfGetFileSize(header);
+#endif
   addr -= (uint32_t)sizeof(JsfFileHeader);
   addr += (uint32_t)((char*)&header->name.firstChars - (char*)header);
   header->name.firstChars = 0;
@@ -280,7 +440,6 @@ bool jsfEraseFile(JsfFileName name) {
   JsfFileHeader header;
   uint32_t addr = jsfFindFile(name, &header);
   if (!addr) return false;
-  jsfCacheClearFile(name);
   jsfEraseFileInternal(addr, &header);
   return true;
 }
@@ -390,6 +549,38 @@ JsfStorageStats jsfGetStorageStats(uint32_t addr, bool allPages) {
   return stats;
 }
 
+#if ESPR_USE_STORAGE_INDEX
+/// Scan all of Storage and put every file in the index
+static void jsfIndexBuild() {
+  JsfFileHeader header;
+  uint32_t banks[] = { JSF_START_ADDRESS,
+#ifdef JSF_BANK2_START_ADDRESS
+                       JSF_BANK2_START_ADDRESS,
+#endif
+                     };
+  uint32_t fileCount = 0;
+  for (unsigned int b=0;b<sizeof(banks)/sizeof(uint32_t);b++)
+    fileCount += jsfGetStorageStats(banks[b], true).fileCount;
+  jsfIndexSize = fileCount*2;
+  if (jsfIndexSize < JSF_INDEX_MIN_SLOTS) jsfIndexSize = JSF_INDEX_MIN_SLOTS;
+  if (jsfIndexSize > JSF_INDEX_MAX_SLOTS) jsfIndexSize = JSF_INDEX_MAX_SLOTS;
+  memset(jsfIndex, 0, sizeof(JsfCacheEntry)*jsfIndexSize);
+  jsfIndexCount = 0;
+  jsfIndexState = JSFI_TOO_BIG;
+  for (unsigned int b=0;b<sizeof(banks)/sizeof(uint32_t);b++) {
+    uint32_t addr = banks[b];
+    if (jsfGetFileHeader(addr, &header, true)) do {
+      if (header.name.firstChars == 0) continue; // replaced
+      uint32_t i = jsfIndexSlot(&header.name);
+      if (jsfIndex[i].addr) continue; // jsfFindFile would have found the first one
+      if (!jsfIndexPut(&header, addr+(uint32_t)sizeof(JsfFileHeader)))
+        return; // too many files
+    } while (jsfGetNextFileHeader(&addr, &header, GNFH_GET_ALL));
+  }
+  jsfIndexState = JSFI_VALID;
+}
+#endif
+
 #ifndef SAVE_ON_FLASH
 
 // Copy one memory buffer to another *circular buffer*
@@ -438,6 +629,14 @@ static void jsfCompactWriteBuffer(uint32_t *writeAddress, uint32_t readAddress,
   }
 }
 
+/// A file has moved in flash - update any JsVars that point to it, by flash address or by memory-mapped address
+static void jsfUpdateMemoryAddress(uint32_t oldAddr, uint32_t length, uint32_t newAddr) {
+  jsvUpdateMemoryAddress(oldAddr, length, newAddr);
+  size_t mappedOldAddr = jshFlashGetMemMapAddress(oldAddr);
+  if (mappedOldAddr && mappedOldAddr!=oldAddr)
+    jsvUpdateMemoryAddress(mappedOldAddr, length, jshFlashGetMemMapAddress(newAddr));
+}
+
 /* Try and compact saved data so it'll fit in Flash again.
  */
 static bool jsfCompactInternal(uint32_t startAddress, char *swapBuffer, uint32_t swapBufferSize) {
@@ -454,8 +653,10 @@ static bool jsfCompactInternal(uint32_t startAddress, char *swapBuffer, uint32_t
       jsDebug(DBG_INFO,"compact> copying file at 0x%08x\n", addr);
       // Rewrite file position for any JsVars that used this file *if* the file changed position
       uint32_t newAddress = writeAddress+swapBufferUsed;
-      if (addr != newAddress)
-        jsvUpdateMemoryAddress(addr, sizeof(JsfFileHeader) + jsfGetFileSize(&header), newAddress);
+      if (addr != newAddress) {
+        jsfUpdateMemoryAddress(addr, (uint32_t)sizeof(JsfFileHeader) + jsfGetFileSize(&header), newAddress);
+        jsfCacheMoveFile(&header, newAddress+(uint32_t)sizeof(JsfFileHeader));
+      }
       // Copy the file into the circular buffer, one bit at a time.
       // Write the header
       memcpy_circular(swapBuffer, &swapBufferHead, swapBufferSize, (char*)&header, sizeof(JsfFileHeader));
@@ -473,6 +674,7 @@ static bool jsfCompactInternal(uint32_t startAddress, char *swapBuffer, uint32_t
           s = swapBufferTail-swapBufferHead;
         if (s==0) {
           jsDebug(DBG_INFO,"compact> error - no space left!\n");
+          jsfCacheClear(); // files may have been moved
           return false;
         }
         if (s>alignedSize) s=alignedSize;
@@ -554,7 +756,7 @@ bool jsfBankCompact(uint32_t startAddress) {
 
 // Try and compact saved data so it'll fit in Flash again
 bool jsfCompact() {
-  jsfCacheClear();
+  jsfCompactStop();
   bool compacted = jsfBankCompact(JSF_START_ADDRESS);
 #ifdef JSF_BANK2_START_ADDRESS
   compacted |= jsfBankCompact(JSF_BANK2_START_ADDRESS);
@@ -596,6 +798,23 @@ void jsfGetDriveBankAddress(char drive, uint32_t *bankStartAddr, uint32_t *bankE
   *bankStartAddr=JSF_DEFAULT_START_ADDRESS;
   *bankEndAddr=JSF_DEFAULT_END_ADDRESS;
 }
+/// Find a hole of at least requiredSize bytes (that doesn't start between excludeStart and excludeEnd). Return its address, or 0 if there isn't one
+static uint32_t jsfFindFreeSpace(uint32_t bankStartAddress, uint32_t requiredSize, uint32_t excludeStart, uint32_t excludeEnd) {
+  uint32_t addr = bankStartAddress;
+  JsfFileHeader header;
+  do {
+    if (jsfGetFileHeader(addr, &header, false)) do {
+    } while (jsfGetNextFileHeader(&addr, &header, GNFH_GET_EMPTY));
+    // If not enough space, skip to next page
+    if (jsfGetSpaceLeftInPage(addr)<requiredSize || (addr>=excludeStart && addr<excludeEnd)) {
+      addr = jsfGetAddressOfNextPage(addr);
+    } else { // if enough space, we can write a file!
+      return addr;
+    }
+  } while (addr);
+  return 0;
+}
+
 /// Create a new 'file' in the memory store - DOES NOT remove existing files with same name. Return the address of data start, or 0 on error
 static uint32_t jsfCreateFile(JsfFileName name, uint32_t size, JsfFileFlags flags, JsfFileHeader *returnedHeader) {
   jsDebug(DBG_INFO,"CreateFile (%d bytes)\n", size);
@@ -610,19 +829,8 @@ static uint32_t jsfCreateFile(JsfFileName name, uint32_t size, JsfFileFlags flag
   JsfFileHeader header;
   uint32_t freeAddr = 0;
   while (!freeAddr) {
-    addr = bankStartAddress;
-    freeAddr = 0;
     // Find a hole that's big enough for our file
-    do {
-      if (jsfGetFileHeader(addr, &header, false)) do {
-      } while (jsfGetNextFileHeader(&addr, &header, GNFH_GET_EMPTY));
-      // If not enough space, skip to next page
-      if (jsfGetSpaceLeftInPage(addr)<requiredSize) {
-        addr = jsfGetAddressOfNextPage(addr);
-      } else { // if enough space, we can write a file!
-        freeAddr = addr;
-      }
-    } while (addr && !freeAddr);
+    freeAddr = jsfFindFreeSpace(bankStartAddress, requiredSize, 0, 0);
     // If we don't have space, compact
     if (!freeAddr) {
       // check this for sanity - in future we might compact forward into other pages, and don't compact if so
@@ -632,7 +840,6 @@ static uint32_t jsfCreateFile(JsfFileName name, uint32_t size, JsfFileFlags flag
           jsDebug(DBG_INFO,"CreateFile - Compact failed\n");
           return 0;
         }
-        addr = bankStartAddress; // addr->startAddr = restart
       } else {
         // FIXME: if we have 2 banks and there is no room in this one, what about the other bank?
         jsDebug(DBG_INFO,"CreateFile - Not enough space\n");
@@ -747,6 +954,406 @@ uint32_t jsfFindFileFromAddr(uint32_t containsAddr, JsfFileHeader *returnedHeade
   return 0;
 }
 
+#ifndef SAVE_ON_FLASH
+// ------------------------------------------------------------------------ Incremental compaction
+/* jsfCompact rewrites all of Storage in one go, which can take seconds. Instead,
+ * when we're idle and Storage is getting full of trash we do small steps that each
+ * leave Storage valid:
+ *
+ * * Trash at the end of Storage is erased, a few pages at a time from the end backwards
+ * * Live files in pages that are mostly trash are copied elsewhere, one at a time
+ * * A page that only contains trash is erased and refilled with files from the end
+ *   of Storage (we can't just erase it, as a blank page marks the end of Storage)
+ *
+ * Before moving anything a step writes what it is doing to JSF_COMPACT_JOURNAL, and
+ * if we lose power jsfCompactRecover uses that to finish or undo the step. */
+
+typedef enum {
+  JSFCJ_MOVE, ///< A file is being copied out of a page we want to reclaim
+  JSFCJ_FILL, ///< A page containing only trash is being erased and refilled with copies of other files
+} JsfCompactJournalType;
+
+/// A file that a JSFCJ_FILL step copies
+typedef struct {
+  uint32_t addr; ///< Address of the original file's header
+  JsfFileHeader header; ///< The original header (as the original's name is zeroed once copied)
+} JsfCompactJournalFile;
+
+/// What an incremental compaction step is doing (stored in JSF_COMPACT_JOURNAL)
+typedef struct {
+  uint32_t type; ///< JsfCompactJournalType
+  /** JSFCJ_MOVE: header addresses of the file and its copy.
+   *  JSFCJ_FILL: where in the page to write the files, and the address of the file header
+   *  the page must lead on to (or 0 if nothing spans into the next page) */
+  uint32_t from, to;
+  uint32_t count; ///< JSFCJ_FILL: how many files are being copied
+  JsfCompactJournalFile files[JSF_COMPACT_FILL_FILES+1]; ///< +1 so there's always space for the check value after the last file
+} JsfCompactJournal;
+
+/// The amount of data stored for a journal with COUNT files (including the check value)
+#define JSF_COMPACT_JOURNAL_SIZE(COUNT) ((uint32_t)(offsetof(JsfCompactJournal,files) + (COUNT)*sizeof(JsfCompactJournalFile) + sizeof(uint32_t)))
+
+/// What is in a page of Storage
+typedef struct {
+  uint32_t start, end;
+  uint32_t first; ///< Where the first file header in the page is (or would be), after any file spanning into the page
+  uint32_t next; ///< Address of the next file header if a file spans out of the page, or 0
+  uint32_t trashBytes; ///< Bytes of trash between 'first' and the end of the page
+  uint32_t live; ///< Header address of a live file in (or spanning into) the page, or 0
+  bool hasFiles;
+} JsfCompactPage;
+
+static const uint32_t jsfCompactBanks[] = { JSF_START_ADDRESS,
+#ifdef JSF_BANK2_START_ADDRESS
+                                            JSF_BANK2_START_ADDRESS,
+#endif
+                                          };
+#define JSF_COMPACT_BANKS (sizeof(jsfCompactBanks)/sizeof(uint32_t))
+/// Address of the page in each bank that background compaction has got up to
+static uint32_t jsfCompactCursor[JSF_COMPACT_BANKS];
+/// How many more steps background compaction can take (0 = not running)
+static uint32_t jsfCompactStepsLeft = 0;
+
+/// Work out a check value for the journal, so we can tell if it was written completely
+static uint32_t jsfCompactJournalCheck(JsfCompactJournal *journal) {
+  unsigned char *p = (unsigned char*)journal;
+  uint32_t len = JSF_COMPACT_JOURNAL_SIZE(journal->count) - (uint32_t)sizeof(uint32_t);
+  uint32_t check = 2166136261;
+  while (len--) check = (check ^ *(p++)) * 16777619;
+  return check;
+}
+
+/// Write a journal file at addr (which must be erased). Returns the address after it
+static uint32_t jsfCompactWriteJournal(uint32_t addr, JsfCompactJournal *journal) {
+  uint32_t len = JSF_COMPACT_JOURNAL_SIZE(journal->count);
+  uint32_t check = jsfCompactJournalCheck(journal);
+  memcpy(&journal->files[journal->count], &check, sizeof(check));
+  JsfFileHeader header;
+  header.size = len;
+  header.name = jsfNameFromString(JSF_COMPACT_JOURNAL);
+  jshFlashWrite(&header, addr, (uint32_t)sizeof(JsfFileHeader));
+  jshFlashWriteAligned(journal, addr+(uint32_t)sizeof(JsfFileHeader), len);
+  return addr + (uint32_t)sizeof(JsfFileHeader) + jsfAlignAddress(len);
+}
+
+/// Mark the file with its header at addr as trash, without touching the cache
+static void jsfCompactZeroName(uint32_t addr) {
+  uint32_t zero = 0;
+  jshFlashWrite(&zero, addr+(uint32_t)offsetof(JsfFileHeader,name), (uint32_t)sizeof(zero));
+}
+
+/// Copy the file with its header at 'from' to 'to' (which must be erased)
+static void jsfCompactCopyFile(uint32_t to, uint32_t from, JsfFileHeader *header) {
+  jshFlashWrite(header, to, (uint32_t)sizeof(JsfFileHeader));
+  uint32_t len = jsfAlignAddress(jsfGetFileSize(header));
+  to += (uint32_t)sizeof(JsfFileHeader);
+  from += (uint32_t)sizeof(JsfFileHeader);
+  unsigned char buf[128];
+  while (len) {
+    uint32_t l = len;
+    if (l>sizeof(buf)) l=sizeof(buf);
+    jshFlashRead(buf, from, l);
+    jshFlashWrite(buf, to, l);
+    from += l;
+    to += l;
+    len -= l;
+  }
+}
+
+/// A file has been copied from 'from' to 'to' - remove the original and update anything pointing to it
+static void jsfCompactFileMoved(uint32_t from, uint32_t to, JsfFileHeader *header) {
+  jsfCompactZeroName(from);
+  jsfUpdateMemoryAddress(from, (uint32_t)sizeof(JsfFileHeader) + jsfGetFileSize(header), to);
+  jsfCacheMoveFile(header, to+(uint32_t)sizeof(JsfFileHeader));
+}
+
+/// Erase the page in a JSFCJ_FILL journal and copy its files into it (this can be done again if power was lost)
+static void jsfCompactDoFill(JsfCompactJournal *journal) {
+  uint32_t pageAddr, pageLen;
+  if (!jshFlashGetPage(journal->from, &pageAddr, &pageLen)) return;
+  jshFlashErasePage(pageAddr);
+  uint32_t addr = journal->from;
+  for (uint32_t i=0;i<journal->count;i++) {
+    JsfCompactJournalFile *f = &journal->files[i];
+    jsfCompactCopyFile(addr, f->addr, &f->header);
+    addr += (uint32_t)sizeof(JsfFileHeader) + jsfAlignAddress(jsfGetFileSize(&f->header));
+  }
+  if (journal->to) {
+    // a file used to span into the next page - add trash that does the same
+    JsfFileHeader header;
+    memset(&header, 0, sizeof(JsfFileHeader));
+    header.size = journal->to - (addr+(uint32_t)sizeof(JsfFileHeader));
+    jshFlashWrite(&header, addr, (uint32_t)sizeof(JsfFileHeader));
+  }
+  // only now everything is copied can we remove the originals
+  addr = journal->from;
+  for (uint32_t i=0;i<journal->count;i++) {
+    JsfCompactJournalFile *f = &journal->files[i];
+    jsfCompactFileMoved(f->addr, addr, &f->header);
+    addr += (uint32_t)sizeof(JsfFileHeader) + jsfAlignAddress(jsfGetFileSize(&f->header));
+  }
+  jshKickWatchDog();
+}
+
+/** Work out what is in the page starting at pageAddr. *addr must be the address of a file
+ * header at or before the start of the page, and is set to the last file header before its end */
+static void jsfCompactGetPage(uint32_t pageAddr, uint32_t *addr, JsfCompactPage *page) {
+  uint32_t pageLen;
+  memset(page, 0, sizeof(JsfCompactPage));
+  if (!jshFlashGetPage(pageAddr, &page->start, &pageLen)) return;
+  page->end = page->start+pageLen;
+  page->first = page->start;
+  JsfFileHeader header;
+  uint32_t a = *addr;
+  if (jsfGetFileHeader(a, &header, false)) do {
+    if (a >= page->end) break;
+    *addr = a;
+    uint32_t fileEnd = a + (uint32_t)sizeof(JsfFileHeader) + jsfAlignAddress(jsfGetFileSize(&header));
+    if (fileEnd <= page->start) continue;
+    page->hasFiles = true;
+    if (a < page->start) { // spans into this page
+      page->first = fileEnd;
+      // if the header itself spans into the page we can't erase the page without changing the header
+      if (a+(uint32_t)sizeof(JsfFileHeader) > page->start)
+        page->first = page->end;
+    }
+    else if (header.name.firstChars == 0)
+      page->trashBytes += ((fileEnd < page->end) ? fileEnd : page->end) - a;
+    if (header.name.firstChars != 0 && !page->live)
+      page->live = a;
+    if (fileEnd > page->end) // spans out of this page
+      page->next = fileEnd;
+  } while (jsfGetNextFileHeader(&a, &header, GNFH_GET_ALL|GNFH_READ_ONLY_FILENAME_START));
+}
+
+/// Erase any pages at the end of Storage that only contain trash. Returns true if anything was erased
+static bool jsfCompactTruncate(uint32_t bankStart) {
+  uint32_t addr = bankStart, liveAddr = bankStart, liveEnd = bankStart, usedEnd = bankStart;
+  JsfFileHeader header;
+  if (jsfGetFileHeader(addr, &header, false)) do {
+    uint32_t fileEnd = addr + (uint32_t)sizeof(JsfFileHeader) + jsfAlignAddress(jsfGetFileSize(&header));
+    usedEnd = fileEnd;
+    if (header.name.firstChars != 0) {
+      liveAddr = addr;
+      liveEnd = fileEnd;
+    }
+  } while (jsfGetNextFileHeader(&addr, &header, GNFH_GET_ALL|GNFH_READ_ONLY_FILENAME_START));
+  // We can erase everything from the end of the page containing the last live file...
+  uint32_t pageAddr, pageLen;
+  if (liveEnd!=bankStart && jshFlashGetPage(liveEnd-1, &pageAddr, &pageLen))
+    liveEnd = pageAddr+pageLen;
+  // ...so long as that doesn't erase half of a header (which could make trash look like a file)
+  addr = liveAddr;
+  if (jsfGetFileHeader(addr, &header, false)) do {
+    if (addr >= liveEnd) break;
+    if (addr+(uint32_t)sizeof(JsfFileHeader) > liveEnd && jshFlashGetPage(liveEnd, &pageAddr, &pageLen))
+      liveEnd = pageAddr+pageLen;
+  } while (jsfGetNextFileHeader(&addr, &header, GNFH_GET_ALL|GNFH_READ_ONLY_FILENAME_START));
+  // Erase from the end backwards, so if we stop part way Storage is still valid
+  int erased = 0;
+  while (usedEnd>liveEnd && erased<JSF_COMPACT_ERASE_PAGES && jshFlashGetPage(usedEnd-1, &pageAddr, &pageLen)) {
+    if (!jsfIsErased(pageAddr, pageLen)) {
+      jsDebug(DBG_INFO,"compact> erase trash page 0x%08x\n", pageAddr);
+      jshFlashErasePage(pageAddr);
+      erased++;
+      jshKickWatchDog();
+    }
+    usedEnd = pageAddr;
+  }
+  return erased>0;
+}
+
+/// Copy the live file in the page elsewhere. Returns true on success
+static bool jsfCompactMove(uint32_t bankStart, JsfCompactPage *page) {
+  JsfFileHeader header;
+  jsfGetFileHeader(page->live, &header, true);
+  uint32_t fileSize = (uint32_t)sizeof(JsfFileHeader) + jsfAlignAddress(jsfGetFileSize(&header));
+  // Don't do big files, as one step shouldn't take too long
+  if (fileSize > JSF_COMPACT_ERASE_PAGES*(page->end-page->start)) return false;
+  // The journal goes right before the copy of the file
+  uint32_t journalSize = (uint32_t)sizeof(JsfFileHeader) + jsfAlignAddress(JSF_COMPACT_JOURNAL_SIZE(0));
+  uint32_t journalAddr = jsfFindFreeSpace(bankStart, journalSize+fileSize, page->start, page->end);
+  if (!journalAddr) return false;
+  JsfCompactJournal journal;
+  journal.type = JSFCJ_MOVE;
+  journal.from = page->live;
+  journal.to = journalAddr+journalSize;
+  journal.count = 0;
+  jsDebug(DBG_INFO,"compact> move 0x%08x => 0x%08x\n", journal.from, journal.to);
+  jsfCompactWriteJournal(journalAddr, &journal);
+  jsfCompactCopyFile(journal.to, journal.from, &header);
+  jsfCompactFileMoved(journal.from, journal.to, &header);
+  jsfCompactZeroName(journalAddr);
+  return true;
+}
+
+/// Erase a page that only contains trash, and fill it with the last files in Storage. Returns true on success
+static bool jsfCompactFill(uint32_t bankStart, JsfCompactPage *page) {
+  // Find the last few live files after this page
+  JsfCompactJournalFile last[JSF_COMPACT_FILL_FILES];
+  uint32_t lastCount = 0, lastIdx = 0;
+  uint32_t bankEnd = jsfGetBankEndAddress(bankStart);
+  uint32_t addr = page->next ? page->next : page->end;
+  uint32_t usedEnd = addr;
+  JsfFileHeader header;
+  if (addr < bankEnd && jsfGetFileHeader(addr, &header, false)) do {
+    usedEnd = addr + (uint32_t)sizeof(JsfFileHeader) + jsfAlignAddress(jsfGetFileSize(&header));
+    if (header.name.firstChars != 0) {
+      last[lastIdx].addr = addr;
+      lastIdx = (lastIdx+1) % JSF_COMPACT_FILL_FILES;
+      if (lastCount<JSF_COMPACT_FILL_FILES) lastCount++;
+    }
+  } while (jsfGetNextFileHeader(&addr, &header, GNFH_GET_ALL|GNFH_READ_ONLY_FILENAME_START));
+  // If a file spans out of the page we need space to add trash in its place
+  uint32_t limit = page->next ? page->end-(uint32_t)sizeof(JsfFileHeader) : page->end;
+  // Take as many as will fit, starting at the end
+  JsfCompactJournal journal;
+  journal.type = JSFCJ_FILL;
+  journal.from = page->first;
+  journal.to = page->next;
+  journal.count = 0;
+  uint32_t used = 0;
+  for (uint32_t i=0;i<lastCount;i++) {
+    JsfCompactJournalFile *f = &last[(lastIdx+JSF_COMPACT_FILL_FILES-1-i) % JSF_COMPACT_FILL_FILES];
+    jsfGetFileHeader(f->addr, &f->header, true);
+    uint32_t s = (uint32_t)sizeof(JsfFileHeader) + jsfAlignAddress(jsfGetFileSize(&f->header));
+    if (page->first+used+s > limit) continue;
+    journal.files[journal.count++] = *f;
+    used += s;
+  }
+  if (!journal.count) return false;
+  /* Until we're done, Storage can't be scanned past this page - so put the journal at the
+   * start of the page after the end of Storage, where jsfCompactRecover will look for it */
+  uint32_t pageAddr, pageLen;
+  if (!jshFlashGetPage(usedEnd-1, &pageAddr, &pageLen)) return false;
+  uint32_t journalAddr = pageAddr+pageLen;
+  uint32_t journalSize = (uint32_t)sizeof(JsfFileHeader)+JSF_COMPACT_JOURNAL_SIZE(journal.count);
+  if (journalAddr+journalSize > bankEnd || !jsfIsErased(journalAddr, journalSize)) return false;
+  jsDebug(DBG_INFO,"compact> refill page 0x%08x with %d files\n", page->start, journal.count);
+  jsfCompactWriteJournal(journalAddr, &journal);
+  jsfCompactDoFill(&journal);
+  jsfCompactZeroName(journalAddr);
+  return true;
+}
+
+/// Do one step of incremental compaction on the bank. Returns false if there's nothing more we can do
+static bool jsfBankCompactStep(unsigned int bank) {
+  uint32_t bankStart = jsfCompactBanks[bank];
+  uint32_t bankEnd = jsfGetBankEndAddress(bankStart);
+  uint32_t pageAddr = jsfCompactCursor[bank];
+  if (pageAddr>=bankEnd) return false;
+  if (jsfCompactTruncate(bankStart)) return true;
+  uint32_t addr = bankStart;
+  JsfCompactPage page;
+  while (pageAddr<bankEnd) {
+    jsfCompactGetPage(pageAddr, &addr, &page);
+    if (!page.hasFiles) break; // a blank page - the end of Storage
+    // only bother if at least half the page is trash we could reclaim
+    if (page.first<page.end && page.trashBytes*2 >= page.end-page.start) {
+      if (page.live) {
+        if (jsfCompactMove(bankStart, &page)) {
+          jsfCompactCursor[bank] = page.start;
+          return true;
+        }
+      } else if (jsfCompactFill(bankStart, &page)) {
+        jsfCompactCursor[bank] = page.end; // don't try and refill this page again
+        return true;
+      }
+    }
+    pageAddr = page.end;
+  }
+  jsfCompactCursor[bank] = bankEnd;
+  return false;
+}
+
+/// Stop any background compaction that is in progress
+static void jsfCompactStop() {
+  jsfCompactStepsLeft = 0;
+  jsfCompactTrashSinceCheck = 0;
+}
+
+/// Finish (or undo) the step described by the journal with its header at addr
+static void jsfCompactRecoverJournal(uint32_t addr, JsfFileHeader *header) {
+  jsDebug(DBG_INFO,"compact> recovering from journal at 0x%08x\n", addr);
+  JsfCompactJournal journal;
+  uint32_t len = jsfGetFileSize(header);
+  if (len <= sizeof(JsfCompactJournal)) {
+    jshFlashRead(&journal, addr+(uint32_t)sizeof(JsfFileHeader), len);
+    uint32_t check;
+    memcpy(&check, ((char*)&journal)+len-sizeof(check), sizeof(check));
+    // if the journal wasn't written completely, we hadn't started moving anything
+    if (journal.count<=JSF_COMPACT_FILL_FILES &&
+        len==JSF_COMPACT_JOURNAL_SIZE(journal.count) &&
+        check==jsfCompactJournalCheck(&journal)) {
+      if (journal.type==JSFCJ_MOVE) {
+        // If the original is still there we may not have finished copying, so remove the copy
+        if (jsfGetFileHeader(journal.from, header, false) && header->name.firstChars!=0 &&
+            jsfGetFileHeader(journal.to, header, false))
+          jsfCompactZeroName(journal.to);
+      } else if (journal.type==JSFCJ_FILL) {
+        jsfCompactDoFill(&journal);
+      }
+    }
+  }
+  jsfCompactZeroName(addr);
+}
+
+/// If we lost power during an incremental compaction step, finish (or undo) it
+void jsfCompactRecover() {
+  JsfFileName name = jsfNameFromString(JSF_COMPACT_JOURNAL);
+  JsfFileHeader header;
+  for (unsigned int b=0;b<JSF_COMPACT_BANKS;b++) {
+    uint32_t bankEnd = jsfGetBankEndAddress(jsfCompactBanks[b]);
+    // JSFCJ_FILL journals are at the start of a page, as we may not be able to get to them by scanning Storage
+    uint32_t addr = jsfCompactBanks[b];
+    while (addr) {
+      if (jsfGetFileHeader(addr, &header, true) && !memcmp(header.name.c, name.c, sizeof(name.c)))
+        jsfCompactRecoverJournal(addr, &header);
+      addr = jsfGetAddressOfNextPage(addr);
+    }
+    // JSFCJ_MOVE journals could be anywhere
+    addr = jsfBankFindFile(jsfCompactBanks[b], bankEnd, name, &header);
+    if (addr) jsfCompactRecoverJournal(addr-(uint32_t)sizeof(JsfFileHeader), &header);
+  }
+  jsfCacheClear();
+}
+
+/// Called when idle. If Storage is getting full of trash, compact a little bit of it. Returns true if there's more to do
+bool jsfCompactIdle() {
+  if (!jsfCompactStepsLeft) {
+    // Only check (which means scanning Storage) if enough has been erased since we last did
+    if (jsfCompactTrashSinceCheck < JSF_COMPACT_CHECK_BYTES) return false;
+    jsfCompactTrashSinceCheck = 0;
+    for (unsigned int b=0;b<JSF_COMPACT_BANKS;b++) {
+      uint32_t bankStart = jsfCompactBanks[b];
+      JsfStorageStats stats = jsfGetStorageStats(bankStart, true);
+      uint32_t pageAddr, pageLen;
+      if (stats.trashBytes*JSF_COMPACT_TRASH_RATIO >= stats.trashBytes+stats.free &&
+          jshFlashGetPage(bankStart, &pageAddr, &pageLen)) {
+        jsDebug(DBG_INFO,"compact> starting background compaction (%d bytes trash)\n", stats.trashBytes);
+        jsfCompactCursor[b] = bankStart;
+        // every page can need a few steps - but make sure we stop eventually
+        jsfCompactStepsLeft += 4 * stats.total / pageLen;
+      } else
+        jsfCompactCursor[b] = jsfGetBankEndAddress(bankStart);
+    }
+    if (!jsfCompactStepsLeft) return false;
+  }
+  bool busy = false;
+  for (unsigned int b=0;b<JSF_COMPACT_BANKS;b++)
+    busy |= jsfBankCompactStep(b);
+  if (!busy || !--jsfCompactStepsLeft) {
+    jsDebug(DBG_INFO,"compact> background compaction finished\n");
+    jsfCompactStepsLeft = 0;
+  }
+  return busy;
+}
+#else
+void jsfCompactRecover() {}
+bool jsfCompactIdle() { return false; }
+static void jsfCompactStop() {}
+#endif
+
 static void jsfBankDebugFiles(uint32_t addr) {
   uint32_t pageAddr = 0, pageLen = 0, pageEndAddr = 0;
 
@@ -867,6 +1474,10 @@ JsVar *jsfReadFile(JsfFileName name, int offset, int length) {
   JsfFileHeader header;
   uint32_t addr = jsfFindFile(name, &header);
   if (!addr) return 0;
+#ifdef JSF_COMPRESSED_FILES
+  if (jsfGetFileFlags(&header)&JSFF_COMPRESSED_BLOCKS)
+    return jsfReadCompressedFile(addr, offset, length);
+#endif
   // clip requested read lengths
   if (offset<0) offset=0;
   int fileLen = (int)jsfGetFileSize(&header);
@@ -888,16 +1499,17 @@ JsVar* jsvAddressToVar(size_t addr, uint32_t length) {
   }
 #endif
 #ifdef LINUX
-  // linux fakes flash with a file, so we can't just return a pointer to it!
-  uint32_t alignedSize = jsfAlignAddress((uint32_t)length);
-  char *d = (char*)malloc(alignedSize);
-  jshFlashRead(d, addr, alignedSize);
-  JsVar *v = jsvNewStringOfLength((uint32_t)length, d);
-  free(d);
-  return v;
-#else
-  return jsvNewNativeString((char*)mappedAddr, length);
+  // linux fakes flash with a file - if that couldn't be memory-mapped we have to copy the data out
+  if (!mappedAddr) {
+    uint32_t alignedSize = jsfAlignAddress((uint32_t)length);
+    char *d = (char*)malloc(alignedSize);
+    jshFlashRead(d, addr, alignedSize);
+    JsVar *v = jsvNewStringOfLength((uint32_t)length, d);
+    free(d);
+    return v;
+  }
 #endif
+  return jsvNewNativeString((char*)mappedAddr, length);
 }
 
 bool jsfWriteFile(JsfFileName name, JsVar *data, JsfFileFlags flags, JsVarInt offset, JsVarInt _size) {
@@ -909,6 +1521,19 @@ bool jsfWriteFile(JsfFileName name, JsVar *data, JsfFileFlags flags, JsVarInt of
     jsExceptionHere(JSET_ERROR, "Can't get pointer to data to write");
     return false;
   }
+  if (flags&JSFF_COMPRESSED_BLOCKS) {
+    flags = (JsfFileFlags)(flags^JSFF_COMPRESSED_BLOCKS);
+#ifdef JSF_COMPRESSED_FILES
+    if (offset || size) {
+      jsExceptionHere(JSET_ERROR, "Compressed files must be written all at once");
+      return false;
+    }
+    uint32_t *table = (uint32_t*)alloca(jsfGetCompressedTableSize((uint32_t)dLen));
+    uint32_t compressedSize = jsfGetCompressedTable(dPtr, (uint32_t)dLen, table);
+    if (compressedSize < dLen) // if compressing doesn't make it smaller, just write it normally
+      return jsfWriteCompressedFile(name, dPtr, (uint32_t)dLen, table, compressedSize);
+#endif
+  }
   if (size==0) size=(uint32_t)dLen;
   if (!size) {
     jsExceptionHere(JSET_ERROR, "Can't create zero length file");
@@ -952,6 +1577,10 @@ bool jsfWriteFile(JsfFileName name, JsVar *data, JsfFileFlags flags, JsVarInt of
     jsExceptionHere(JSET_ERROR, "Unable to find or create file");
     return false;
   }
+  if (jsfGetFileFlags(&header)&JSFF_COMPRESSED_BLOCKS) {
+    jsExceptionHere(JSET_ERROR, "Can't write part of a compressed file");
+    return false;
+  }
   if ((uint32_t)offset+(uint32_t)dLen > jsfGetFileSize(&header)) {
     jsExceptionHere(JSET_ERROR, "Too much data for file size");
     return false;
@@ -967,46 +1596,62 @@ bool jsfWriteFile(JsfFileName name, JsVar *data, JsfFileFlags flags, JsVarInt of
   return true;
 }
 
+/// Add the file with this header (at addr) to the list of files and/or hash if it matches
+static void jsfListFilesAdd(JsVar *files, uint32_t addr, JsfFileHeader header, JsVar *regex, JsfFileFlags containing, JsfFileFlags notContaining, uint32_t *hash) {
+  JsfFileFlags flags = jsfGetFileFlags(&header);
+  if (notContaining&flags) return;
+  if (containing && !(containing&flags)) return;
+  if (flags&JSFF_STORAGEFILE) {
+    // find last char
+    int i = 0;
+    while (i+1<sizeof(header.name) && header.name.c[i+1]) i++;
+    // if last ch isn't \1 (eg first StorageFile) ignore this
+    if (header.name.c[i]!=1) return;
+    // if we're specifically asking for StorageFile, remove last char
+    if (containing&JSFF_STORAGEFILE)
+      header.name.c[i]=0;
+  }
+  JsVar *v = jsfVarFromName(header.name);
+  bool match = true;
+  if (regex) {
+    JsVar *m = jswrap_string_match(v,regex);
+    match = !(jsvIsUndefined(m) || jsvIsNull(m));
+    jsvUnLock(m);
+  }
+#ifndef SAVE_ON_FLASH
+  if (hash && match) {
+    *hash = (*hash<<1) | (*hash>>31); // roll hash
+    *hash = *hash ^ addr ^ jsvGetIntegerAndUnLock(jswrap_espruino_CRC32(v)); // apply filename
+  }
+#endif
+  if (match && files) jsvArrayPushAndUnLock(files, v);
+  else jsvUnLock(v);
+}
+
 /** Return all files in flash as a JsVar array of names. If regex is supplied, it is used to filter the filenames using String.match(regexp)
  * If containing!=0, file flags must contain one of the 'containing' argument's bits.
  * Flags can't contain any bits in the 'notContaining' argument
  */
 static void jsfBankListFiles(JsVar *files, uint32_t addr, JsVar *regex, JsfFileFlags containing, JsfFileFlags notContaining, uint32_t *hash) {
   JsfFileHeader header;
+#if ESPR_USE_STORAGE_INDEX
+  if (jsfIndexState == JSFI_NONE) jsfIndexBuild();
+  if (jsfIndexState == JSFI_VALID && jsuGetFreeStack() > 256+jsfIndexCount*sizeof(uint32_t)) {
+    // we have all the files in RAM - just go through them in the order they are in flash
+    uint32_t *slots = (uint32_t*)alloca(jsfIndexCount*sizeof(uint32_t));
+    uint32_t n = jsfIndexGetFiles(addr, jsfGetBankEndAddress(addr), slots);
+    for (uint32_t i=0;i<n;i++) {
+      header = jsfIndex[slots[i]].header;
+      jsfListFilesAdd(files, jsfIndex[slots[i]].addr-(uint32_t)sizeof(JsfFileHeader), header, regex, containing, notContaining, hash);
+    }
+    return;
+  }
+#endif
   memset(&header,0,sizeof(JsfFileHeader));
   if (jsfGetFileHeader(addr, &header, true)) do {
-    if (header.name.firstChars != 0) { // if not replaced
-      JsfFileFlags flags = jsfGetFileFlags(&header);
-      if (notContaining&flags) continue;
-      if (containing && !(containing&flags)) continue;
-      if (flags&JSFF_STORAGEFILE) {
-        // find last char
-        int i = 0;
-        while (i+1<sizeof(header.name) && header.name.c[i+1]) i++;
-        // if last ch isn't \1 (eg first StorageFile) ignore this
-        if (header.name.c[i]!=1) continue;
-        // if we're specifically asking for StorageFile, remove last char
-        if (containing&JSFF_STORAGEFILE)
-          header.name.c[i]=0;
-      }
-      JsVar *v = jsfVarFromName(header.name);
-      bool match = true;
-      if (regex) {
-        JsVar *m = jswrap_string_match(v,regex);
-        match = !(jsvIsUndefined(m) || jsvIsNull(m));
-        jsvUnLock(m);
-      }
-#ifndef SAVE_ON_FLASH
-      if (hash && match) {
-        *hash = (*hash<<1) | (*hash>>31); // roll hash
-        *hash = *hash ^ addr ^ jsvGetIntegerAndUnLock(jswrap_espruino_CRC32(v)); // apply filename
-      }
-#endif
-      if (match && files) jsvArrayPushAndUnLock(files, v);
-      else jsvUnLock(v);
-    }
+    if (header.name.firstChars != 0) // if not replaced
+      jsfListFilesAdd(files, addr, header, regex, containing, notContaining, hash);
   } while (jsfGetNextFileHeader(&addr, &header, GNFH_GET_ALL));
-
 }
 
 /** Return all files in flash as a JsVar array of names. If regex is supplied, it is used to filter the filenames using String.match(regexp)
@@ -1098,6 +1743,127 @@ int jsfLoadFromFlash_readcb(uint32_t *cbdata) {
   return data->buffer[data->bufferCnt++];
 }
 
+#ifdef JSF_COMPRESSED_FILES
+// ------------------------------------------------------------------------ Compressed files (JSFF_COMPRESSED_BLOCKS)
+
+// cbdata = struct jsfcbData. Like jsfSaveToFlash_writecb, but without the progress dots
+static void jsfCompressed_writecb(unsigned char ch, uint32_t *cbdata) {
+  jsfcbData *data = (jsfcbData*)cbdata;
+  data->buffer[data->bufferCnt++] = ch;
+  if (data->bufferCnt>=(uint32_t)sizeof(data->buffer)) {
+    jshFlashWrite(data->buffer, data->address, data->bufferCnt);
+    data->address += data->bufferCnt;
+    data->bufferCnt = 0;
+  }
+}
+
+/// The size of the table at the start of a JSFF_COMPRESSED_BLOCKS file (padded so the blocks start aligned)
+static uint32_t jsfGetCompressedTableSize(uint32_t length) {
+  uint32_t blocks = (length+JSF_COMPRESSED_BLOCK_SIZE-1) / JSF_COMPRESSED_BLOCK_SIZE;
+  return jsfAlignAddress((uint32_t)sizeof(uint32_t)*(blocks+2)); // length + block offsets
+}
+
+/** Fill in the table at the start of a JSFF_COMPRESSED_BLOCKS file for 'data' (jsfGetCompressedTableSize bytes)
+ * by working out how big each block is once compressed, and return the size of the file */
+static uint32_t jsfGetCompressedTable(const char *data, uint32_t length, uint32_t *table) {
+  uint32_t tableSize = jsfGetCompressedTableSize(length);
+  memset(table, 0xFF, tableSize);
+  table[0] = length;
+  uint32_t offset = tableSize, block = 0;
+  for (uint32_t i=0;i<length;i+=JSF_COMPRESSED_BLOCK_SIZE) {
+    table[++block] = offset;
+    uint32_t blockLen = length-i;
+    if (blockLen>JSF_COMPRESSED_BLOCK_SIZE) blockLen=JSF_COMPRESSED_BLOCK_SIZE;
+    offset += heatshrink_encode((unsigned char*)&data[i], blockLen, NULL, NULL);
+  }
+  table[++block] = offset; // end of the last block
+  return offset;
+}
+
+/** Write 'data' to a new JSFF_COMPRESSED_BLOCKS file (replacing any file of the same name). table and compressedSize
+ * are from jsfGetCompressedTable. The table is written in one go and the blocks are written in aligned chunks, so no
+ * part of flash is written twice */
+static bool jsfWriteCompressedFile(JsfFileName name, const char *data, uint32_t length, uint32_t *table, uint32_t compressedSize) {
+  JsfFileHeader header;
+  uint32_t addr = jsfFindFile(name, &header);
+  if (addr) jsfEraseFileInternal(addr, &header);
+  addr = jsfCreateFile(name, compressedSize, JSFF_COMPRESSED_BLOCKS, &header);
+  if (!addr) {
+    jsExceptionHere(JSET_ERROR, "Unable to find or create file");
+    return false;
+  }
+  uint32_t tableSize = jsfGetCompressedTableSize(length);
+  jshFlashWrite(table, addr, tableSize);
+  jsfcbData cbData;
+  memset(&cbData, 0, sizeof(cbData));
+  cbData.address = addr + tableSize;
+  for (uint32_t i=0;i<length;i+=JSF_COMPRESSED_BLOCK_SIZE) {
+    uint32_t blockLen = length-i;
+    if (blockLen>JSF_COMPRESSED_BLOCK_SIZE) blockLen=JSF_COMPRESSED_BLOCK_SIZE;
+    heatshrink_encode((unsigned char*)&data[i], blockLen, jsfCompressed_writecb, (uint32_t*)&cbData);
+  }
+  assert(cbData.address + cbData.bufferCnt == addr + compressedSize);
+  if (cbData.bufferCnt) {
+    // pad to alignment - jsfCreateFile left room for this
+    while (cbData.bufferCnt & (JSF_ALIGNMENT-1))
+      cbData.buffer[cbData.bufferCnt++] = 0xFF;
+    jshFlashWrite(cbData.buffer, cbData.address, cbData.bufferCnt);
+  }
+  return true;
+}
+
+uint32_t jsfGetDecompressedSize(uint32_t addr) {
+  uint32_t length;
+  jshFlashRead(&length, addr, (uint32_t)sizeof(length));
+  return length;
+}
+
+/// Decompress 'length' bytes from 'offset' onwards in a JSFF_COMPRESSED_BLOCKS file, only decompressing the blocks that contain them
+static uint32_t jsfDecompressRange(uint32_t addr, uint32_t offset, uint32_t length, void (*out_callback)(unsigned char ch, uint32_t *cbdata), uint32_t *out_cbdata) {
+  uint32_t fileLength = jsfGetDecompressedSize(addr);
+  if (offset>=fileLength) return 0;
+  if (length>fileLength-offset) length=fileLength-offset;
+  uint32_t written = 0;
+  while (written<length) {
+    uint32_t block = (offset+written) / JSF_COMPRESSED_BLOCK_SIZE;
+    uint32_t blockOffset[2]; // start and end of this block
+    jshFlashRead(blockOffset, addr + (uint32_t)sizeof(uint32_t)*(block+1), (uint32_t)sizeof(blockOffset));
+    jsfcbData cbData;
+    memset(&cbData, 0, sizeof(cbData));
+    cbData.address = addr+blockOffset[0];
+    cbData.endAddress = addr+blockOffset[1];
+    uint32_t l = heatshrink_decode_range_cb(jsfLoadFromFlash_readcb, (uint32_t*)&cbData,
+        offset+written - block*JSF_COMPRESSED_BLOCK_SIZE, length-written,
+        out_callback, out_cbdata);
+    if (!l) break; // corrupt file?
+    written += l;
+  }
+  return written;
+}
+
+uint32_t jsfReadDecompressed(uint32_t addr, uint32_t offset, void *buf, uint32_t length) {
+  unsigned char *dataPtr = (unsigned char*)buf;
+  return jsfDecompressRange(addr, offset, length, heatshrink_ptr_output_cb, (uint32_t*)&dataPtr);
+}
+
+/// Like jsfReadFile, but for a JSFF_COMPRESSED_BLOCKS file - the data is decompressed into RAM
+static JsVar *jsfReadCompressedFile(uint32_t addr, int offset, int length) {
+  int fileLen = (int)jsfGetDecompressedSize(addr);
+  if (offset<0) offset=0;
+  if (length<=0) length=fileLen;
+  if (offset>fileLen) offset=fileLen;
+  if (offset+length>fileLen) length=fileLen-offset;
+  if (length<=0) return jsvNewFromEmptyString();
+  JsVar *v = jsvNewStringOfLength((unsigned int)length, NULL);
+  if (!v) return 0;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, v, 0);
+  jsfDecompressRange(addr, (uint32_t)offset, (uint32_t)length, heatshrink_var_output_cb, (uint32_t*)&it);
+  jsvStringIteratorFree(&it);
+  return v;
+}
+#endif // JSF_COMPRESSED_FILES
+
 /// Save the RAM image to flash (this is the actual interpreter state)
 void jsfSaveToFlash() {
 #ifdef ESPR_NO_VARIMAGE
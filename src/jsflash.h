@@ -33,10 +33,23 @@ typedef struct {
 
 typedef enum {
   JSFF_NONE,
+  JSFF_COMPRESSED_BLOCKS = 32, // This file was written with Storage.write(..., {compress:true}) - see JSF_COMPRESSED_FILES
   JSFF_STORAGEFILE = 64,  // This file is a 'storage file' created by Storage.open
   JSFF_COMPRESSED = 128   // This file contains compressed data (used only for .varimg currently)
 } JsfFileFlags; // these are stored in the top 8 bits of JsfFileHeader.size
 
+#if defined(USE_HEATSHRINK) && !defined(SAVE_ON_FLASH)
+/* Files with JSFF_COMPRESSED_BLOCKS contain:
+ *   uint32_t length;                 // the length of the data once decompressed
+ *   uint32_t blockOffset[blocks+1];  // offset (from the start of the file) of each compressed block, and of the end of the last one
+ *   ... padding to JSF_ALIGNMENT
+ *   ... compressed blocks
+ * Each block is JSF_COMPRESSED_BLOCK_SIZE bytes of data (less for the last one) compressed separately with heatshrink,
+ * so to read from the middle of a file we only have to decompress the blocks that contain the data we want. */
+#define JSF_COMPRESSED_FILES
+#define JSF_COMPRESSED_BLOCK_SIZE 1024
+#endif
+
 
 // ------------------------------------------------------------------------ Flash Storage Functionality
 /// utility function for creating JsfFileName
@@ -59,14 +72,24 @@ uint32_t jsfFindFileFromAddr(uint32_t containsAddr, JsfFileHeader *returnedHeade
 JsVar* jsvAddressToVar(size_t addr, uint32_t length);
 /// Return the contents of a file as a memory mapped var
 JsVar *jsfReadFile(JsfFileName name, int offset, int length);
-/// Write a file. For simple stuff just leave offset and size as 0
+/// Write a file. For simple stuff just leave offset and size as 0. If flags contains JSFF_COMPRESSED_BLOCKS, offset and size must be 0
 bool jsfWriteFile(JsfFileName name, JsVar *data, JsfFileFlags flags, JsVarInt offset, JsVarInt _size);
+#ifdef JSF_COMPRESSED_FILES
+/// Return the length of the data in a JSFF_COMPRESSED_BLOCKS file (at addr) once it is decompressed
+uint32_t jsfGetDecompressedSize(uint32_t addr);
+/// Decompress 'length' bytes from 'offset' onwards in a JSFF_COMPRESSED_BLOCKS file (at addr) into buf. Returns the number of bytes read
+uint32_t jsfReadDecompressed(uint32_t addr, uint32_t offset, void *buf, uint32_t length);
+#endif
 /// Erase the given file, return true on success
 bool jsfEraseFile(JsfFileName name);
 /// Erase the entire contents of the memory store
 bool jsfEraseAll();
 /// Try and compact saved data so it'll fit in Flash again
 bool jsfCompact();
+/// If we lost power part way through an incremental compaction step, finish (or undo) it
+void jsfCompactRecover();
+/// Called when idle. If Storage is getting full of trash, compact a little bit of it. Returns true if there's more to do
+bool jsfCompactIdle();
 /** Return all files in flash as a JsVar array of names. If regex is supplied, it is used to filter the filenames using String.match(regexp)
  * If containing!=0, file flags must contain one of the 'containing' argument's bits.
  * Flags can't contain any bits in the 'notContaining' argument
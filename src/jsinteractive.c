@@ -21,10 +21,12 @@
 #include "jswrap_json.h"
 #include "jswrap_io.h"
 #include "jswrap_stream.h"
+#include "jsserial.h"
 #include "jswrap_espruino.h" // jswrap_espruino_getErrorFlagArray
 #include "jsflash.h" // load and save to flash
 #include "jswrap_interactive.h" // jswrap_interactive_setTimeout
 #include "jswrap_object.h" // jswrap_object_keys_or_property_names
+#include "jswrap_map.h" // jswrap_map_getEntries
 #include "jsnative.h" // jsnSanityTest
 #ifdef BLUETOOTH
 #include "bluetooth.h"
@@ -220,14 +222,32 @@ NO_INLINE void jsiConsolePrintChar(char data) {
   jshTransmit(consoleDevice, (unsigned char)data);
 }
 
+/**
+ * Send a block of characters to the console, converting '\n' to '\r\n'
+ * and following it with newLineCh (if it is not 0).
+ */
+static void jsiConsolePrintBuf(const char *str, size_t len, char newLineCh) {
+  while (len) {
+    const char *nl = memchr(str, '\n', len);
+    size_t chars = nl ? (size_t)(nl-str) : len;
+    jshTransmitBlock(consoleDevice, (const unsigned char *)str, (unsigned int)chars);
+    str += chars;
+    len -= chars;
+    if (nl) {
+      jsiConsolePrintChar('\r');
+      jsiConsolePrintChar('\n');
+      if (newLineCh) jsiConsolePrintChar(newLineCh);
+      str++;
+      len--;
+    }
+  }
+}
+
 /**
  * \breif Send a NULL terminated string to the console.
  */
 NO_INLINE void jsiConsolePrintString(const char *str) {
-  while (*str) {
-    if (*str == '\n') jsiConsolePrintChar('\r');
-    jsiConsolePrintChar(*(str++));
-  }
+  jsiConsolePrintBuf(str, strlen(str), 0);
 }
 
 #ifdef USE_FLASH_MEMORY
@@ -288,10 +308,10 @@ void jsiConsolePrintStringVarWithNewLineChar(JsVar *v, size_t fromCharacter, cha
   JsvStringIterator it;
   jsvStringIteratorNew(&it, v, fromCharacter);
   while (jsvStringIteratorHasChar(&it)) {
-    char ch = jsvStringIteratorGetCharAndNext(&it);
-    if (ch == '\n') jsiConsolePrintChar('\r');
-    jsiConsolePrintChar(ch);
-    if (ch == '\n' && newLineCh) jsiConsolePrintChar(newLineCh);
+    unsigned char *data;
+    unsigned int len;
+    jsvStringIteratorGetPtrAndNext(&it, &data, &len);
+    jsiConsolePrintBuf((const char *)data, len, newLineCh);
   }
   jsvStringIteratorFree(&it);
 }
@@ -796,6 +816,8 @@ void jsiSemiInit(bool autoLoad, JsfFileName *loadedFilename) {
 #ifdef BANGLEJS
     jsiConsolePrintf("Checking storage...\n");
 #endif
+    // finish off anything background compaction was doing when we lost power
+    jsfCompactRecover();
     if (!jsfIsStorageValid(JSFSTT_NORMAL)) {
       jsiConsolePrintf("Storage is corrupt.\n");
       jsfResetStorage();
@@ -951,6 +973,8 @@ int jsiCountBracketsInInput() {
 
 /// Tries to get rid of some memory (by clearing command history). Returns true if it got rid of something, false if it didn't.
 bool jsiFreeMoreMemory() {
+  // free any caches that libraries have first
+  if (jswFreeMoreMemory()) return true;
 #ifdef USE_DEBUGGER
   // remove debug history first
   jsvObjectRemoveChild(execInfo.hiddenRoot, JSI_DEBUG_HISTORY_NAME);
@@ -1786,6 +1810,27 @@ JsVar *jsiSetTimeout(void (*functionPtr)(void), JsVarFloat milliseconds) {
   return idx;
 }
 
+void jsiSetTimeoutOnce(const char *name, void (*functionPtr)(void), JsVarFloat milliseconds) {
+  JsVar *timerArrayPtr = jsvLock(timerArray);
+  JsVar *timer = jsvObjectGetChild(execInfo.hiddenRoot, name, 0);
+  // it may have been removed with clearTimeout()
+  JsVar *timerName = timer ? jsvGetIndexOf(timerArrayPtr, timer, true) : 0;
+  if (timerName) {
+    JsSysTime time = jshGetSystemTime() - jsiLastIdleTime + jshGetTimeFromMilliseconds(milliseconds);
+    if ((JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChild(timer, "time", 0)) > time) {
+      jsvObjectSetChildAndUnLock(timer, "time", jsvNewFromLongInteger(time));
+      jsiTimersChanged();
+    }
+  } else {
+    JsVar *idx = jsiSetTimeout(functionPtr, milliseconds);
+    if (idx) {
+      jsvObjectSetChildAndUnLock(execInfo.hiddenRoot, name, jsvSkipNameAndUnLock(jsvFindChildFromVar(timerArrayPtr, idx, false)));
+      jsvUnLock(idx);
+    }
+  }
+  jsvUnLock3(timerName, timer, timerArrayPtr);
+}
+
 bool jsiHasTimers() {
   if (!timerArray) return false;
   JsVar *timerArrayPtr = jsvLock(timerArray);
@@ -1843,17 +1888,16 @@ static JsVar *jsiExtractIOEventData(IOEvent *event, int *eventsHandled) {
     jsvStringIteratorNew(&it, stringData, 0);
 
     int i, chars = IOEVENTFLAGS_GETCHARS(event->flags);
-    while (chars) {
-      for (i=0;i<chars;i++) {
-        jsvStringIteratorAppend(&it, event->data.chars[i]);
-      }
-      // look down the stack and see if there is more data
-      if (jshIsTopEvent(IOEVENTFLAGS_GETTYPE(event->flags))) {
-        jshPopIOEvent(event);
-        (*eventsHandled)++;
-        chars = IOEVENTFLAGS_GETCHARS(event->flags);
-      } else
-        chars = 0;
+    for (i=0;i<chars;i++)
+      jsvStringIteratorAppend(&it, event->data.chars[i]);
+    // look down the stack and grab any more data for this device in blocks
+    IOEventFlags device = IOEVENTFLAGS_GETTYPE(event->flags);
+    char buf[64];
+    unsigned int len;
+    while ((len = jshPopIOEvents(device, buf, sizeof(buf), eventsHandled))) {
+      unsigned int j;
+      for (j=0;j<len;j++)
+        jsvStringIteratorAppend(&it, buf[j]);
     }
     jsvStringIteratorFree(&it);
   }
@@ -1867,8 +1911,8 @@ int jsiHandleIOEventForSerial(JsVar *usartClass, IOEvent *event) {
   int eventsHandled = 0;
   JsVar *stringData = jsiExtractIOEventData(event,  &eventsHandled);
   if (stringData) {
-    // Now run the handler
-    jswrap_stream_pushData(usartClass, stringData, true);
+    // Now run the handler (or add to the coalescing buffer)
+    jsserialPushData(usartClass, stringData);
     jsvUnLock(stringData);
   }
   return eventsHandled;
@@ -2388,7 +2432,13 @@ void jsiDumpState(vcbprintf_callback user_callback, void *user_data) {
         // normal variable definition
         cbprintf(user_callback, user_data, "var %v = ", child);
         bool hasProto = false;
+#ifndef SAVE_ON_FLASH
+        JsVar *mapEntries = jswrap_map_getEntries(data, 0);
+        jsvUnLock(mapEntries);
+        if (jsvIsObject(data) && !mapEntries) { // Map/Set are written with 'new Map(...)' by jsiDumpJSON
+#else
         if (jsvIsObject(data)) {
+#endif
           JsVar *proto = jsvObjectGetChild(data, JSPARSE_INHERITS_VAR, 0);
           if (proto) {
             JsVar *protoName = jsvGetPathTo(execInfo.root, proto, 4, data);
@@ -66,6 +66,10 @@ bool jsiExecuteEventCallbackOn(const char *objectName, const char *cbName, unsig
 
 /// Create a timeout in JS to execute the given native function (outside of an IRQ). Returns the index
 JsVar *jsiSetTimeout(void (*functionPtr)(void), JsVarFloat milliseconds);
+/** Like jsiSetTimeout, but keeps the timer in hiddenRoot under 'name' so only one is ever pending.
+ * If it is, it's just brought forward if needed. The native function must remove 'name' from
+ * hiddenRoot when it runs (before calling this again) */
+void jsiSetTimeoutOnce(const char *name, void (*functionPtr)(void), JsVarFloat milliseconds);
 
 IOEventFlags jsiGetDeviceFromClass(JsVar *deviceClass);
 JsVar *jsiGetClassNameFromDevice(IOEventFlags device);
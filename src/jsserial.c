@@ -22,6 +22,11 @@ void jsserialHardwareFunc(unsigned char data, serial_sender_data *info) {
   jshTransmit(device, data);
 }
 
+void jsserialHardwareBlockFunc(unsigned char *data, unsigned int len, void *info) {
+  IOEventFlags device = *(IOEventFlags*)info;
+  jshTransmitBlock(device, data, len);
+}
+
 #ifndef SAVE_ON_FLASH
 /**
  * Send a single byte through Serial.
@@ -113,6 +118,9 @@ bool jsserialPopulateUSARTInfo(
       {"parity", JSV_OBJECT /* a variable */, &parity},
       {"flow", JSV_OBJECT /* a variable */, &flow},
       {"errors", JSV_BOOLEAN, &inf->errorHandling},
+#ifndef SAVE_ON_FLASH
+      {"coalesce", JSV_OBJECT, 0}, // handled by jsserialCoalesceSetup
+#endif
   };
 
   if (!jsvIsUndefined(baud)) {
@@ -297,7 +305,7 @@ bool jsserialEventCallbackIdle() {
         JsVar *stringData = jsvNewStringOfLength(data->bufLen, data->buf);
         data->bufLen = 0;
         if (stringData) {
-          jswrap_stream_pushData(parent, stringData, true);
+          jsserialPushData(parent, stringData);
           jsvUnLock(stringData);
         }
       }
@@ -341,3 +349,188 @@ void jsserialEventCallback(bool state, IOEventFlags channel) {
 
 }
 #endif
+
+#ifndef SAVE_ON_FLASH
+/// Received data is coalesced into this (followed by 'size' bytes of data), stored in a flat string
+typedef struct {
+  uint16_t size; ///< deliver data once we have this many bytes
+  uint16_t latency; ///< deliver data once the oldest byte has waited this many milliseconds (0 = never)
+  int16_t delimiter; ///< deliver data up to and including this character (or -1)
+  uint16_t length; ///< amount of data currently buffered
+  JsSysTime firstTime; ///< when the oldest buffered byte arrived
+} SerialCoalesceData;
+
+#define SERIAL_COALESCE_NAME JS_HIDDEN_CHAR_STR"coalesce"
+#define SERIAL_COALESCE_TIMER_NAME "serialrxT" ///< the one pending coalescing timer, in hiddenRoot
+
+static SerialCoalesceData *jsserialGetCoalesceData(JsVar *dataVar) {
+  return jsvIsFlatString(dataVar) ? (SerialCoalesceData *)jsvGetFlatStringPointer(dataVar) : 0;
+}
+
+/// List of Serial objects that have coalescing enabled (so the timeout can find them)
+static JsVar *jsserialGetCoalesceList(bool create) {
+  return jsvObjectGetChild(execInfo.hiddenRoot, "serialrx", create?JSV_ARRAY:0);
+}
+
+/// Deliver the first 'length' bytes of buffered data to the Serial object's handler
+static void jsserialCoalesceDeliver(JsVar *parent, SerialCoalesceData *c, unsigned int length) {
+  char *buf = (char*)&c[1];
+  JsVar *stringData = jsvNewStringOfLength(length, buf);
+  c->length = (uint16_t)(c->length - length);
+  memmove(buf, &buf[length], c->length);
+  // firstTime is left alone - what's left in the buffer may have been waiting since then
+  if (stringData) {
+    jswrap_stream_pushData(parent, stringData, true);
+    jsvUnLock(stringData);
+  }
+}
+
+/// Called from a timeout to deliver any data that has been buffered for longer than 'latency'
+static void jsserialCoalesceTimeout() {
+  jsvObjectRemoveChild(execInfo.hiddenRoot, SERIAL_COALESCE_TIMER_NAME);
+  JsVar *list = jsserialGetCoalesceList(false);
+  if (!list) return;
+  JsSysTime time = jshGetSystemTime();
+  JsSysTime nextTimeout = JSSYSTIME_MAX;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, list);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *parent = jsvObjectIteratorGetValue(&it);
+    JsVar *dataVar = jsvObjectGetChild(parent, SERIAL_COALESCE_NAME, 0);
+    SerialCoalesceData *c = jsserialGetCoalesceData(dataVar);
+    if (c && c->length && c->latency) {
+      JsSysTime timeLeft = c->firstTime + jshGetTimeFromMilliseconds(c->latency) - time;
+      if (timeLeft <= 0)
+        jsserialCoalesceDeliver(parent, c, c->length);
+      else if (timeLeft < nextTimeout)
+        nextTimeout = timeLeft;
+    }
+    jsvUnLock2(dataVar, parent);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  jsvUnLock(list);
+  // Something we found wasn't quite ready yet - come back for it
+  if (nextTimeout != JSSYSTIME_MAX)
+    jsiSetTimeoutOnce(SERIAL_COALESCE_TIMER_NAME, jsserialCoalesceTimeout, jshGetMillisecondsFromTime(nextTimeout));
+}
+
+/// Add data to a Serial object's coalescing buffer, delivering it if we've got enough
+static void jsserialCoalescePushData(JsVar *parent, SerialCoalesceData *c, JsVar *data) {
+  char *buf = (char*)&c[1];
+  int lastDelimiter = -1;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, data, 0);
+  while (jsvStringIteratorHasChar(&it)) {
+    if (!c->length) {
+      // first data in the buffer - make sure it gets delivered in time
+      c->firstTime = jshGetSystemTime();
+      if (c->latency)
+        jsiSetTimeoutOnce(SERIAL_COALESCE_TIMER_NAME, jsserialCoalesceTimeout, c->latency);
+    }
+    char ch = jsvStringIteratorGetCharAndNext(&it);
+    buf[c->length++] = ch;
+    if (c->delimiter>=0 && ch==(char)c->delimiter)
+      lastDelimiter = c->length;
+    if (c->length >= c->size) {
+      // buffer full - deliver everything
+      jsserialCoalesceDeliver(parent, c, c->length);
+      lastDelimiter = -1;
+    }
+  }
+  jsvStringIteratorFree(&it);
+  // deliver everything up to the last delimiter in one go
+  if (lastDelimiter>0)
+    jsserialCoalesceDeliver(parent, c, (unsigned int)lastDelimiter);
+  /* If we delivered and still have data, the pending timeout will
+  notice and start another one */
+}
+
+/// Deliver anything in a Serial object's coalescing buffer right now
+void jsserialCoalesceFlush(JsVar *parent) {
+  JsVar *dataVar = jsvObjectGetChild(parent, SERIAL_COALESCE_NAME, 0);
+  SerialCoalesceData *c = jsserialGetCoalesceData(dataVar);
+  if (c && c->length)
+    jsserialCoalesceDeliver(parent, c, c->length);
+  jsvUnLock(dataVar);
+}
+
+bool jsserialCoalesceSetup(JsVar *parent, JsVar *options) {
+  // deliver anything that was buffered with the old settings
+  jsserialCoalesceFlush(parent);
+  jsvObjectRemoveChild(parent, SERIAL_COALESCE_NAME);
+  JsVar *list = jsserialGetCoalesceList(false);
+  if (list) {
+    JsVar *idx = jsvGetIndexOf(list, parent, true);
+    if (idx) jsvRemoveChild(list, idx);
+    jsvUnLock(idx);
+    if (!jsvGetChildren(list))
+      jsvObjectRemoveChild(execInfo.hiddenRoot, "serialrx");
+    jsvUnLock(list);
+  }
+
+  JsVar *coalesce = jsvIsObject(options) ? jsvObjectGetChild(options, "coalesce", 0) : 0;
+  if (jsvIsUndefined(coalesce) || jsvIsNull(coalesce) || (jsvIsBoolean(coalesce) && !jsvGetBool(coalesce))) {
+    jsvUnLock(coalesce);
+    return true;
+  }
+  JsVarInt size = 128;
+  JsVarInt latency = 50;
+  JsVar *delimiter = 0;
+  jsvConfigObject configs[] = {
+      {"size", JSV_INTEGER, &size},
+      {"latency", JSV_INTEGER, &latency},
+      {"delimiter", JSV_STRING_0, &delimiter},
+  };
+  bool ok = jsvIsBoolean(coalesce) || jsvReadConfigObject(coalesce, configs, sizeof(configs) / sizeof(jsvConfigObject));
+  jsvUnLock(coalesce);
+  int delimiterChar = -1;
+  if (ok && delimiter) {
+    if (jsvIsString(delimiter) && jsvGetStringLength(delimiter)==1)
+      delimiterChar = (unsigned char)jsvGetCharInString(delimiter, 0);
+    else {
+      jsExceptionHere(JSET_ERROR, "coalesce.delimiter should be a single character, got %q", delimiter);
+      ok = false;
+    }
+  }
+  jsvUnLock(delimiter);
+  if (ok && (size<1 || size>0xFFFF || latency<0 || latency>0xFFFF)) {
+    jsExceptionHere(JSET_ERROR, "Invalid coalesce.size or coalesce.latency");
+    ok = false;
+  }
+  if (!ok) return false;
+
+  JsVar *dataVar = jsvNewFlatStringOfLength((unsigned int)(sizeof(SerialCoalesceData) + (size_t)size));
+  if (!dataVar) {
+    jsExceptionHere(JSET_ERROR, "Unable to allocate data for Serial coalescing");
+    return false;
+  }
+  SerialCoalesceData *c = jsserialGetCoalesceData(dataVar);
+  c->size = (uint16_t)size;
+  c->latency = (uint16_t)latency;
+  c->delimiter = (int16_t)delimiterChar;
+  c->length = 0;
+  c->firstTime = 0;
+  jsvObjectSetChildAndUnLock(parent, SERIAL_COALESCE_NAME, dataVar);
+  list = jsserialGetCoalesceList(true);
+  if (list) {
+    jsvArrayPush(list, parent);
+    jsvUnLock(list);
+  }
+  return true;
+}
+#endif
+
+void jsserialPushData(JsVar *parent, JsVar *data) {
+#ifndef SAVE_ON_FLASH
+  JsVar *dataVar = jsvObjectGetChild(parent, SERIAL_COALESCE_NAME, 0);
+  SerialCoalesceData *c = jsserialGetCoalesceData(dataVar);
+  if (c) {
+    jsserialCoalescePushData(parent, c, data);
+    jsvUnLock(dataVar);
+    return;
+  }
+  jsvUnLock(dataVar);
+#endif
+  jswrap_stream_pushData(parent, data, true);
+}
@@ -17,6 +17,11 @@
 typedef JshUSARTInfo serial_sender_data; // the larger of JshSPIInfo or IOEventFlags
 typedef void (*serial_sender)(unsigned char data, serial_sender_data *info);
 
+/// Send a character to a hardware Serial device (serial_sender_data is the IOEventFlags)
+void jsserialHardwareFunc(unsigned char data, serial_sender_data *info);
+/// Send a block of data to a hardware Serial device (for jsvIterateBufferCallback)
+void jsserialHardwareBlockFunc(unsigned char *data, unsigned int len, void *info);
+
 bool jsserialPopulateUSARTInfo(JshUSARTInfo *inf, JsVar *baud,  JsVar *options);
 
 // Get the correct Serial send function (and the data to send to it).
@@ -32,5 +37,11 @@ bool jsserialEventCallbackIdle();
 // This is used with jshSetEventCallback to allow Serial data to be received in software
 void jsserialEventCallback(bool state, IOEventFlags flags);
 
-
-
+#ifndef SAVE_ON_FLASH
+/// Set up (or remove) coalescing of received data from the 'coalesce' field of Serial.setup's options
+bool jsserialCoalesceSetup(JsVar *parent, JsVar *options);
+/// Deliver anything in a Serial object's coalescing buffer right now
+void jsserialCoalesceFlush(JsVar *parent);
+#endif
+/// Pass received data to a Serial object's 'data' handler (coalescing it first if that was set up)
+void jsserialPushData(JsVar *parent, JsVar *data);
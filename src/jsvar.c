@@ -3911,7 +3911,15 @@ int jsvGarbageCollect() {
   return (int)freedCount;
 }
 
+/// Incremented whenever jsvDefragment runs (and variables may have moved)
+static uint32_t jsvDefragCount = 0;
+
+uint32_t jsvGetDefragCount() {
+  return jsvDefragCount;
+}
+
 void jsvDefragment() {
+  jsvDefragCount++;
   // garbage collect - removes cruft
   // also puts free list in order
   jsvGarbageCollect();
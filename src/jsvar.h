@@ -687,6 +687,10 @@ int jsvGarbageCollect();
 /** Defragement memory - this could take a while with interrupts turned off! */
 void jsvDefragment();
 
+/** Returns a number that changes each time jsvDefragment is called. References stored
+ * anywhere other than in variable links (eg. inside a flat string) are invalid once it changes */
+uint32_t jsvGetDefragCount();
+
 // Dump any locked variables that aren't referenced from `global` - for debugging memory leaks
 void jsvDumpLockedVars();
 // Dump the free list - in order
@@ -15,6 +15,7 @@
  */
 #include "jswrap_json.h"
 #include "jswrap_object.h"
+#include "jswrap_map.h"
 #include "jsparse.h"
 #include "jsinteractive.h"
 #include "jswrapper.h"
@@ -407,8 +408,22 @@ void jsfGetJSONWithCallback(JsVar *var, JsVar *varName, JSONFlags flags, const c
     }
   } else if (jsvIsObject(var)) {
     IOEventFlags device = (flags & JSON_SHOW_DEVICES) ? jsiGetDeviceFromClass(var) : EV_NONE;
+#ifndef SAVE_ON_FLASH
+    bool isMap;
+    // JSON.stringify gives '{}' for Map/Set (as hidden children are ignored), but otherwise show the contents
+    JsVar *mapEntries = (flags & JSON_JSON_COMPATIBILE) ? 0 : jswrap_map_getEntries(var, &isMap);
+#endif
     if (device!=EV_NONE) {
       cbprintf(user_callback, user_data, "%s", jshGetDeviceString(device));
+#ifndef SAVE_ON_FLASH
+    } else if (mapEntries) {
+      jsvUnLock(mapEntries);
+      JsVar *items = jswrap_map_toArray(var, isMap ? JSMAP_ENTRIES : JSMAP_VALUES, isMap);
+      cbprintf(user_callback, user_data, isMap ? "new Map(" : "new Set(");
+      jsfGetJSONWithCallback(items, NULL, flags, whitespace, user_callback, user_data);
+      cbprintf(user_callback, user_data, ")");
+      jsvUnLock(items);
+#endif
     } else {
       bool showContents = true;
       if (flags & JSON_SHOW_OBJECT_NAMES) {
@@ -0,0 +1,804 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2021 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * This file is designed to be parsed during the build process
+ *
+ * JavaScript Map and Set implementation
+ *
+ * Entries are stored in insertion order in a hidden array - key,value,key,value
+ * for a Map, or just the values for a Set. Keys and values are normal children
+ * of that array, so garbage collection, reference counting and saving all work
+ * as they do for any other array.
+ *
+ * To find a key quickly, a hidden flat string holds an open-addressed hash
+ * table of references to the key names in the array. It's only an index: if
+ * there's not enough memory for it we just search the array, and it's rebuilt
+ * if it was made for a different array (after a copy) or vars have been moved
+ * by jsvDefragment.
+ * ----------------------------------------------------------------------------
+ */
+#include "jswrap_map.h"
+#include "jsvar.h"
+#include "jsvariterator.h"
+#include "jsparse.h"
+
+#ifndef SAVE_ON_FLASH
+
+#define JSMAP_MAP_ENTRIES JS_HIDDEN_CHAR_STR"Map" ///< Name of the array of entries in a Map
+#define JSMAP_SET_ENTRIES JS_HIDDEN_CHAR_STR"Set" ///< Name of the array of entries in a Set
+#define JSMAP_TABLE JS_HIDDEN_CHAR_STR"MTb" ///< Name of the hash table in a Map or Set
+#define JSMAP_TABLE_MIN_SLOTS 8 ///< Smallest hash table (must be a power of 2)
+#define JSMAP_DELETED ((JsVarRef)~(JsVarRef)0) ///< Hash table slot whose entry has been deleted
+
+typedef struct {
+  JsVarRef entries;     ///< The array of entries this table is for
+  uint32_t defragCount; ///< jsvGetDefragCount() when the table was built
+  uint32_t count;       ///< How many entries are in the table
+  uint32_t used;        ///< How many slots aren't empty (entries plus deleted slots)
+  uint32_t mask;        ///< Number of slots - 1
+} JsMapTableHeader;
+
+typedef struct {
+  JsVarRef name;        ///< The name of the key in the entries array, 0 if empty or JSMAP_DELETED
+  uint16_t hash;        ///< Top 16 bits of the key's hash, so we rarely have to compare keys that don't match
+} JsMapTableSlot;
+
+static JsMapTableHeader *jsmapTableHeader(JsVar *table) {
+  return (JsMapTableHeader*)jsvGetFlatStringPointer(table);
+}
+
+static JsMapTableSlot *jsmapTableSlots(JsVar *table) {
+  return (JsMapTableSlot*)(jsmapTableHeader(table)+1);
+}
+
+static uint32_t jsmapHashInteger(JsVarInt i) {
+  uint32_t h = (uint32_t)i;
+  h ^= h >> 16;
+  h *= 0x7FEB352D;
+  h ^= h >> 15;
+  h *= 0x846CA68B;
+  h ^= h >> 16;
+  return h;
+}
+
+static uint32_t jsmapHashBool(bool b) {
+  return b ? 0xB001B001 : 0xB000B000;
+}
+
+/// Hash a key so that keys that are equal according to SameValueZero have the same hash
+static uint32_t jsmapHashValue(JsVar *v) {
+  if (!v) return 0x0DEF0DEF; // undefined
+  if (jsvIsNull(v)) return 0x00110011;
+  if (jsvIsBoolean(v)) return jsmapHashBool(jsvGetBool(v));
+  if (jsvIsInt(v)) return jsmapHashInteger(v->varData.integer);
+  if (jsvIsFloat(v)) {
+    JsVarFloat f = v->varData.floating;
+    if (isnan(f)) return 0x7FF87FF8; // all NaNs are the same key
+    // integer values (including -0) must hash the same as the equivalent int
+    if (f>=-2147483648.0 && f<2147483648.0 && (JsVarFloat)(JsVarInt)f==f)
+      return jsmapHashInteger((JsVarInt)f);
+    uint32_t h = 2166136261u;
+    const unsigned char *p = (const unsigned char*)&f;
+    for (size_t i=0;i<sizeof(f);i++)
+      h = (h ^ p[i]) * 16777619u;
+    return h;
+  }
+  if (jsvIsString(v)) {
+    uint32_t h = 2166136261u;
+    JsvStringIterator it;
+    jsvStringIteratorNew(&it, v, 0);
+    while (jsvStringIteratorHasChar(&it)) {
+      h = (h ^ (unsigned char)jsvStringIteratorGetChar(&it)) * 16777619u;
+      jsvStringIteratorNext(&it);
+    }
+    jsvStringIteratorFree(&it);
+    return h;
+  }
+  // anything else is only equal to itself
+  return jsmapHashInteger((JsVarInt)jsvGetRef(v)) ^ 0x9E3779B9;
+}
+
+/// Hash the key that a name in the entries array points to
+static uint32_t jsmapHashName(JsVar *name) {
+  // don't use jsvSkipName for these as it would allocate a new var
+  if (jsvIsNameIntInt(name)) return jsmapHashInteger(jsvGetFirstChildSigned(name));
+  if (jsvIsNameIntBool(name)) return jsmapHashBool(jsvGetFirstChild(name)!=0);
+  JsVar *key = jsvLockSafe(jsvGetFirstChild(name));
+  uint32_t h = jsmapHashValue(key);
+  jsvUnLock(key);
+  return h;
+}
+
+/// SameValueZero comparison of two values that aren't the same variable
+static bool jsmapValueEquals(JsVar *a, JsVar *b) {
+  if ((jsvIsInt(a) || jsvIsFloat(a)) && (jsvIsInt(b) || jsvIsFloat(b))) {
+    if (jsvIsInt(a) && jsvIsInt(b))
+      return a->varData.integer == b->varData.integer;
+    JsVarFloat fa = jsvGetFloat(a), fb = jsvGetFloat(b);
+    return fa==fb || (isnan(fa) && isnan(fb));
+  }
+  if (jsvIsString(a) && jsvIsString(b))
+    return jsvCompareString(a, b, 0, 0, false)==0;
+  if (jsvIsBoolean(a) && jsvIsBoolean(b))
+    return jsvGetBool(a) == jsvGetBool(b);
+  if (jsvIsNull(a) && jsvIsNull(b))
+    return true;
+  return false; // objects are only equal if they're the same variable
+}
+
+/// SameValueZero comparison of a key with the key a name in the entries array points to
+static bool jsmapKeyEquals(JsVar *key, JsVar *name) {
+  if (jsvIsNameIntInt(name)) {
+    JsVarInt i = jsvGetFirstChildSigned(name);
+    if (jsvIsInt(key)) return key->varData.integer == i;
+    return jsvIsFloat(key) && key->varData.floating == (JsVarFloat)i;
+  }
+  if (jsvIsNameIntBool(name))
+    return jsvIsBoolean(key) && jsvGetBool(key) == (jsvGetFirstChild(name)!=0);
+  JsVarRef ref = jsvGetFirstChild(name);
+  if (!ref || !key) return !ref && !key; // undefined
+  if (ref == jsvGetRef(key)) return true;
+  if (jsvHasChildren(key)) return false; // objects must be the same variable
+  JsVar *v = jsvLock(ref);
+  bool eq = jsmapValueEquals(key, v);
+  jsvUnLock(v);
+  return eq;
+}
+
+/// Given the name of a key in the entries array, get the reference of the next key's name
+static JsVarRef jsmapNextKey(JsVar *name, bool isMap) {
+  JsVarRef ref = jsvGetNextSibling(name);
+  if (isMap && ref) { // skip over the value
+    JsVar *value = jsvLock(ref);
+    ref = jsvGetNextSibling(value);
+    jsvUnLock(value);
+  }
+  return ref;
+}
+
+/// Add a key's name to the hash table. The key must not already be in it, and there must be an empty slot
+static void jsmapTableInsert(JsVar *table, JsVarRef name, uint32_t hash) {
+  JsMapTableHeader *header = jsmapTableHeader(table);
+  JsMapTableSlot *slots = jsmapTableSlots(table);
+  uint32_t i = hash & header->mask;
+  while (slots[i].name && slots[i].name!=JSMAP_DELETED)
+    i = (i+1) & header->mask;
+  if (!slots[i].name) header->used++;
+  slots[i].name = name;
+  slots[i].hash = (uint16_t)(hash >> 16);
+  header->count++;
+}
+
+/// Build a new hash table from the entries array. Returns the (locked) table, or 0 if there wasn't enough memory
+static JsVar *jsmapTableBuild(JsVar *parent, JsVar *entries, bool isMap) {
+  // free the old table first so its memory can be reused
+  jsvObjectRemoveChild(parent, JSMAP_TABLE);
+  uint32_t count = (uint32_t)jsvGetChildren(entries);
+  if (isMap) count /= 2;
+  // make sure it's no more than 1/4 full, so we can add as many entries again before rebuilding
+  uint32_t slotCount = JSMAP_TABLE_MIN_SLOTS;
+  while (slotCount < (count+1)*4) slotCount <<= 1;
+  size_t size = sizeof(JsMapTableHeader) + slotCount*sizeof(JsMapTableSlot);
+  JsVar *table = jsvNewFlatStringOfLength((unsigned int)size);
+  if (!table) return 0; // not enough memory - we'll just search the entries array
+  JsMapTableHeader *header = jsmapTableHeader(table);
+  memset(header, 0, size);
+  header->entries = jsvGetRef(entries);
+  header->defragCount = jsvGetDefragCount();
+  header->mask = slotCount-1;
+  JsVarRef ref = jsvGetFirstChild(entries);
+  while (ref) {
+    JsVar *name = jsvLock(ref);
+    jsmapTableInsert(table, ref, jsmapHashName(name));
+    ref = jsmapNextKey(name, isMap);
+    jsvUnLock(name);
+  }
+  jsvObjectSetChild(parent, JSMAP_TABLE, table);
+  return table;
+}
+
+/** Get the hash table (locked), rebuilding it if it's out of date, or if
+ * we're adding and it's half full. Returns 0 if there's not enough memory for one */
+static JsVar *jsmapGetTable(JsVar *parent, JsVar *entries, bool isMap, bool adding) {
+  JsVar *table = jsvObjectGetChild(parent, JSMAP_TABLE, 0);
+  if (jsvIsFlatString(table)) {
+    JsMapTableHeader *header = jsmapTableHeader(table);
+    if (header->entries == jsvGetRef(entries) &&
+        header->defragCount == jsvGetDefragCount() &&
+        (!adding || (header->used+1)*2 <= header->mask+1))
+      return table;
+  }
+  jsvUnLock(table);
+  return jsmapTableBuild(parent, entries, isMap);
+}
+
+/** Find the name of a key in the entries array (locked), or return 0. If there's a
+ * table and the key is found, *slot is set to the slot it was in */
+static JsVar *jsmapFind(JsVar *entries, JsVar *table, bool isMap, JsVar *key, uint32_t hash, uint32_t *slot) {
+  if (table) {
+    JsMapTableHeader *header = jsmapTableHeader(table);
+    JsMapTableSlot *slots = jsmapTableSlots(table);
+    uint16_t h = (uint16_t)(hash >> 16);
+    uint32_t i = hash & header->mask;
+    while (slots[i].name) {
+      if (slots[i].name!=JSMAP_DELETED && slots[i].hash==h) {
+        JsVar *name = jsvLock(slots[i].name);
+        if (jsmapKeyEquals(key, name)) {
+          *slot = i;
+          return name;
+        }
+        jsvUnLock(name);
+      }
+      i = (i+1) & header->mask;
+    }
+    return 0;
+  }
+  // No table - search every key
+  JsVarRef ref = jsvGetFirstChild(entries);
+  while (ref) {
+    JsVar *name = jsvLock(ref);
+    if (jsmapKeyEquals(key, name)) return name;
+    ref = jsmapNextKey(name, isMap);
+    jsvUnLock(name);
+  }
+  return 0;
+}
+
+JsVar *jswrap_map_getEntries(JsVar *obj, bool *isMap) {
+  if (!jsvIsObject(obj)) return 0;
+  bool objIsMap = true;
+  JsVar *entries = jsvObjectGetChild(obj, JSMAP_MAP_ENTRIES, 0);
+  if (!entries) {
+    objIsMap = false;
+    entries = jsvObjectGetChild(obj, JSMAP_SET_ENTRIES, 0);
+  }
+  if (!jsvIsArray(entries)) {
+    jsvUnLock(entries);
+    return 0;
+  }
+  if (isMap) *isMap = objIsMap;
+  return entries;
+}
+
+/// Get the array of entries for a Map/Set (locked), or throw an exception if parent isn't one
+static JsVar *jsmapGetEntriesChecked(JsVar *parent, bool isMap) {
+  bool parentIsMap;
+  JsVar *entries = jswrap_map_getEntries(parent, &parentIsMap);
+  if (!entries || parentIsMap!=isMap) {
+    jsvUnLock(entries);
+    jsExceptionHere(JSET_TYPEERROR, "Expecting a %s, got %t", isMap?"Map":"Set", parent);
+    return 0;
+  }
+  return entries;
+}
+
+/// Add all the items from an iterable to a new Map or Set
+static void jsmapAddIterable(JsVar *obj, JsVar *iterable, bool isMap) {
+  if (jsvIsUndefined(iterable) || jsvIsNull(iterable)) return;
+  JsVar *items;
+  bool iterableIsMap;
+  JsVar *iterableEntries = jswrap_map_getEntries(iterable, &iterableIsMap);
+  if (iterableEntries) {
+    // another Map or Set - Maps take [key,value] entries, Sets just the values
+    jsvUnLock(iterableEntries);
+    items = jswrap_map_toArray(iterable, isMap ? JSMAP_ENTRIES : JSMAP_VALUES, iterableIsMap);
+  } else if (jsvIsIterable(iterable)) {
+    items = jsvLockAgain(iterable);
+  } else {
+    jsExceptionHere(JSET_TYPEERROR, "Expecting something iterable, got %t", iterable);
+    return;
+  }
+  JsvIterator it;
+  jsvIteratorNew(&it, items, JSIF_EVERY_ARRAY_ELEMENT);
+  while (jsvIteratorHasElement(&it) && !jspHasError()) {
+    JsVar *item = jsvIteratorGetValue(&it);
+    if (isMap) {
+      if (jsvIsArray(item)) {
+        JsVar *key = jsvGetArrayItem(item, 0);
+        JsVar *value = jsvGetArrayItem(item, 1);
+        jsvUnLock3(jswrap_map_set(obj, key, value, true), key, value);
+      } else {
+        jsExceptionHere(JSET_TYPEERROR, "Expecting [key,value] array, got %t", item);
+      }
+    } else {
+      jsvUnLock(jswrap_map_set(obj, item, 0, false));
+    }
+    jsvUnLock(item);
+    jsvIteratorNext(&it);
+  }
+  jsvIteratorFree(&it);
+  jsvUnLock(items);
+}
+
+/*JSON{
+  "type" : "class",
+  "class" : "Map",
+  "ifndef" : "SAVE_ON_FLASH"
+}
+A collection of key/value pairs where the keys can be of any type. Keys are
+compared with SameValueZero (so `NaN` matches `NaN` and `-0` matches `0`, but
+objects only match themselves), and entries are iterated in the order they
+were added.
+
+Keys are found with a hash table, so `get`/`set`/`has`/`delete` take the same
+time however many entries there are.
+
+**Note:** Espruino doesn't support iterators, so `keys()`, `values()` and
+`entries()` return arrays.
+ */
+/*JSON{
+  "type" : "constructor",
+  "class" : "Map",
+  "name" : "Map",
+  "generate" : "jswrap_map_constructor",
+  "params" : [
+    ["iterable","JsVar","(optional) An array (or Map) of `[key,value]` entries to add"]
+  ],
+  "return" : ["JsVar","A new Map"],
+  "return_object" : "Map",
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Create a new Map
+
+```
+var m = new Map([["a",1],[2,"b"]]);
+m.set({}, 3);
+print(m.get("a")); // 1
+print(m.size); // 3
+```
+ */
+JsVar *jswrap_map_constructor(JsVar *iterable) {
+  JsVar *map = jspNewObject(0, "Map");
+  if (!map) return 0;
+  jsvUnLock(jsvObjectGetChild(map, JSMAP_MAP_ENTRIES, JSV_ARRAY));
+  jsmapAddIterable(map, iterable, true);
+  return map;
+}
+
+/*JSON{
+  "type" : "class",
+  "class" : "Set",
+  "ifndef" : "SAVE_ON_FLASH"
+}
+A collection of unique values of any type. Values are compared with
+SameValueZero (so `NaN` matches `NaN` and `-0` matches `0`, but objects only
+match themselves), and are iterated in the order they were added.
+
+Values are found with a hash table, so `add`/`has`/`delete` take the same
+time however many values there are.
+
+**Note:** Espruino doesn't support iterators, so `keys()`, `values()` and
+`entries()` return arrays.
+ */
+/*JSON{
+  "type" : "constructor",
+  "class" : "Set",
+  "name" : "Set",
+  "generate" : "jswrap_set_constructor",
+  "params" : [
+    ["iterable","JsVar","(optional) An array (or Set) of values to add"]
+  ],
+  "return" : ["JsVar","A new Set"],
+  "return_object" : "Set",
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Create a new Set
+
+```
+var s = new Set([1,2,2,"2"]);
+print(s.size); // 3
+print(s.has(2)); // true
+```
+ */
+JsVar *jswrap_set_constructor(JsVar *iterable) {
+  JsVar *set = jspNewObject(0, "Set");
+  if (!set) return 0;
+  jsvUnLock(jsvObjectGetChild(set, JSMAP_SET_ENTRIES, JSV_ARRAY));
+  jsmapAddIterable(set, iterable, false);
+  return set;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "Map",
+  "name" : "set",
+  "generate_full" : "jswrap_map_set(parent, key, value, true)",
+  "params" : [
+    ["key","JsVar","The key"],
+    ["value","JsVar","The value"]
+  ],
+  "return" : ["JsVar","This Map"],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Set the value for a key, adding it if it doesn't already exist
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "Set",
+  "name" : "add",
+  "generate_full" : "jswrap_map_set(parent, value, 0, false)",
+  "params" : [
+    ["value","JsVar","The value to add"]
+  ],
+  "return" : ["JsVar","This Set"],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Add a value to the Set if it isn't already in it
+ */
+JsVar *jswrap_map_set(JsVar *parent, JsVar *key, JsVar *value, bool isMap) {
+  JsVar *entries = jsmapGetEntriesChecked(parent, isMap);
+  if (!entries) return 0;
+  // -0 is stored as 0
+  JsVar *zero = 0;
+  if (jsvIsFloat(key) && key->varData.floating==0)
+    key = zero = jsvNewFromInteger(0);
+  JsVar *table = jsmapGetTable(parent, entries, isMap, true);
+  uint32_t hash = jsmapHashValue(key), slot;
+  JsVar *name = jsmapFind(entries, table, isMap, key, hash, &slot);
+  if (name) {
+    if (isMap) {
+      JsVar *valueName = jsvLock(jsvGetNextSibling(name));
+      jsvSetValueOfName(valueName, value);
+      jsvUnLock(valueName);
+    }
+  } else {
+    JsVarInt index = jsvGetArrayLength(entries);
+    name = jsvMakeIntoVariableName(jsvNewFromInteger(index), key);
+    JsVar *valueName = isMap ? jsvMakeIntoVariableName(jsvNewFromInteger(index+1), value) : 0;
+    if (name && (valueName || !isMap)) {
+      jsvAddName(entries, name);
+      if (valueName) jsvAddName(entries, valueName);
+      if (table) jsmapTableInsert(table, jsvGetRef(name), hash);
+    } // else out of memory - error flag will have been set already
+    jsvUnLock(valueName);
+  }
+  jsvUnLock4(name, table, entries, zero);
+  return jsvLockAgain(parent);
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "Map",
+  "name" : "get",
+  "generate" : "jswrap_map_get",
+  "params" : [
+    ["key","JsVar","The key"]
+  ],
+  "return" : ["JsVar","The value for the key, or `undefined`"],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Get the value for a key, or `undefined` if it isn't in the Map
+ */
+JsVar *jswrap_map_get(JsVar *parent, JsVar *key) {
+  JsVar *entries = jsmapGetEntriesChecked(parent, true);
+  if (!entries) return 0;
+  JsVar *table = jsmapGetTable(parent, entries, true, false);
+  uint32_t slot;
+  JsVar *name = jsmapFind(entries, table, true, key, jsmapHashValue(key), &slot);
+  JsVar *value = 0;
+  if (name) value = jsvSkipNameAndUnLock(jsvLock(jsvGetNextSibling(name)));
+  jsvUnLock3(name, table, entries);
+  return value;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "Map",
+  "name" : "has",
+  "generate_full" : "jswrap_map_has(parent, key, true)",
+  "params" : [
+    ["key","JsVar","The key"]
+  ],
+  "return" : ["bool","`true` if the key is in the Map"],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Return `true` if the key is in the Map
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "Set",
+  "name" : "has",
+  "generate_full" : "jswrap_map_has(parent, value, false)",
+  "params" : [
+    ["value","JsVar","The value"]
+  ],
+  "return" : ["bool","`true` if the value is in the Set"],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Return `true` if the value is in the Set
+ */
+bool jswrap_map_has(JsVar *parent, JsVar *key, bool isMap) {
+  JsVar *entries = jsmapGetEntriesChecked(parent, isMap);
+  if (!entries) return false;
+  JsVar *table = jsmapGetTable(parent, entries, isMap, false);
+  uint32_t slot;
+  JsVar *name = jsmapFind(entries, table, isMap, key, jsmapHashValue(key), &slot);
+  jsvUnLock3(name, table, entries);
+  return name!=0;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "Map",
+  "name" : "delete",
+  "generate_full" : "jswrap_map_delete(parent, key, true)",
+  "params" : [
+    ["key","JsVar","The key"]
+  ],
+  "return" : ["bool","`true` if the key was in the Map"],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Remove a key (and its value) from the Map
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "Set",
+  "name" : "delete",
+  "generate_full" : "jswrap_map_delete(parent, value, false)",
+  "params" : [
+    ["value","JsVar","The value"]
+  ],
+  "return" : ["bool","`true` if the value was in the Set"],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Remove a value from the Set
+ */
+bool jswrap_map_delete(JsVar *parent, JsVar *key, bool isMap) {
+  JsVar *entries = jsmapGetEntriesChecked(parent, isMap);
+  if (!entries) return false;
+  JsVar *table = jsmapGetTable(parent, entries, isMap, false);
+  uint32_t slot;
+  JsVar *name = jsmapFind(entries, table, isMap, key, jsmapHashValue(key), &slot);
+  if (name) {
+    // removing the last entry shortens the array, but keep indices increasing so forEach can find its place
+    JsVarInt length = jsvGetArrayLength(entries);
+    if (table) {
+      jsmapTableHeader(table)->count--;
+      jsmapTableSlots(table)[slot].name = JSMAP_DELETED;
+    }
+    if (isMap) {
+      JsVar *valueName = jsvLock(jsvGetNextSibling(name));
+      jsvRemoveChild(entries, valueName);
+      jsvUnLock(valueName);
+    }
+    jsvRemoveChild(entries, name);
+    jsvSetArrayLength(entries, length, false);
+  }
+  jsvUnLock3(name, table, entries);
+  return name!=0;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "Map",
+  "name" : "clear",
+  "generate_full" : "jswrap_map_clear(parent, true)",
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Remove everything from the Map
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "Set",
+  "name" : "clear",
+  "generate_full" : "jswrap_map_clear(parent, false)",
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Remove everything from the Set
+ */
+void jswrap_map_clear(JsVar *parent, bool isMap) {
+  JsVar *entries = jsmapGetEntriesChecked(parent, isMap);
+  if (!entries) return;
+  jsvUnLock(entries);
+  const char *entriesName = isMap ? JSMAP_MAP_ENTRIES : JSMAP_SET_ENTRIES;
+  jsvObjectRemoveChild(parent, JSMAP_TABLE);
+  // Use a new array, so anything iterating over the old one stops
+  jsvObjectSetChildAndUnLock(parent, entriesName, jsvNewEmptyArray());
+}
+
+/*JSON{
+  "type" : "property",
+  "class" : "Map",
+  "name" : "size",
+  "generate_full" : "jswrap_map_size(parent, true)",
+  "return" : ["int","The number of entries in the Map"],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+The number of entries in the Map
+ */
+/*JSON{
+  "type" : "property",
+  "class" : "Set",
+  "name" : "size",
+  "generate_full" : "jswrap_map_size(parent, false)",
+  "return" : ["int","The number of values in the Set"],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+The number of values in the Set
+ */
+int jswrap_map_size(JsVar *parent, bool isMap) {
+  JsVar *entries = jsmapGetEntriesChecked(parent, isMap);
+  if (!entries) return 0;
+  JsVar *table = jsmapGetTable(parent, entries, isMap, false);
+  int size;
+  if (table) size = (int)jsmapTableHeader(table)->count;
+  else size = jsvGetChildren(entries) / (isMap ? 2 : 1);
+  jsvUnLock2(table, entries);
+  return size;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "Map",
+  "name" : "forEach",
+  "generate_full" : "jswrap_map_forEach(parent, callback, thisArg, true)",
+  "params" : [
+    ["callback","JsVar","Function to call with `(value, key, map)` for each entry"],
+    ["thisArg","JsVar","(optional) The value of `this` for the callback"]
+  ],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Call a function for each entry in the Map, in the order they were added
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "Set",
+  "name" : "forEach",
+  "generate_full" : "jswrap_map_forEach(parent, callback, thisArg, false)",
+  "params" : [
+    ["callback","JsVar","Function to call with `(value, value, set)` for each value"],
+    ["thisArg","JsVar","(optional) The value of `this` for the callback"]
+  ],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Call a function for each value in the Set, in the order they were added
+ */
+void jswrap_map_forEach(JsVar *parent, JsVar *callback, JsVar *thisArg, bool isMap) {
+  if (!jsvIsFunction(callback)) {
+    jsExceptionHere(JSET_TYPEERROR, "Expecting a function, got %t", callback);
+    return;
+  }
+  JsVar *entries = jsmapGetEntriesChecked(parent, isMap);
+  if (!entries) return;
+  /* Entries are named with increasing indices, so we remember the index of the last
+  key we called back for. If the callback deleted that key we can then find where to
+  carry on from, even if the entries after it were deleted too. 'entries' stays
+  locked so that if the callback calls clear() we can tell it's a new array. */
+  JsVar *name = jsvLockSafe(jsvGetFirstChild(entries));
+  JsVarInt lastIndex = -1;
+  while (name && !jspHasError()) {
+    JsVar *args[3];
+    JsVar *key = jsvSkipName(name);
+    args[0] = isMap ? jsvSkipNameAndUnLock(jsvLock(jsvGetNextSibling(name))) : jsvLockAgainSafe(key);
+    args[1] = key;
+    args[2] = parent;
+    lastIndex = name->varData.integer;
+    jsvUnLock(jspeFunctionCall(callback, 0, thisArg, false, 3, args));
+    jsvUnLock2(args[0], key);
+    JsVar *current = jswrap_map_getEntries(parent, 0);
+    if (current != entries) {
+      // cleared - carry on from the start of the new array
+      jsvUnLock2(entries, name);
+      entries = current;
+      name = entries ? jsvLockSafe(jsvGetFirstChild(entries)) : 0;
+      continue;
+    }
+    jsvUnLock(current);
+    JsVarRef next;
+    if (jsvGetRefs(name)) {
+      // still in the Map - carry on from here, which includes anything just added
+      next = jsmapNextKey(name, isMap);
+    } else {
+      // it was deleted - find the first key added after it
+      next = jsvGetFirstChild(entries);
+      while (next) {
+        JsVar *n = jsvLock(next);
+        bool after = n->varData.integer > lastIndex;
+        if (!after) next = jsmapNextKey(n, isMap);
+        jsvUnLock(n);
+        if (after) break;
+      }
+    }
+    jsvUnLock(name);
+    name = jsvLockSafe(next);
+  }
+  jsvUnLock2(name, entries);
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "Map",
+  "name" : "keys",
+  "generate_full" : "jswrap_map_toArray(parent, JSMAP_KEYS, true)",
+  "return" : ["JsVar","An array of keys"],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Return an array of the Map's keys, in the order they were added
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "Map",
+  "name" : "values",
+  "generate_full" : "jswrap_map_toArray(parent, JSMAP_VALUES, true)",
+  "return" : ["JsVar","An array of values"],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Return an array of the Map's values, in the order they were added
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "Map",
+  "name" : "entries",
+  "generate_full" : "jswrap_map_toArray(parent, JSMAP_ENTRIES, true)",
+  "return" : ["JsVar","An array of `[key,value]` arrays"],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Return an array of the Map's `[key,value]` entries, in the order they were added
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "Set",
+  "name" : "values",
+  "generate_full" : "jswrap_map_toArray(parent, JSMAP_VALUES, false)",
+  "return" : ["JsVar","An array of values"],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Return an array of the Set's values, in the order they were added
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "Set",
+  "name" : "keys",
+  "generate_full" : "jswrap_map_toArray(parent, JSMAP_KEYS, false)",
+  "return" : ["JsVar","An array of values"],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+The same as `Set.values()`
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "Set",
+  "name" : "entries",
+  "generate_full" : "jswrap_map_toArray(parent, JSMAP_ENTRIES, false)",
+  "return" : ["JsVar","An array of `[value,value]` arrays"],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Return an array of `[value,value]` for each value in the Set, in the order they were added
+ */
+JsVar *jswrap_map_toArray(JsVar *parent, JsMapArrayType type, bool isMap) {
+  JsVar *entries = jsmapGetEntriesChecked(parent, isMap);
+  if (!entries) return 0;
+  JsVar *arr = jsvNewEmptyArray();
+  JsVar *name = arr ? jsvLockSafe(jsvGetFirstChild(entries)) : 0;
+  while (name) {
+    JsVar *key = jsvSkipName(name);
+    JsVar *value = isMap ? jsvSkipNameAndUnLock(jsvLock(jsvGetNextSibling(name))) : jsvLockAgainSafe(key);
+    if (type==JSMAP_KEYS) {
+      jsvArrayPush(arr, key);
+    } else if (type==JSMAP_VALUES) {
+      jsvArrayPush(arr, value);
+    } else {
+      JsVar *entry = jsvNewEmptyArray();
+      if (entry) {
+        jsvArrayPush(entry, key);
+        jsvArrayPush(entry, value);
+        jsvArrayPushAndUnLock(arr, entry);
+      }
+    }
+    jsvUnLock2(key, value);
+    JsVarRef next = jsmapNextKey(name, isMap);
+    jsvUnLock(name);
+    name = jsvLockSafe(next);
+  }
+  jsvUnLock(entries);
+  return arr;
+}
+
+#endif // SAVE_ON_FLASH
@@ -0,0 +1,34 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2021 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * JavaScript Map and Set Implementation
+ * ----------------------------------------------------------------------------
+ */
+#include "jsvar.h"
+
+typedef enum {
+  JSMAP_KEYS,    ///< Array of keys
+  JSMAP_VALUES,  ///< Array of values
+  JSMAP_ENTRIES, ///< Array of [key,value] arrays
+} JsMapArrayType;
+
+/// If obj is a Map or Set, return its (hidden) array of entries and set *isMap (if isMap!=0). Otherwise return 0
+JsVar *jswrap_map_getEntries(JsVar *obj, bool *isMap);
+
+JsVar *jswrap_map_constructor(JsVar *iterable);
+JsVar *jswrap_set_constructor(JsVar *iterable);
+JsVar *jswrap_map_set(JsVar *parent, JsVar *key, JsVar *value, bool isMap);
+JsVar *jswrap_map_get(JsVar *parent, JsVar *key);
+bool jswrap_map_has(JsVar *parent, JsVar *key, bool isMap);
+bool jswrap_map_delete(JsVar *parent, JsVar *key, bool isMap);
+void jswrap_map_clear(JsVar *parent, bool isMap);
+int jswrap_map_size(JsVar *parent, bool isMap);
+void jswrap_map_forEach(JsVar *parent, JsVar *callback, JsVar *thisArg, bool isMap);
+JsVar *jswrap_map_toArray(JsVar *parent, JsMapArrayType type, bool isMap);
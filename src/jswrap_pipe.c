@@ -23,12 +23,27 @@
  *    * When the pipe closes, unless 'end=false' on initialisation, we call
  *      'end' on destination, and 'close' on source.
  *
+ *   Unless a chunkSize is given, the size of chunks adapts to how quickly
+ *   the destination takes them. When both streams are implemented natively
+ *   (File, StorageFile, Serial, Sockets, ...) read and write are called
+ *   directly without going through the interpreter. There's no C-level
+ *   stream interface though - each chunk is still read into a JsVar and
+ *   handed to write, just as it is for streams implemented in JS.
+ *
  * ----------------------------------------------------------------------------
  */
 
 #include "jswrap_pipe.h"
 #include "jswrap_object.h"
 #include "jswrap_stream.h"
+#include "jsnative.h"
+
+#define PIPE_DEFAULT_CHUNK_SIZE 64
+#ifndef PIPE_MAX_CHUNK_SIZE
+#define PIPE_MAX_CHUNK_SIZE 4096
+#endif
+#define PIPE_FAST_WRITE_MS 10 ///< If a chunk is taken within this time, double the chunk size
+#define PIPE_SLOW_WRITE_MS 100 ///< If a chunk takes longer than this to be taken, halve the chunk size
 
 static JsVar* pipeGetArray(bool create) {
   return jsvObjectGetChild(execInfo.hiddenRoot, "pipes", create ? JSV_ARRAY : 0);
@@ -100,6 +115,29 @@ static void handlePipeClose(JsVar *arr, JsvObjectIterator *it, JsVar* pipe) {
   jsvUnLock(idx);
 }
 
+/// Call a method on a stream with one argument. Native methods are called directly rather than via the interpreter
+static JsVar *pipeCallMethod(JsVar *func, JsVar *thisArg, JsVar *arg) {
+  if (jsvIsNativeFunction(func) && !jsvGetFirstChild(func)) // no bound arguments
+    return jsnCallFunction(jsvGetNativeFunctionPtr(func), func->varData.native.argTypes, thisArg, &arg, 1);
+  return jspExecuteFunction(func, thisArg, 1, &arg);
+}
+
+/** A chunk was taken by the destination 'time' after we wrote it (either write returned or the
+ * destination drained). If it's adaptive, change the chunk size to suit */
+static void pipeAdaptChunkSize(JsVar *pipe, JsSysTime time) {
+  if (!jsvGetBoolAndUnLock(jsvObjectGetChild(pipe,"adapt",0))) return;
+  JsVarInt size = jsvGetIntegerAndUnLock(jsvObjectGetChild(pipe,"chunkSize",0));
+  if (time < jshGetTimeFromMilliseconds(PIPE_FAST_WRITE_MS)) {
+    // only grow while there's plenty of free memory for the bigger chunks
+    if (size < PIPE_MAX_CHUNK_SIZE && jsvMoreFreeVariablesThan((unsigned int)size))
+      size *= 2;
+  } else if (time > jshGetTimeFromMilliseconds(PIPE_SLOW_WRITE_MS)) {
+    if (size > PIPE_DEFAULT_CHUNK_SIZE)
+      size /= 2;
+  }
+  jsvObjectSetChildAndUnLock(pipe,"chunkSize",jsvNewFromInteger(size));
+}
+
 static bool handlePipe(JsVar *arr, JsvObjectIterator *it, JsVar* pipe) {
   bool paused = jsvGetBoolAndUnLock(jsvObjectGetChild(pipe,"drainWait",0));
   if (paused) return false;
@@ -111,17 +149,23 @@ static bool handlePipe(JsVar *arr, JsvObjectIterator *it, JsVar* pipe) {
 
   bool dataTransferred = false;
   if(source && destination && chunkSize && position) {
-    JsVar *readFunc = jspGetNamedField(source, "read", false);
-    JsVar *writeFunc = jspGetNamedField(destination, "write", false);
+    // looked up once when the pipe was created
+    JsVar *readFunc = jsvObjectGetChild(pipe,"readFn",0);
+    JsVar *writeFunc = jsvObjectGetChild(pipe,"writeFn",0);
     if (jsvIsFunction(readFunc) && jsvIsFunction(writeFunc)) { // do the objects have the necessary methods on them?
-      JsVar *buffer = jspExecuteFunction(readFunc, source, 1, &chunkSize);
+      JsVar *buffer = pipeCallMethod(readFunc, source, chunkSize);
       if(buffer) {
         JsVarInt bufferSize = jsvGetLength(buffer);
         if (bufferSize>0) {
-          JsVar *response = jspExecuteFunction(writeFunc, destination, 1, &buffer);
+          JsSysTime writeTime = jshGetSystemTime();
+          JsVar *response = pipeCallMethod(writeFunc, destination, buffer);
           if (jsvIsBoolean(response) && jsvGetBool(response)==false) {
             // If boolean false was returned, wait for drain event (http://nodejs.org/api/stream.html#stream_writable_write_chunk_encoding_callback)
             jsvObjectSetChildAndUnLock(pipe,"drainWait",jsvNewFromBool(true));
+            jsvObjectSetChildAndUnLock(pipe,"writeTime",jsvNewFromFloat((JsVarFloat)writeTime));
+          } else if (bufferSize >= jsvGetInteger(chunkSize)) {
+            // only adapt if we had a whole chunk, otherwise the source is what's slowing us down
+            pipeAdaptChunkSize(pipe, jshGetSystemTime() - writeTime);
           }
           jsvUnLock(response);
           jsvSetInteger(position, jsvGetInteger(position) + bufferSize);
@@ -197,6 +241,12 @@ static void jswrap_pipe_drain_listener(JsVar *destination) {
       if (dst == destination) {
         // found it! said wait to false
         jsvObjectSetChildAndUnLock(pipe,"drainWait",jsvNewFromBool(false));
+        JsVar *writeTime = jsvObjectGetChild(pipe,"writeTime",0);
+        if (writeTime) {
+          pipeAdaptChunkSize(pipe, jshGetSystemTime() - (JsSysTime)jsvGetFloat(writeTime));
+          jsvUnLock(writeTime);
+          jsvObjectRemoveChild(pipe,"writeTime");
+        }
       }
       jsvUnLock2(dst, pipe);
       jsvObjectIteratorNext(&it);
@@ -245,7 +295,7 @@ static void jswrap_pipe_dst_close_listener(JsVar *destination) {
   "params" : [
     ["source","JsVar","The source file/stream that will send content."],
     ["destination","JsVar","The destination file/stream that will receive content from the source."],
-    ["options","JsVar",["An optional object `{ chunkSize : int=64, end : bool=true, complete : function }`","chunkSize : The amount of data to pipe from source to destination at a time","complete : a function to call when the pipe activity is complete","end : call the 'end' function on the destination when the source is finished"]]
+    ["options","JsVar",["An optional object `{ chunkSize : int=64, end : bool=true, complete : function }`","chunkSize : The amount of data to pipe from source to destination at a time. If not specified this starts at 64 and adapts to how fast the destination takes data","complete : a function to call when the pipe activity is complete","end : call the 'end' function on the destination when the source is finished"]]
   ]
 }*/
 void jswrap_pipe(JsVar* source, JsVar* dest, JsVar* options) {
@@ -258,7 +308,8 @@ void jswrap_pipe(JsVar* source, JsVar* dest, JsVar* options) {
     JsVar *writeFunc = jspGetNamedField(dest, "write", false);
     if(jsvIsFunction(readFunc)) {
       if(jsvIsFunction(writeFunc)) {
-        JsVarInt chunkSize = 64;
+        JsVarInt chunkSize = PIPE_DEFAULT_CHUNK_SIZE;
+        bool adaptive = true;
         bool callEnd = true;
         // parse Options Object
         if (jsvIsObject(options)) {
@@ -272,9 +323,10 @@ void jswrap_pipe(JsVar* source, JsVar* dest, JsVar* options) {
           if (c) callEnd = jsvGetBoolAndUnLock(c);
           c = jsvObjectGetChild(options, "chunkSize", false);
           if (c) {
-            if (jsvIsNumeric(c) && jsvGetInteger(c)>0)
+            if (jsvIsNumeric(c) && jsvGetInteger(c)>0) {
               chunkSize = jsvGetInteger(c);
-            else
+              adaptive = false;
+            } else
               jsExceptionHere(JSET_TYPEERROR, "chunkSize must be an integer > 0");
             jsvUnLock(c);
           }
@@ -287,7 +339,10 @@ void jswrap_pipe(JsVar* source, JsVar* dest, JsVar* options) {
         jswrap_object_addEventListener(dest, "close", jswrap_pipe_dst_close_listener, JSWAT_THIS_ARG);
         // set up the rest of the pipe
         jsvObjectSetChildAndUnLock(pipe, "chunkSize", jsvNewFromInteger(chunkSize));
+        if (adaptive) jsvObjectSetChildAndUnLock(pipe, "adapt", jsvNewFromBool(true));
         jsvObjectSetChildAndUnLock(pipe, "end", jsvNewFromBool(callEnd));
+        jsvObjectSetChild(pipe, "readFn", readFunc);
+        jsvObjectSetChild(pipe, "writeFn", writeFunc);
         jsvUnLock3(jsvAddNamedChild(pipe, position, "position"), 
                    jsvAddNamedChild(pipe, source, "source"), 
                    jsvAddNamedChild(pipe, dest, "destination"));
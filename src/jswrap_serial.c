@@ -241,6 +241,11 @@ The second argument can contain:
   flow:null/undefined/'none'/'xon', // (default none) software flow control
   path:null/undefined/string        // Linux Only - the path to the Serial device to use
   errors:false                      // (default false) whether to forward framing/parity errors
+  coalesce:undefined/true/{         // (default undefined) combine received data into fewer, larger 'data' events
+    size:128,                       // (default 128) deliver data when we have this many bytes...
+    latency:50,                     // (default 50) ...or when the oldest byte has waited this many ms (0=never)
+    delimiter:"\n"                  // (default none) ...or up to the last of these characters received
+  }
 }
 ```
 
@@ -267,6 +272,13 @@ data then the queue might overflow `E.getErrorFlags()` would return `FIFO_FULL`.
 However if you need to respond to `framing` or `parity` errors then 
 you'll need to use `errors:true` when initialising serial.
 
+If you're receiving a lot of data, each `data` event may only contain a few
+characters - which means your handler is called (and a new String allocated)
+very often. `coalesce` makes Espruino buffer received data natively and
+only call `data` when enough has arrived, the oldest byte is `latency`
+milliseconds old, or (for line-based protocols like GPS/AT) a `delimiter`
+has been received - eg. `Serial1.setup(9600,{coalesce:{delimiter:"\n"}})`.
+
 On Linux builds there is no default Serial device, so you must specify
 a path to a device - for instance: `Serial1.setup(9600,{path:"/dev/ttyACM0"})`
 
@@ -295,6 +307,11 @@ void jswrap_serial_setup(JsVar *parent, JsVar *baud, JsVar *options) {
     jsvObjectSetChildAndUnLock(parent, "path", jsvObjectGetChild(options, "path", 0));
 #endif
 
+#ifndef SAVE_ON_FLASH
+  if (ok)
+    ok = jsserialCoalesceSetup(parent, options);
+#endif
+
   if (!ok) {
     jsvUnLock(options);
     return;
@@ -362,6 +379,7 @@ void jswrap_serial_unsetup(JsVar *parent) {
       jsserialEventCallbackKill(parent, &inf);
   }
   jsvUnLock2(options, baud);
+  jsserialCoalesceSetup(parent, 0); // deliver and remove any coalesced data
   // Remove stored settings
   jsvObjectRemoveChild(parent, USART_BAUDRATE_NAME);
   jsvObjectRemoveChild(parent, DEVICE_OPTIONS_NAME);
@@ -394,7 +412,10 @@ void _jswrap_serial_print(JsVar *parent, JsVar *arg, bool isPrint, bool newLine)
     return;
 
   if (isPrint) arg = jsvAsString(arg);
-  jsvIterateCallback(arg, (void (*)(int,  void *))serialSend, (void*)&serialSendData);
+  if (serialSend == jsserialHardwareFunc) // hardware can send whole blocks at once
+    jsvIterateBufferCallback(arg, jsserialHardwareBlockFunc, (void*)&serialSendData);
+  else
+    jsvIterateCallback(arg, (void (*)(int,  void *))serialSend, (void*)&serialSendData);
   if (isPrint) jsvUnLock(arg);
   if (newLine) {
     serialSend((unsigned char)'\r', &serialSendData);
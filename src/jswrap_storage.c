@@ -39,6 +39,25 @@ const int STORAGEFILE_CHUNKSIZE =
   (FLASH_PAGE_SIZE*10) - sizeof(JsfFileHeader);
 #endif
 
+/// How much a StorageFile reads ahead when its data isn't memory-mapped
+#define STORAGEFILE_READ_BUFFER_SIZE 128
+/// Hidden child of a StorageFile that contains its StorageFileReadBuffer
+#define STORAGEFILE_READ_BUFFER_NAME JS_HIDDEN_CHAR_STR"rb"
+/// Size of a StorageFile's write buffer when opened with `{buffer:true}`
+#define STORAGEFILE_WRITE_BUFFER_SIZE 256
+/// Default time (in milliseconds) data can wait in a StorageFile's write buffer before it's written
+#define STORAGEFILE_WRITE_LATENCY 1000
+/// Hidden child of a StorageFile that contains its StorageFileWriteBuffer
+#define STORAGEFILE_WRITE_BUFFER_NAME JS_HIDDEN_CHAR_STR"wb"
+/// Name (in hiddenRoot) of the list of StorageFiles that have data waiting in their write buffers
+#define STORAGEFILE_WRITE_LIST_NAME "sfwb"
+/// Name (in hiddenRoot) of the timeout that writes buffered data, so we only ever have one pending
+#define STORAGEFILE_WRITE_TIMER_NAME "sfwbT"
+
+static bool jswrap_storagefile_setupWriteBuffer(JsVar *f, JsVar *options);
+static void jswrap_storagefile_removeWriteBuffer(JsVar *f);
+static int jswrap_storagefile_getBufferedLength(JsVar *f);
+
 /*JSON{
   "type" : "library",
   "class" : "Storage"
@@ -113,7 +132,8 @@ Read a file from the flash storage area that has
 been written with `require("Storage").write(...)`.
 
 This function returns a memory-mapped String that points to the actual
-memory area in read-only memory, so it won't use up RAM.
+memory area in read-only memory, so it won't use up RAM (unless the file
+was written with `{compress:true}`, in which case the data is decompressed into RAM).
 
 As such you can check if a file exists efficiently using `require("Storage").read(filename)!==undefined`.
 
@@ -202,7 +222,7 @@ JsVar *jswrap_storage_readArrayBuffer(JsVar *name) {
   "params" : [
     ["name","JsVar","The filename - max 28 characters (case sensitive)"],
     ["data","JsVar","The data to write"],
-    ["offset","int","[optional] The offset within the file to write"],
+    ["offset","JsVar","[optional] The offset within the file to write, or an object of options: `{compress:true}` to compress the file"],
     ["size","int","[optional] The size of the file (if a file is to be created that is bigger than the data)"]
   ],
   "return" : ["bool","True on success, false on failure"]
@@ -241,10 +261,25 @@ This can be useful if you've got more data to write than you
 have RAM available - for instance the Web IDE uses this method
 to write large files into onboard storage.
 
+Large files (fonts, images or JSON data) can be compressed with
+`require("Storage").write("MyFile", data, {compress:true})`. `Storage.read`
+and `StorageFile` then decompress them transparently, but `read` has to
+return them in RAM rather than as a memory-mapped String. The file
+is compressed in 1kB blocks, so reading part of it with `Storage.read(name, offset, length)`
+only decompresses the blocks that contain the data. Compressed files must be written
+all at once, and if compressing doesn't make the file smaller it's written normally.
+
 **Note:** This function should be used with normal files, and not
 `StorageFile`s created with `require("Storage").open(filename, ...)`
 */
-bool jswrap_storage_write(JsVar *name, JsVar *data, JsVarInt offset, JsVarInt _size) {
+bool jswrap_storage_write(JsVar *name, JsVar *data, JsVar *offsetOrOptions, JsVarInt _size) {
+  JsfFileFlags flags = JSFF_NONE;
+  JsVarInt offset = 0;
+  if (jsvIsObject(offsetOrOptions)) {
+    if (jsvGetBoolAndUnLock(jsvObjectGetChild(offsetOrOptions, "compress", 0)))
+      flags |= JSFF_COMPRESSED_BLOCKS;
+  } else
+    offset = jsvGetInteger(offsetOrOptions);
   JsVar *d;
   if (jsvIsObject(data)) {
     d = jswrap_json_stringify(data,0,0);
@@ -252,7 +287,7 @@ bool jswrap_storage_write(JsVar *name, JsVar *data, JsVarInt offset, JsVarInt _s
     _size = 0;
   } else
     d = jsvLockAgainSafe(data);
-  bool success = jsfWriteFile(jsfNameFromVar(name), d, JSFF_NONE, offset, _size);
+  bool success = jsfWriteFile(jsfNameFromVar(name), d, flags, offset, _size);
   jsvUnLock(d);
   return success;
 }
@@ -380,6 +415,12 @@ garbage and moves on to a fresh part of flash memory. Espruino only
 fully erases those files when it is running low on flash, or when
 `compact` is called.
 
+When Espruino is idle and a lot of Storage is taken up by deleted files,
+it also compacts Storage in the background, a small piece at a time, so
+that writing a file rarely has to wait for `compact`. A note is kept in
+Storage of what is being moved so that if power is lost part way through
+nothing is lost.
+
 `compact` may fail if there isn't enough RAM free on the stack to
 use as swap space, however in this case it will not lose data.
 
@@ -394,6 +435,15 @@ void jswrap_storage_compact() {
   jsfCompact();
 }
 
+/*JSON{
+  "type" : "idle",
+  "generate" : "jswrap_storage_idle",
+  "ifndef" : "SAVE_ON_FLASH"
+}*/
+bool jswrap_storage_idle() {
+  return jsfCompactIdle();
+}
+
 /*JSON{
   "type" : "staticmethod",
   "ifdef" : "DEBUG",
@@ -468,7 +518,8 @@ JsVar *jswrap_storage_getStats() {
   "generate" : "jswrap_storage_open",
   "params" : [
     ["name","JsVar","The filename - max **27** characters (case sensitive)"],
-    ["mode","JsVar","The open mode - must be either `'r'` for read,`'w'` for write , or `'a'` for append"]
+    ["mode","JsVar","The open mode - must be either `'r'` for read,`'w'` for write , or `'a'` for append"],
+    ["options","JsVar","(optional) Options for writing - see below"]
   ],
   "return" : ["JsVar","An object containing {read,write,erase}"],
   "return_object" : "StorageFile"
@@ -478,10 +529,26 @@ Open a file in the Storage area. This can be used for appending data
 
 Please see `StorageFile` for more information (and examples).
 
-**Note:** These files write through immediately - they do not need closing.
+**Note:** By default these files write through immediately - they do not need closing.
+
+If you're appending lots of small pieces of data (eg. logging) you can ask for
+writes to be buffered in RAM and written to flash in larger blocks, which uses
+less CPU time and fewer flash write cycles:
+
+```
+var f = require("Storage").open("log","a",{
+  buffer : 256,   // bytes of data to buffer (or `true` for the default of 256)
+  latency : 1000  // (optional) write data that has been buffered for this many milliseconds (default 1000)
+});
+f.write("Data\n"); // stored in RAM
+f.flush(); // write it to flash now
+```
 
+Buffered data is written when the buffer fills, after `latency` milliseconds, when
+`StorageFile.flush()` or `StorageFile.close()` is called, or when Espruino is reset.
+Anything still in the buffer will be lost if power is removed.
 */
-JsVar *jswrap_storage_open(JsVar *name, JsVar *modeVar) {
+JsVar *jswrap_storage_open(JsVar *name, JsVar *modeVar, JsVar *options) {
   char mode = 0;
   if (jsvIsStringEqual(modeVar,"r")) mode='r';
   else if (jsvIsStringEqual(modeVar,"w")) mode='w';
@@ -549,8 +616,23 @@ JsVar *jswrap_storage_open(JsVar *name, JsVar *modeVar) {
     }
     // Now 'chunk' and offset points to the last (or a free) page
   }
+  if ((mode=='w' || mode=='a') && !jswrap_storagefile_setupWriteBuffer(f, options)) {
+    jsvUnLock(f);
+    return 0;
+  }
   if (mode=='r') {
-    // read - do nothing, we're good.
+#ifdef JSF_COMPRESSED_FILES
+    if (!addr) {
+      // Not a StorageFile - but if it's a compressed file, read that (decompressing as we go)
+      uint32_t compressedAddr = jsfFindFile(jsfNameFromVar(name), &header);
+      if (compressedAddr && (jsfGetFileFlags(&header)&JSFF_COMPRESSED_BLOCKS)) {
+        addr = compressedAddr;
+        fileLen = jsfGetDecompressedSize(addr);
+        chunk = 255; // there's no next chunk
+        jsvObjectSetChildAndUnLock(f,"compressed",jsvNewFromBool(true));
+      }
+    }
+#endif
   }
 
   DBG("Open %j Chunk %d Offset %d addr 0x%08x len %d\n",name,chunk,offset,addr,fileLen);
@@ -611,11 +693,84 @@ f.readLine() // undefined
 f.erase();
 ```
 
+You can also use `require("Storage").open(filename,"r")` to read a file that was
+written with `require("Storage").write(filename, data, {compress:true})`. It is
+decompressed as it is read, so it never has to fit in RAM all at once.
+
 **Note:** `StorageFile` uses the fact that all bits of erased flash memory
 are 1 to detect the end of a file. As such you should not write character
 code 255 (`"\xFF"`) to these files.
 */
 
+/// Read-ahead buffer for a StorageFile whose data isn't memory-mapped (eg. external flash, or compressed files)
+typedef struct {
+  uint32_t addr; ///< Address of the chunk the data came from (0 = nothing buffered)
+  int offset;    ///< Offset in the chunk of buf[0]
+  int len;       ///< Number of valid bytes in buf
+  char buf[STORAGEFILE_READ_BUFFER_SIZE];
+} StorageFileReadBuffer;
+
+/** Get a pointer to the data at 'offset' in the chunk at 'addr'. On entry *len is the number of bytes
+ * left in the chunk, and on exit it's how many bytes can be read from the pointer. The data comes
+ * straight from flash if it's memory-mapped, or from a read-ahead buffer stored on the StorageFile
+ * if not (*bufVar is locked when that's first needed - the caller must unlock it). Returns 0 if out of memory */
+static const char *jswrap_storagefile_getData(JsVar *f, JsVar **bufVar, uint32_t addr, int offset, int *len, bool compressed) {
+#ifndef USE_FLASH_MEMORY // on ESP8266 we can only read memory-mapped flash 32 bits at a time
+  if (!compressed) {
+    size_t mappedAddr = jshFlashGetMemMapAddress((size_t)(addr+(uint32_t)offset));
+    if (mappedAddr) return (const char*)mappedAddr;
+  }
+#endif
+  if (!*bufVar) {
+    *bufVar = jsvObjectGetChild(f, STORAGEFILE_READ_BUFFER_NAME, 0);
+    if (!*bufVar) {
+      *bufVar = jsvNewFlatStringOfLength(sizeof(StorageFileReadBuffer));
+      if (!*bufVar) return 0;
+      memset(jsvGetFlatStringPointer(*bufVar), 0, sizeof(StorageFileReadBuffer));
+      jsvObjectSetChild(f, STORAGEFILE_READ_BUFFER_NAME, *bufVar);
+    }
+  }
+  StorageFileReadBuffer *rb = (StorageFileReadBuffer*)jsvGetFlatStringPointer(*bufVar);
+  if (rb->addr!=addr || offset<rb->offset || offset>=rb->offset+rb->len) {
+    // not in the buffer - read ahead as much as we can
+    rb->addr = addr;
+    rb->offset = offset;
+    rb->len = *len;
+    if (rb->len > STORAGEFILE_READ_BUFFER_SIZE) rb->len = STORAGEFILE_READ_BUFFER_SIZE;
+#ifdef JSF_COMPRESSED_FILES
+    if (compressed)
+      rb->len = (int)jsfReadDecompressed(addr, (uint32_t)offset, rb->buf, (uint32_t)rb->len);
+    else
+#endif
+      jshFlashRead(rb->buf, addr+(uint32_t)offset, (uint32_t)rb->len);
+  }
+  int available = rb->offset + rb->len - offset;
+  if (*len > available) *len = available;
+  return &rb->buf[offset - rb->offset];
+}
+
+/** Get the address of the chunk a StorageFile is currently on (0 if none). Files can be moved in flash
+ * by background compaction (see jsfCompactIdle) so if the header before the address we had doesn't
+ * have the chunk's name any more, look it up again */
+static uint32_t jswrap_storagefile_getAddr(JsVar *f) {
+  uint32_t addr = (uint32_t)jsvGetIntegerAndUnLock(jsvObjectGetChild(f,"addr",0));
+  if (!addr) return 0;
+  JsfFileName fname = jsfNameFromVarAndUnLock(jsvObjectGetChild(f,"name",0));
+  if (!jsvGetBoolAndUnLock(jsvObjectGetChild(f,"compressed",0))) {
+    int fnamei = sizeof(fname)-1;
+    while (fnamei && fname.c[fnamei-1]==0) fnamei--;
+    fname.c[fnamei] = (char)jsvGetIntegerAndUnLock(jsvObjectGetChild(f,"chunk",0));
+  }
+  JsfFileHeader header;
+  jshFlashRead(&header, addr-(uint32_t)sizeof(JsfFileHeader), sizeof(JsfFileHeader));
+  if (memcmp(&header.name, &fname, sizeof(fname))==0) return addr;
+  DBG("Chunk moved from 0x%08x\n",addr);
+  addr = jsfFindFile(fname, &header);
+  jsvObjectSetChildAndUnLock(f,"addr",jsvNewFromInteger(addr));
+  jsvObjectRemoveChild(f,STORAGEFILE_READ_BUFFER_NAME); // this was read from the old address
+  return addr;
+}
+
 JsVar *jswrap_storagefile_read_internal(JsVar *f, int len) {
   bool isReadLine = len<0;
   char mode = (char)jsvGetIntegerAndUnLock(jsvObjectGetChild(f,"mode",0));
@@ -624,26 +779,26 @@ JsVar *jswrap_storagefile_read_internal(JsVar *f, int len) {
     return 0;
   }
 
-  uint32_t addr = (uint32_t)jsvGetIntegerAndUnLock(jsvObjectGetChild(f,"addr",0));
-  if (!addr) return 0; // end of file
+  uint32_t addr = jswrap_storagefile_getAddr(f);
+  if (!addr) return 0; // end of file (or the file was erased)
   int offset = jsvGetIntegerAndUnLock(jsvObjectGetChild(f,"offset",0));
   int fileLen = jsvGetIntegerAndUnLock(jsvObjectGetChild(f,"len",0));
-  int chunk = jsvGetIntegerAndUnLock(jsvObjectGetChild(f,"chunk",0));
-  JsfFileName fname = jsfNameFromVarAndUnLock(jsvObjectGetChild(f,"name",0));
-  int fnamei = sizeof(fname)-1;
-  while (fnamei && fname.c[fnamei-1]==0) fnamei--;
-  fname.c[fnamei]=chunk;
+  bool compressed = jsvGetBoolAndUnLock(jsvObjectGetChild(f,"compressed",0));
 
   JsVar *result = 0;
-  char buf[32];
-  if (isReadLine) len = sizeof(buf);
+  JsVar *bufVar = 0;
+  if (isReadLine) len = 0x7FFFFFFF; // until we find a newline
   while (len) {
     int remaining = fileLen - offset;
     if (remaining<=0) { // next page
+      int chunk = jsvGetIntegerAndUnLock(jsvObjectGetChild(f,"chunk",0));
       offset = 0;
       if (chunk==255) {
         addr=0;
       } else {
+        JsfFileName fname = jsfNameFromVarAndUnLock(jsvObjectGetChild(f,"name",0));
+        int fnamei = sizeof(fname)-1;
+        while (fnamei && fname.c[fnamei-1]==0) fnamei--;
         chunk++;
         fname.c[fnamei]=chunk;
         JsfFileHeader header;
@@ -657,40 +812,35 @@ JsVar *jswrap_storagefile_read_internal(JsVar *f, int len) {
       remaining = fileLen;
       if (!addr) {
         // end of file!
+        jsvUnLock(bufVar);
         return result;
       }
     }
-    int l = len;
-    if (l>(int)sizeof(buf)) l=(int)sizeof(buf);
-    if (l>remaining) l=remaining;
-    jshFlashRead(buf, addr+offset, l);
-    for (int i=0;i<l;i++) {
-      if (buf[i]==(char)255) {
-        // end of file!
-        l = i;
-        len = l;
-        break;
-      }
-      if (isReadLine && buf[i]=='\n') {
-        l = i+1;
-        len = l;
-        isReadLine = false; // done
-        break;
-      }
+    int l = remaining;
+    const char *data = jswrap_storagefile_getData(f, &bufVar, addr, offset, &l, compressed);
+    if (!data) break;
+    if (l>len) l=len;
+    const char *end;
+    // find the newline first, so we only check the line itself for 0xFF (not the whole chunk)
+    if (isReadLine && (end = memchr(data, '\n', (size_t)l))) {
+      l = (int)(end+1-data);
+      len = l; // done
+    }
+    if (!compressed && (end = memchr(data, 255, (size_t)l))) { // end of file!
+      l = (int)(end-data);
+      len = l;
     }
 
     if (!l) break;
     if (!result)
       result = jsvNewFromEmptyString();
     if (result)
-      jsvAppendStringBuf(result,buf,l);
+      jsvAppendStringBuf(result,data,(size_t)l);
 
     len -= l;
     offset += l;
-    // if we're still reading lines, set the length to buffer size
-    if (isReadLine)
-      len = sizeof(buf);
   }
+  jsvUnLock(bufVar);
   jsvObjectSetChildAndUnLock(f,"offset",jsvNewFromInteger(offset));
   return result;
 }
@@ -743,6 +893,8 @@ This requires Espruino to read the file from scratch,
 which is not a fast operation.
 */
 int jswrap_storagefile_getLength(JsVar *f) {
+  if (jsvGetBoolAndUnLock(jsvObjectGetChild(f,"compressed",0)))
+    return jsvGetIntegerAndUnLock(jsvObjectGetChild(f,"len",0));
   // Get name and position of name digit
   JsVar *n = jsvObjectGetChild(f,"name",0);
   JsfFileName fname = jsfNameFromVar(n);
@@ -789,32 +941,12 @@ int jswrap_storagefile_getLength(JsVar *f) {
     }
   }
   length += offset;
-  return length;
+  // Data that's waiting in the write buffer will be in the file soon
+  return length + jswrap_storagefile_getBufferedLength(f);
 }
 
-
-
-/*JSON{
-  "type" : "method",
-  "ifndef" : "SAVE_ON_FLASH",
-  "class" : "StorageFile",
-  "name" : "write",
-  "generate" : "jswrap_storagefile_write",
-  "params" : [
-    ["data","JsVar","The data to write. This should not include `'\\xFF'` (character code 255)"]
-  ]
-}
-Append the given data to a file. You should not attempt to append  `"\xFF"` (character code 255).
-*/
-void jswrap_storagefile_write(JsVar *f, JsVar *_data) {
-  char mode = (char)jsvGetIntegerAndUnLock(jsvObjectGetChild(f,"mode",0));
-  if (mode!='w' && mode!='a') {
-    jsExceptionHere(JSET_ERROR, "Can't write in this mode");
-    return;
-  }
-
-  JsVar *data = jsvAsString(_data);
-  if (!data) return;
+/// Write data (a String) to the end of a StorageFile in flash
+static void jswrap_storagefile_writeData(JsVar *f, JsVar *data) {
   size_t len = jsvGetStringLength(data);
   if (len==0) return;
   int offset = jsvGetIntegerAndUnLock(jsvObjectGetChild(f,"offset",0));
@@ -829,16 +961,10 @@ void jswrap_storagefile_write(JsVar *f, JsVar *_data) {
   DBG("Write Chunk %d Offset %d addr 0x%08x\n",chunk,offset,addr);
   int remaining = fileLen - offset;
   if (addr) {
-    JsfFileHeader header;
-    jshFlashRead(&header, addr-(uint32_t)sizeof(JsfFileHeader), sizeof(JsfFileHeader));
-    if (memcmp(&header.name, &fname, fnamei+1)!=0) {
-      addr = jsfFindFile(fname, &header);
-      if (!addr) {
-        jsExceptionHere(JSET_ERROR, "File deleted while writing!");
-        return;
-      } else {
-        jsvObjectSetChildAndUnLock(f,"addr",jsvNewFromInteger(addr));
-      }
+    addr = jswrap_storagefile_getAddr(f);
+    if (!addr) {
+      jsExceptionHere(JSET_ERROR, "File deleted while writing!");
+      return;
     }
   } else {
     DBG("Write Create Chunk\n");
@@ -853,7 +979,6 @@ void jswrap_storagefile_write(JsVar *f, JsVar *_data) {
     } else {
       // there would already have been an exception
     }
-    jsvUnLock(data);
     return;
   }
   if ((int)len<remaining) {
@@ -872,7 +997,6 @@ void jswrap_storagefile_write(JsVar *f, JsVar *_data) {
     // Next page
     if (chunk==255) {
       jsExceptionHere(JSET_ERROR, "File too big!");
-      jsvUnLock(data);
       return;
     } else {
       chunk++;
@@ -890,14 +1014,269 @@ void jswrap_storagefile_write(JsVar *f, JsVar *_data) {
       jsvObjectSetChildAndUnLock(f,"len",jsvNewFromInteger(fileLen));
       jsvObjectSetChildAndUnLock(f,"addr",jsvNewFromInteger(addr));
     } else {
-      jsvUnLock(data);
       return; // there would already have been an exception
     }
     offset = jsvGetStringLength(part);
     jsvUnLock(part);
     jsvObjectSetChildAndUnLock(f,"offset",jsvNewFromInteger(offset));
   }
-  jsvUnLock(data);
+}
+
+/// Data written to a buffered StorageFile is kept in this (followed by 'size' bytes of data), stored in a flat string
+typedef struct {
+  uint16_t size;       ///< write data to flash once we have this many bytes
+  uint16_t latency;    ///< write data once the oldest byte has waited this many milliseconds
+  uint16_t length;     ///< amount of data currently buffered
+  JsSysTime firstTime; ///< when the oldest buffered byte was written
+} StorageFileWriteBuffer;
+
+static StorageFileWriteBuffer *jswrap_storagefile_getWriteBuffer(JsVar *bufVar) {
+  return jsvIsFlatString(bufVar) ? (StorageFileWriteBuffer*)jsvGetFlatStringPointer(bufVar) : 0;
+}
+
+/// List of StorageFiles with data waiting in their write buffers (so the timeout can find them)
+static JsVar *jswrap_storagefile_getWriteList(bool create) {
+  return jsvObjectGetChild(execInfo.hiddenRoot, STORAGEFILE_WRITE_LIST_NAME, create?JSV_ARRAY:0);
+}
+
+/// Remove a StorageFile from the list of files with buffered data
+static void jswrap_storagefile_removeFromWriteList(JsVar *f) {
+  JsVar *list = jswrap_storagefile_getWriteList(false);
+  if (!list) return;
+  JsVar *idx = jsvGetIndexOf(list, f, true);
+  if (idx) jsvRemoveChild(list, idx);
+  jsvUnLock(idx);
+  if (!jsvGetChildren(list))
+    jsvObjectRemoveChild(execInfo.hiddenRoot, STORAGEFILE_WRITE_LIST_NAME);
+  jsvUnLock(list);
+}
+
+/** Write data from a StorageFile's write buffer to flash. If 'all' is false we only write up to the
+ * last flash page (or failing that, flash word) boundary, so each part of flash is written once in
+ * a single burst - the rest waits for more data. This doesn't remove the file from the write list */
+static void jswrap_storagefile_flushInternal(JsVar *f, bool all) {
+  JsVar *bufVar = jsvObjectGetChild(f, STORAGEFILE_WRITE_BUFFER_NAME, 0);
+  StorageFileWriteBuffer *wb = jswrap_storagefile_getWriteBuffer(bufVar);
+  if (wb && wb->length) {
+    char *buf = (char*)&wb[1];
+    uint32_t len = wb->length;
+    uint32_t addr = jswrap_storagefile_getAddr(f);
+    int offset = jsvGetIntegerAndUnLock(jsvObjectGetChild(f,"offset",0));
+    int fileLen = jsvGetIntegerAndUnLock(jsvObjectGetChild(f,"len",0));
+    if (!all && addr && offset+(int)len < fileLen) { // if we're going into a new chunk, just write it all
+      uint32_t writeAddr = addr+(uint32_t)offset;
+      uint32_t pageStart, pageSize;
+      if (jshFlashGetPage(writeAddr+len, &pageStart, &pageSize) && pageStart>writeAddr)
+        len = pageStart-writeAddr;
+      else if (len > ((writeAddr+len)&(JSF_ALIGNMENT-1)))
+        len -= (writeAddr+len)&(JSF_ALIGNMENT-1);
+    }
+    JsVar *data = jsvNewStringOfLength(len, buf);
+    if (data) {
+      // firstTime is left alone - what's left in the buffer may have been waiting since then
+      wb->length = (uint16_t)(wb->length - len);
+      memmove(buf, &buf[len], wb->length);
+      jswrap_storagefile_writeData(f, data);
+      jsvUnLock(data);
+    }
+  }
+  jsvUnLock(bufVar);
+}
+
+/// Called from a timeout to write any data that has been buffered for longer than 'latency'
+static void jswrap_storagefile_writeTimeout() {
+  jsvObjectRemoveChild(execInfo.hiddenRoot, STORAGEFILE_WRITE_TIMER_NAME); // this timeout is no longer pending
+  JsVar *list = jswrap_storagefile_getWriteList(false);
+  if (!list) return;
+  JsSysTime time = jshGetSystemTime();
+  JsSysTime nextTimeout = JSSYSTIME_MAX;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, list);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *f = jsvObjectIteratorGetValue(&it);
+    JsVar *bufVar = jsvObjectGetChild(f, STORAGEFILE_WRITE_BUFFER_NAME, 0);
+    StorageFileWriteBuffer *wb = jswrap_storagefile_getWriteBuffer(bufVar);
+    JsSysTime timeLeft = wb ? wb->firstTime + jshGetTimeFromMilliseconds(wb->latency) - time : 0;
+    if (timeLeft <= 0)
+      jswrap_storagefile_flushInternal(f, true);
+    if (!wb || !wb->length) {
+      jsvObjectIteratorRemoveAndGotoNext(&it, list);
+    } else {
+      if (timeLeft < nextTimeout)
+        nextTimeout = timeLeft;
+      jsvObjectIteratorNext(&it);
+    }
+    jsvUnLock2(bufVar, f);
+  }
+  jsvObjectIteratorFree(&it);
+  if (!jsvGetChildren(list))
+    jsvObjectRemoveChild(execInfo.hiddenRoot, STORAGEFILE_WRITE_LIST_NAME);
+  jsvUnLock(list);
+  // Something we found wasn't quite ready yet - come back for it
+  if (nextTimeout != JSSYSTIME_MAX)
+    jsiSetTimeoutOnce(STORAGEFILE_WRITE_TIMER_NAME, jswrap_storagefile_writeTimeout, jshGetMillisecondsFromTime(nextTimeout));
+}
+
+/// Add data to a StorageFile's write buffer, writing it to flash if the buffer fills up
+static void jswrap_storagefile_bufferData(JsVar *f, StorageFileWriteBuffer *wb, JsVar *data) {
+  char *buf = (char*)&wb[1];
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, data, 0);
+  while (jsvStringIteratorHasChar(&it)) {
+    if (!wb->length) {
+      // first data in the buffer - make sure it gets written in time
+      wb->firstTime = jshGetSystemTime();
+      JsVar *list = jswrap_storagefile_getWriteList(true);
+      if (list) {
+        // the file may still be listed if the buffer was emptied since the timeout last ran
+        JsVar *idx = jsvGetIndexOf(list, f, true);
+        if (!idx) jsvArrayPush(list, f);
+        jsvUnLock2(idx, list);
+      }
+      jsiSetTimeoutOnce(STORAGEFILE_WRITE_TIMER_NAME, jswrap_storagefile_writeTimeout, wb->latency);
+    }
+    buf[wb->length++] = jsvStringIteratorGetCharAndNext(&it);
+    if (wb->length >= wb->size) {
+      jswrap_storagefile_flushInternal(f, false);
+      if (jspHasError()) break;
+    }
+  }
+  jsvStringIteratorFree(&it);
+}
+
+/// Get the amount of data in a StorageFile's write buffer that hasn't been written to flash yet
+static int jswrap_storagefile_getBufferedLength(JsVar *f) {
+  JsVar *bufVar = jsvObjectGetChild(f, STORAGEFILE_WRITE_BUFFER_NAME, 0);
+  StorageFileWriteBuffer *wb = jswrap_storagefile_getWriteBuffer(bufVar);
+  int length = wb ? wb->length : 0;
+  jsvUnLock(bufVar);
+  return length;
+}
+
+/// Throw away a StorageFile's write buffer (and any data in it)
+static void jswrap_storagefile_removeWriteBuffer(JsVar *f) {
+  jswrap_storagefile_removeFromWriteList(f);
+  jsvObjectRemoveChild(f, STORAGEFILE_WRITE_BUFFER_NAME);
+}
+
+/// Set up a StorageFile's write buffer from the options given to Storage.open
+static bool jswrap_storagefile_setupWriteBuffer(JsVar *f, JsVar *options) {
+  JsVar *buffer = jsvIsObject(options) ? jsvObjectGetChild(options, "buffer", 0) : 0;
+  if (jsvIsUndefined(buffer) || jsvIsNull(buffer) || (jsvIsBoolean(buffer) && !jsvGetBool(buffer))) {
+    jsvUnLock(buffer);
+    return true;
+  }
+  JsVarInt size = jsvIsBoolean(buffer) ? STORAGEFILE_WRITE_BUFFER_SIZE : jsvGetInteger(buffer);
+  jsvUnLock(buffer);
+  JsVarInt latency = STORAGEFILE_WRITE_LATENCY;
+  JsVar *latencyVar = jsvObjectGetChild(options, "latency", 0);
+  if (latencyVar) latency = jsvGetInteger(latencyVar);
+  jsvUnLock(latencyVar);
+  if (size<1 || size>0xFFFF || latency<0 || latency>0xFFFF) {
+    jsExceptionHere(JSET_ERROR, "Invalid buffer or latency");
+    return false;
+  }
+  JsVar *bufVar = jsvNewFlatStringOfLength((unsigned int)(sizeof(StorageFileWriteBuffer) + (size_t)size));
+  if (!bufVar) {
+    jsExceptionHere(JSET_ERROR, "Unable to allocate StorageFile buffer");
+    return false;
+  }
+  StorageFileWriteBuffer *wb = jswrap_storagefile_getWriteBuffer(bufVar);
+  wb->size = (uint16_t)size;
+  wb->latency = (uint16_t)latency;
+  wb->length = 0;
+  wb->firstTime = 0;
+  jsvObjectSetChildAndUnLock(f, STORAGEFILE_WRITE_BUFFER_NAME, bufVar);
+  return true;
+}
+
+/*JSON{
+  "type" : "method",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "StorageFile",
+  "name" : "write",
+  "generate" : "jswrap_storagefile_write",
+  "params" : [
+    ["data","JsVar","The data to write. This should not include `'\\xFF'` (character code 255)"]
+  ]
+}
+Append the given data to a file. You should not attempt to append  `"\xFF"` (character code 255).
+
+If the file was opened with `{buffer:...}` the data may be kept in RAM for a while before
+being written - see `require("Storage").open`.
+*/
+void jswrap_storagefile_write(JsVar *f, JsVar *_data) {
+  char mode = (char)jsvGetIntegerAndUnLock(jsvObjectGetChild(f,"mode",0));
+  if (mode!='w' && mode!='a') {
+    jsExceptionHere(JSET_ERROR, "Can't write in this mode");
+    return;
+  }
+
+  JsVar *data = jsvAsString(_data);
+  if (!data) return;
+  JsVar *bufVar = jsvObjectGetChild(f, STORAGEFILE_WRITE_BUFFER_NAME, 0);
+  StorageFileWriteBuffer *wb = jswrap_storagefile_getWriteBuffer(bufVar);
+  if (wb)
+    jswrap_storagefile_bufferData(f, wb, data);
+  else
+    jswrap_storagefile_writeData(f, data);
+  jsvUnLock2(bufVar, data);
+}
+
+/*JSON{
+  "type" : "method",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "StorageFile",
+  "name" : "flush",
+  "generate" : "jswrap_storagefile_flush"
+}
+If the file was opened with `{buffer:...}`, write any data that is still
+buffered in RAM to flash right now. Otherwise this does nothing.
+*/
+void jswrap_storagefile_flush(JsVar *f) {
+  jswrap_storagefile_flushInternal(f, true);
+  jswrap_storagefile_removeFromWriteList(f);
+}
+
+/*JSON{
+  "type" : "method",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "StorageFile",
+  "name" : "close",
+  "generate" : "jswrap_storagefile_close"
+}
+Write any buffered data to flash (see `StorageFile.flush`) and close the file. It
+can't be read from or written to afterwards.
+
+Files that weren't opened with `{buffer:...}` don't need closing.
+*/
+void jswrap_storagefile_close(JsVar *f) {
+  jswrap_storagefile_flushInternal(f, true);
+  jswrap_storagefile_removeWriteBuffer(f);
+  jsvObjectRemoveChild(f, STORAGEFILE_READ_BUFFER_NAME);
+  jsvObjectSetChildAndUnLock(f,"mode",jsvNewFromInteger(0));
+}
+
+/*JSON{
+  "type" : "kill",
+  "generate" : "jswrap_storage_kill",
+  "ifndef" : "SAVE_ON_FLASH"
+}*/
+void jswrap_storage_kill() {
+  // Write out anything that's still buffered before we lose it
+  JsVar *list = jswrap_storagefile_getWriteList(false);
+  if (!list) return;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, list);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *f = jsvObjectIteratorGetValue(&it);
+    jswrap_storagefile_flushInternal(f, true);
+    jsvUnLock(f);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  jsvUnLock(list);
+  jsvObjectRemoveChild(execInfo.hiddenRoot, STORAGEFILE_WRITE_LIST_NAME);
 }
 
 /*JSON{
@@ -910,6 +1289,10 @@ void jswrap_storagefile_write(JsVar *f, JsVar *_data) {
 Erase this file
 */
 void jswrap_storagefile_erase(JsVar *f) {
+  if (jsvGetBoolAndUnLock(jsvObjectGetChild(f,"compressed",0))) {
+    jsfEraseFile(jsfNameFromVarAndUnLock(jsvObjectGetChild(f,"name",0)));
+    jsvObjectRemoveChild(f,"compressed");
+  }
   JsfFileName fname = jsfNameFromVarAndUnLock(jsvObjectGetChild(f,"name",0));
   int fnamei = sizeof(fname)-1;
   while (fnamei && fname.c[fnamei-1]==0) fnamei--;
@@ -922,6 +1305,7 @@ void jswrap_storagefile_erase(JsVar *f) {
     chunk++;
   }
   // reset everything
+  jswrap_storagefile_removeWriteBuffer(f);
   jsvObjectSetChildAndUnLock(f,"chunk",jsvNewFromInteger(1));
   jsvObjectSetChildAndUnLock(f,"offset",jsvNewFromInteger(0));
   jsvObjectSetChildAndUnLock(f,"addr",jsvNewFromInteger(0));
@@ -122,6 +122,9 @@ void jswInit();
 /** Tasks to run on Deinitialisation */
 void jswKill();
 
+/** Tasks to run when we're low on memory. Returns true if any memory was freed */
+bool jswFreeMoreMemory();
+
 /** Tasks to run when a character is received on a certain event channel. True if handled and shouldn't go to IRQ */
 bool jswOnCharEvent(IOEventFlags channel, char charData);
 
@@ -16,12 +16,15 @@
  #include <stdio.h>
  #include <unistd.h>
  #include <sys/time.h>
+ #include <time.h>
 #ifdef __MINGW32__
  #include <conio.h>
 #else//!__MINGW32__
  #include <sys/select.h>
  #include <termios.h>
  #include <fcntl.h>
+ #include <errno.h>
+ #include <sys/mman.h>
 #endif//__MINGW32__
  #include <signal.h>
  #include <inttypes.h>
@@ -31,12 +34,26 @@
 #include "jsutils.h"
 #include "jsparse.h"
 #include "jsinteractive.h"
+#include "jshardware_linux.h"
 
 #include <pthread.h>
+#ifdef USE_EPOLL
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#endif
 
 #define FAKE_FLASH_FILENAME  "espruino.flash"
 #define FAKE_FLASH_BLOCKSIZE FLASH_PAGE_SIZE
 #define FAKE_FLASH_BLOCKS    (FLASH_TOTAL/FLASH_PAGE_SIZE)
+#ifndef __MINGW32__
+/* Map the flash file into memory once rather than opening it for every
+ * access. This also lets jshFlashGetMemMapAddress return real pointers so
+ * Storage.read can return native strings like it does on most MCUs */
+#define FAKE_FLASH_MMAP
+static void jshFlashUnmap();
+#endif
 
 #ifndef FLASH_64BITS_ALIGNMENT
 #define FLASH_UNITARY_WRITE_SIZE 4
@@ -68,19 +85,24 @@ JshPinState gpioState[JSH_PIN_COUNT]; // will be set to UNDEFINED if it isn't ex
 
 bool gpioShouldWatch[JSH_PIN_COUNT]; // whether we should watch this pin for changes
 bool gpioLastState[JSH_PIN_COUNT]; // the last state of this pin
+#ifdef USE_EPOLL
+int gpioValueFd[JSH_PIN_COUNT]; // if >=0, the pin's 'value' file, registered with epoll for edge interrupts (otherwise we poll the pin)
+#endif
 
 
-// functions for accessing the sysfs GPIO
-void sysfs_write(const char *path, const char *data) {
+// functions for accessing the sysfs GPIO. Returns true on success
+bool sysfs_write(const char *path, const char *data) {
 /*  jsiConsolePrint(path);
   jsiConsolePrint(" = '");
   jsiConsolePrint(data);
   jsiConsolePrint("'\n");*/
+  bool ok = false;
   int f = open(path, O_WRONLY);
   if (f>=0) {
-    write(f, data, strlen(data));
+    ok = write(f, data, strlen(data)) == (ssize_t)strlen(data);
     close(f);
   } 
+  return ok;
 }
 
 void sysfs_write_int(const char *path, JsVarInt val) {
@@ -113,22 +135,30 @@ JsVarInt sysfs_read_int(const char *path) {
 #error EXTI_COUNT needs to be 16 or above for WiringPi
 #endif
 
-void irqEXTI0() { jshPushIOWatchEvent(EV_EXTI0); }
-void irqEXTI1() { jshPushIOWatchEvent(EV_EXTI0+1); }
-void irqEXTI2() { jshPushIOWatchEvent(EV_EXTI0+2); }
-void irqEXTI3() { jshPushIOWatchEvent(EV_EXTI0+3); }
-void irqEXTI4() { jshPushIOWatchEvent(EV_EXTI0+4); }
-void irqEXTI5() { jshPushIOWatchEvent(EV_EXTI0+5); }
-void irqEXTI6() { jshPushIOWatchEvent(EV_EXTI0+6); }
-void irqEXTI7() { jshPushIOWatchEvent(EV_EXTI0+7); }
-void irqEXTI8() { jshPushIOWatchEvent(EV_EXTI0+8); }
-void irqEXTI9() { jshPushIOWatchEvent(EV_EXTI0+9); }
-void irqEXTI10() { jshPushIOWatchEvent(EV_EXTI0+10); }
-void irqEXTI11() { jshPushIOWatchEvent(EV_EXTI0+11); }
-void irqEXTI12() { jshPushIOWatchEvent(EV_EXTI0+12); }
-void irqEXTI13() { jshPushIOWatchEvent(EV_EXTI0+13); }
-void irqEXTI14() { jshPushIOWatchEvent(EV_EXTI0+14); }
-void irqEXTI15() { jshPushIOWatchEvent(EV_EXTI0+15); }
+static void jshInputThreadWakeMain();
+
+/// Called from WiringPi's interrupt thread - push the event and wake jshSleep, as the sysfs watcher does
+static void irqEXTIPush(IOEventFlags channel) {
+  jshPushIOWatchEvent(channel);
+  jshInputThreadWakeMain();
+}
+
+void irqEXTI0() { irqEXTIPush(EV_EXTI0); }
+void irqEXTI1() { irqEXTIPush(EV_EXTI0+1); }
+void irqEXTI2() { irqEXTIPush(EV_EXTI0+2); }
+void irqEXTI3() { irqEXTIPush(EV_EXTI0+3); }
+void irqEXTI4() { irqEXTIPush(EV_EXTI0+4); }
+void irqEXTI5() { irqEXTIPush(EV_EXTI0+5); }
+void irqEXTI6() { irqEXTIPush(EV_EXTI0+6); }
+void irqEXTI7() { irqEXTIPush(EV_EXTI0+7); }
+void irqEXTI8() { irqEXTIPush(EV_EXTI0+8); }
+void irqEXTI9() { irqEXTIPush(EV_EXTI0+9); }
+void irqEXTI10() { irqEXTIPush(EV_EXTI0+10); }
+void irqEXTI11() { irqEXTIPush(EV_EXTI0+11); }
+void irqEXTI12() { irqEXTIPush(EV_EXTI0+12); }
+void irqEXTI13() { irqEXTIPush(EV_EXTI0+13); }
+void irqEXTI14() { irqEXTIPush(EV_EXTI0+14); }
+void irqEXTI15() { irqEXTIPush(EV_EXTI0+15); }
 void irqEXTIDoNothing() { }
 
 void (*irqEXTIs[16])(void) = {
@@ -241,8 +271,8 @@ int getch()
 {
     int r;
     unsigned char c;
-    if ((r = (int)read(STDIN_FILENO, &c, sizeof(c))) < 0) {
-        return r;
+    if ((r = (int)read(STDIN_FILENO, &c, sizeof(c))) <= 0) {
+        return -1; // error or end of file
     } else {
         return c;
     }
@@ -251,34 +281,143 @@ int getch()
 
 pthread_t inputThread;
 bool isInitialised;
+#ifdef USE_EPOLL
+/// What a file descriptor registered with epollFd is for (stored in the top 32 bits of epoll_event.data.u64)
+typedef enum {
+  EPW_STDIN,
+  EPW_DEVICE, ///< ioDevices[id]
+  EPW_GPIO,   ///< gpioValueFd[id]
+  EPW_SOCKET, ///< id is the socket itself
+  EPW_TIMER,  ///< timerFd
+  EPW_KICK,   ///< kickFd
+} EpollWatchType;
+#define EPW_TAG(TYPE, ID) ((((uint64_t)(TYPE))<<32) | (uint32_t)(ID))
+/// Everything the input thread waits on
+int epollFd = -1;
+/// Armed by jshSleep so the input thread wakes us when the next JS timer is due
+int timerFd = -1;
+/// Written to wake the input thread up (eg. when there is data to transmit, or to kill it)
+int kickFd = -1;
+/// Written by the input thread to wake jshSleep
+int mainWakeFd = -1;
+/// True if stdin is registered with epollFd (it can't be if it's a file, so then we poll it)
+bool stdinWatched;
+/// True once stdin has been closed, so we don't need to check it
+bool stdinClosed;
+bool jshLinuxSleepUntilWoken = true;
+
+static bool jshEpollAdd(int fd, uint32_t events, uint64_t tag) {
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.u64 = tag;
+  return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+static void jshEventFdWrite(int fd) {
+  uint64_t one = 1;
+  if (fd>=0 && write(fd, &one, sizeof(one))<0) {
+    // only fails if the counter is already huge - in which case it'll wake anyway
+  }
+}
+
+static void jshEventFdClear(int fd) {
+  uint64_t value;
+  if (read(fd, &value, sizeof(value))<0) {
+    // nothing to clear
+  }
+}
+
+void jshLinuxWatchSocket(int sckt, bool forWrite) {
+  if (epollFd<0 || sckt<0) return;
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT | (forWrite ? EPOLLOUT : 0);
+  ev.data.u64 = EPW_TAG(EPW_SOCKET, sckt);
+  if (epoll_ctl(epollFd, EPOLL_CTL_MOD, sckt, &ev)<0 && errno==ENOENT)
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, sckt, &ev);
+}
+
+void jshLinuxUnwatchSocket(int sckt) {
+  if (epollFd<0 || sckt<0) return;
+  epoll_ctl(epollFd, EPOLL_CTL_DEL, sckt, NULL);
+}
+
+/// Register an open Serial/SPI device so the input thread wakes when it has data
+static void jshLinuxWatchDevice(IOEventFlags device) {
+  if (epollFd>=0 && ioDevices[device])
+    jshEpollAdd(ioDevices[device], EPOLLIN, EPW_TAG(EPW_DEVICE, device));
+}
+#else
+/// Signalled by the input thread when it has pushed events, so jshSleep can wake up straight away
+pthread_mutex_t inputWakeMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t inputWakeCond = PTHREAD_COND_INITIALIZER;
+#endif
+
+static void jshInputThreadWakeMain() {
+#ifdef USE_EPOLL
+  jshEventFdWrite(mainWakeFd);
+#else
+  pthread_mutex_lock(&inputWakeMutex);
+  pthread_cond_signal(&inputWakeCond);
+  pthread_mutex_unlock(&inputWakeMutex);
+#endif
+}
+
+#ifdef SYSFS_GPIO_DIR
+/// Push an event if a watched pin has changed state. Returns true if an event was pushed
+static bool jshInputThreadPinChanged(Pin pin, bool state) {
+  if (state == gpioLastState[pin]) return false;
+  jshPushIOEvent(pinToEVEXTI(pin) | (state?EV_EXTI_IS_HIGH:0), jshGetSystemTime());
+  gpioLastState[pin] = state;
+  return true;
+}
+#endif
 
 void jshInputThread() {
+#ifdef USE_EPOLL
+  bool stdinReady = true;
+#endif
   while (isInitialised) {
     bool shortSleep = false;
+    bool hasPushed = false;
     /* Handle the delayed Ctrl-C -> interrupt behaviour (see description by EXEC_CTRL_C's definition)  */
     if (execInfo.execute & EXEC_CTRL_C_WAIT)
       execInfo.execute = (execInfo.execute & ~EXEC_CTRL_C_WAIT) | EXEC_INTERRUPTED;
     if (execInfo.execute & EXEC_CTRL_C)
       execInfo.execute = (execInfo.execute & ~EXEC_CTRL_C) | EXEC_CTRL_C_WAIT;
     // Read from the console if we have space
-    while (kbhit() && (jshGetEventsUsed()<IOBUFFERMASK/2)) {
-      int ch = getch();
-      if (ch<0) break;
-      if (ch==4) exit(0); // exit on Ctrl-D
-      jshPushIOCharEvent(EV_USBSERIAL, (char)ch);
+#ifdef USE_EPOLL
+    if ((stdinReady || !stdinWatched) && !stdinClosed) {
+      while ((jshGetEventsUsed()<IOBUFFERMASK/2) && (stdinReady = (kbhit()>0))) {
+#else
+    {
+      while (kbhit() && (jshGetEventsUsed()<IOBUFFERMASK/2)) {
+#endif
+        int ch = getch();
+        if (ch<0) break;
+        if (ch==4) exit(0); // exit on Ctrl-D
+        jshPushIOCharEvent(EV_USBSERIAL, (char)ch);
+        hasPushed = true;
+      }
     }
     // Read from any open devices - if we have space
     if (jshGetEventsUsed() < IOBUFFERMASK/2) {
       int i;
       for (i=0;i<=EV_DEVICE_MAX;i++) {
         if (ioDevices[i]) {
-          char buf[32];
+          char buf[256];
+          // only read as much as we can fit in the event queue in one go
+          int bytes = (IOBUFFERMASK/2 - jshGetEventsUsed()) * IOEVENT_MAXCHARS;
+          if (bytes > (int)sizeof(buf)) bytes = (int)sizeof(buf);
+          if (bytes <= 0) break;
           // read can return -1 (EAGAIN) because O_NONBLOCK is set
-          int bytes = (int)read(ioDevices[i], buf, sizeof(buf));
+          bytes = (int)read(ioDevices[i], buf, (size_t)bytes);
           if (bytes>0) {
             //int j; for (j=0;j<bytes;j++) printf("]] '%c'\r\n", buf[j]);
             jshPushIOCharEvents(i, buf, (unsigned int)bytes);
             shortSleep = true;
+            hasPushed = true;
           }
         }
       }
@@ -286,10 +425,20 @@ void jshInputThread() {
     // Write any data we have
     IOEventFlags device = jshGetDeviceToTransmit();
     while (device != EV_NONE) {
-      char ch = (char)jshGetCharToTransmit(device);
-      //printf("[[ '%c'\r\n", ch);
+      unsigned char buf[TXBUFFERMASK+1];
+      unsigned int len = jshGetDataToTransmit(device, buf, sizeof(buf));
       if (ioDevices[device]) {
-        write(ioDevices[device], &ch, 1);
+        unsigned char *ptr = buf;
+        while (len) { // the device is non-blocking, so we may not be able to write it all at once
+          ssize_t written = write(ioDevices[device], ptr, len);
+          if (written>0) {
+            ptr += written;
+            len -= (unsigned int)written;
+          } else if (written<0 && errno!=EAGAIN && errno!=EWOULDBLOCK) {
+            break;
+          } else
+            jshDelayMicroseconds(100);
+        }
         shortSleep = true;
       }
       device = jshGetDeviceToTransmit();
@@ -299,17 +448,68 @@ void jshInputThread() {
 #ifdef SYSFS_GPIO_DIR
     Pin pin;
     for (pin=0;pin<JSH_PIN_COUNT;pin++)
-      if (gpioShouldWatch[pin]) {
+#ifdef USE_EPOLL
+      if (gpioShouldWatch[pin] && gpioValueFd[pin]<0) // if we couldn't get edge interrupts, poll
+#else
+      if (gpioShouldWatch[pin])
+#endif
+      {
         shortSleep = true;
-        bool state = jshPinGetValue(pin);
-        if (state != gpioLastState[pin]) {
-          jshPushIOEvent(pinToEVEXTI(pin) | (state?EV_EXTI_IS_HIGH:0), jshGetSystemTime());
-          gpioLastState[pin] = state;
-        }
+        if (jshInputThreadPinChanged(pin, jshPinGetValue(pin)))
+          hasPushed = true;
       }
 #endif
 
-    jshDelayMicroseconds(shortSleep ? 1000 : 50000);
+    if (hasPushed) jshInputThreadWakeMain();
+#ifdef USE_EPOLL
+    if (epollFd<0 || jshGetEventsUsed()>=IOBUFFERMASK/2) {
+      // no epoll, or the queue is full and we must give the main thread time to empty it before reading more
+      jshDelayMicroseconds((epollFd<0) ? 1000 : 100);
+      continue;
+    }
+    int timeout = -1; // wait until something happens
+    if (shortSleep) timeout = 1; // we're polling pins, or are busy receiving/sending
+    else if ((!stdinWatched && !stdinClosed) || (execInfo.execute & (EXEC_CTRL_C|EXEC_CTRL_C_WAIT)))
+      timeout = 50;
+    struct epoll_event events[16];
+    int i, n = epoll_wait(epollFd, events, sizeof(events)/sizeof(struct epoll_event), timeout);
+    for (i=0;i<n;i++) {
+      uint32_t id = (uint32_t)events[i].data.u64;
+      switch ((EpollWatchType)(events[i].data.u64>>32)) {
+        case EPW_STDIN:
+          if (events[i].events & EPOLLIN) {
+            stdinReady = true;
+          } else { // hung up
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, STDIN_FILENO, NULL);
+            stdinClosed = true;
+          }
+          break;
+        case EPW_DEVICE: break; // devices are read at the top of the loop
+#ifdef SYSFS_GPIO_DIR
+        case EPW_GPIO: {
+          char value[4];
+          if (pread(gpioValueFd[id], value, sizeof(value), 0)>0 &&
+              jshInputThreadPinChanged((Pin)id, value[0]=='1'))
+            jshInputThreadWakeMain();
+        } break;
+#endif
+        case EPW_SOCKET: // one-shot, so the network layer re-arms it when it has read everything
+          jshInputThreadWakeMain();
+          break;
+        case EPW_TIMER:
+          jshEventFdClear(timerFd);
+          jshInputThreadWakeMain();
+          break;
+        case EPW_KICK:
+          jshEventFdClear(kickFd);
+          break;
+        default: break;
+      }
+    }
+#else
+    // if we're receiving data, come straight back for more
+    jshDelayMicroseconds(hasPushed ? 100 : (shortSleep ? 1000 : 50000));
+#endif
   }
 }
 
@@ -354,7 +554,26 @@ void jshInit() {
 #ifdef SYSFS_GPIO_DIR
   for (i=0;i<JSH_PIN_COUNT;i++) {
     gpioShouldWatch[i] = false;    
+#ifdef USE_EPOLL
+    gpioValueFd[i] = -1;
+#endif
+  }
+#endif
+#ifdef USE_EPOLL
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+  timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  kickFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  mainWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (epollFd<0 || timerFd<0 || kickFd<0 || mainWakeFd<0 ||
+      !jshEpollAdd(timerFd, EPOLLIN, EPW_TAG(EPW_TIMER, 0)) ||
+      !jshEpollAdd(kickFd, EPOLLIN, EPW_TAG(EPW_KICK, 0))) {
+    printf("Unable to set up epoll, %s - polling instead\n", strerror(errno));
+    if (epollFd>=0) close(epollFd);
+    epollFd = -1;
   }
+  // stdin can't be watched if it's a file, in which case we'll just poll it
+  stdinClosed = false;
+  stdinWatched = epollFd>=0 && jshEpollAdd(STDIN_FILENO, EPOLLIN, EPW_TAG(EPW_STDIN, 0));
 #endif
 
   isInitialised = true;
@@ -370,8 +589,15 @@ void jshReset() {
 void jshKill() {
   int i;
 
+#ifdef FAKE_FLASH_MMAP
+  jshFlashUnmap();
+#endif
+
   // Request that the input thread finishes
   isInitialised = false;
+#ifdef USE_EPOLL
+  jshEventFdWrite(kickFd); // wake it up if it's waiting
+#endif
   // wait for thread to finish
   pthread_join(inputThread, NULL);
 
@@ -384,9 +610,23 @@ void jshKill() {
 #ifdef SYSFS_GPIO_DIR
 
   // unexport any GPIO that we exported
-  for (i=0;i<JSH_PIN_COUNT;i++)
+  for (i=0;i<JSH_PIN_COUNT;i++) {
+#ifdef USE_EPOLL
+    if (gpioValueFd[i]>=0) {
+      close(gpioValueFd[i]);
+      gpioValueFd[i] = -1;
+    }
+#endif
     if (gpioState[i] != JSHPINSTATE_UNDEFINED)
       sysfs_write_int(SYSFS_GPIO_DIR"/unexport", i);
+  }
+#endif
+#ifdef USE_EPOLL
+  if (epollFd>=0) close(epollFd);
+  if (timerFd>=0) close(timerFd);
+  if (kickFd>=0) close(kickFd);
+  if (mainWakeFd>=0) close(mainWakeFd);
+  epollFd = timerFd = kickFd = mainWakeFd = -1;
 #endif
 }
 
@@ -598,6 +838,23 @@ IOEventFlags jshPinWatch(Pin pin, bool shouldWatch, JshPinWatchFlags flags) {
 #ifdef SYSFS_GPIO_DIR
         gpioShouldWatch[pin] = true;
         gpioLastState[pin] = jshPinGetValue(pin);
+#ifdef USE_EPOLL
+        // If the pin can give us edge interrupts, wait on them rather than polling
+        char path[64] = SYSFS_GPIO_DIR"/gpio";
+        itostr(pin, &path[strlen(path)], 10);
+        size_t pathLen = strlen(path);
+        strcpy(&path[pathLen], "/edge");
+        if (epollFd>=0 && gpioValueFd[pin]<0 && sysfs_write(path, "both")) {
+          strcpy(&path[pathLen], "/value");
+          int fd = open(path, O_RDONLY | O_NONBLOCK);
+          char value[4];
+          if (fd>=0 && pread(fd, value, sizeof(value), 0)>=0 && // must read before waiting for an edge
+              jshEpollAdd(fd, EPOLLPRI | EPOLLERR, EPW_TAG(EPW_GPIO, pin))) {
+            gpioValueFd[pin] = fd;
+          } else if (fd>=0)
+            close(fd);
+        }
+#endif
 #endif
 #ifdef USE_WIRINGPI
         wiringPiISR(pin, INT_EDGE_BOTH, irqEXTIs[exti-EV_EXTI0]);
@@ -609,6 +866,16 @@ IOEventFlags jshPinWatch(Pin pin, bool shouldWatch, JshPinWatchFlags flags) {
       gpioEventFlags[pin] = 0;
 #ifdef SYSFS_GPIO_DIR
       gpioShouldWatch[pin] = false;
+#ifdef USE_EPOLL
+      if (gpioValueFd[pin]>=0) {
+        close(gpioValueFd[pin]); // also removes it from epoll
+        gpioValueFd[pin] = -1;
+        char path[64] = SYSFS_GPIO_DIR"/gpio";
+        itostr(pin, &path[strlen(path)], 10);
+        strcat(&path[strlen(path)], "/edge");
+        sysfs_write(path, "none");
+      }
+#endif
 #endif
 #ifdef USE_WIRINGPI
       wiringPiISR(pin, INT_EDGE_BOTH, irqEXTIDoNothing);
@@ -645,9 +912,13 @@ void jshUSARTSetup(IOEventFlags device, JshUSARTInfo *inf) {
   char path[256];
   if (jshGetDevicePath(device, path, sizeof(path))) {
     ioDevices[device] = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
-    if (!ioDevices[device]) {
+    if (ioDevices[device]<0) {
+      ioDevices[device] = 0;
       jsError("Open of path %s failed", path);
     } else {
+#ifdef USE_EPOLL
+      jshLinuxWatchDevice(device);
+#endif
       struct termios settings;
       tcgetattr(ioDevices[device], &settings); // get current settings
 
@@ -726,7 +997,10 @@ void jshUSARTSetup(IOEventFlags device, JshUSARTInfo *inf) {
  * to set up interrupts */
 void jshUSARTKick(IOEventFlags device) {
   assert(DEVICE_IS_USART(device) || DEVICE_IS_SPI(device));
-  // all done by the idle loop
+  // all done by the input thread
+#ifdef USE_EPOLL
+  jshEventFdWrite(kickFd); // wake it up if it's waiting
+#endif
 }
 
 void jshSPISetup(IOEventFlags device, JshSPIInfo *inf) {
@@ -736,9 +1010,13 @@ void jshSPISetup(IOEventFlags device, JshSPIInfo *inf) {
    char path[256];
    if (jshGetDevicePath(device, path, sizeof(path))) {
      ioDevices[device] = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
-     if (!ioDevices[device]) {
+     if (ioDevices[device]<0) {
+       ioDevices[device] = 0;
        jsError("Open of path %s failed", path);
      } else {
+#ifdef USE_EPOLL
+       jshLinuxWatchDevice(device);
+#endif
      }
    } else {
      jsError("No path defined for device");
@@ -784,6 +1062,28 @@ void jshI2CRead(IOEventFlags device, unsigned char address, int nBytes, unsigned
 
 /// Enter simple sleep mode (can be woken up by interrupts). Returns true on success
 bool jshSleep(JsSysTime timeUntilWake) {
+#ifdef USE_EPOLL
+  // Everything we could be waiting for wakes the input thread, which then wakes us
+  JsVarFloat usecfloat = jshGetMillisecondsFromTime(timeUntilWake)*1000;
+  unsigned int usecs = (usecfloat < 0xFFFFFFFF) ? (unsigned int)usecfloat : 0xFFFFFFFF;
+  if (usecs < 1000) return true;
+  if (!jshLinuxSleepUntilWoken && usecs > 50000)
+    usecs = 50000;
+  int timeout = -1;
+  if (epollFd>=0) {
+    struct itimerspec ts;
+    memset(&ts, 0, sizeof(ts));
+    ts.it_value.tv_sec = (time_t)(usecs/1000000);
+    ts.it_value.tv_nsec = (long)(usecs%1000000)*1000;
+    timerfd_settime(timerFd, 0, &ts, NULL);
+  } else
+    timeout = 1; // no epoll, so the input thread is polling - we should too
+  if (!jshHasEvents()) {
+    struct pollfd pfd = { .fd = mainWakeFd, .events = POLLIN };
+    poll(&pfd, 1, timeout); // returns early if interrupted by a signal
+  }
+  jshEventFdClear(mainWakeFd);
+#else
   bool hasWatches = false;
 #ifdef SYSFS_GPIO_DIR
   Pin pin;
@@ -797,8 +1097,19 @@ bool jshSleep(JsSysTime timeUntilWake) {
     usecs=1000; // don't sleep much if we have watches - we need to keep polling them
   if (usecs > 50000)
     usecs = 50000; // don't want to sleep too much (user input/HTTP/etc)
-  if (usecs >= 1000)  
-    jshDelayMicroseconds(usecs);
+  if (usecs >= 1000) {
+    // wait, but wake up early if the input thread pushes any events
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += (long)(usecs%1000000)*1000;
+    ts.tv_sec += (time_t)(usecs/1000000) + ts.tv_nsec/1000000000;
+    ts.tv_nsec %= 1000000000;
+    pthread_mutex_lock(&inputWakeMutex);
+    if (!jshHasEvents())
+      pthread_cond_timedwait(&inputWakeCond, &inputWakeMutex, &ts);
+    pthread_mutex_unlock(&inputWakeMutex);
+  }
+#endif
   return true;
 }
 
@@ -849,6 +1160,105 @@ JsVar *jshFlashGetFree() {
   return jsFreeFlash;
 }
 
+#ifdef FAKE_FLASH_MMAP
+static unsigned char *flashMap = 0; ///< The contents of FAKE_FLASH_FILENAME, or 0 if not mapped yet
+
+/// Memory-map the flash file (creating it if 'create' is set). Returns 0 if it couldn't be mapped
+static unsigned char *jshFlashMap(bool create) {
+  if (flashMap) return flashMap;
+  int fd = open(FAKE_FLASH_FILENAME, O_RDWR | (create ? O_CREAT : 0), 0644);
+  if (fd<0) return 0;
+  off_t len = FAKE_FLASH_BLOCKSIZE*FAKE_FLASH_BLOCKS;
+  off_t filelen = lseek(fd, 0, SEEK_END);
+  if (filelen>=0 && filelen<len) {
+    // Pad with 0xFF (erased flash) - mapping beyond the end of the file would give us zeros
+    size_t pad = (size_t)(len-filelen);
+    char *buf = malloc(pad);
+    ssize_t w = -1;
+    if (buf) {
+      memset(buf,0xFF, pad);
+      w = write(fd, buf, pad);
+      free(buf);
+    }
+    if (w!=(ssize_t)pad) {
+      close(fd);
+      return 0;
+    }
+  }
+  void *m = mmap(0, (size_t)len, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd); // the mapping keeps its own reference to the file
+  if (m==MAP_FAILED) return 0;
+  flashMap = (unsigned char*)m;
+  return flashMap;
+}
+
+/** Ask for the part of the flash file we just changed to be written back to disk. This is
+ * MS_ASYNC so writes stay cheap - jshFlashUnmap does a full MS_SYNC when we exit */
+static void jshFlashSync(uint32_t offset, uint32_t len) {
+  uint32_t pageMask = (uint32_t)sysconf(_SC_PAGESIZE)-1;
+  uint32_t start = offset & ~pageMask;
+  msync(&flashMap[start], offset+len-start, MS_ASYNC);
+}
+
+/// Write any changes to the flash file back to disk and unmap it
+static void jshFlashUnmap() {
+  if (!flashMap) return;
+  msync(flashMap, FAKE_FLASH_BLOCKSIZE*FAKE_FLASH_BLOCKS, MS_SYNC);
+  munmap(flashMap, FAKE_FLASH_BLOCKSIZE*FAKE_FLASH_BLOCKS);
+  flashMap = 0;
+}
+
+void jshFlashErasePage(uint32_t addr) {
+  //jsDebug(DBG_VERBOSE,"FlashErasePage 0x%08x\n", addr);
+  unsigned char *m = jshFlashMap(false);
+  if (!m) return; // if no file and we're erasing, we don't have to do anything
+  uint32_t startAddr, pageSize;
+  if (jshFlashGetPage(addr, &startAddr, &pageSize)) {
+    memset(&m[startAddr-FLASH_START], 0xFF, pageSize);
+    jshFlashSync(startAddr-FLASH_START, pageSize);
+  }
+}
+void jshFlashRead(void *buf, uint32_t addr, uint32_t len) {
+  //jsDebug(DBG_VERBOSE,"FlashRead 0x%08x %d\n", addr,len);
+  if (addr<FLASH_START || addr+len>FLASH_START+FLASH_TOTAL) {
+    assert(0); // out of range
+    return;
+  }
+  unsigned char *m = jshFlashMap(false);
+  if (!m) { // no file, so it's all 0xFF
+    memset(buf, 0xFF, len);
+    return;
+  }
+  memcpy(buf, &m[addr-FLASH_START], len);
+}
+void jshFlashWrite(void *buf, uint32_t addr, uint32_t len) {
+  //jsDebug(DBG_VERBOSE,"FlashWrite 0x%08x %d\n", addr,len);
+  uint32_t i;
+#ifndef SPIFLASH_BASE // for debug
+  assert(!(addr&(FLASH_UNITARY_WRITE_SIZE-1))); // sanity checks here to mirror real hardware
+  assert(!(len&(FLASH_UNITARY_WRITE_SIZE-1))); // sanity checks here to mirror real hardware
+#endif
+  if (addr<FLASH_START || addr+len>FLASH_START+FLASH_TOTAL) {
+    assert(0); // out of range
+    return;
+  }
+  unsigned char *m = jshFlashMap(true);
+  if (!m) return;
+  m += addr-FLASH_START;
+  // like real flash, we can only clear bits
+  for (i=0;i<len;i++)
+    m[i] &= ((unsigned char*)buf)[i];
+  jshFlashSync(addr-FLASH_START, len);
+}
+
+size_t jshFlashGetMemMapAddress(size_t ptr) {
+  if (ptr<FLASH_START || ptr>=FLASH_START+FLASH_TOTAL)
+    return 0;
+  unsigned char *m = jshFlashMap(false);
+  if (!m) return 0;
+  return (size_t)&m[ptr-FLASH_START];
+}
+#else // !FAKE_FLASH_MMAP
 static FILE *jshFlashOpenFile(bool dontCreate) {
   FILE *f = fopen(FAKE_FLASH_FILENAME, "r+b");
   if (!f && dontCreate) return 0;
@@ -946,6 +1356,7 @@ void jshFlashWrite(void *buf, uint32_t addr, uint32_t len) {
 size_t jshFlashGetMemMapAddress(size_t ptr) {
   return 0;
 }
+#endif // FAKE_FLASH_MMAP
 
 unsigned int jshSetSystemClock(JsVar *options) {
   return 0;
@@ -0,0 +1,39 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * Linux-specific parts of the Hardware interface Layer that other
+ * Linux-only code (eg. the network) needs access to
+ * ----------------------------------------------------------------------------
+ */
+#ifndef JSHARDWARE_LINUX_H_
+#define JSHARDWARE_LINUX_H_
+
+#include "jsutils.h"
+
+/* On Linux everything the idle loop could be waiting for (stdin, Serial
+ * devices, GPIO, sockets and the next timer) is registered on a single epoll
+ * instance so we only wake up when there's work to do. Other platforms
+ * using this target (MacOS) fall back to polling. */
+#if defined(__linux__) && !defined(__MINGW32__)
+#define USE_EPOLL
+#endif
+
+#ifdef USE_EPOLL
+/** If there are no timers jshSleep normally waits until something (input, a
+ * socket or a pin) wakes it. When running code to completion (eg. with `-e`)
+ * this is cleared so that we still return every so often to check if we're done */
+extern bool jshLinuxSleepUntilWoken;
+/// Wake the idle loop once when the socket becomes readable (or writable if forWrite). Must be called again after each wake
+void jshLinuxWatchSocket(int sckt, bool forWrite);
+/// Stop waking the idle loop for the socket (call before closing it)
+void jshLinuxUnwatchSocket(int sckt);
+#endif
+
+#endif /* JSHARDWARE_LINUX_H_ */
@@ -16,6 +16,10 @@
 #include "jsinteractive.h"
 #include "jswrapper.h"
 
+#include "jshardware_linux.h"
+#ifdef USE_NET
+#include "socketserver.h"
+#endif
 #ifdef ESPR_JIT
 #include "jsjit.h"
 #endif
@@ -131,6 +135,18 @@ void addNativeFunction(const char *name, void (*callbackPtr)(void)) {
 
 void nativeQuit() { isRunning = false; }
 
+/// After running code, should we keep going around the idle loop (rather than exiting)?
+static bool shouldKeepRunning(bool isBusy) {
+#ifdef USE_EPOLL
+  jshLinuxSleepUntilWoken = false; // make sure jshSleep returns now and then so we can check
+#endif
+  return isRunning && (isBusy || jsiHasTimers()
+#ifdef USE_NET
+      || socketHasConnections() // we may still get data, even if we're not busy
+#endif
+      );
+}
+
 void nativeInterrupt() { jspSetInterrupted(true); }
 
 static char *read_file(const char *filename) {
@@ -191,7 +207,7 @@ bool run_test(const char *filename) {
 
   isRunning = true;
   bool isBusy = true;
-  while (isRunning && (jsiHasTimers() || isBusy))
+  while (shouldKeepRunning(isBusy))
     isBusy = jsiLoop();
 
   JsVar *result = jsvObjectGetChild(execInfo.root, "result", 0 /*no create*/);
@@ -425,7 +441,7 @@ int main(int argc, char **argv) {
         int errCode = handleErrors();
         isRunning = !errCode;
         bool isBusy = true;
-        while (isRunning && (jsiHasTimers() || isBusy))
+        while (shouldKeepRunning(isBusy))
           isBusy = jsiLoop();
         jsiKill();
         jsvKill();
@@ -511,7 +527,7 @@ int main(int argc, char **argv) {
     free(buffer);
     isRunning = !errCode;
     bool isBusy = true;
-    while (isRunning && (jsiHasTimers() || isBusy))
+    while (shouldKeepRunning(isBusy))
       isBusy = jsiLoop();
     jsiKill();
     jsvKill();
@@ -0,0 +1,31 @@
+// 16 bit colour blending (used for antialiasing, fonts and 2 bit images) with 32 levels
+var ok = true;
+function blend(fg, bg, amt) { // per-channel reference
+  var a = (amt+4)>>3;
+  function ch(s, m) { return ((((bg>>s)&m)*(32-a) + ((fg>>s)&m)*a) >> 5) << s; }
+  return ch(11,31) | ch(5,63) | ch(0,31);
+}
+var g = Graphics.createArrayBuffer(16,16,16);
+// 2 bit images are drawn with a palette blended from bg to fg
+var img = {width:4,height:1,bpp:2,buffer:new Uint8Array([0b00011011]).buffer};
+[[0xFFFF,0],[0xF800,0x07FF],[0x1234,0xFEDC],[0x8410,0x8410]].forEach(function(c) {
+  g.setColor(c[0]).setBgColor(c[1]).drawImage(img,0,0);
+  [0,85,171,256].forEach(function(amt, x) {
+    if (g.getPixel(x,0)!=blend(c[0],c[1],amt)) {
+      print("image", c, x, g.getPixel(x,0).toString(16), blend(c[0],c[1],amt).toString(16));
+      ok = false;
+    }
+  });
+});
+// antialiased pixels must be the fg blended onto what was underneath
+if (g.drawLineAA) {
+  var levels = {};
+  for (var a=0;a<=256;a+=8) levels[blend(0xF81F,0x07E0,a)] = 1;
+  g.setBgColor(0x07E0).clear().setColor(0xF81F).drawLineAA(0,1,15,9);
+  for (var y=0;y<16;y++) for (var x=0;x<16;x++)
+    if (!levels[g.getPixel(x,y)]) {
+      print("drawLineAA", x, y, g.getPixel(x,y).toString(16));
+      ok = false;
+    }
+}
+result = ok;
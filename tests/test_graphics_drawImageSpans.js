@@ -0,0 +1,58 @@
+// drawImage into 8 and 16 bit Graphics uses a faster span-based path when not rotated
+// Check it against drawing with the Graphics rotated (which uses the pixel-by-pixel path)
+var ok = true;
+
+function check(bpp, flags, img, x, y) {
+  var a = Graphics.createArrayBuffer(32,24,bpp,flags);
+  var b = Graphics.createArrayBuffer(24,32,bpp,flags);
+  b.setRotation(1);
+  [a,b].forEach(g => {
+    g.setColor(bpp==16 ? 0x1234 : 0x12).fillRect(0,0,31,31);
+    g.setColor(bpp==16 ? 0xFFFF : 0xFF).setBgColor(0);
+    g.drawImage(img, x, y);
+  });
+  for (var py=0;py<24;py++)
+    for (var px=0;px<32;px++)
+      if (a.getPixel(px,py)!=b.getPixel(px,py)) {
+        console.log("bpp",bpp,flags,"at",x,y,"pixel",px,py,"got",a.getPixel(px,py),"expected",b.getPixel(px,py));
+        ok = false;
+        return;
+      }
+  var m = a.getModified(true);
+  if (m.x1>=m.x2) ok = false; // modified area should have been set
+}
+
+var w = 70, h = 10; // more than one span wide
+var img16 = { width:w, height:h, bpp:16, transparent:0x07E0, buffer:new Uint8Array(w*h*2) };
+var img8 = { width:w, height:h, bpp:8, transparent:3, buffer:new Uint8Array(w*h) };
+var img4 = { width:w, height:h, bpp:4, transparent:1, buffer:new Uint8Array(w*h/2) };
+var img1 = { width:w, height:h, bpp:1, buffer:new Uint8Array(Math.ceil(w*h/8)) };
+for (var i=0;i<w*h;i++) {
+  var c = (i*37)&0xFFFF;
+  if ((i%7)==0) c = 0x07E0;
+  img16.buffer[i*2] = c>>8;
+  img16.buffer[i*2+1] = c&255;
+  img8.buffer[i] = (i*13)&255;
+  if ((i&3)==0) img4.buffer[i>>1] = (i*5)&255;
+  if ((i&7)==0) img1.buffer[i>>3] = (i*7)&255;
+}
+img16.buffer = img16.buffer.buffer;
+img8.buffer = img8.buffer.buffer;
+img4.buffer = img4.buffer.buffer;
+img1.buffer = img1.buffer.buffer;
+var img16solid = Object.assign({}, img16);
+delete img16solid.transparent;
+var img2pal = { width:w, height:h, bpp:2, transparent:2, palette:new Uint16Array([0xF800,0x07E0,0x001F,0xFFFF]), buffer:img4.buffer };
+
+[[0,0],[-5,3],[-60,-4],[10,20],[-3,-9],[30,5],[100,100]].forEach(function(p) {
+  check(16, {msb:true}, img16, p[0], p[1]);
+  check(16, {}, img16, p[0], p[1]);
+  check(16, {}, img16solid, p[0], p[1]);
+  check(16, {}, img2pal, p[0], p[1]);
+  check(16, {}, img1, p[0], p[1]);
+  check(8, {}, img8, p[0], p[1]);
+  check(8, {}, img4, p[0], p[1]);
+  check(8, {}, img1, p[0], p[1]);
+});
+
+result = ok;
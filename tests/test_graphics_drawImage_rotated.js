@@ -0,0 +1,36 @@
+// drawImage onto a rotated/reflected Graphics should put every pixel in the same place as setPixel would
+function fill(a,f) { for (var i=0;i<a.length;i++) a[i]=f(i); return a; }
+var W = 13, H = 7;
+var src = fill(new Uint8Array(W*H), i => (i*37)&15); // pixel values, 0 is transparent
+var imgs = [
+  {width:W,height:H,bpp:8,transparent:0,buffer:fill(new Uint8Array(W*H),i=>src[i]).buffer},
+  {width:W,height:H,bpp:16,transparent:0,buffer:fill(new Uint8Array(W*H*2),i=>(i&1)?src[i>>1]:0).buffer}, // MSB first
+  {width:W,height:H,bpp:4,transparent:0,buffer:fill(new Uint8Array(Math.ceil(W*H/2)),i=>(src[i*2]<<4)|src[i*2+1]).buffer}
+];
+var ok = true;
+[8,16,4].forEach(function(bpp) {
+  var g = Graphics.createArrayBuffer(20,16,bpp);
+  imgs.forEach(function(img) {
+    if (img.bpp!=bpp) return; // would need converting with a palette
+    [0,1,2,3].forEach(function(r) { [false,true].forEach(function(reflect) {
+      g.setRotation(r,reflect).setBgColor(1).clear();
+      var px = -3, py = 11; // partly off the edge
+      g.drawImage(img, px, py);
+      var gw = g.getWidth(), gh = g.getHeight();
+      for (var y=0;y<H;y++) for (var x=0;x<W;x++) {
+        var ux = px+x, uy = py+y;
+        if (ux<0 || uy<0 || ux>=gw || uy>=gh) continue;
+        var c = src[x+y*W];
+        if (g.getPixel(ux,uy) != (c ? c : 1)) ok = false;
+      }
+      // nothing else should have been touched
+      var n = 0;
+      for (var y=0;y<gh;y++) for (var x=0;x<gw;x++) if (g.getPixel(x,y)!=1) n++;
+      var expected = 0;
+      for (var y=0;y<H;y++) for (var x=0;x<W;x++)
+        if (px+x>=0 && py+y>=0 && px+x<gw && py+y<gh && src[x+y*W] && src[x+y*W]!=1) expected++;
+      if (n!=expected) ok = false;
+    });});
+  });
+});
+result = ok;
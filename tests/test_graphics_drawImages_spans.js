@@ -0,0 +1,83 @@
+// drawImages with unrotated, unscaled layers composites whole runs of pixels at once - check it against a per-pixel reference
+var ok = true;
+
+function mkLayer(w,h,bpp,pal,opts) {
+  // pack the pixels by hand (MSB first) so we can use any bpp
+  var buf = new Uint8Array((w*h*bpp+7)>>3), bit = 0;
+  var pix = (x,y) => (x*7+y*13+x*y) % (1<<Math.min(bpp,12));
+  for (var y=0;y<h;y++)
+    for (var x=0;x<w;x++) {
+      var c = pix(x,y);
+      for (var b=bpp-1;b>=0;b--,bit++)
+        if ((c>>b)&1) buf[bit>>3] |= 128>>(bit&7);
+    }
+  var img = {width:w,height:h,bpp:bpp,buffer:buf.buffer};
+  if (pal) img.palette = pal;
+  if (opts.transparent!==undefined) img.transparent = opts.transparent;
+  return {src:{getPixel:pix}, img:img, x:opts.x, y:opts.y, repeat:opts.repeat};
+}
+
+var pal8 = new Uint16Array(256);
+for (var i=0;i<256;i++) pal8[i] = i*3+1;
+var layers = [
+  mkLayer(7,5,8,pal8,{x:2,y:1,repeat:true}),
+  mkLayer(30,9,2,new Uint16Array([0,0x1111,0x2222,0x3333]),{x:-3,y:5,transparent:0}),
+  mkLayer(11,4,3,new Uint16Array([0,1,2,3,4,5,6,7].map(c=>c*0x801)),{x:40,y:2,transparent:0}),
+  mkLayer(70,3,1,new Uint16Array([0xF800,0x07E0]),{x:10,y:20,transparent:0}),
+  ];
+var top = mkLayer(5,5,16,undefined,{x:30,y:30,transparent:0x0007});
+
+function refPixel(ls, x, y) {
+  for (var i=ls.length-1;i>=0;i--) {
+    var l = ls[i];
+    var ix = x-l.x, iy = y-l.y;
+    if (l.repeat) {
+      ix = ((ix%l.img.width)+l.img.width)%l.img.width;
+      iy = ((iy%l.img.height)+l.img.height)%l.img.height;
+    }
+    if (ix<0 || iy<0 || ix>=l.img.width || iy>=l.img.height) continue;
+    var c = l.src.getPixel(ix,iy);
+    if (c===l.img.transparent) continue;
+    return l.img.palette ? l.img.palette[c] : c;
+  }
+  return 0xABCD; // not drawn
+}
+
+function check(g, ls, name) {
+  g.setBgColor(0xABCD).clear();
+  g.drawImages(ls.map(l=>({image:l.img,x:l.x,y:l.y,repeat:l.repeat})),{x:0,y:0,width:g.getWidth(),height:g.getHeight()});
+  var mask = (1<<g.getBPP())-1, errors = 0;
+  for (var y=0;y<g.getHeight();y++)
+    for (var x=0;x<g.getWidth();x++)
+      if (g.getPixel(x,y) != (refPixel(ls,x,y)&mask)) errors++;
+  if (errors) {
+    print(name+": "+errors+" pixels wrong");
+    ok = false;
+  }
+}
+
+[layers, [layers[0], layers[3], top]].forEach(function(ls, n) {
+  check(Graphics.createArrayBuffer(100,40,16,{msb:true}), ls, n+" 16bpp");
+  check(Graphics.createArrayBuffer(100,40,8), ls, n+" 8bpp");
+  check(Graphics.createArrayBuffer(100,40,4), ls, n+" 4bpp"); // not blitSpan
+  check(Graphics.createArrayBuffer(40,100,16,{msb:true}).setRotation(1), ls, n+" 16bpp rotated");
+  check(Graphics.createArrayBuffer(100,40,16,{msb:true}).setRotation(2), ls, n+" 16bpp rotated 180");
+});
+
+// Rotated layers mixed in are still drawn a pixel at a time - compare with drawing one layer at a time
+var a = Graphics.createArrayBuffer(100,40,16,{msb:true});
+var b = Graphics.createArrayBuffer(100,40,16,{msb:true});
+var opts = {x:0,y:0,width:100,height:40};
+var mixed = [
+  {image:layers[0].img,x:2,y:1,repeat:true},
+  {image:layers[1].img,x:50,y:20,rotate:0.3,center:true},
+  {image:layers[3].img,x:10,y:20},
+  {image:layers[1].img,x:20,y:10,scale:2}];
+a.drawImages(mixed,opts);
+mixed.forEach(l=>b.drawImages([l],opts));
+if (E.toString(a.buffer)!=E.toString(b.buffer)) {
+  print("mixed layers differ");
+  ok = false;
+}
+
+result = ok;
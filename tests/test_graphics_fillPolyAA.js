@@ -0,0 +1,30 @@
+// fillPolyAA should fill the inside solidly, blend the edges, and leave the outside alone
+var g = Graphics.createArrayBuffer(32,32,8);
+var ok = true;
+function px(x,y) { return g.getPixel(x,y); }
+// pixel-aligned square - exactly the same as fillPoly
+g.clear().setColor(255).fillPolyAA([4,4, 20,4, 20,20, 4,20]);
+var other = 0;
+for (var y=0;y<32;y++) for (var x=0;x<32;x++) {
+  var c = px(x,y), inside = x>=4 && x<20 && y>=4 && y<20;
+  if (inside ? c!=255 : c!=0) other++;
+}
+ok = ok && other==0;
+// half-pixel offset square - edges are 50% blended
+g.clear().fillPolyAA([4,4, 20,4, 20,20, 4,20].map(v=>v+0.5));
+ok = ok && px(10,10)==255 && px(20,10)>=120 && px(20,10)<=136 && px(4,10)>=120 && px(4,10)<=136;
+ok = ok && px(3,10)==0 && px(21,10)==0 && px(10,3)==0;
+ok = ok && px(20,20)>=56 && px(20,20)<=72; // corner is 25%
+// a diagonal edge - intensities should increase across it
+g.clear().fillPolyAA([0,0, 31,0, 0,31]);
+ok = ok && px(2,2)==255 && px(31,31)==0;
+var p = px(15,15);
+ok = ok && p>0 && p<255;
+// total coverage of a triangle should be about its area (31*31/2 pixels)
+var sum = 0;
+for (var y=0;y<32;y++) for (var x=0;x<32;x++) sum += px(x,y);
+ok = ok && Math.abs(sum/255 - 31*31/2) < 8;
+// self-intersecting star (non-zero winding) fills the middle
+g.clear().fillPolyAA([16,1, 25,30, 2,11, 30,11, 7,30]);
+ok = ok && px(16,16)==255 && px(0,0)==0;
+result = ok;
@@ -0,0 +1,30 @@
+// fillRect on flat ArrayBuffers writes whole words at a time - check every bit depth and layout against setPixel
+var ok = true;
+function check(w, h, bpp, opts) {
+  var a = Graphics.createArrayBuffer(w,h,bpp,opts);
+  var b = Graphics.createArrayBuffer(w,h,bpp,opts);
+  var rects = [[0,0,w-1,h-1],[1,1,w-2,h-2],[3,2,3,h-1],[0,5,w-1,5],[5,3,w-5,7],[w-3,0,w+10,h+10],[2,1,9,1],[7,0,40,3]];
+  rects.forEach(function(r,n) {
+    var col = (n*0x5A3C7)&((1<<bpp)-1);
+    if (bpp==32) col = 0x12345678*(n+1);
+    a.setColor(col).fillRect(r[0],r[1],r[2],r[3]);
+    for (var y=r[1];y<=r[3];y++)
+      for (var x=r[0];x<=r[2];x++)
+        b.setPixel(x,y,col);
+    var ba = new Uint8Array(a.buffer), bb = new Uint8Array(b.buffer);
+    for (var i=0;i<ba.length;i++) if (ba[i]!=bb[i]) {
+      console.log(bpp, opts, "rect", r, "byte", i, ba[i], "!=", bb[i]);
+      ok = false;
+      return;
+    }
+  });
+}
+[1,2,4,8,16,24,32].forEach(function(bpp) {
+  check(37,16,bpp);
+  check(64,16,bpp,{msb:true});
+  if (bpp<=16) check(37,16,bpp,{interleavex:true});
+  if (bpp<=16) check(64,16,bpp,{interleavex:true, msb:true});
+});
+check(37,16,1,{vertical_byte:true});
+check(37,16,1,{vertical_byte:true, msb:true});
+result = ok;
@@ -0,0 +1,42 @@
+// getModified should return a list of separate non-overlapping modified rectangles
+var g = Graphics.createArrayBuffer(64,64,8);
+function rectStr(m) {
+  return m.rects.map(r=>r.x1+","+r.y1+","+r.x2+","+r.y2).sort().join(" ");
+}
+function overlaps(a,b) {
+  return a.x1<=b.x2 && a.x2>=b.x1 && a.y1<=b.y2 && a.y2>=b.y1;
+}
+var ok = true;
+// Two opposite corners stay separate
+g.setPixel(0,0).fillRect(50,50,60,55);
+var m = g.getModified(true);
+ok = ok && m.x1==0 && m.y1==0 && m.x2==60 && m.y2==55;
+ok = ok && rectStr(m)=="0,0,0,0 50,50,60,55";
+// Overlapping areas are merged
+g.fillRect(10,10,20,20).fillRect(15,15,25,25);
+ok = ok && rectStr(g.getModified(true))=="10,10,25,25";
+// Pixels next to each other join up into one rect
+for (var x=5;x<30;x++) g.setPixel(x,40);
+ok = ok && rectStr(g.getModified(true))=="5,40,29,40";
+// Too many areas get merged, but still cover everything that was drawn
+var drawn = [];
+for (var i=0;i<20;i++) {
+  var x = (i*37)%60, y = (i*23)%60;
+  g.fillRect(x,y,x+2,y+1);
+  drawn.push({x1:x,y1:y,x2:x+2,y2:y+1});
+}
+m = g.getModified();
+ok = ok && m.rects.length<=4;
+m.rects.forEach(function(a,i) {
+  m.rects.forEach(function(b,j) { if (i!=j && overlaps(a,b)) ok = false; });
+});
+drawn.forEach(function(d) {
+  if (!m.rects.some(r=>d.x1>=r.x1 && d.y1>=r.y1 && d.x2<=r.x2 && d.y2<=r.y2)) ok = false;
+});
+ok = ok && m.x1==Math.min.apply(null,m.rects.map(r=>r.x1)) && m.y2==Math.max.apply(null,m.rects.map(r=>r.y2));
+g.getModified(true);
+ok = ok && g.getModified()===undefined;
+// Off-screen drawing doesn't count, and clipped drawing is clipped
+g.fillRect(-10,-10,-5,-5).fillRect(60,-5,70,3);
+ok = ok && rectStr(g.getModified(true))=="60,0,63,3";
+result = ok;
@@ -0,0 +1,78 @@
+// Text drawn from the glyph cache should be identical to rendering each character directly
+var ok = true;
+// Vector font, including clipping, scaled X/Y, alignment and rotation.
+// CRCs are of the output from before the glyph cache was added
+var g = Graphics.createArrayBuffer(64,48,1);
+var r = [];
+for (var rot=0;rot<4;rot++) {
+  for (var pass=0;pass<2;pass++) { // second pass is all from the cache
+    g.clear().setRotation(rot, rot==2);
+    g.setFont("Vector",13).drawString("Ag%9",-3,2);
+    g.setFont("Vector",22,17).drawString("W@",20,-5);
+    g.setFontAlign(0,0).setFont("Vector",9).drawString("jq\nxy",30,30).setFontAlign(-1,-1);
+    g.setFontVector(11).setFontAlign(-1,-1,90).drawString("ro",50,2).setFontAlign(-1,-1,0);
+    if (pass) r.push(E.CRC32(g.buffer));
+  }
+}
+ok = ok && JSON.stringify(r)=="[2972089501,1406103515,1089119797,1454041124]";
+// Fill the cache so older glyphs get evicted, then check again
+for (var s=10;s<60;s+=3) g.setFont("Vector",s).drawString("Mg8#",0,0);
+g.clear().setRotation(0);
+g.setFont("Vector",13).drawString("Ag%9",-3,2);
+g.setFont("Vector",22,17).drawString("W@",20,-5);
+g.setFontAlign(0,0).setFont("Vector",9).drawString("jq\nxy",30,30).setFontAlign(-1,-1);
+g.setFontVector(11).setFontAlign(-1,-1,90).drawString("ro",50,2).setFontAlign(-1,-1,0);
+ok = ok && E.CRC32(g.buffer)==r[0];
+// Width from the cache matches drawing
+g.setRotation(0).setFont("Vector",20);
+ok = ok && g.stringWidth("Hello")==g.stringWidth("He")+g.stringWidth("llo");
+ok = ok && g.stringWidth(" ")==10;
+
+// Custom fonts - check against a simple JS renderer
+function makeFont(bpp, height, seed, bitmapSeed) {
+  var widths = "", bits = 0;
+  for (var c=0;c<20;c++) { var w = 1+((c*seed)%5); widths += String.fromCharCode(w); bits += w*height*bpp; }
+  var bmp = new Uint8Array((bits+7)>>3);
+  bitmapSeed = bitmapSeed||seed;
+  for (var i=0;i<bmp.length;i++) bmp[i] = (i*bitmapSeed*31)^(i>>2)^bitmapSeed;
+  return {bpp:bpp, height:height, widths:widths, bitmap:E.toString(bmp)};
+}
+function drawRef(f, str, x, y) { // returns a string of which pixels should be set
+  var offsets = [], o = 0;
+  for (var c=0;c<f.widths.length;c++) { offsets.push(o); o += f.widths.charCodeAt(c)*f.height*f.bpp; }
+  var set = {};
+  for (var i=0;i<str.length;i++) {
+    var c = str.charCodeAt(i)-65, w = f.widths.charCodeAt(c), bit = offsets[c];
+    for (var cx=0;cx<w;cx++) for (var cy=0;cy<f.height;cy++) {
+      var v = (f.bitmap.charCodeAt(bit>>3) >> (8-f.bpp-(bit&7))) & ((1<<f.bpp)-1);
+      bit += f.bpp;
+      if (v) set[(x+cx)+","+(y+cy)] = v;
+    }
+    x += w;
+  }
+  return set;
+}
+var cg = Graphics.createArrayBuffer(48,16,8);
+function check(f, str, x, y) {
+  var g = cg;
+  g.setColor(255).setFontCustom(f.bitmap, 65, f.widths, f.height|(f.bpp<<16));
+  for (var pass=0;pass<2;pass++) {
+    g.clear().drawString(str, x, y);
+    var ref = drawRef(f, str, x, y), good = true;
+    for (var py=0;py<16;py++) for (var px=0;px<48;px++) {
+      var p = g.getPixel(px,py), v = ref[px+","+py]|0;
+      if (v ? (p==0 || (v==(1<<f.bpp)-1 && p!=255)) : p!=0) good = false;
+    }
+    if (!good) ok = false;
+  }
+  ok = ok && g.stringWidth(str)==str.split("").reduce((a,c)=>a+f.widths.charCodeAt(c.charCodeAt(0)-65),0);
+}
+var f1 = makeFont(1, 7, 3), f2 = makeFont(2, 5, 7), f4 = makeFont(4, 3, 5);
+check(f1, "ABCDEFGHIJ", 1, 2);
+check(f2, "ABCDEFGHIJ", -2, 3); // 2bpp with glyphs that don't start on a byte boundary
+check(f4, "JIHGFEDCBA", 0, 0);
+// changing the font data (even to a string of the same length) must not use stale glyphs
+check(makeFont(1, 7, 3, 11), "ABCDEFGHIJ", 1, 2);
+check(f1, "ABCDEFGHIJ", 1, 2);
+
+result = ok;
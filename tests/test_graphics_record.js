@@ -0,0 +1,60 @@
+// Graphics.record/replay should draw exactly what the recorded calls would have, and only redraw what changed
+var g1 = Graphics.createArrayBuffer(64,32,8);
+var g2 = Graphics.createArrayBuffer(64,32,8);
+var img = {width:4,height:4,bpp:8,buffer:new Uint8Array([1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16]).buffer};
+var img2 = {width:4,height:4,bpp:8,buffer:new Uint8Array([16,15,14,13,12,11,10,9,8,7,6,5,4,3,2,1]).buffer};
+function draw(g, a) {
+  g.reset().setColor(3).clearRect(0,0,63,31);        // 0,1,2
+  g.setColor(7).fillRect({x:2,y:2,w:20,h:10,r:3});    // 3,4
+  g.setFont("4x6:2").setFontAlign(-1,-1);              // 5,6
+  g.setColor(a.col).drawString(a.text, 5, 20);         // 7,8
+  g.setColor(5).drawLine(0,0,63,31).drawPoly(a.poly,true).fillPoly([40,20,60,20,50,30]); // 9,10,11,12
+  g.fillCircle(30,10,5).drawEllipse(25,15,35,25).setPixel(1,30,12).drawRect(45,15,62,30); // 13,14,15,16
+  g.setFont("Vector",10).drawString(a.num,30,0).drawImage(a.img, 10, 20, {scale:2}); // 17,18,19
+}
+var base = {col:9, text:"12:00", poly:[40,2,60,2,50,14], num:123, img:img};
+var list = g1.record(g => draw(g, base));
+var ok = !g1.getModified(); // nothing drawn while recording
+ok = ok && g1.getColor()==5; // but state did change
+function check(overrides, changes) {
+  var a = Object.assign({}, base, changes);
+  g1.replay(list, overrides);
+  var m = g1.getModified(true);
+  draw(g2, a);
+  ok = ok && E.CRC32(g1.buffer)==E.CRC32(g2.buffer);
+  return m;
+}
+check(undefined, {});
+// nothing changed - nothing drawn
+ok = ok && check(undefined, {})===undefined;
+// only the area of the changed text is redrawn, even though other commands overlap it
+var m = check({8:"12:01"}, {text:"12:01"});
+ok = ok && m.x1==5 && m.y1==20 && m.x2<48 && m.y2<30;
+ok = ok && check({8:"12:01"}, {text:"12:01"})===undefined;
+check({8:["1234567890"]}, {text:"1234567890"}); // text gets bigger, covering later commands
+check(undefined, {}); // back to recorded values
+check({7:1}, {col:1}); // colors
+check({7:"#fff"}, {col:"#fff"});
+check({11:[30,2,50,2,40,14]}, {poly:[30,2,50,2,40,14]}); // polys
+check({18:7}, {num:7}); // numbers
+check({19:img2}, {img:img2}); // images
+check({}, {});
+// all=true redraws everything, and commands outside the clip rect are skipped
+g1.setClipRect(0,0,20,31); g2.setClipRect(0,0,20,31);
+g1.clear(); g2.clear();
+g1.replay(list, {}, true);
+draw(g2, base);
+ok = ok && E.CRC32(g1.buffer)==E.CRC32(g2.buffer);
+g1.setClipRect(0,0,63,31); g2.setClipRect(0,0,63,31);
+// rotated
+g1.setRotation(1); g2.setRotation(1);
+g1.replay(list, {}, true);
+draw(g2, base);
+ok = ok && E.CRC32(g1.buffer)==E.CRC32(g2.buffer);
+check({8:"Rot"}, {text:"Rot"});
+// errors
+try { g1.record(5); ok = false; } catch (e) { }
+try { g1.record(function() { g1.record(function(){}); }); ok = false; } catch (e) { }
+try { g1.replay({}); ok = false; } catch (e) { }
+g1.replay(g1.record(function(){}));
+result = ok;
@@ -0,0 +1,47 @@
+// Graphics.createSDL in headless mode draws to memory, and g.getStats() reports on each flip
+// (only built with USE_LCD_SDL=1 or USE_LCD_SDL=headless)
+if (!Graphics.createSDL) {
+  result = 1;
+} else {
+  var ok = true;
+  var g = Graphics.createSDL(64,32,16,{headless:true});
+  var s = g.getStats();
+  ok = ok && s.headless && s.frames==0;
+  // pixels keep their colour in the Graphics' format
+  g.setColor(0xF800).fillRect(2,2,9,9).setPixel(20,20,0x1234);
+  ok = ok && g.getPixel(5,5)==0xF800 && g.getPixel(20,20)==0x1234 && g.getPixel(0,0)==0;
+  // antialiasing reads back what's there
+  g.setColor(0x07E0).fillPolyAA([30,5, 40,6, 35,15]);
+  ok = ok && g.getPixel(35,8)==0x07E0;
+  g.flip();
+  s = g.getStats();
+  // 64 pixels from fillRect, 1 from setPixel, plus the polygon
+  ok = ok && s.frames==1 && s.pixels>65 && s.pixels<200;
+  // only the modified rectangles are flushed, 4 bytes per pixel
+  ok = ok && s.flushBytes>=(64+1)*4 && s.flushBytes<64*32*4/2;
+  ok = ok && g.getModified()===undefined;
+  // nothing drawn, nothing flushed
+  g.flip();
+  s = g.getStats();
+  ok = ok && s.frames==2 && s.pixels==0 && s.flushBytes==0 && s.frameTime>=0;
+  // images use blitSpan
+  g.drawImage({width:4,height:1,bpp:16,buffer:new Uint8Array([0,1,0,2,0,3,0,4]).buffer},40,20);
+  ok = ok && g.getPixel(40,20)==1 && g.getPixel(43,20)==4;
+  g.flip(true);
+  s = g.getStats();
+  ok = ok && s.frames==3 && s.pixels==4 && s.flushBytes==64*32*4;
+  // other Graphics don't have stats
+  ok = ok && Graphics.createArrayBuffer(8,8,1).getStats()===undefined;
+  // there's only one SDL buffer, so a new instance takes over and the old one stops drawing
+  var old = g;
+  g = Graphics.createSDL(4,4,8,{headless:true});
+  old.setColor(0xFFFF).fillRect(0,0,63,31);
+  ok = ok && old.getStats()===undefined;
+  g.setColor(0x1FF).fillRect(0,0,3,3);
+  ok = ok && g.getPixel(3,3)==0xFF && g.getStats().frames==0;
+  // reassigning the same variable works too
+  g = Graphics.createSDL(8,8,16,{headless:true});
+  g.setColor(0x1234).fillRect(0,0,7,7);
+  ok = ok && g.getPixel(7,7)==0x1234;
+  result = ok;
+}
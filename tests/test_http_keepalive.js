@@ -0,0 +1,48 @@
+// HTTP keep-alive and pipelining server and client test
+
+var result = 0;
+var http = require("http");
+var got = [];
+
+var server = http.createServer(function (req, res) {
+  console.log("Request " + req.url);
+  var body = '';
+  req.on('data', function(data) { body += data; });
+  req.on('end', function() {
+    var reply = req.url + body;
+    res.writeHead(200, {'Content-Type': 'text/plain', 'Content-Length': reply.length });
+    res.end(reply);
+  });
+});
+server.listen(8080);
+
+function request(path, data, callback) {
+  var options = url.parse("http://localhost:8080"+path);
+  options.method = data ? "POST" : "GET";
+  options.keepAlive = true;
+  if (data) options.headers = { "Content-Length" : data.length };
+  var req = http.request(options, function(res) {
+    var body = '';
+    res.on('data', function(data) { body += data; });
+    res.on('close', function() {
+      console.log(">" + body);
+      got.push(body);
+      if (callback) callback();
+    });
+  });
+  req.on('error', function(e) { console.log(">ERROR: " + e.message); });
+  req.end(data);
+}
+
+// these three are pipelined on one connection
+request("/a");
+request("/b", "-post-");
+request("/c", undefined, function() {
+  // and this one reuses it afterwards
+  setTimeout(function() {
+    request("/d", undefined, function() {
+      server.close();
+      result = got.join(",")=="/a,/b-post-,/c,/d";
+    });
+  }, 10);
+});
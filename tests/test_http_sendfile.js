@@ -0,0 +1,78 @@
+// HTTP res.sendFile from Storage, and automatic chunked responses
+
+var result = 0;
+var http = require("http");
+var storage = require("Storage");
+var file = new Array(200).fill("0123456789abcdef").join("");
+storage.write("web.txt", file);
+var big = new Array(1000).fill("The quick brown fox ").join("");
+storage.write("big.txt", big, {compress:true});
+storage.write("gone.txt", big);
+storage.write("same.txt", big);
+var got = {};
+
+var server = http.createServer(function (req, res) {
+  console.log("Request " + req.url);
+  if (req.url=="/stream") { // no Content-Length, so should be sent chunked
+    res.write("Hello ");
+    res.write("World");
+    res.end();
+  } else if (req.url=="/gone.txt") { // file is erased and flash compacted while it's being sent
+    res.sendFile("gone.txt");
+    storage.erase("gone.txt");
+    storage.compact();
+  } else if (req.url=="/same.txt") { // file is rewritten with the same length while it's being sent
+    res.sendFile("same.txt");
+    storage.write("same.txt", big.toUpperCase());
+  } else if (!res.sendFile(req.url.substr(1))) {
+    res.writeHead(404, {'Content-Length':9});
+    res.end("Not found");
+  }
+});
+server.listen(8080);
+
+function request(path, callback) {
+  var options = url.parse("http://localhost:8080"+path);
+  options.keepAlive = true;
+  http.get(options, function(res) {
+    var body = '';
+    res.on('data', function(data) { body += data; });
+    res.on('close', function() {
+      console.log(path, res.statusCode, res.headers, body.length);
+      got[path] = { status : res.statusCode, headers : res.headers, body : body };
+      callback();
+    });
+  }).on('error', function(e) { console.log(">ERROR: " + e.message); });
+}
+
+request("/web.txt", function() {
+  request("/missing.txt", function() {
+    request("/stream", function() {
+     request("/big.txt", function() {
+      request("/gone.txt", function() {
+      request("/same.txt", function() {
+      server.close();
+      storage.erase("web.txt");
+      storage.erase("big.txt");
+      storage.erase("same.txt");
+      var gone = got["/gone.txt"];
+      var same = got["/same.txt"];
+      result = got["/big.txt"].status==200 &&
+               got["/big.txt"].headers["Content-Length"]==big.length &&
+               got["/big.txt"].body==big &&
+               // the response must be cut short, and never contain whatever is now in flash
+               gone.body.length < big.length && big.startsWith(gone.body) &&
+               same.body.length < big.length && big.startsWith(same.body) &&
+               got["/web.txt"].status==200 &&
+               got["/web.txt"].headers["Content-Length"]==file.length &&
+               got["/web.txt"].body==file &&
+               got["/missing.txt"].status==404 &&
+               got["/stream"].headers["Transfer-Encoding"]=="chunked" &&
+               got["/stream"].headers["Connection"]=="keep-alive" &&
+               got["/stream"].body=="Hello World";
+      });
+      });
+     });
+    });
+  });
+});
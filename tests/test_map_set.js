@@ -0,0 +1,101 @@
+// Map and Set - SameValueZero keys, insertion order, hashed lookups
+var ok = true;
+function check(a,b) { if (a!==b) { console.log("Expected "+b+", got "+a); ok = false; } }
+
+var o = {};
+var m = new Map([["a",1],[2,"b"]]);
+check(m.set(o, 3), m);
+m.set(NaN, "nan").set(-0, "zero").set(2.0, "two").set(true, "t").set(null, "n").set(undefined, "u");
+check(m.size, 8);
+check(m.get("a"), 1);
+check(m.get(2), "two");
+check(m.get("2"), undefined);
+check(m.get(o), 3);
+check(m.get({}), undefined);
+check(m.get(NaN), "nan");
+check(m.get(0), "zero");
+check(m.get(1), undefined);
+check(m.get(true), "t");
+check(m.get(null), "n");
+check(m.get(undefined), "u");
+check(1/m.keys()[4], Infinity); // -0 is stored as 0
+check(JSON.stringify(m.keys()), '["a",2,{},null,0,true,null,null]');
+check(m.delete("a"), true);
+check(m.delete("a"), false);
+check(m.size, 7);
+m.set("a", 5); // added again, so now last
+check(JSON.stringify(m.entries()[7]), '["a",5]');
+check(JSON.stringify(m), "{}");
+check(E.toJS(new Map([["x",[1]]])), 'new Map([["x",[1]]])');
+
+var s = new Set([1,2,2,"2",1.0,true,null,undefined,null]);
+check(s.size, 6);
+check(s.add(3), s);
+check(s.has(2) && s.has("2") && !s.has("3") && s.has(undefined), true);
+check(JSON.stringify(s.values()), '[1,2,"2",true,null,null,3]');
+check(E.toJS(new Set([1,"a"])), 'new Set([1,"a"])');
+
+// forEach in insertion order, handling deletes and adds
+var seen = [];
+s.forEach(function(v,k,set) {
+  seen.push(v);
+  if (v===2) set.delete("2");
+  if (v===1) set.add("end");
+});
+check(JSON.stringify(seen), '[1,2,true,null,null,3,"end"]');
+// deleting the current entry and the one after it carries on from the next one left
+seen = [];
+var s2 = new Set([1,2,3,4]);
+s2.forEach(function(v) {
+  seen.push(v);
+  if (v==1) { s2.delete(1); s2.delete(2); }
+});
+check(JSON.stringify(seen), '[1,3,4]');
+seen = [];
+var m2 = new Map([["a",1],["b",2],["c",3]]);
+m2.forEach(function(v,k) {
+  seen.push(k);
+  if (k=="a") { m2.delete("a"); m2.delete("b"); }
+});
+check(JSON.stringify(seen), '["a","c"]');
+// ...and if everything after it was deleted, but something new was added
+seen = [];
+s2 = new Set([1,2,3]);
+s2.forEach(function(v) {
+  seen.push(v);
+  if (v==1) { s2.delete(1); s2.delete(2); s2.delete(3); s2.add(5); }
+});
+check(JSON.stringify(seen), '[1,5]');
+// clear() then add is visited too
+seen = [];
+s2 = new Set([1,2,3]);
+s2.forEach(function(v) {
+  seen.push(v);
+  if (v==1) { s2.clear(); s2.add(7); }
+});
+check(JSON.stringify(seen), '[1,7]');
+
+// lots of entries, deletes, and a defrag (which moves vars the hash table refers to)
+var junk = [];
+for (var i=0;i<2000;i++) junk.push("j"+i);
+var big = new Map();
+for (i=0;i<500;i++) big.set("k"+i, i);
+junk = undefined; // leave gaps for E.defrag to move the Map's vars into
+E.defrag();
+junk = []; // reuse the memory the Map's vars moved out of
+for (i=0;i<2000;i++) junk.push("x"+i);
+junk = undefined;
+for (i=0;i<500;i++) if (big.get("k"+i)!==i) ok = false;
+for (i=0;i<500;i+=2) big.delete("k"+i);
+check(big.size, 250);
+for (i=0;i<500;i++) if (big.has("k"+i) != (i&1)) ok = false;
+var copy = new Map(big);
+check(copy.size, 250);
+check(copy.get("k499"), 499);
+big.clear();
+check(big.size, 0);
+check(big.get("k1"), undefined);
+
+try { m.get.call(s, 1); ok = false; } catch (e) { }
+
+result = ok;
@@ -0,0 +1,27 @@
+// Pipe chunk size grows when the destination takes data quickly, unless chunkSize is given
+
+function source(total) {
+  var n = 0;
+  return { read : function(len) {
+    if (n>=total) return undefined;
+    len = Math.min(len, total-n);
+    n += len;
+    return "x".repeat(len);
+  }};
+}
+function dest(sizes) {
+  return { write : function(d) { sizes.push(d.length); return true; } };
+}
+
+var adaptive = [], fixed = [];
+var done = 0;
+function check() {
+  if (++done < 2) return;
+  var sum = function(a) { return a.reduce(function(a,b){return a+b;},0); };
+  result = sum(adaptive)==8192 && sum(fixed)==8192 &&
+           adaptive[0]==64 && Math.max.apply(null, adaptive)>64 &&
+           fixed.every(function(l) { return l==64; });
+}
+
+E.pipe(source(8192), dest(adaptive), { complete : check });
+E.pipe(source(8192), dest(fixed), { chunkSize : 64, complete : check });
@@ -0,0 +1,33 @@
+// Check that Serial 'coalesce' combines received data into fewer events
+
+var lines = [];
+LoopbackB.setup(9600, {coalesce:{delimiter:"\n", latency:0}});
+LoopbackB.on('data', function(d) { lines.push(d); });
+LoopbackA.write("Hello\nWor");
+LoopbackA.write("ld\nPartial");
+
+var chunks = [];
+LoopbackA.setup(9600, {coalesce:{size:8, latency:20}});
+LoopbackA.on('data', function(d) { chunks.push(d); });
+LoopbackB.write("0123456789");
+
+setTimeout(function() {
+  var ok = lines.length==1 && lines[0]=="Hello\nWorld\n" &&
+           chunks.length==2 && chunks[0]=="01234567" && chunks[1]=="89";
+  if (!ok) return console.log(lines, chunks);
+  /* A delimiter that only delivers part of the buffer mustn't restart the coalescing
+  window - what's left has been waiting since the first byte arrived */
+  var got = [];
+  LoopbackA.setup(9600, {coalesce:{delimiter:"\n", latency:200}});
+  LoopbackA.removeAllListeners('data');
+  LoopbackA.on('data', function(d) { got.push({ d : d, t : getTime()-start }); });
+  var start = getTime();
+  LoopbackB.write("ab");
+  setTimeout(function() { LoopbackB.write("\ncd"); }, 100);
+  setTimeout(function() {
+    result = got.length==2 &&
+             got[0].d=="ab\n" && got[0].t>=0.09 &&
+             got[1].d=="cd" && got[1].t>=0.19 && got[1].t<0.27;
+    if (!result) console.log(got);
+  }, 400);
+}, 100);
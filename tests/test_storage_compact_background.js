@@ -0,0 +1,23 @@
+// Storage should compact itself a bit at a time when idle and full of trash
+var s = require("Storage");
+s.eraseAll();
+var data = "";
+for (var i=0;i<1000;i++) data += String.fromCharCode(48+(i%64));
+// rewrite the same files lots of times so most of Storage is trash
+for (var j=0;j<20;j++)
+  for (var i=0;i<10;i++) s.write("f"+i, data.substr(0,900+i)+j);
+s.write("keep", "hello");
+var before = s.getStats();
+
+setTimeout(function() {
+  var after = s.getStats();
+  var ok = s.read("keep")=="hello";
+  for (var i=0;i<10;i++)
+    ok = ok && s.read("f"+i)==data.substr(0,900+i)+"19";
+  result = ok &&
+           s.list().length==11 &&
+           after.fileCount==before.fileCount &&
+           after.trashBytes < before.trashBytes/2 &&
+           after.freeBytes > before.freeBytes*2;
+  s.eraseAll();
+}, 500);
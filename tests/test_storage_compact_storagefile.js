@@ -0,0 +1,45 @@
+// StorageFiles that are open while Storage compacts itself in the background should still work
+var s = require("Storage");
+s.eraseAll();
+var data = "";
+for (var i=0;i<1000;i++) data += String.fromCharCode(48+(i%64));
+var lines = [];
+for (var i=0;i<200;i++) lines.push("Line "+i+" "+data.substr(0,i%50)+"\n");
+// write the StorageFile in between lots of rewritten files, so its chunks end up among the trash
+var w = s.open("log","w");
+for (var j=0;j<20;j++) {
+  for (var i=0;i<10;i++) w.write(lines[j*10+i]);
+  for (var i=0;i<10;i++) s.write("f"+i, data.substr(0,900+i)+j);
+}
+// open readers part way through each chunk of the file
+var readers = [];
+for (var i=0;i<200;i+=25) {
+  var r = s.open("log","r");
+  for (var j=0;j<i;j++) r.readLine();
+  readers.push({r:r, line:i});
+}
+// where each chunk of the StorageFile is in flash
+function chunkAddrs() {
+  var addrs = [], chunk;
+  for (var c=1;(chunk=s.read("log"+String.fromCharCode(c)))!==undefined;c++)
+    addrs.push(E.getAddressOf(chunk,true));
+  return addrs;
+}
+var before = chunkAddrs();
+
+setTimeout(function() {
+  var after = chunkAddrs();
+  var moved = before.filter(function(a,i) { return a!=after[i]; }).length;
+  // carry on reading and writing where we left off
+  w.write("End\n");
+  lines.push("End\n");
+  var ok = true;
+  readers.forEach(function(rd) {
+    var l;
+    while ((l=rd.r.readLine())!==undefined)
+      ok = ok && l==lines[rd.line++];
+    ok = ok && rd.line==lines.length;
+  });
+  result = ok && moved>0; // make sure compaction did move the file
+  s.eraseAll();
+}, 500);
@@ -0,0 +1,37 @@
+// Files written with {compress:true} should be smaller, and read back transparently
+var s = require("Storage");
+s.eraseAll();
+var data = "";
+for (var i=0;i<5000;i++) data += "Line "+(i%100)+" of some very compressible data\n";
+s.write("big", data, {compress:true});
+s.write("small", "Hi", {compress:true}); // too small to compress - written normally
+var stats = s.getStats();
+
+var ok = s.read("big")==data;
+// reads from the middle - across block boundaries too
+[[0,10],[1000,100],[1020,10],[2047,2],[100000,5000],[data.length-3,10]].forEach(function(r) {
+  ok = ok && s.read("big",r[0],r[1])==data.substr(r[0],r[1]);
+});
+ok = ok && s.read("small")=="Hi";
+ok = ok && stats.fileBytes < data.length/4;
+ok = ok && s.readJSON("big",true)===undefined;
+// StorageFile can read it too
+var f = s.open("big","r");
+var lines = 0, l;
+while ((l=f.readLine())!==undefined) {
+  if (l!="Line "+(lines%100)+" of some very compressible data\n") ok=false;
+  lines++;
+}
+ok = ok && lines==5000 && f.getLength()==data.length;
+// writing part of a compressed file isn't allowed
+try { s.write("big", "x", 5); ok = false; } catch (e) { }
+// JSON
+s.write("json", {a:[1,2,3], b:data.substr(0,2000)}, {compress:true});
+ok = ok && s.readJSON("json").b==data.substr(0,2000);
+// compaction moves compressed files correctly
+s.write("trash", data.substr(0,20000));
+s.erase("trash");
+s.compact();
+ok = ok && s.read("big")==data && s.list().length==3;
+result = ok;
+s.eraseAll();
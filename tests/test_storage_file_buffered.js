@@ -0,0 +1,49 @@
+// StorageFile opened with {buffer:...} keeps small writes in RAM until flushed
+var s = require("Storage");
+s.eraseAll();
+function readAll(name) { return s.open(name||"log","r").read(10000)||""; }
+var ok = true;
+var f = s.open("log","w",{buffer:64, latency:100});
+var expected = "";
+for (var i=0;i<5;i++) {
+  var rec = "rec"+i+"\n";
+  f.write(rec);
+  expected += rec;
+}
+// nothing has been written to flash yet, but getLength knows about it
+ok = ok && readAll()=="" && f.getLength()==expected.length;
+f.flush();
+ok = ok && readAll()==expected && f.getLength()==expected.length;
+// filling the buffer writes (at least some of) it straight away
+for (var i=0;i<20;i++) {
+  var rec = "record number "+i+"\n";
+  f.write(rec);
+  expected += rec;
+}
+var written = readAll();
+ok = ok && written.length>=expected.length-64 && expected.startsWith(written) && f.getLength()==expected.length;
+// bad options
+try { s.open("x","w",{buffer:-1}); ok = false; } catch (e) { }
+// a buffer that keeps filling and emptying still writes everything
+var g = s.open("log2","w",{buffer:4, latency:100});
+for (var i=0;i<21;i++) g.write("abcde");
+var gExpected = new Array(22).join("abcde");
+ok = ok && readAll("log2").length<gExpected.length;
+// the rest gets written 'latency' milliseconds after the first byte was buffered, even if more is written later
+f.write("end");
+expected += "end";
+setTimeout(function() {
+  f.write("more");
+  ok = ok && readAll()!=expected+"more";
+}, 50);
+setTimeout(function() {
+  expected += "more";
+  result = ok && readAll()==expected && readAll("log2")==gExpected;
+  // close() writes anything left straight away
+  f.write("!");
+  result = result && readAll()==expected;
+  f.close();
+  result = result && readAll()==expected+"!";
+  try { f.write("x"); result = false; } catch (e) { }
+  s.eraseAll();
+}, 130);
@@ -0,0 +1,43 @@
+// Check Storage lookups/listing stay right as files are created, replaced, erased and compacted
+var tests=0,testsPass=0;
+function test(a,b) {
+  tests++;
+  if (a===b) testsPass++;
+  else console.log("Test "+tests+" failed: "+JSON.stringify(a)+" vs "+JSON.stringify(b));
+}
+
+var s = require("Storage");
+s.eraseAll();
+var names = [];
+for (var i=0;i<40;i++) {
+  names.push("f"+i);
+  s.write("f"+i, "file "+i);
+}
+test(s.list().join(","), names.join(","));
+var hash = s.hash();
+test(s.read("f17"), "file 17");
+test(s.read("missing"), undefined);
+// replace and erase some, which leaves trash in flash
+for (var i=0;i<40;i+=3) s.write("f"+i, "new "+i);
+for (var i=1;i<40;i+=3) s.erase("f"+i);
+test(s.read("f0"), "new 0");
+test(s.read("f1"), undefined);
+test(s.read("f2"), "file 2");
+test(s.hash()!=hash, true);
+var list = s.list().sort().join(",");
+s.compact();
+test(s.list().sort().join(","), list);
+var ok = true;
+for (var i=0;i<40;i++)
+  if (s.read("f"+i) !== [ "new "+i, undefined, "file "+i ][i%3]) ok = false;
+test(ok, true);
+// file order in list() is the order in flash, so a new file goes at the end
+s.write("zz", "last");
+var l = s.list();
+test(l[l.length-1], "zz");
+test(s.read("zz"), "last");
+s.eraseAll();
+test(s.list().length, 0);
+test(s.read("f2"), undefined);
+
+result = tests==testsPass;